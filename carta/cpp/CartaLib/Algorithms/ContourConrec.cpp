@@ -7,6 +7,7 @@
 #include "IImage.h"
 #include "LineCombiner.h"
 
+#include <algorithm>
 #include <cmath>
 #include <QString>
 #include <QDebug>
@@ -31,7 +32,11 @@ typedef std::vector < double > VD;
    yCoords         ! row coordinates (second index)
    nc              ! number of contour levels
    z               ! contour levels in increasing order
+
+   The rows are kept in memory in the native type of the data (Scalar), so float
+   data is not promoted to double.
 */
+template < typename Scalar >
 static Carta::Lib::Algorithms::ContourConrec::Result
 conrecFaster(
     NdArray::RawViewInterface * view,
@@ -48,10 +53,10 @@ conrecFaster(
     // we will only need two rows in memory at any given time
 //    int nRows = jub - jlb + 1;
     int nCols = iub - ilb + 1;
-    double * rows[2] {
+    Scalar * rows[2] {
         nullptr, nullptr
     };
-    std::vector < double > row1( nCols ), row2( nCols );
+    std::vector < Scalar > row1( nCols ), row2( nCols );
     rows[0] = & row1[0];
     rows[1] = & row2[0];
     int nextRowToReadIn = 0;
@@ -65,8 +70,8 @@ conrecFaster(
         auto rawRowView = view-> getView( rowSlice );
         nextRowToReadIn++;
 
-        // make a double view of this raw row view
-        NdArray::Double dview( rawRowView, true );
+        // make a typed view of this raw row view
+        NdArray::TypedView < Scalar > dview( rawRowView, true );
 
         // shift the row up
         // note: we could avoid this memory copy if we swapped row[] pointers instead,
@@ -74,12 +79,13 @@ conrecFaster(
         // gain and lot more complicated algorithm
         row1 = row2;
 
-        // read in the data into row2
-        int i = 0;
-        dview.forEach([&] ( const double & val ) {
-                          row2[i++] = val;
-                      }
-                      );
+        // read in the data into row2, in contiguous blocks
+        int64_t i = 0;
+        dview.forEach( nCols, [&] ( const Scalar * data, int64_t count ) {
+                           std::copy( data, data + count, row2.begin() + i );
+                           i += count;
+                       }
+                       );
         CARTA_ASSERT( i == nCols );
     };
     updateRows();
@@ -342,8 +348,22 @@ ContourConrec::compute( NdArray::RawViewInterface * view )
         ycoords[row] = row;
     }
 
-    Result result1 =
-        conrecFaster(
+    // float data is processed as float, everything else as double
+    Result result1;
+    if ( view-> pixelType() == Image::PixelType::Real32 ) {
+        result1 = conrecFaster < float > (
+            view,
+            0,
+            m_nCols - 1,
+            0,
+            m_nRows - 1,
+            xcoords,
+            ycoords,
+            m_levels.size(),
+            & sortedRawLevels[0] );
+    }
+    else {
+        result1 = conrecFaster < double > (
             view,
             0,
             m_nCols - 1,
@@ -353,6 +373,7 @@ ContourConrec::compute( NdArray::RawViewInterface * view )
             ycoords,
             m_levels.size(),
             & sortedRawLevels[0] );
+    }
 
     Result result;
     QRectF rect( 0, 0, m_nCols, m_nRows);
@@ -0,0 +1,131 @@
+/**
+ *
+ **/
+
+#include "PermuteAxes.h"
+#include "CartaLib/CartaLib.h"
+#include <algorithm>
+
+namespace Carta
+{
+namespace Lib
+{
+namespace Algorithms
+{
+template < typename T >
+static void
+permuteTyped( const T * src, const std::vector < int > & srcDims,
+              const std::vector < int > & perm, T * dst )
+{
+    size_t nDims = perm.size();
+    CARTA_ASSERT( srcDims.size() == nDims );
+
+    // dimensions of the result, and the distance in the source (srcStrides) and
+    // in the result (dstStrides) between neighbours along each axis of the result
+    std::vector < int64_t > strides( nDims ), srcStrides( nDims ), dstStrides( nDims );
+    std::vector < int > dims( nDims );
+    int64_t total = 1;
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        strides[i] = total;
+        total *= srcDims[i];
+    }
+    if ( total == 0 ) {
+        return;
+    }
+    int64_t dstStride = 1;
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        dims[i] = srcDims[perm[i]];
+        srcStrides[i] = strides[perm[i]];
+        dstStrides[i] = dstStride;
+        dstStride *= dims[i];
+    }
+
+    // find the axis of the result that is contiguous in the source
+    size_t j = 0;
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        if ( dims[i] > 1 && srcStrides[i] == 1 ) {
+            j = i;
+            break;
+        }
+    }
+
+    // visit every combination of the axes other than 0 and j
+    std::vector < int > pos( nDims, 0 );
+    while ( true ) {
+        int64_t srcBase = 0, dstBase = 0;
+        for ( size_t i = 1 ; i < nDims ; i++ ) {
+            srcBase += pos[i] * srcStrides[i];
+            dstBase += pos[i] * dstStrides[i];
+        }
+        const T * s = src + srcBase;
+        T * d = dst + dstBase;
+        if ( j == 0 ) {
+            // the first axis is also the fastest one in the source (or nothing is)
+            for ( int i = 0 ; i < dims[0] ; i++ ) {
+                d[i] = s[i * srcStrides[0]];
+            }
+        }
+        else {
+            // blocked transpose of axes 0 and j
+            int64_t s0 = srcStrides[0], dj = dstStrides[j];
+            for ( int jb = 0 ; jb < dims[j] ; jb += PermuteBlockSize ) {
+                int jEnd = std::min( dims[j], jb + PermuteBlockSize );
+                for ( int ib = 0 ; ib < dims[0] ; ib += PermuteBlockSize ) {
+                    int iEnd = std::min( dims[0], ib + PermuteBlockSize );
+                    for ( int jj = jb ; jj < jEnd ; jj++ ) {
+                        T * dRow = d + jj * dj;
+                        const T * sCol = s + jj;
+                        for ( int ii = ib ; ii < iEnd ; ii++ ) {
+                            dRow[ii] = sCol[ii * s0];
+                        }
+                    }
+                }
+            }
+        }
+
+        // next combination
+        size_t i = 1;
+        for ( ; i < nDims ; i++ ) {
+            if ( i == j ) {
+                continue;
+            }
+            if ( ++pos[i] < dims[i] ) {
+                break;
+            }
+            pos[i] = 0;
+        }
+        if ( i >= nDims ) {
+            break;
+        }
+    }
+} // permuteTyped
+
+void
+permuteAxes( const char * src, const std::vector < int > & srcDims,
+             const std::vector < int > & perm, int elementSize, char * dst )
+{
+    switch ( elementSize )
+    {
+    case 1 :
+        permuteTyped( reinterpret_cast < const uint8_t * > ( src ), srcDims, perm,
+                      reinterpret_cast < uint8_t * > ( dst ) );
+        break;
+    case 2 :
+        permuteTyped( reinterpret_cast < const uint16_t * > ( src ), srcDims, perm,
+                      reinterpret_cast < uint16_t * > ( dst ) );
+        break;
+    case 4 :
+        permuteTyped( reinterpret_cast < const uint32_t * > ( src ), srcDims, perm,
+                      reinterpret_cast < uint32_t * > ( dst ) );
+        break;
+    case 8 :
+        permuteTyped( reinterpret_cast < const uint64_t * > ( src ), srcDims, perm,
+                      reinterpret_cast < uint64_t * > ( dst ) );
+        break;
+    default :
+        CARTA_ASSERT_X( false, "unsupported element size" );
+    } // switch
+} // permuteAxes
+}
+}
+}
@@ -0,0 +1,34 @@
+/**
+ * Copy of an n-dimensional array with its axes permuted (a generalized transpose).
+ *
+ * When the axis that is contiguous in the source is not the first axis of the result,
+ * the copy is done in square blocks of these two axes, so that both the reads and the
+ * writes stay in the cache.
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Carta
+{
+namespace Lib
+{
+namespace Algorithms
+{
+/// size of the blocks (in elements along each of the two axes) used by permuteAxes()
+static constexpr int PermuteBlockSize = 32;
+
+/// copy an array while permuting its axes
+/// \param src source array, first axis fastest
+/// \param srcDims dimensions of the source
+/// \param perm axis i of the result is axis perm[i] of the source
+/// \param elementSize size of the elements in bytes (1, 2, 4 or 8)
+/// \param dst where to store the result, first axis fastest
+void
+permuteAxes( const char * src, const std::vector < int > & srcDims,
+             const std::vector < int > & perm, int elementSize, char * dst );
+}
+}
+}
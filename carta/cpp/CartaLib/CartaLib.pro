@@ -19,6 +19,7 @@ SOURCES += \
     IImage.cpp \
     PixelType.cpp \
     Slice.cpp \
+    PermutedImage.cpp \
     AxisInfo.cpp \
     AxisLabelInfo.cpp \
     AxisDisplayInfo.cpp \
@@ -26,13 +27,15 @@ SOURCES += \
     IPlotLabelGenerator.cpp \
     Hooks/LoadAstroImage.cpp \
     PixelPipeline/CustomizablePixelPipeline.cpp \
+    PixelPipeline/BatchConvert.cpp \
     PWLinear.cpp \
     VectorGraphics/VGList.cpp \
     VectorGraphics/BetterQPainter.cpp \
     Algorithms/ContourConrec.cpp \
     IWcsGridRenderService.cpp \
     ContourSet.cpp \
-    Algorithms/LineCombiner.cpp
+    Algorithms/LineCombiner.cpp \
+    Algorithms/PermuteAxes.cpp
 
 HEADERS += \
     CartaLib.h\
@@ -48,6 +51,7 @@ HEADERS += \
     PixelType.h \
     Nullable.h \
     Slice.h \
+    PermutedImage.h \
     AxisInfo.h \
     AxisLabelInfo.h \
     AxisDisplayInfo.h \
@@ -57,6 +61,7 @@ HEADERS += \
     TPixelPipeline/IScalar2Scalar.h \
     PixelPipeline/IPixelPipeline.h \
     PixelPipeline/CustomizablePixelPipeline.h \
+    PixelPipeline/BatchConvert.h \
     PWLinear.h \
     VectorGraphics/VGList.h \
     Hooks/GetWcsGridRenderer.h \
@@ -66,7 +71,8 @@ HEADERS += \
     IWcsGridRenderService.h \
     IContourGeneratorService.h \
     ContourSet.h \
-    Algorithms/LineCombiner.h
+    Algorithms/LineCombiner.h \
+    Algorithms/PermuteAxes.h
 
 unix {
     target.path = /usr/lib
@@ -5,6 +5,7 @@
 /// plugins that only declare but don't define methods compile just fine... :(
 
 #include "IImage.h"
+#include <algorithm>
 
 const Unit &Image::ImageInterface::getPixelUnit() const
 {
@@ -55,6 +56,60 @@ NdArray::RawViewInterface * Image::ImageInterface::getErrorSlice(const SliceND &
     qFatal( "Calling unimplemented virtual function... ");
 }
 
+/// make a slice selecting a single index on every axis from firstAxis on
+static SliceND pointSlice( const Image::ImageInterface::VI & pos, size_t firstAxis )
+{
+    SliceND slice;
+    for ( size_t i = 0; i < pos.size(); i++ ) {
+        if ( i >= firstAxis ) {
+            slice.start( pos[i] ).end( pos[i] + 1 );
+        }
+        if ( i + 1 < pos.size() ) {
+            slice.next();
+        }
+    }
+    return slice;
+}
+
+/// is pos inside of the image, checking axes from firstAxis on
+static bool isInside( const Image::ImageInterface::VI & pos, const Image::ImageInterface::VI & dims,
+                      size_t firstAxis )
+{
+    if ( pos.size() != dims.size() || dims.empty() ) {
+        return false;
+    }
+    for ( size_t i = firstAxis; i < pos.size(); i++ ) {
+        if ( pos[i] < 0 || pos[i] >= dims[i] ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Image::ImageInterface::getPixel( const VI & pos, double & value )
+{
+    if ( ! isInside( pos, dims(), 0 ) ) {
+        return false;
+    }
+    std::unique_ptr < NdArray::RawViewInterface > view( getDataSlice( pointSlice( pos, 0 ) ) );
+    NdArray::TypedView < double > typedView( view.get(), false );
+    value = typedView.get( VI( pos.size(), 0 ) );
+    return true;
+}
+
+bool Image::ImageInterface::getRow( const VI & pos, double * row )
+{
+    if ( ! isInside( pos, dims(), 1 ) ) {
+        return false;
+    }
+    std::unique_ptr < NdArray::RawViewInterface > view( getDataSlice( pointSlice( pos, 1 ) ) );
+    NdArray::TypedView < double > typedView( view.get(), false );
+    typedView.forEach( dims()[0], [& row] ( const double * data, int64_t count ) {
+        row = std::copy( data, data + count, row );
+    });
+    return true;
+}
+
 Image::MetaDataInterface::SharedPtr Image::ImageInterface::metaData()
 {
     qFatal( "Calling unimplemented virtual function... ");
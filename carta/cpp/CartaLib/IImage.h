@@ -30,7 +30,9 @@
 #include <functional>
 #include <initializer_list>
 #include <cstdint>
+#include <cstring>
 #include <memory>
+#include <vector>
 
 /// description of a unit
 /// this will hopefully evolve a lot...
@@ -152,6 +154,12 @@ public:
     /// but the supplied function gets called with multiple pixel data
     /// (however many fit into the buffer)
     ///
+    /// \param buffSize max number of bytes passed to func in one call
+    /// \param func called with the data and the number of elements (not bytes)
+    /// \param buff optional buffer to use, if not supplied the data passed to func
+    /// may point into internal storage, and is only valid during the call
+    /// \param traversal order of traversal
+    ///
     /// I think I like this one the most.
     virtual void
     forEach( int64_t buffSize,
@@ -211,6 +219,42 @@ public:
         m_rawView->forEach( wrapper, traversal );
     }
 
+    /// typed version of RawViewInterface::forEach(buffSize, ...)
+    /// \param chunkSize max number of elements passed to func in one call
+    /// \param func called with contiguous blocks of elements and their count
+    /// \param traversal order of traversal
+    ///
+    /// If the view already contains data of this type, the blocks are passed to func
+    /// without any conversion.
+    void
+    forEach(
+        int64_t chunkSize,
+        std::function < void (const Type *, int64_t) > func,
+        RawViewInterface::Traversal traversal = RawViewInterface::Traversal::Sequential )
+    {
+        Image::PixelType srcType = m_rawView-> pixelType();
+        int64_t srcSize = Image::pixelType2size( srcType );
+        Q_ASSERT( srcSize > 0 );
+        if ( srcType == Image::CType2PixelType < Type >::type ) {
+            auto wrapper = [& func] ( const char * ptr, int64_t count )->void
+            {
+                func( reinterpret_cast < const Type * > ( ptr ), count );
+            };
+            m_rawView-> forEach( chunkSize * srcSize, wrapper, nullptr, traversal );
+            return;
+        }
+        std::vector < Type > converted;
+        auto wrapper = [this, & func, & converted, srcSize] ( const char * ptr, int64_t count )->void
+        {
+            converted.resize( count );
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                converted[i] = m_converterFunc( ptr + i * srcSize );
+            }
+            func( converted.data(), count );
+        };
+        m_rawView-> forEach( chunkSize * srcSize, wrapper, nullptr, traversal );
+    }
+
     ~TypedView()
     {
         if ( m_keepOwnership ) {
@@ -376,11 +420,48 @@ public:
     virtual NdArray::RawViewInterface  *
     getErrorSlice( const SliceND & sliceInfo) = 0;
 
+    /// \brief point query: read a single pixel, converted to double
+    /// \param pos position of the pixel, one index per axis
+    /// \param value where to store the result
+    /// \return false if pos is outside of the image
+    /// \note the default implementation creates a view with getDataSlice(), image
+    /// types with faster random access should override it
+    virtual bool
+    getPixel( const VI & pos, double & value );
+
+    /// \brief read a row of pixels (along the first axis), converted to double
+    /// \param pos position of the row, one index per axis, pos[0] is ignored
+    /// \param row where to store dims()[0] values
+    /// \return false if pos is outside of the image
+    /// \note the default implementation creates a view with getDataSlice(), overrides
+    /// can read narrower pixels into row and convert them with widenRow()
+    virtual bool
+    getRow( const VI & pos, double * row );
+
     /// return a pointer to a meta data object, which is essentially a collection
     /// of algorithms that allows us to do useful things with metadata stored with
     /// the image
     virtual Image::MetaDataInterface::SharedPtr
     metaData() = 0;
+
+protected:
+
+    /// convert count values of type T, stored one after another at the start of row,
+    /// to doubles in place, so that getRow() does not need a buffer of its own
+    template < typename T >
+    static void
+    widenRow( double * row, int64_t count )
+    {
+        static_assert( sizeof( T ) <= sizeof( double ), "values must fit into doubles" );
+
+        // backwards, so that every value is read before its bytes are overwritten
+        const char * packed = reinterpret_cast < const char * > ( row );
+        for ( int64_t i = count - 1 ; i >= 0 ; --i ) {
+            T value;
+            std::memcpy( & value, packed + i * sizeof( T ), sizeof( T ) );
+            row[i] = value;
+        }
+    }
 };
 } // namespace Image
 
@@ -0,0 +1,295 @@
+/**
+ *
+ **/
+
+#include "PermutedImage.h"
+#include "Algorithms/PermuteAxes.h"
+#include <algorithm>
+
+namespace Carta
+{
+namespace Lib
+{
+PermutedView::PermutedView( NdArray::RawViewInterface * srcView, const VI & perm )
+    : m_srcView( srcView ), m_perm( perm )
+{
+    CARTA_ASSERT( srcView != nullptr );
+    const VI & srcDims = m_srcView-> dims();
+    CARTA_ASSERT( srcDims.size() == perm.size() );
+    m_dims.resize( perm.size() );
+    for ( size_t i = 0 ; i < perm.size() ; i++ ) {
+        m_dims[i] = srcDims[perm[i]];
+    }
+    m_currentPos.resize( perm.size(), 0 );
+    m_srcPos.resize( perm.size(), 0 );
+    m_elementSize = Image::pixelType2size( m_srcView-> pixelType() );
+}
+
+SliceND
+PermutedView::sourceSlice( const SliceND & sliceInfo, const VI & perm )
+{
+    SliceND in = sliceInfo;
+    SliceND out;
+    for ( size_t i = 0 ; i < perm.size() ; i++ ) {
+        out.slice( perm[i] ) = in.slice( i );
+    }
+
+    // keep any extra slices, so that applying the result fails the same way
+    for ( int i = perm.size() ; i < in.dims() ; i++ ) {
+        out.slice( i ) = in.slice( i );
+    }
+    return out;
+}
+
+const char *
+PermutedView::get( const VI & pos )
+{
+    std::fill( m_srcPos.begin(), m_srcPos.end(), 0 );
+    for ( size_t i = 0 ; i < pos.size() && i < m_perm.size() ; i++ ) {
+        m_srcPos[m_perm[i]] = pos[i];
+    }
+    return m_srcView-> get( m_srcPos );
+}
+
+void
+PermutedView::forEach(
+    std::function < void (const char *) > func,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    if ( traversal == Traversal::Optimal || isSourceOrder() ) {
+        m_srcView-> forEach( func, traversal );
+        return;
+    }
+
+    // visit the elements block by block
+    int elementSize = m_elementSize;
+    auto chunkFunc = [&func, elementSize] ( const char * data, int64_t count ) {
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            func( data + i * elementSize );
+        }
+    };
+    forEach( DefaultChunkSize * elementSize, chunkFunc, nullptr, traversal );
+}
+
+NdArray::RawViewInterface *
+PermutedView::getView( const SliceND & sliceInfo )
+{
+    return new PermutedView( m_srcView-> getView( sourceSlice( sliceInfo, m_perm ) ), m_perm );
+}
+
+int64_t
+PermutedView::read( int64_t buffSize, char * buff,
+                    NdArray::RawViewInterface::Traversal traversal )
+{
+    Q_UNUSED( traversal );
+    int64_t count = readElements( m_readPos, buffSize / m_elementSize, buff );
+    m_readPos += count;
+    return count * m_elementSize;
+}
+
+int64_t
+PermutedView::read( int64_t chunk, int64_t buffSize, char * buff,
+                    NdArray::RawViewInterface::Traversal traversal )
+{
+    Q_UNUSED( traversal );
+    int64_t chunkSize = buffSize / m_elementSize;
+    int64_t count = readElements( chunk * chunkSize, chunkSize, buff );
+    return count * m_elementSize;
+}
+
+void
+PermutedView::forEach(
+    int64_t buffSize,
+    std::function < void (const char *, int64_t count) > func,
+    char * buff,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    // the order of the source is fine, so let it do the work
+    if ( traversal == Traversal::Optimal || isSourceOrder() ) {
+        m_srcView-> forEach( buffSize, func, buff, traversal );
+        return;
+    }
+
+    CARTA_ASSERT( buffSize >= m_elementSize );
+    int64_t maxElements = buffSize / m_elementSize;
+    int64_t total = nElements();
+    std::vector < char > localBuff;
+    if ( ! buff && total > 0 ) {
+        localBuff.resize( std::min( maxElements, total ) * m_elementSize );
+        buff = localBuff.data();
+    }
+    for ( int64_t start = 0 ; start < total ; start += maxElements ) {
+        int64_t count = readElements( start, maxElements, buff );
+        func( buff, count );
+    }
+} // forEach
+
+bool
+PermutedView::isSourceOrder() const
+{
+    int last = - 1;
+    for ( size_t i = 0 ; i < m_perm.size() ; i++ ) {
+        if ( m_dims[i] > 1 ) {
+            if ( m_perm[i] < last ) {
+                return false;
+            }
+            last = m_perm[i];
+        }
+    }
+    return true;
+}
+
+int64_t
+PermutedView::nElements() const
+{
+    int64_t result = 1;
+    for ( auto dim : m_dims ) {
+        result *= dim;
+    }
+    return result;
+}
+
+int64_t
+PermutedView::readElements( int64_t start, int64_t count, char * out )
+{
+    int64_t total = nElements();
+    if ( start < 0 || start >= total || count <= 0 ) {
+        return 0;
+    }
+    count = std::min( count, total - start );
+
+    if ( isSourceOrder() ) {
+        m_srcView-> seek( start );
+        return m_srcView-> read( count * m_elementSize, out ) / m_elementSize;
+    }
+
+    // position of the first element in view coordinates
+    size_t nDims = m_dims.size();
+    VI pos( nDims );
+    int64_t rest = start;
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        pos[i] = rest % m_dims[i];
+        rest /= m_dims[i];
+    }
+
+    // the range is read as a few boxes, each as large as possible while still
+    // contiguous in the sequential order (a partial row, complete rows, complete
+    // planes, ..., then the same in reverse towards the end of the range), and each
+    // box is read from the source in the source order, then reordered
+    int64_t done = 0;
+    VI srcBoxDims( nDims );
+    while ( done < count ) {
+        int64_t remaining = count - done;
+        size_t k = 0;
+        int64_t plane = 1;
+        while ( k + 1 < nDims && pos[k] == 0 && plane * m_dims[k] <= remaining ) {
+            plane *= m_dims[k];
+            k++;
+        }
+        int64_t len = std::min < int64_t > ( m_dims[k] - pos[k], remaining / plane );
+
+        SliceND srcSlice;
+        for ( size_t i = 0 ; i < nDims ; i++ ) {
+            int lo = i < k ? 0 : pos[i];
+            int n = i < k ? m_dims[i] : ( i == k ? len : 1 );
+            srcSlice.slice( m_perm[i] ).start( lo ).end( lo + n );
+            srcBoxDims[m_perm[i]] = n;
+        }
+        std::unique_ptr < NdArray::RawViewInterface > boxView( m_srcView-> getView( srcSlice ) );
+        int64_t boxBytes = len * plane * m_elementSize;
+        m_box.resize( boxBytes );
+        m_chunk.resize( boxBytes );
+
+        // the source may deliver the box in several chunks, all of them in its own buffer
+        char * dst = m_box.data();
+        char * boxEnd = dst + boxBytes;
+        boxView-> forEach( boxBytes, [&dst, boxEnd, this] ( const char * data, int64_t n ) {
+                               int64_t bytes = std::min < int64_t > ( n * m_elementSize,
+                                                                      boxEnd - dst );
+                               std::copy( data, data + bytes, dst );
+                               dst += bytes;
+                           }, m_chunk.data() );
+        Algorithms::permuteAxes( m_box.data(), srcBoxDims, m_perm, m_elementSize,
+                                 out + done * m_elementSize );
+        done += len * plane;
+
+        // advance the position, with carry into the higher axes
+        pos[k] += len;
+        for ( size_t i = k ; i + 1 < nDims && pos[i] == m_dims[i] ; i++ ) {
+            pos[i] = 0;
+            pos[i + 1]++;
+        }
+    }
+    return count;
+} // readElements
+
+PermutedImage::PermutedImage( Image::ImageInterface::SharedPtr source, const VI & perm,
+                              Image::MetaDataInterface::SharedPtr metaData )
+    : m_source( source ), m_perm( perm ), m_metaData( metaData )
+{
+    CARTA_ASSERT( source );
+    const VI & srcDims = m_source-> dims();
+    CARTA_ASSERT( srcDims.size() == perm.size() );
+    m_dims.resize( perm.size() );
+    for ( size_t i = 0 ; i < perm.size() ; i++ ) {
+        m_dims[i] = srcDims[perm[i]];
+    }
+}
+
+std::shared_ptr < Image::ImageInterface >
+PermutedImage::getPermuted( const std::vector < int > & indices )
+{
+    CARTA_ASSERT( indices.size() == m_perm.size() );
+    VI composed( indices.size() );
+    for ( size_t i = 0 ; i < indices.size() ; i++ ) {
+        composed[i] = m_perm[indices[i]];
+    }
+    return m_source-> getPermuted( composed );
+}
+
+NdArray::RawViewInterface *
+PermutedImage::getDataSlice( const SliceND & sliceInfo )
+{
+    return new PermutedView( m_source-> getDataSlice(
+                                 PermutedView::sourceSlice( sliceInfo, m_perm ) ), m_perm );
+}
+
+NdArray::RawViewInterface *
+PermutedImage::getErrorSlice( const SliceND & sliceInfo )
+{
+    return new PermutedView( m_source-> getErrorSlice(
+                                 PermutedView::sourceSlice( sliceInfo, m_perm ) ), m_perm );
+}
+
+bool
+PermutedImage::getPixel( const VI & pos, double & value )
+{
+    if ( pos.size() != m_perm.size() ) {
+        return false;
+    }
+    return m_source-> getPixel( sourcePos( pos ), value );
+}
+
+bool
+PermutedImage::getRow( const VI & pos, double * row )
+{
+    if ( pos.size() != m_perm.size() ) {
+        return false;
+    }
+    if ( ! m_perm.empty() && m_perm[0] == 0 ) {
+        return m_source-> getRow( sourcePos( pos ), row );
+    }
+    return Image::ImageInterface::getRow( pos, row );
+}
+
+PermutedImage::VI
+PermutedImage::sourcePos( const VI & pos ) const
+{
+    VI result( pos.size() );
+    for ( size_t i = 0 ; i < pos.size() ; i++ ) {
+        result[m_perm[i]] = pos[i];
+    }
+    return result;
+}
+}
+}
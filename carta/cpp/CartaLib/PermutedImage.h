@@ -0,0 +1,223 @@
+/**
+ * Image and view adaptors that present another image with its axes permuted.
+ *
+ * Nothing is copied when the adaptors are created. Slices of the permuted image are
+ * translated into slices of the source image, and only the data that is actually read
+ * is reordered:
+ *
+ *   - Traversal::Optimal reads are passed straight to the source view, since the order
+ *     does not matter.
+ *   - Traversal::Sequential reads are passed straight to the source view as well, if
+ *     the permutation does not change the order of the axes that have more than one
+ *     element (e.g. a single plane with the frame axes moved around).
+ *   - Otherwise the requested range is read from the source in boxes, and each box is
+ *     reordered with the cache-blocked Algorithms::permuteAxes().
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include <memory>
+#include <vector>
+
+namespace Carta
+{
+namespace Lib
+{
+/// view of another view with permuted axes
+class PermutedView
+    : public NdArray::RawViewInterface
+{
+    CLASS_BOILERPLATE( PermutedView );
+
+public:
+
+    /// \param srcView the view to permute, this instance takes ownership of it
+    /// \param perm axis i of this view is axis perm[i] of srcView
+    PermutedView( NdArray::RawViewInterface * srcView, const VI & perm );
+
+    virtual PixelType
+    pixelType() override
+    {
+        return m_srcView-> pixelType();
+    }
+
+    virtual const VI &
+    dims() override
+    {
+        return m_dims;
+    }
+
+    virtual const char *
+    get( const VI & pos ) override;
+
+    virtual void
+    forEach( std::function < void (const char *) > func,
+             Traversal traversal = Traversal::Sequential ) override;
+
+    virtual const VI &
+    currentPos() override
+    {
+        return m_currentPos;
+    }
+
+    virtual RawViewInterface *
+    getView( const SliceND & sliceInfo ) override;
+
+    virtual int64_t
+    read( int64_t buffSize, char * buff,
+          Traversal traversal = Traversal::Sequential ) override;
+
+    virtual void
+    seek( int64_t ind = 0 ) override
+    {
+        m_readPos = ind;
+    }
+
+    virtual int64_t
+    read( int64_t chunk, int64_t buffSize, char * buff,
+          Traversal traversal = Traversal::Sequential ) override;
+
+    virtual void
+    forEach( int64_t buffSize,
+             std::function < void (const char *, int64_t count) > func,
+             char * buff = nullptr,
+             Traversal traversal = Traversal::Sequential ) override;
+
+    /// translate a slice of the permuted array into a slice of the source array
+    static SliceND
+    sourceSlice( const SliceND & sliceInfo, const VI & perm );
+
+protected:
+
+    /// default block size (in elements) used by the element-wise forEach()
+    static constexpr int64_t DefaultChunkSize = 1024 * 1024;
+
+    /// does sequential order of this view match the sequential order of the source?
+    bool
+    isSourceOrder() const;
+
+    /// total number of elements in the view
+    int64_t
+    nElements() const;
+
+    /// read elements [start, start+count) of the view in sequential order
+    /// \return number of elements read
+    int64_t
+    readElements( int64_t start, int64_t count, char * out );
+
+    std::unique_ptr < NdArray::RawViewInterface > m_srcView;
+    VI m_perm, m_dims, m_currentPos, m_srcPos;
+    int m_elementSize = 0;
+
+    /// buffer for the boxes read from the source
+    std::vector < char > m_box;
+
+    /// buffer the source reads the chunks of a box into
+    std::vector < char > m_chunk;
+
+    // position (in elements) of the next stateful read()
+    int64_t m_readPos = 0;
+};
+
+/// image with permuted axes, reading the data from another image
+class PermutedImage
+    : public Image::ImageInterface
+{
+    CLASS_BOILERPLATE( PermutedImage );
+
+public:
+
+    /// \param source the image to permute
+    /// \param perm axis i of this image is axis perm[i] of source
+    /// \param metaData meta data describing the permuted axes
+    PermutedImage( Image::ImageInterface::SharedPtr source, const VI & perm,
+                   Image::MetaDataInterface::SharedPtr metaData );
+
+    virtual const Unit &
+    getPixelUnit() const override
+    {
+        return m_source-> getPixelUnit();
+    }
+
+    /// permutes the source image instead of stacking adaptors
+    virtual std::shared_ptr < Image::ImageInterface >
+    getPermuted( const std::vector < int > & indices ) override;
+
+    virtual const VI &
+    dims() const override
+    {
+        return m_dims;
+    }
+
+    /// masks are not permuted, so there is no mask
+    virtual bool
+    hasMask() const override
+    {
+        return false;
+    }
+
+    virtual bool
+    hasErrorsInfo() const override
+    {
+        return m_source-> hasErrorsInfo();
+    }
+
+    virtual PixelType
+    pixelType() const override
+    {
+        return m_source-> pixelType();
+    }
+
+    virtual PixelType
+    errorType() const override
+    {
+        return m_source-> errorType();
+    }
+
+    virtual NdArray::RawViewInterface *
+    getDataSlice( const SliceND & sliceInfo ) override;
+
+    virtual NdArray::Byte *
+    getMaskSlice( const SliceND & sliceInfo ) override
+    {
+        Q_UNUSED( sliceInfo );
+        return nullptr;
+    }
+
+    virtual NdArray::RawViewInterface *
+    getErrorSlice( const SliceND & sliceInfo ) override;
+
+    virtual bool
+    getPixel( const VI & pos, double & value ) override;
+
+    /// rows along the first axis of the source are read from the source directly
+    virtual bool
+    getRow( const VI & pos, double * row ) override;
+
+    virtual Image::MetaDataInterface::SharedPtr
+    metaData() override
+    {
+        return m_metaData;
+    }
+
+    /// the image this one reads from
+    Image::ImageInterface::SharedPtr
+    source() const
+    {
+        return m_source;
+    }
+
+protected:
+
+    /// translate a position in this image to a position in the source
+    VI
+    sourcePos( const VI & pos ) const;
+
+    Image::ImageInterface::SharedPtr m_source;
+    VI m_perm, m_dims;
+    Image::MetaDataInterface::SharedPtr m_metaData;
+};
+}
+}
@@ -0,0 +1,329 @@
+/**
+ *
+ **/
+
+#include "BatchConvert.h"
+#include "CartaLib/CartaLib.h"
+#include <cmath>
+
+// SSE2 is part of x86-64, so those kernels are always compiled in there. AVX2 kernels
+// are compiled with a target attribute and only used if the CPU supports them. Older
+// gcc (< 4.9) did not allow intrinsics in such functions without -mavx2.
+#if defined ( __GNUC__ ) && defined ( __x86_64__ )
+#define CARTA_BATCH_SSE2 1
+#include <emmintrin.h>
+#if defined ( __clang__ ) || __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 9 )
+#define CARTA_BATCH_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+namespace Carta
+{
+namespace Lib
+{
+namespace PixelPipeline
+{
+namespace Batch
+{
+namespace
+{
+/// pack channels in range 0..255 into an opaque QRgb
+inline QRgb
+packRgb( int r, int g, int b )
+{
+    return 0xff000000u | ( r << 16 ) | ( g << 8 ) | b;
+}
+
+/// scalar kernel, also used for the leftovers by the vectorized kernels
+template < bool interpolated, typename Scalar >
+void
+convertScalar( const Lut & lut, const Scalar * in, QRgb * out, int64_t count, QRgb nanColor )
+{
+    const double n1 = lut.n1;
+    for ( int64_t i = 0 ; i < count ; ++i ) {
+        double x = in[i];
+        if ( std::isnan( x ) ) {
+            out[i] = nanColor;
+            continue;
+        }
+        double t = ( x - lut.min ) * lut.invDelta;
+        t = t < 0 ? 0 : ( t > n1 ? n1 : t );
+        if ( ! interpolated ) {
+            out[i] = lut.qrgb[int64_t( t + 0.5 )];
+            continue;
+        }
+        double ind = std::min( double ( int64_t( t ) ), n1 - 1 );
+        double frac = t - ind;
+        int64_t k = ind;
+        double r = lut.red[k] * ( 1 - frac ) + lut.red[k + 1] * frac;
+        double g = lut.green[k] * ( 1 - frac ) + lut.green[k + 1] * frac;
+        double b = lut.blue[k] * ( 1 - frac ) + lut.blue[k + 1] * frac;
+        out[i] = packRgb( int (r + 0.5), int (g + 0.5), int (b + 0.5) );
+    }
+} // convertScalar
+
+#ifdef CARTA_BATCH_SSE2
+
+/// SSE2 kernel for 2 doubles, the results end up in the low 64 bits
+template < bool interpolated >
+inline __m128i
+convert2Sse2( const Lut & lut, __m128d x, __m128i nanColor )
+{
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d half = _mm_set1_pd( 0.5 );
+    const __m128d n1 = _mm_set1_pd( double ( lut.n1 ) );
+
+    // clamp, note that max() returns the second operand (0) for NaNs
+    __m128d nanMask = _mm_cmpunord_pd( x, x );
+    __m128d t = _mm_mul_pd( _mm_sub_pd( x, _mm_set1_pd( lut.min ) ), _mm_set1_pd( lut.invDelta ) );
+    t = _mm_min_pd( _mm_max_pd( t, zero ), n1 );
+
+    __m128i rgb;
+    if ( ! interpolated ) {
+        __m128i ind = _mm_cvttpd_epi32( _mm_add_pd( t, half ) );
+        rgb = _mm_set_epi32( 0, 0,
+                             lut.qrgb[_mm_cvtsi128_si32( _mm_shuffle_epi32( ind, 1 ) )],
+                             lut.qrgb[_mm_cvtsi128_si32( ind )] );
+    }
+    else {
+        __m128d ind = _mm_cvtepi32_pd( _mm_cvttpd_epi32( t ) );
+        ind = _mm_min_pd( ind, _mm_sub_pd( n1, _mm_set1_pd( 1.0 ) ) );
+        __m128d frac = _mm_sub_pd( t, ind );
+        __m128d frac1 = _mm_sub_pd( _mm_set1_pd( 1.0 ), frac );
+        __m128i indi = _mm_cvttpd_epi32( ind );
+        int k0 = _mm_cvtsi128_si32( indi );
+        int k1 = _mm_cvtsi128_si32( _mm_shuffle_epi32( indi, 1 ) );
+
+        auto channel = [&] ( const std::vector < double > & c ) -> __m128i {
+            __m128d a = _mm_set_pd( c[k1], c[k0] );
+            __m128d b = _mm_set_pd( c[k1 + 1], c[k0 + 1] );
+            __m128d v = _mm_add_pd( _mm_mul_pd( a, frac1 ), _mm_mul_pd( b, frac ) );
+            return _mm_cvttpd_epi32( _mm_add_pd( v, half ) );
+        };
+        rgb = _mm_or_si128( _mm_slli_epi32( channel( lut.red ), 16 ),
+                            _mm_slli_epi32( channel( lut.green ), 8 ) );
+        rgb = _mm_or_si128( rgb, channel( lut.blue ) );
+        rgb = _mm_or_si128( rgb, _mm_set1_epi32( int (0xff000000u) ) );
+    }
+
+    // replace NaNs with nan color
+    __m128i mask = _mm_shuffle_epi32( _mm_castpd_si128( nanMask ), _MM_SHUFFLE( 3, 3, 2, 0 ) );
+    return _mm_or_si128( _mm_and_si128( mask, nanColor ), _mm_andnot_si128( mask, rgb ) );
+} // convert2Sse2
+
+template < bool interpolated >
+void
+convertSse2( const Lut & lut, const double * in, QRgb * out, int64_t count, QRgb nanColor )
+{
+    const __m128i nanc = _mm_set1_epi32( int (nanColor) );
+    int64_t i = 0;
+    for ( ; i + 2 <= count ; i += 2 ) {
+        __m128i rgb = convert2Sse2 < interpolated > ( lut, _mm_loadu_pd( in + i ), nanc );
+        _mm_storel_epi64( reinterpret_cast < __m128i * > ( out + i ), rgb );
+    }
+    convertScalar < interpolated > ( lut, in + i, out + i, count - i, nanColor );
+}
+
+template < bool interpolated >
+void
+convertSse2( const Lut & lut, const float * in, QRgb * out, int64_t count, QRgb nanColor )
+{
+    const __m128i nanc = _mm_set1_epi32( int (nanColor) );
+    int64_t i = 0;
+    for ( ; i + 4 <= count ; i += 4 ) {
+        __m128 xf = _mm_loadu_ps( in + i );
+        __m128i lo = convert2Sse2 < interpolated > ( lut, _mm_cvtps_pd( xf ), nanc );
+        __m128i hi = convert2Sse2 < interpolated > ( lut, _mm_cvtps_pd( _mm_movehl_ps( xf, xf ) ),
+                                                     nanc );
+        _mm_storeu_si128( reinterpret_cast < __m128i * > ( out + i ),
+                          _mm_unpacklo_epi64( lo, hi ) );
+    }
+    convertScalar < interpolated > ( lut, in + i, out + i, count - i, nanColor );
+}
+
+#endif // CARTA_BATCH_SSE2
+
+#ifdef CARTA_BATCH_AVX2
+
+/// interpolate 4 values of a single channel and round them to integers
+__attribute__ ( ( target( "avx2" ) ) )
+inline __m128i
+blendChannelAvx2( const double * channel, __m128i k0, __m128i k1, __m256d frac, __m256d frac1 )
+{
+    __m256d a = _mm256_i32gather_pd( channel, k0, 8 );
+    __m256d b = _mm256_i32gather_pd( channel, k1, 8 );
+    __m256d v = _mm256_add_pd( _mm256_mul_pd( a, frac1 ), _mm256_mul_pd( b, frac ) );
+    return _mm256_cvttpd_epi32( _mm256_add_pd( v, _mm256_set1_pd( 0.5 ) ) );
+}
+
+/// AVX2 kernel for 4 doubles
+template < bool interpolated >
+__attribute__ ( ( target( "avx2" ) ) )
+inline __m128i
+convert4Avx2( const Lut & lut, __m256d x, __m128i nanColor )
+{
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d half = _mm256_set1_pd( 0.5 );
+    const __m256d n1 = _mm256_set1_pd( double ( lut.n1 ) );
+
+    // clamp, note that max() returns the second operand (0) for NaNs
+    __m256d nanMask = _mm256_cmp_pd( x, x, _CMP_UNORD_Q );
+    __m256d t = _mm256_mul_pd( _mm256_sub_pd( x, _mm256_set1_pd( lut.min ) ),
+                               _mm256_set1_pd( lut.invDelta ) );
+    t = _mm256_min_pd( _mm256_max_pd( t, zero ), n1 );
+
+    __m128i rgb;
+    if ( ! interpolated ) {
+        __m128i ind = _mm256_cvttpd_epi32( _mm256_add_pd( t, half ) );
+        rgb = _mm_i32gather_epi32( reinterpret_cast < const int * > ( lut.qrgb.data() ), ind, 4 );
+    }
+    else {
+        __m256d ind = _mm256_cvtepi32_pd( _mm256_cvttpd_epi32( t ) );
+        ind = _mm256_min_pd( ind, _mm256_sub_pd( n1, _mm256_set1_pd( 1.0 ) ) );
+        __m256d frac = _mm256_sub_pd( t, ind );
+        __m256d frac1 = _mm256_sub_pd( _mm256_set1_pd( 1.0 ), frac );
+        __m128i k0 = _mm256_cvttpd_epi32( ind );
+        __m128i k1 = _mm_add_epi32( k0, _mm_set1_epi32( 1 ) );
+
+        __m128i r = blendChannelAvx2( lut.red.data(), k0, k1, frac, frac1 );
+        __m128i g = blendChannelAvx2( lut.green.data(), k0, k1, frac, frac1 );
+        __m128i b = blendChannelAvx2( lut.blue.data(), k0, k1, frac, frac1 );
+        rgb = _mm_or_si128( _mm_slli_epi32( r, 16 ), _mm_slli_epi32( g, 8 ) );
+        rgb = _mm_or_si128( rgb, b );
+        rgb = _mm_or_si128( rgb, _mm_set1_epi32( int (0xff000000u) ) );
+    }
+
+    // replace NaNs with nan color, the 64 bit masks are narrowed down to 32 bits
+    __m256i mask64 = _mm256_castpd_si256( nanMask );
+    __m128i mask = _mm256_castsi256_si128(
+        _mm256_permutevar8x32_epi32( mask64, _mm256_setr_epi32( 0, 2, 4, 6, 0, 2, 4, 6 ) ) );
+    return _mm_blendv_epi8( rgb, nanColor, mask );
+} // convert4Avx2
+
+template < bool interpolated >
+__attribute__ ( ( target( "avx2" ) ) )
+void
+convertAvx2( const Lut & lut, const double * in, QRgb * out, int64_t count, QRgb nanColor )
+{
+    const __m128i nanc = _mm_set1_epi32( int (nanColor) );
+    int64_t i = 0;
+    for ( ; i + 4 <= count ; i += 4 ) {
+        __m128i rgb = convert4Avx2 < interpolated > ( lut, _mm256_loadu_pd( in + i ), nanc );
+        _mm_storeu_si128( reinterpret_cast < __m128i * > ( out + i ), rgb );
+    }
+    convertScalar < interpolated > ( lut, in + i, out + i, count - i, nanColor );
+}
+
+template < bool interpolated >
+__attribute__ ( ( target( "avx2" ) ) )
+void
+convertAvx2( const Lut & lut, const float * in, QRgb * out, int64_t count, QRgb nanColor )
+{
+    const __m128i nanc = _mm_set1_epi32( int (nanColor) );
+    int64_t i = 0;
+    for ( ; i + 8 <= count ; i += 8 ) {
+        __m256 xf = _mm256_loadu_ps( in + i );
+        __m128i lo = convert4Avx2 < interpolated > (
+            lut, _mm256_cvtps_pd( _mm256_castps256_ps128( xf ) ), nanc );
+        __m128i hi = convert4Avx2 < interpolated > (
+            lut, _mm256_cvtps_pd( _mm256_extractf128_ps( xf, 1 ) ), nanc );
+        _mm_storeu_si128( reinterpret_cast < __m128i * > ( out + i ), lo );
+        _mm_storeu_si128( reinterpret_cast < __m128i * > ( out + i + 4 ), hi );
+    }
+    convertScalar < interpolated > ( lut, in + i, out + i, count - i, nanColor );
+}
+
+#endif // CARTA_BATCH_AVX2
+
+/// pick the kernel
+template < bool interpolated, typename Scalar >
+void
+dispatch( const Lut & lut, const Scalar * in, QRgb * out, int64_t count, QRgb nanColor, Isa isa )
+{
+    CARTA_ASSERT( lut.n1 >= 1 );
+
+#ifdef CARTA_BATCH_AVX2
+    if ( isa == Isa::AVX2 && bestIsa() == Isa::AVX2 ) {
+        convertAvx2 < interpolated > ( lut, in, out, count, nanColor );
+        return;
+    }
+#endif
+#ifdef CARTA_BATCH_SSE2
+    if ( isa != Isa::Scalar ) {
+        convertSse2 < interpolated > ( lut, in, out, count, nanColor );
+        return;
+    }
+#endif
+    Q_UNUSED( isa );
+    convertScalar < interpolated > ( lut, in, out, count, nanColor );
+}
+}
+
+Isa
+bestIsa()
+{
+    static const Isa isa = [] () {
+#ifdef CARTA_BATCH_AVX2
+                               __builtin_cpu_init();
+                               if ( __builtin_cpu_supports( "avx2" ) ) {
+                                   return Isa::AVX2;
+                               }
+#endif
+#ifdef CARTA_BATCH_SSE2
+                               return Isa::SSE2;
+#else
+                               return Isa::Scalar;
+#endif
+                           } ();
+    return isa;
+}
+
+void
+Lut::set( const std::vector < std::array < double, 3 > > & entries, double p_min, double p_max )
+{
+    CARTA_ASSERT( entries.size() > 1 );
+    CARTA_ASSERT( p_min < p_max );
+    min = p_min;
+    n1 = entries.size() - 1;
+    invDelta = 1.0 / ( ( p_max - p_min ) / n1 );
+
+    qrgb.resize( entries.size() );
+    red.resize( entries.size() );
+    green.resize( entries.size() );
+    blue.resize( entries.size() );
+    for ( size_t i = 0 ; i < entries.size() ; ++i ) {
+        red[i] = Carta::Lib::clamp( entries[i][0] * 255, 0.0, 255.0 );
+        green[i] = Carta::Lib::clamp( entries[i][1] * 255, 0.0, 255.0 );
+        blue[i] = Carta::Lib::clamp( entries[i][2] * 255, 0.0, 255.0 );
+        qrgb[i] = packRgb( std::round( red[i] ), std::round( green[i] ), std::round( blue[i] ) );
+    }
+}
+
+void
+convert( const Lut & lut, bool interpolated, const double * in, QRgb * out, int64_t count,
+         QRgb nanColor, Isa isa )
+{
+    if ( interpolated ) {
+        dispatch < true > ( lut, in, out, count, nanColor, isa );
+    }
+    else {
+        dispatch < false > ( lut, in, out, count, nanColor, isa );
+    }
+}
+
+void
+convert( const Lut & lut, bool interpolated, const float * in, QRgb * out, int64_t count,
+         QRgb nanColor, Isa isa )
+{
+    if ( interpolated ) {
+        dispatch < true > ( lut, in, out, count, nanColor, isa );
+    }
+    else {
+        dispatch < false > ( lut, in, out, count, nanColor, isa );
+    }
+}
+}
+}
+}
+}
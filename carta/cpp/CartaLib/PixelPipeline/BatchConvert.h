@@ -0,0 +1,85 @@
+/**
+ * Batch conversion of raw pixels to QRgb using a lookup table.
+ *
+ * This is the workhorse behind CachedPipeline::convertqBatch(). The kernels take
+ * a contiguous span of float/double values and produce a span of QRgb values. They
+ * take care of NaNs, clamping to the clip range, the table lookup and (optionally)
+ * linear interpolation between neighbouring table entries.
+ *
+ * There are SSE2 and AVX2 versions of the kernels, as well as a scalar fallback. The
+ * best version supported by the CPU is picked at runtime, unless the caller asks for
+ * a specific one (mainly useful for testing). All versions produce identical results.
+ **/
+
+#pragma once
+
+#include <QRgb>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Carta
+{
+namespace Lib
+{
+namespace PixelPipeline
+{
+namespace Batch
+{
+/// instruction sets the kernels are available for
+enum class Isa {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+/// return the best instruction set supported by both the build and the CPU
+Isa
+bestIsa();
+
+/// lookup table prepared for batch conversion
+struct Lut {
+    /// value corresponding to the first entry
+    double min = 0;
+
+    /// inverse of the distance between entries
+    double invDelta = 1;
+
+    /// index of the last entry
+    int64_t n1 = 0;
+
+    /// entries quantized to 8 bits, used for nearest entry lookups
+    std::vector < QRgb > qrgb;
+
+    /// channels of entries scaled to 0..255, used for interpolated lookups
+    std::vector < double > red, green, blue;
+
+    /// set up the table
+    /// \param entries normalized rgb values, evenly spaced in [min..max], at least 2
+    /// \param min value corresponding to the first entry
+    /// \param max value corresponding to the last entry
+    void
+    set( const std::vector < std::array < double, 3 > > & entries, double min, double max );
+};
+
+/// convert a span of values to QRgb
+/// \param lut lookup table
+/// \param interpolated whether to interpolate between table entries, or use the closest one
+/// \param in input values
+/// \param out output values
+/// \param count number of values to convert
+/// \param nanColor value to output for NaNs
+/// \param isa which version of the kernels to use, if the requested instruction set
+/// is not available, the next best one is used
+void
+convert( const Lut & lut, bool interpolated, const double * in, QRgb * out, int64_t count,
+         QRgb nanColor, Isa isa = bestIsa() );
+
+/// float version of convert()
+void
+convert( const Lut & lut, bool interpolated, const float * in, QRgb * out, int64_t count,
+         QRgb nanColor, Isa isa = bestIsa() );
+}
+}
+}
+}
@@ -5,3 +5,132 @@
 
 #include "CustomizablePixelPipeline.h"
 
+namespace Carta
+{
+namespace Lib
+{
+namespace PixelPipeline
+{
+namespace
+{
+/// apply the scale function to a normalized value
+template < ScaleType scale >
+inline double
+applyScale( const FusedParams & params, double n );
+
+template <>
+inline double
+applyScale < ScaleType::Linear > ( const FusedParams &, double n )
+{
+    return n;
+}
+
+template <>
+inline double
+applyScale < ScaleType::Sqr > ( const FusedParams &, double n )
+{
+    return n * n;
+}
+
+template <>
+inline double
+applyScale < ScaleType::Sqrt > ( const FusedParams &, double n )
+{
+    return std::sqrt( n );
+}
+
+template <>
+inline double
+applyScale < ScaleType::Log > ( const FusedParams & params, double n )
+{
+    return std::log( params.a * n + 1 ) * params.invLogA1;
+}
+
+template <>
+inline double
+applyScale < ScaleType::Polynomial > ( const FusedParams & params, double n )
+{
+    return std::pow( n, params.a );
+}
+
+/// the fused pipeline, equivalent to the clamp, ScaleStage, ReversableStage1, normalization,
+/// colormap and InvertibleStage4 chain, except that the value stays normalized
+/// throughout instead of being denormalized after every stage
+template < ScaleType scale, bool gamma, bool reverse, bool invert >
+void
+fusedConvert( const FusedParams & params, double val, NormRgb & result )
+{
+    // stage 0 + normalization
+    double n = ( Carta::Lib::clamp( val, params.min, params.max ) - params.min ) * params.invRange;
+
+    // stage 1
+    n = applyScale < scale > ( params, n );
+    if ( gamma ) {
+        n = std::pow( n, params.gamma );
+    }
+    if ( reverse ) {
+        n = 1.0 - n;
+    }
+
+    // stage 3
+    params.colormap-> convert( n, result );
+
+    // stage 4
+    if ( invert ) {
+        result[0] = 1.0 - result[0];
+        result[1] = 1.0 - result[1];
+        result[2] = 1.0 - result[2];
+    }
+}
+
+template < ScaleType scale, bool gamma, bool reverse >
+FusedKernel
+selectInvert( bool invert )
+{
+    return invert ? & fusedConvert < scale, gamma, reverse, true >
+           : & fusedConvert < scale, gamma, reverse, false >;
+}
+
+template < ScaleType scale, bool gamma >
+FusedKernel
+selectReverse( bool reverse, bool invert )
+{
+    return reverse ? selectInvert < scale, gamma, true > ( invert )
+           : selectInvert < scale, gamma, false > ( invert );
+}
+
+template < ScaleType scale >
+FusedKernel
+selectGamma( bool gamma, bool reverse, bool invert )
+{
+    return gamma ? selectReverse < scale, true > ( reverse, invert )
+           : selectReverse < scale, false > ( reverse, invert );
+}
+}
+
+FusedKernel
+compileFusedKernel( ScaleType scale, bool gamma, bool reverse, bool invert )
+{
+    switch ( scale )
+    {
+    case ScaleType::Linear :
+        return selectGamma < ScaleType::Linear > ( gamma, reverse, invert );
+
+    case ScaleType::Polynomial :
+        return selectGamma < ScaleType::Polynomial > ( gamma, reverse, invert );
+
+    case ScaleType::Sqr :
+        return selectGamma < ScaleType::Sqr > ( gamma, reverse, invert );
+
+    case ScaleType::Sqrt :
+        return selectGamma < ScaleType::Sqrt > ( gamma, reverse, invert );
+
+    case ScaleType::Log :
+        return selectGamma < ScaleType::Log > ( gamma, reverse, invert );
+    }
+    CARTA_ASSERT_X( false, "Invalid scale type" );
+    return selectGamma < ScaleType::Linear > ( gamma, reverse, invert );
+} // compileFusedKernel
+}
+}
+}
@@ -76,7 +76,7 @@ public:
 
 private:
 
-    bool m_inverted;
+    bool m_inverted = false;
 };
 
 enum class ScaleType
@@ -132,6 +132,12 @@ public:
         if( m_gamma < 0) { m_gamma = 0; }
     }
 
+    double
+    gamma() const
+    {
+        return m_gamma;
+    }
+
     virtual void
     convert( double & val ) override
     {
@@ -157,6 +163,12 @@ public:
         return m_a;
     }
 
+    ScaleType
+    type() const
+    {
+        return m_scaleType;
+    }
+
     void
     setType( ScaleType stype )
     {
@@ -216,12 +228,48 @@ private:
     double m_gamma = 1.0;
 };
 
+/// parameters of the compiled (fused) form of the CustomizablePixelPipeline
+struct FusedParams {
+    /// clip range
+    double min = 0, max = 1;
+
+    /// 1 / (max - min)
+    double invRange = 1;
+
+    /// scale parameter
+    double a = 1;
+
+    /// 1 / log(a+1), used by the log scale
+    double invLogA1 = 1;
+
+    /// gamma correction factor
+    double gamma = 1;
+
+    /// colormap, not owned
+    IColormap * colormap = nullptr;
+};
+
+/// signature of a compiled pipeline kernel: double -> normalized rgb, i.e. stages 0..4
+typedef void (* FusedKernel)( const FusedParams & params, double val, NormRgb & result );
+
+/// select the kernel specialized for the given configuration
+/// the kernels are template instantiations, so there are no per-pixel branches
+/// on the configuration and no virtual calls except for the colormap
+/// \param scale scale type
+/// \param gamma whether gamma correction is applied
+/// \param reverse whether the values are reversed
+/// \param invert whether the colors are inverted
+/// \return kernel
+FusedKernel
+compileFusedKernel( ScaleType scale, bool gamma, bool reverse, bool invert );
+
 /// this is the pipeline that we use in CARTA
 /// it should support all of the GUI actions of a colormap dialog, e.g.:
 /// - invert, reverse, colormap, log/gamma/cycles, manual clip
 ///
-/// \todo this is getting extremely inefficient, I think it's time to
-/// hand-optimize it without the stages
+/// The stages are not chained at runtime. Instead, every time the configuration
+/// changes the pipeline is compiled into a single fused kernel, see compileFusedKernel().
+/// Scale stage is only used to hold the scale settings (and to compute the cache id).
 ///
 class CustomizablePixelPipeline : public IClippedPixelPipeline
 {
@@ -231,13 +279,9 @@ public:
 
     CustomizablePixelPipeline()
     {
-        m_pipe.reset( new Composite() );
         m_scaleStage = std::make_shared < ScaleStage > ();
-        m_pipe-> addStage1( m_scaleStage);
-        m_reversible = std::make_shared < ReversableStage1 > ();
-        m_pipe-> addStage1( m_reversible );
-        m_invertible = std::make_shared < InvertibleStage4 > ();
-        m_pipe-> addStage4( m_invertible );
+        m_colormap = std::make_shared < GrayCMap > ();
+        compile();
     }
 
     /// set gamma correction facor (1.0 is default, i.e. no gamma)
@@ -245,6 +289,7 @@ public:
     setGamma( double gamma)
     {
         m_scaleStage-> setGamma( gamma);
+        compile();
     }
 
     /// set max values for rgb (values will be interpolated up to this value)
@@ -252,6 +297,7 @@ public:
     void
     setRgbMax( NormRgb rgb) {
         m_maxRgb = rgb;
+        m_unitRgbMax = m_maxRgb[0] == 1.0 && m_maxRgb[1] == 1.0 && m_maxRgb[2] == 1.0;
     }
 
     /// some scales require a parameter
@@ -259,6 +305,7 @@ public:
     setScaleParam( double a )
     {
         m_scaleStage-> setParam( a );
+        compile();
     }
 
 
@@ -275,27 +322,29 @@ public:
     setScale( ScaleType scale )
     {
         m_scaleStage-> setType( scale );
+        compile();
     }
 
     void
     setInvert( bool flag )
     {
         m_invertFlag = flag;
-        m_invertible-> setInverted( flag );
+        compile();
     }
 
     void
     setReverse( bool flag )
     {
         m_reverseFlag = flag;
-        m_reversible-> setReversed( flag );
+        compile();
     }
 
     void
     setColormap( IColormapNamed::SharedPtr colormap )
     {
         m_cmapName = colormap-> name();
-        m_pipe-> setStage3( colormap );
+        m_colormap = colormap;
+        compile();
     }
 
     /*virtual*/ void
@@ -303,13 +352,14 @@ public:
     {
         m_clipMin = min;
         m_clipMax = max;
-        m_pipe-> setMinMax( m_clipMin, m_clipMax );
+        compile();
     }
 
     virtual void
     convert( double val, Carta::Lib::PixelPipeline::NormRgb & result ) override
     {
-        m_pipe-> convert( val, result );
+        CARTA_ASSERT( ! std::isnan( val ) );
+        m_kernel( m_params, val, result );
         result[0] *= m_maxRgb[0];
         result[1] *= m_maxRgb[1];
         result[2] *= m_maxRgb[2];
@@ -318,13 +368,31 @@ public:
     virtual void
     convertq( double val, QRgb & result ) override
     {
-        m_pipe-> convertq( val, result );
+        CARTA_ASSERT( ! std::isnan( val ) );
+        NormRgb drgb;
+        m_kernel( m_params, val, drgb );
+        normRgb2QRgb( drgb, result );
+        if ( m_unitRgbMax ) {
+            return;
+        }
         auto red = std::round( qRed( result) * m_maxRgb[0]);
         auto green = std::round(qGreen( result) * m_maxRgb[1]);
         auto blue = std::round(qBlue( result) * m_maxRgb[2]);
         result = qRgb( red, green, blue);
     }
 
+    virtual void
+    convertqBatch( const double * in, QRgb * out, int64_t count, QRgb nanColor ) override
+    {
+        fusedBatch( in, out, count, nanColor );
+    }
+
+    virtual void
+    convertqBatch( const float * in, QRgb * out, int64_t count, QRgb nanColor ) override
+    {
+        fusedBatch( in, out, count, nanColor );
+    }
+
     virtual void
     getClips( double & min, double & max ) override
     {
@@ -347,15 +415,48 @@ public:
 
 private:
 
-    Composite::UniquePtr m_pipe = nullptr;
+    /// rebuild the fused kernel and its parameters from the current settings
+    void
+    compile()
+    {
+        m_params.min = m_clipMin;
+        m_params.max = m_clipMax;
+        m_params.invRange = 1.0 / ( m_clipMax - m_clipMin );
+        m_params.a = m_scaleStage-> param();
+        m_params.invLogA1 = 1.0 / std::log( m_params.a + 1 );
+        m_params.gamma = m_scaleStage-> gamma();
+        m_params.colormap = m_colormap.get();
+        m_kernel = compileFusedKernel( m_scaleStage-> type(), m_params.gamma != 1.0,
+                                       m_reverseFlag, m_invertFlag );
+    }
+
+    /// convert a span of values without going through the virtual convertq()
+    template < typename Scalar >
+    void
+    fusedBatch( const Scalar * in, QRgb * out, int64_t count, QRgb nanColor )
+    {
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            if ( Q_LIKELY( ! std::isnan( in[i] ) ) ) {
+                CustomizablePixelPipeline::convertq( in[i], out[i] );
+            }
+            else {
+                out[i] = nanColor;
+            }
+        }
+    }
+
     ScaleStage::SharedPtr m_scaleStage = nullptr;
-    ReversableStage1::SharedPtr m_reversible = nullptr;
-    InvertibleStage4::SharedPtr m_invertible = nullptr;
+    IColormap::SharedPtr m_colormap = nullptr;
     double m_clipMin = 0, m_clipMax = 1;
     NormRgb m_maxRgb {{ 1.0, 1.0, 1.0}};
+    bool m_unitRgbMax = true;
 
     QString m_cmapName;
     bool m_invertFlag = false, m_reverseFlag = false;
+
+    /// compiled form of the pipeline
+    FusedParams m_params;
+    FusedKernel m_kernel = nullptr;
 };
 }
 }
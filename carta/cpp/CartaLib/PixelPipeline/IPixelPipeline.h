@@ -1,6 +1,7 @@
 #pragma once
 
 #include "CartaLib/CartaLib.h"
+#include "CartaLib/PixelPipeline/BatchConvert.h"
 #include <QRgb>
 #include <stdexcept>
 #include <cmath>
@@ -166,6 +167,36 @@ public:
     virtual void
     convertq( double val, QRgb & result ) = 0;
 
+    /// convert a span of values to 8 bit RGB, NaNs are converted to nanColor
+    /// the default implementation calls convertq() for every value, pipelines that
+    /// can do better should override it
+    virtual void
+    convertqBatch( const double * in, QRgb * out, int64_t count, QRgb nanColor )
+    {
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            if ( Q_LIKELY( ! std::isnan( in[i] ) ) ) {
+                convertq( in[i], out[i] );
+            }
+            else {
+                out[i] = nanColor;
+            }
+        }
+    }
+
+    /// float version of convertqBatch()
+    virtual void
+    convertqBatch( const float * in, QRgb * out, int64_t count, QRgb nanColor )
+    {
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            if ( Q_LIKELY( ! std::isnan( in[i] ) ) ) {
+                convertq( in[i], out[i] );
+            }
+            else {
+                out[i] = nanColor;
+            }
+        }
+    }
+
     /// returns the input clip range
     /// \note this is not strictly necessary for minimalist interface, but we do use
     /// this just about everywhere where we need IPixelPipeline for caching, so I stuck
@@ -347,6 +378,9 @@ public:
         m_n1 = m_cache.size() - 1;
         m_d = ( m_max - m_min ) / m_n1;
         m_dInvN1 = 1 / m_d;
+
+        // prepare the table for batch conversions
+        m_lut.set( m_cache, min, max );
     }
 
     void
@@ -360,6 +394,22 @@ public:
         normRgb2QRgb( drgb, result );
     }
 
+    /// convert a span of values to 8 bit RGB using the vectorized kernels,
+    /// NaNs are converted to nanColor
+    /// \note this is safe to call from multiple threads at the same time
+    void
+    convertqBatch( const double * in, QRgb * out, int64_t count, QRgb nanColor ) const
+    {
+        Batch::convert( m_lut, interpolated, in, out, count, nanColor );
+    }
+
+    /// float version of convertqBatch()
+    void
+    convertqBatch( const float * in, QRgb * out, int64_t count, QRgb nanColor ) const
+    {
+        Batch::convert( m_lut, interpolated, in, out, count, nanColor );
+    }
+
 private:
 
     std::vector < NormRgb > m_cache;
@@ -367,6 +417,9 @@ private:
     double m_min = 0, m_max = 1;
     double m_d, m_dInvN1, m_n1;
 
+    /// lookup table for batch conversions
+    Batch::Lut m_lut;
+
 };
 
 
@@ -12,6 +12,28 @@ Image::pixelType2int( const Image::PixelType & type )
     return static_cast < int > ( type );
 }
 
+int
+Image::pixelType2size( const Image::PixelType & type )
+{
+    switch ( type )
+    {
+    case PixelType::Byte :
+        return sizeof( uint8_t );
+    case PixelType::Int16 :
+        return sizeof( int16_t );
+    case PixelType::Int32 :
+        return sizeof( int32_t );
+    case PixelType::Int64 :
+        return sizeof( int64_t );
+    case PixelType::Real32 :
+        return sizeof( float );
+    case PixelType::Real64 :
+        return sizeof( double );
+    default :
+        return 0;
+    }
+}
+
 //QString Image::pixelType2String(Image::PixelType t)
 //{
 //    switch (t) {
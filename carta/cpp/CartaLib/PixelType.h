@@ -29,6 +29,9 @@ static_assert( sizeof(double) == 8, "bad double size");
 // convenience function convert pixel type to int
 int pixelType2int( const PixelType & type);
 
+/// size of a pixel of the given type in bytes, 0 for unknown types
+int pixelType2size( const PixelType & type);
+
 /// convert PixelType to c type
 template <PixelType pt>
 struct PixelType2CType {};
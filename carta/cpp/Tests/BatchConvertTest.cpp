@@ -0,0 +1,91 @@
+#include "catch.h"
+#include "CartaLib/PixelPipeline/IPixelPipeline.h"
+#include <limits>
+#include <vector>
+
+using namespace Carta::Lib::PixelPipeline;
+
+namespace
+{
+/// some test data with NaNs, infinities and values outside of the clip range
+template < typename Scalar >
+std::vector < Scalar >
+testData()
+{
+    std::vector < Scalar > data;
+    for ( int i = 0 ; i < 1003 ; ++i ) {
+        data.push_back( -3.0 + i * 0.00731 );
+    }
+    data[5] = std::numeric_limits < Scalar >::quiet_NaN();
+    data[17] = std::numeric_limits < Scalar >::infinity();
+    data[18] = - std::numeric_limits < Scalar >::infinity();
+    data[1001] = std::numeric_limits < Scalar >::quiet_NaN();
+    return data;
+}
+
+template < bool interpolated, typename Scalar >
+void
+checkBatch()
+{
+    Composite pp;
+    pp.setMinMax( -2, 4 );
+    CachedPipeline < interpolated > cpp;
+    cpp.cache( pp, 1000, -2, 4 );
+
+    std::vector < Scalar > data = testData < Scalar > ();
+    QRgb nanColor = qRgb( 255, 0, 0 );
+
+    std::vector < QRgb > reference( data.size() );
+    cpp.convertqBatch( data.data(), reference.data(), data.size(), nanColor );
+
+    // all instruction sets must give identical results
+    std::vector < NormRgb > entries( 1000 );
+    for ( int i = 0 ; i < 1000 ; ++i ) {
+        double x = -2 + 6.0 / 999 * i;
+        pp.convert( x, entries[i] );
+    }
+    Batch::Lut lut;
+    lut.set( entries, -2, 4 );
+    for ( Batch::Isa isa : { Batch::Isa::Scalar, Batch::Isa::SSE2, Batch::Isa::AVX2 } ) {
+        std::vector < QRgb > out( data.size() );
+        Batch::convert( lut, interpolated, data.data(), out.data(), out.size(), nanColor, isa );
+        REQUIRE( out == reference );
+    }
+
+    // and they should match the per pixel conversion (within rounding)
+    for ( size_t i = 0 ; i < data.size() ; ++i ) {
+        if ( std::isnan( data[i] ) ) {
+            REQUIRE( reference[i] == nanColor );
+            continue;
+        }
+
+        // the per pixel conversion does not handle infinities
+        if ( std::isinf( data[i] ) ) {
+            continue;
+        }
+        QRgb expected;
+        cpp.convertq( data[i], expected );
+        INFO( "value " << data[i] );
+        REQUIRE( std::abs( qRed( reference[i] ) - qRed( expected ) ) <= 1 );
+        REQUIRE( std::abs( qGreen( reference[i] ) - qGreen( expected ) ) <= 1 );
+        REQUIRE( std::abs( qBlue( reference[i] ) - qBlue( expected ) ) <= 1 );
+        REQUIRE( qAlpha( reference[i] ) == 255 );
+    }
+} // checkBatch
+}
+
+TEST_CASE( "Batch pixel pipeline conversion", "[pp]" ) {
+
+    SECTION( "Nearest double" ) {
+        checkBatch < false, double > ();
+    }
+    SECTION( "Nearest float" ) {
+        checkBatch < false, float > ();
+    }
+    SECTION( "Interpolated double" ) {
+        checkBatch < true, double > ();
+    }
+    SECTION( "Interpolated float" ) {
+        checkBatch < true, float > ();
+    }
+}
@@ -0,0 +1,90 @@
+#include "catch.h"
+#include "core/CacheManager.h"
+
+using namespace Carta::Core;
+
+static CacheManager::Statistics statsFor( const CacheManager & manager, const QString & category)
+{
+    for( auto & stats : manager.statistics()) {
+        if( stats.category == category) {
+            return stats;
+        }
+    }
+    return CacheManager::Statistics();
+}
+
+static CacheKey key( const char * str)
+{
+    return CacheKey::fromString( str);
+}
+
+TEST_CASE( "Cache keys", "[cache]" ) {
+    REQUIRE( CacheKey().isNull());
+    REQUIRE( CacheKey::fromString( "").isNull());
+    REQUIRE( key( "a") == key( "a"));
+    REQUIRE( key( "a") != key( "b"));
+    REQUIRE( key( "a").with( 1).with( 2) == key( "a").with( 1).with( 2));
+    REQUIRE( key( "a").with( 1).with( 2) != key( "a").with( 2).with( 1));
+    REQUIRE( key( "a").with( 1) != key( "a").with( 1.0));
+    REQUIRE_FALSE( CacheKey().with( 0).isNull());
+}
+
+TEST_CASE( "Cache manager", "[cache]" ) {
+
+    CacheManager manager;
+    manager.setBudget( 1000);
+    manager.setCategoryBudget( "frame", 600);
+
+    ManagedCache<int> cache1( "frame", manager);
+    ManagedCache<int> cache2( "frame", manager);
+    ManagedCache<int> cache3( "index", manager);
+
+    SECTION( "owners do not see each other's entries") {
+        cache1.insert( key( "a"), std::make_shared<int>( 1), 100);
+        REQUIRE( cache1.object( key( "a")) != nullptr);
+        REQUIRE( cache2.object( key( "a")) == nullptr);
+        auto stats = statsFor( manager, "frame");
+        REQUIRE( stats.hits == 1);
+        REQUIRE( stats.misses == 1);
+        REQUIRE( stats.bytes == 100);
+    }
+
+    SECTION( "category budget evicts least recently used entries of the category") {
+        cache1.insert( key( "a"), std::make_shared<int>( 1), 300);
+        cache3.insert( key( "x"), std::make_shared<int>( 3), 300);
+        cache2.insert( key( "b"), std::make_shared<int>( 2), 200);
+        cache1.object( key( "a"));
+        cache2.insert( key( "c"), std::make_shared<int>( 4), 200);
+        // 'b' was the least recently used frame
+        REQUIRE( cache2.object( key( "b")) == nullptr);
+        REQUIRE( cache1.object( key( "a")) != nullptr);
+        REQUIRE( cache3.object( key( "x")) != nullptr);
+        REQUIRE( statsFor( manager, "frame").evictions == 1);
+        REQUIRE( statsFor( manager, "frame").bytes == 500);
+    }
+
+    SECTION( "process-wide budget evicts across categories") {
+        cache3.insert( key( "x"), std::make_shared<int>( 3), 500);
+        cache1.insert( key( "a"), std::make_shared<int>( 1), 400);
+        cache2.insert( key( "b"), std::make_shared<int>( 2), 200);
+        REQUIRE( cache3.object( key( "x")) == nullptr);
+        REQUIRE( manager.totalBytes() == 600);
+        REQUIRE( statsFor( manager, "index").evictions == 1);
+    }
+
+    SECTION( "entries are removed with their owner") {
+        {
+            ManagedCache<int> temp( "frame", manager);
+            temp.insert( key( "a"), std::make_shared<int>( 1), 100);
+            REQUIRE( manager.totalBytes() == 100);
+        }
+        REQUIRE( manager.totalBytes() == 0);
+    }
+
+    SECTION( "take removes the entry") {
+        cache1.insert( key( "a"), std::make_shared<int>( 1), 100);
+        REQUIRE( * cache1.take( key( "a")) == 1);
+        REQUIRE( cache1.object( key( "a")) == nullptr);
+        REQUIRE( manager.totalBytes() == 0);
+    }
+}
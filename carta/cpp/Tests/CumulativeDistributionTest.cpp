@@ -0,0 +1,91 @@
+#include "catch.h"
+#include "MemoryView.h"
+#include "core/Algorithms/CumulativeDistribution.h"
+#include "core/Algorithms/quantileAlgorithms.h"
+#include <random>
+
+using namespace Carta::Core::Algorithms;
+
+namespace
+{
+typedef std::vector < int > VI;
+
+/// normal values, with nans, outliers or infinities depending on the kind
+std::vector < float >
+makeData( int kind )
+{
+    std::mt19937 gen( 3 );
+    std::normal_distribution < float > normal( 0, 1 );
+    std::vector < float > data;
+    for ( int i = 0 ; i < 200000 ; i++ ) {
+        float v = normal( gen );
+        if ( kind == 1 && i % 100 == 0 ) {
+            v = i % 200 == 0 ? NAN : 1e30f;
+        }
+        if ( kind == 2 && i % 1000 == 0 ) {
+            v = i % 3000 == 0 ? - INFINITY : INFINITY;
+        }
+        data.push_back( v );
+    }
+    return data;
+}
+}
+
+TEST_CASE( "Refined distribution is exact", "[distribution]" )
+{
+    for ( int kind = 0 ; kind < 3 ; kind++ ) {
+        std::vector < float > data = makeData( kind );
+        FloatView raw( data );
+        CumulativeDistribution::SharedPtr distribution = CumulativeDistribution::compute( & raw );
+        auto makeView = [&data] () { return new FloatView( data ); };
+
+        NdArray::TypedView < float > view( & raw, false );
+        std::vector < double > quant { 0.0, 0.001, 0.025, 0.3, 0.5, 0.975, 0.999, 1.0 };
+        std::vector < float > exact = quantiles2pixels( view, quant );
+        for ( size_t k = 0 ; k < quant.size() ; k++ ) {
+            REQUIRE( distribution-> quantile( quant[k], 0, makeView ) == exact[k] );
+        }
+        for ( double value : { -2.5, -0.1, 0.0, double( exact[3] ), 1.7, 1e31 } ) {
+            REQUIRE( distribution-> percentile( value, 0, makeView ) == pixel2quantile( view, value ) );
+        }
+    }
+}
+
+TEST_CASE( "Distribution lookups are within the rank error", "[distribution]" )
+{
+    std::vector < float > data = makeData( 1 );
+    FloatView raw( data );
+    NdArray::TypedView < float > view( & raw, false );
+    CumulativeDistribution::SharedPtr distribution = CumulativeDistribution::compute( & raw );
+    auto makeView = [&data] () { return new FloatView( data ); };
+    int64_t bytes = distribution-> bytes();
+
+    // the outliers put almost all values into the first bin, which gets refined
+    for ( double value : { -2.5, -0.1, 0.0, 1.7 } ) {
+        double exact = pixel2quantile( view, value );
+        REQUIRE( std::fabs( distribution-> percentile( value, 1e-4, makeView ) - exact ) <= 1e-4 );
+    }
+    REQUIRE( distribution-> bytes() > bytes );
+
+    // without a view nothing is refined, but the extremes are still exact
+    CumulativeDistribution::SharedPtr coarse = CumulativeDistribution::compute( & raw );
+    REQUIRE( coarse-> quantile( 0 ) == quantiles2pixels( view, { 0.0 } )[0] );
+    REQUIRE( coarse-> quantile( 1 ) == 1e30f );
+    REQUIRE( coarse-> percentile( 1e31 ) == 1 );
+    REQUIRE( coarse-> bytes() == bytes );
+}
+
+TEST_CASE( "Distribution of a range too narrow for its bins", "[distribution]" )
+{
+    // Bins / width overflows, although HistogramQuantileBins / width does not
+    const double tiny = 1e-304;
+    std::vector < double > data;
+    for ( int i = 0 ; i < 100000 ; i++ ) {
+        data.push_back( i % 4 == 0 ? tiny : 0 );
+    }
+    DoubleView raw( data );
+    CumulativeDistribution::SharedPtr distribution = CumulativeDistribution::compute( & raw );
+    REQUIRE( distribution-> quantile( 0.5 ) == 0 );
+    REQUIRE( distribution-> quantile( 0.9 ) == tiny );
+    REQUIRE( distribution-> percentile( 0 ) == 0.75 );
+}
@@ -0,0 +1,149 @@
+#include "catch.h"
+#include "MemoryView.h"
+#include "core/Algorithms/FineHistogram.h"
+#include <random>
+
+using namespace Carta::Core::Algorithms;
+
+namespace
+{
+typedef std::vector < int > VI;
+
+/// normal values, with nans and infinities
+std::vector < float >
+makeData()
+{
+    std::mt19937 gen( 7 );
+    std::normal_distribution < float > normal( 0, 1 );
+    std::vector < float > data;
+    for ( int i = 0 ; i < 200000 ; i++ ) {
+        float v = normal( gen );
+        if ( i % 100 == 0 ) {
+            v = NAN;
+        }
+        else if ( i % 1000 == 1 ) {
+            v = i % 2000 == 1 ? INFINITY : - INFINITY;
+        }
+        data.push_back( v );
+    }
+    return data;
+}
+
+/// histogram of binCount bins over [lo, hi], computed directly
+std::vector < double >
+directHistogram( const std::vector < float > & data, int binCount, double lo, double hi )
+{
+    std::vector < double > counts( binCount, 0 );
+    for ( float v : data ) {
+        if ( std::isfinite( v ) && v >= lo && v <= hi ) {
+            counts[std::min < int > ( ( v - lo ) / ( hi - lo ) * binCount, binCount - 1 )]++;
+        }
+    }
+    return counts;
+}
+}
+
+TEST_CASE( "Fine histogram rebins like a direct histogram", "[histogram]" )
+{
+    std::vector < float > data = makeData();
+    FloatView raw( data );
+    FineHistogram::SharedPtr histogram = FineHistogram::compute( & raw );
+    REQUIRE( histogram-> count() == 197800 );
+    float min = INFINITY;
+    for ( float v : data ) {
+        if ( std::isfinite( v ) ) {
+            min = std::min( min, v );
+        }
+    }
+    REQUIRE( histogram-> min() == min );
+
+    std::vector < double > direct = directHistogram( data, 25, histogram-> min(),
+                                                     histogram-> max() );
+    auto rebinned = histogram-> rebin( 25 );
+    REQUIRE( rebinned.size() == 25 );
+    double total = 0;
+    for ( size_t bin = 0 ; bin < rebinned.size() ; bin++ ) {
+        REQUIRE( std::fabs( rebinned[bin].second - direct[bin] ) <= 10 );
+        total += rebinned[bin].second;
+    }
+    REQUIRE( total == histogram-> count() );
+
+    // a narrow range needs finer bins than the histogram has
+    REQUIRE( histogram-> covers( 100, -1, 1 ) );
+    REQUIRE( ! histogram-> covers( 100, 0, 0.01 ) );
+}
+
+TEST_CASE( "Fine histogram of a range", "[histogram]" )
+{
+    std::vector < float > data = makeData();
+    FloatView raw( data );
+    FineHistogram::SharedPtr histogram = FineHistogram::compute( & raw, -1, 1 );
+    int64_t inside = std::count_if( data.begin(), data.end(), [] ( float v ) {
+                                        return v >= -1 && v <= 1;
+                                    } );
+    REQUIRE( histogram-> count() == inside );
+    REQUIRE( histogram-> min() >= -1 );
+    REQUIRE( histogram-> max() <= 1 );
+    REQUIRE( ! histogram-> covers( 10, -2, 1 ) );
+    REQUIRE( histogram-> covers( 10, -0.5, 0.5 ) );
+
+    std::vector < double > direct = directHistogram( data, 10, -0.5, 0.5 );
+    auto rebinned = histogram-> rebin( 10, -0.5, 0.5 );
+    REQUIRE( rebinned.size() == 10 );
+    REQUIRE( rebinned.front().first == Approx( -0.45 ) );
+    for ( size_t bin = 0 ; bin < rebinned.size() ; bin++ ) {
+        REQUIRE( std::fabs( rebinned[bin].second - direct[bin] ) <= 10 );
+    }
+}
+
+TEST_CASE( "Fine histogram of a range too narrow to split", "[histogram]" )
+{
+    // the width of the range is a denormal, so the bin scale would overflow
+    const double tiny = std::numeric_limits < double >::denorm_min();
+    std::vector < double > data;
+    for ( int i = 0 ; i < 1000 ; i++ ) {
+        data.push_back( i % 4 == 0 ? tiny : 0 );
+    }
+    DoubleView raw( data );
+    FineHistogram::SharedPtr histogram = FineHistogram::compute( & raw );
+    REQUIRE( histogram-> count() == 1000 );
+    REQUIRE( histogram-> min() == 0 );
+    REQUIRE( histogram-> max() == tiny );
+    REQUIRE( histogram-> bins()[0] == 1000 );
+    auto rebinned = histogram-> rebin( 10, 0, tiny );
+    double total = 0;
+    for ( auto & bin : rebinned ) {
+        total += bin.second;
+    }
+    REQUIRE( total == 1000 );
+}
+
+TEST_CASE( "Fine histogram of a range wider than the values", "[histogram]" )
+{
+    std::vector < float > data;
+    for ( int i = 0 ; i < 10000 ; i++ ) {
+        data.push_back( i / 9999.0f );
+    }
+    FloatView raw( data );
+
+    // the fine bins span the values, so the range can be rebinned without counting again
+    FineHistogram::SharedPtr histogram = FineHistogram::compute( & raw, -100, 100 );
+    REQUIRE( histogram-> min() == 0 );
+    REQUIRE( histogram-> max() == 1 );
+    REQUIRE( histogram-> covers( 1000, -100, 100 ) );
+    REQUIRE( FineHistogram::compute( & raw )-> covers( 1000, -100, 100 ) );
+
+    // the bins span the whole range, not just the values
+    auto rebinned = histogram-> rebin( 1000, -100, 100 );
+    REQUIRE( rebinned.size() == 1000 );
+    REQUIRE( rebinned.front().first == Approx( -99.9 ) );
+    REQUIRE( rebinned.back().first == Approx( 99.9 ) );
+    REQUIRE( rebinned[499].second == 0 );
+    REQUIRE( std::fabs( rebinned[500].second - 2000 ) <= 1 );
+    double total = 0;
+    for ( int bin = 500 ; bin < 505 ; bin++ ) {
+        total += rebinned[bin].second;
+    }
+    REQUIRE( total == 10000 );
+    REQUIRE( rebinned[505].second == 0 );
+}
@@ -0,0 +1,138 @@
+#include "catch.h"
+#include "core/ImageRegistry.h"
+#include <chrono>
+#include <thread>
+
+using namespace Carta::Core;
+
+namespace
+{
+/// image that counts how many instances are alive
+class CountedImage : public Image::ImageInterface
+{
+public:
+
+    CountedImage() : m_dims { 10, 10 }, m_unit( "Jy" ) { alive++; }
+
+    ~CountedImage() { alive--; }
+
+    virtual const Unit &
+    getPixelUnit() const override { return m_unit; }
+
+    virtual std::shared_ptr < Image::ImageInterface >
+    getPermuted( const std::vector < int > & ) override { return nullptr; }
+
+    virtual const VI &
+    dims() const override { return m_dims; }
+
+    virtual bool
+    hasMask() const override { return false; }
+
+    virtual bool
+    hasErrorsInfo() const override { return false; }
+
+    virtual PixelType
+    pixelType() const override { return PixelType::Real64; }
+
+    virtual PixelType
+    errorType() const override { return PixelType::Real64; }
+
+    virtual NdArray::RawViewInterface *
+    getDataSlice( const SliceND & ) override { return nullptr; }
+
+    virtual NdArray::Byte *
+    getMaskSlice( const SliceND & ) override { return nullptr; }
+
+    virtual NdArray::RawViewInterface *
+    getErrorSlice( const SliceND & ) override { return nullptr; }
+
+    virtual Image::MetaDataInterface::SharedPtr
+    metaData() override { return nullptr; }
+
+    static int alive;
+
+private:
+
+    VI m_dims;
+    Unit m_unit;
+};
+
+int CountedImage::alive = 0;
+}
+
+TEST_CASE( "Image registry testing", "[imageregistry]" ) {
+
+    ImageRegistry registry;
+    int opens = 0;
+    auto open = [&opens] ( const QString & ) -> Image::ImageInterface::SharedPtr {
+        opens++;
+        return std::make_shared < CountedImage > ();
+    };
+
+    SECTION( "Images are shared while in use" ) {
+        auto a = registry.acquireKey( "a", "a.fits", open );
+        auto b = registry.acquireKey( "a", "a.fits", open );
+        auto c = registry.acquireKey( "c", "c.fits", open );
+        REQUIRE( opens == 2 );
+        REQUIRE( a == b );
+        REQUIRE( a != c );
+        REQUIRE( registry.size() == 2 );
+        REQUIRE( registry.idleCount() == 0 );
+
+        // unregistered files are always opened
+        auto d = registry.acquireKey( "", "http://a.fits", open );
+        auto e = registry.acquireKey( "", "http://a.fits", open );
+        REQUIRE( opens == 4 );
+        REQUIRE( d != e );
+    }
+
+    SECTION( "Released images stay open until evicted" ) {
+        auto a = registry.acquireKey( "a", "a.fits", open );
+        a = nullptr;
+        REQUIRE( registry.idleCount() == 1 );
+        REQUIRE( CountedImage::alive == 1 );
+        a = registry.acquireKey( "a", "a.fits", open );
+        REQUIRE( opens == 1 );
+        REQUIRE( registry.idleCount() == 0 );
+
+        // too many idle images
+        registry.setMaxIdle( 1 );
+        auto b = registry.acquireKey( "b", "b.fits", open );
+        a = nullptr;
+        b = nullptr;
+        REQUIRE( registry.idleCount() == 1 );
+        REQUIRE( CountedImage::alive == 1 );
+        b = registry.acquireKey( "b", "b.fits", open );
+        REQUIRE( opens == 2 );
+
+        // idle timeout
+        registry.setIdleTimeout( 0 );
+        b = nullptr;
+        REQUIRE( registry.size() == 0 );
+        REQUIRE( CountedImage::alive == 0 );
+        b = registry.acquireKey( "b", "b.fits", open );
+        REQUIRE( opens == 3 );
+    }
+
+    SECTION( "Acquiring an image evicts the ones that timed out" ) {
+        registry.setIdleTimeout( 20 );
+        auto a = registry.acquireKey( "a", "a.fits", open );
+        a = nullptr;
+        REQUIRE( CountedImage::alive == 1 );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 30 ) );
+        auto b = registry.acquireKey( "b", "b.fits", open );
+        REQUIRE( registry.size() == 1 );
+        REQUIRE( CountedImage::alive == 1 );
+    }
+
+    SECTION( "Failed opens are not registered" ) {
+        auto a = registry.acquireKey( "a", "a.fits", [] ( const QString & ) {
+                                          return Image::ImageInterface::SharedPtr();
+                                      }
+                                      );
+        REQUIRE( ! a );
+        REQUIRE( registry.size() == 0 );
+    }
+
+    registry.clearIdle();
+}
@@ -0,0 +1,50 @@
+#include "catch.h"
+#include "core/Algorithms/IndexImage.h"
+#include "CartaLib/PixelPipeline/CustomizablePixelPipeline.h"
+#include "core/GrayColormap.h"
+#include <cmath>
+
+using namespace Carta;
+using Core::Algorithms::IndexImage;
+
+TEST_CASE( "Index image", "[index]" ) {
+
+    const int width = 7, height = 5;
+    std::vector<float> data( width * height);
+    for( size_t i = 0 ; i < data.size() ; i ++) {
+        data[i] = std::sin( i * 0.7) * 3;
+    }
+    data[3] = std::nanf( "");
+
+    IndexImage index( width, height, -2, 2);
+    index.quantizeRows( data.data(), 0, 2);
+    index.quantizeRows( data.data(), 2, height);
+
+    Lib::PixelPipeline::CustomizablePixelPipeline pp;
+    pp.setColormap( std::make_shared<Core::GrayColormap>());
+    pp.setMinMax( -2, 2);
+    Lib::PixelPipeline::CachedPipeline<true> lut;
+    lut.cache( pp, 1000, -2, 2);
+
+    QRgb nanColor = qRgb( 255, 0, 0);
+    std::vector<QRgb> table = index.colorTable( lut, nanColor);
+    REQUIRE( int( table.size()) == IndexImage::ColorTableSize);
+    REQUIRE( table[IndexImage::NanIndex] == nanColor);
+
+    std::vector<QRgb> colorized( width * height);
+    index.colorize( table, 0, height, reinterpret_cast<uchar *>( colorized.data()));
+
+    // compare with converting the raw values directly, allowing for rounding
+    for( int y = 0 ; y < height ; y ++) {
+        for( int x = 0 ; x < width ; x ++) {
+            QRgb direct;
+            lut.convertqBatch( & data[y * width + x], & direct, 1, nanColor);
+            // the image is built bottom-up
+            QRgb indexed = colorized[( height - 1 - y) * width + x];
+            INFO( "x=" << x << " y=" << y);
+            REQUIRE( std::abs( qRed( direct) - qRed( indexed)) <= 1);
+            REQUIRE( std::abs( qGreen( direct) - qGreen( indexed)) <= 1);
+            REQUIRE( std::abs( qBlue( direct) - qBlue( indexed)) <= 1);
+        }
+    }
+}
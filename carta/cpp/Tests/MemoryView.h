@@ -0,0 +1,140 @@
+/**
+ * In-memory views used as test data.
+ *
+ * The data is stored with the first axis fastest. The chunked forEach() normally passes
+ * pointers into the data, but with a maximum chunk size it behaves like the image
+ * loaders instead: the data is copied into the caller's buffer (when one is given) in
+ * chunks of at most that many elements, each of them starting at the beginning of the
+ * buffer.
+ **/
+
+#pragma once
+
+#include "CartaLib/IImage.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+template < typename Scalar >
+class MemoryView : public NdArray::RawViewInterface
+{
+public:
+
+    /// one dimensional view of data
+    MemoryView( const std::vector < Scalar > & data, int64_t maxChunk = 0 )
+        : MemoryView( VI { int( data.size() ) }, data, maxChunk ) { }
+
+    /// view of data with the given dimensions
+    /// \param maxChunk if positive, the maximum number of elements per chunk
+    MemoryView( const VI & dims, const std::vector < Scalar > & data, int64_t maxChunk = 0 )
+        : m_dims( dims ), m_data( data ), m_pos( dims.size(), 0 ), m_maxChunk( maxChunk ) { }
+
+    virtual PixelType
+    pixelType() override
+    {
+        return std::is_same < Scalar, float >::value ? PixelType::Real32 : PixelType::Real64;
+    }
+
+    virtual const VI &
+    dims() override { return m_dims; }
+
+    virtual const char *
+    get( const VI & pos ) override
+    {
+        return reinterpret_cast < const char * > ( & m_data[index( pos )] );
+    }
+
+    virtual void
+    forEach( std::function < void (const char *) > func, Traversal ) override
+    {
+        for ( const Scalar & v : m_data ) {
+            func( reinterpret_cast < const char * > ( & v ) );
+        }
+    }
+
+    virtual const VI &
+    currentPos() override { return m_pos; }
+
+    virtual RawViewInterface *
+    getView( const SliceND & sliceInfo ) override
+    {
+        SliceND::ApplyResult ar = SliceND( sliceInfo ).apply( m_dims );
+        VI dims, pos( m_dims.size() );
+        int64_t total = 1;
+        for ( const auto & r : ar.dims() ) {
+            dims.push_back( std::max < int > ( r.count, 1 ) );
+            total *= dims.back();
+        }
+        std::vector < Scalar > data;
+        for ( int64_t i = 0 ; i < total ; i++ ) {
+            int64_t rest = i;
+            for ( size_t k = 0 ; k < dims.size() ; k++ ) {
+                pos[k] = ar.dims()[k].start + ( rest % dims[k] ) * ar.dims()[k].step;
+                rest /= dims[k];
+            }
+            data.push_back( m_data[index( pos )] );
+        }
+        return new MemoryView( dims, data, m_maxChunk );
+    }
+
+    virtual int64_t
+    read( int64_t buffSize, char * buff, Traversal ) override
+    {
+        int64_t n = std::min < int64_t > ( buffSize / sizeof( Scalar ), m_data.size() - m_readPos );
+        std::memcpy( buff, & m_data[m_readPos], n * sizeof( Scalar ) );
+        m_readPos += n;
+        return n * sizeof( Scalar );
+    }
+
+    virtual void
+    seek( int64_t ind ) override { m_readPos = ind; }
+
+    virtual int64_t
+    read( int64_t chunk, int64_t buffSize, char * buff, Traversal traversal ) override
+    {
+        seek( chunk * ( buffSize / sizeof( Scalar ) ) );
+        return read( buffSize, buff, traversal );
+    }
+
+    virtual void
+    forEach( int64_t buffSize, std::function < void (const char *, int64_t) > func,
+             char * buff, Traversal ) override
+    {
+        int64_t chunk = buffSize / sizeof( Scalar );
+        if ( m_maxChunk > 0 ) {
+            chunk = std::min( chunk, m_maxChunk );
+        }
+        for ( size_t i = 0 ; i < m_data.size() ; i += chunk ) {
+            int64_t n = std::min < int64_t > ( chunk, m_data.size() - i );
+            const char * data = reinterpret_cast < const char * > ( & m_data[i] );
+            if ( m_maxChunk > 0 && buff ) {
+                std::memcpy( buff, data, n * sizeof( Scalar ) );
+                data = buff;
+            }
+            func( data, n );
+        }
+    }
+
+private:
+
+    int64_t
+    index( const VI & pos ) const
+    {
+        int64_t result = 0, stride = 1;
+        for ( size_t i = 0 ; i < m_dims.size() ; i++ ) {
+            result += pos[i] * stride;
+            stride *= m_dims[i];
+        }
+        return result;
+    }
+
+    VI m_dims;
+    std::vector < Scalar > m_data;
+    VI m_pos;
+    int64_t m_maxChunk = 0;
+    int64_t m_readPos = 0;
+};
+
+typedef MemoryView < float > FloatView;
+typedef MemoryView < double > DoubleView;
@@ -0,0 +1,46 @@
+#include "catch.h"
+#include "core/Algorithms/MipmapPyramid.h"
+#include <cmath>
+#include <limits>
+
+using namespace Carta::Core::Algorithms;
+
+TEST_CASE( "Mipmap pyramid testing", "[mipmap]" ) {
+
+    const double nan = std::numeric_limits < double >::quiet_NaN();
+
+    SECTION( "Level selection" ) {
+        MipmapPyramid pyramid( 1000, 300 );
+        REQUIRE( pyramid.maxLevel() == 10 );
+        REQUIRE( pyramid.levelForZoom( 2.0 ) == 0 );
+        REQUIRE( pyramid.levelForZoom( 1.0 ) == 0 );
+        REQUIRE( pyramid.levelForZoom( 0.7 ) == 0 );
+        REQUIRE( pyramid.levelForZoom( 0.5 ) == 1 );
+        REQUIRE( pyramid.levelForZoom( 0.2 ) == 2 );
+        REQUIRE( pyramid.levelForZoom( 1e-9 ) == 10 );
+    }
+
+    SECTION( "NaN aware reduction" ) {
+        // 3x3 input, reduced by 2 gives 2x2 output with partial blocks at the edges
+        MipmapPyramid::Level src;
+        src.width = 3;
+        src.height = 3;
+        src.data = { 1, 2, 3,
+                     3, nan, 5,
+                     nan, nan, 7 };
+
+        MipmapPyramid::Level mean = MipmapPyramid::reduce( src, 2, MipmapPyramid::Reduction::Mean );
+        REQUIRE( mean.width == 2 );
+        REQUIRE( mean.height == 2 );
+        REQUIRE( mean.data[0] == 2 );
+        REQUIRE( mean.data[1] == 4 );
+        REQUIRE( std::isnan( mean.data[2] ) );
+        REQUIRE( mean.data[3] == 7 );
+
+        MipmapPyramid::Level max = MipmapPyramid::reduce( src, 2, MipmapPyramid::Reduction::Max );
+        REQUIRE( max.data[0] == 3 );
+        REQUIRE( max.data[1] == 5 );
+        REQUIRE( std::isnan( max.data[2] ) );
+        REQUIRE( max.data[3] == 7 );
+    }
+}
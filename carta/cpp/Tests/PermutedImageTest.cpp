@@ -0,0 +1,143 @@
+#include "catch.h"
+#include "MemoryView.h"
+#include "CartaLib/PermutedImage.h"
+#include "CartaLib/Algorithms/PermuteAxes.h"
+#include <cstring>
+#include <numeric>
+
+using namespace Carta::Lib;
+
+namespace
+{
+typedef std::vector < int > VI;
+
+/// value of the source element at pos
+double
+value( const VI & pos )
+{
+    return pos[0] + 100 * pos[1] + 10000 * pos[2];
+}
+
+/// 3D source cube where each element identifies its position
+DoubleView *
+makeCube( const VI & dims )
+{
+    std::vector < double > data;
+    for ( int z = 0 ; z < dims[2] ; z++ ) {
+        for ( int y = 0 ; y < dims[1] ; y++ ) {
+            for ( int x = 0 ; x < dims[0] ; x++ ) {
+                data.push_back( value( { x, y, z } ) );
+            }
+        }
+    }
+    return new DoubleView( dims, data );
+}
+
+/// read the whole view in sequential order, with a small buffer
+std::vector < double >
+readAll( NdArray::RawViewInterface & view, int64_t buffElements )
+{
+    std::vector < double > result;
+    std::vector < char > buff( buffElements * 8 );
+    view.forEach( buff.size(), [&result] ( const char * data, int64_t count ) {
+                      const double * d = reinterpret_cast < const double * > ( data );
+                      result.insert( result.end(), d, d + count );
+                  }, buff.data() );
+    return result;
+}
+
+/// the expected contents of the source permuted by perm, in sequential order
+std::vector < double >
+expected( const VI & srcDims, const VI & perm )
+{
+    VI dims( 3 ), pos( 3 ), srcPos( 3 );
+    for ( int i = 0 ; i < 3 ; i++ ) {
+        dims[i] = srcDims[perm[i]];
+    }
+    std::vector < double > result;
+    for ( pos[2] = 0 ; pos[2] < dims[2] ; pos[2]++ ) {
+        for ( pos[1] = 0 ; pos[1] < dims[1] ; pos[1]++ ) {
+            for ( pos[0] = 0 ; pos[0] < dims[0] ; pos[0]++ ) {
+                for ( int i = 0 ; i < 3 ; i++ ) {
+                    srcPos[perm[i]] = pos[i];
+                }
+                result.push_back( value( srcPos ) );
+            }
+        }
+    }
+    return result;
+}
+}
+
+TEST_CASE( "permuteAxes matches a naive transpose", "[permute]" )
+{
+    VI srcDims { 37, 45, 3 };
+    std::unique_ptr < DoubleView > cube( makeCube( srcDims ) );
+    std::vector < double > src = readAll( * cube, 1000000 );
+    for ( VI perm : std::vector < VI > { { 0, 1, 2 }, { 1, 0, 2 }, { 2, 0, 1 }, { 2, 1, 0 }, { 1, 2, 0 } } ) {
+        std::vector < double > dst( src.size() );
+        Algorithms::permuteAxes( reinterpret_cast < const char * > ( src.data() ), srcDims, perm,
+                                 sizeof( double ), reinterpret_cast < char * > ( dst.data() ) );
+        REQUIRE( dst == expected( srcDims, perm ) );
+    }
+}
+
+TEST_CASE( "PermutedView reads in the permuted order", "[permute]" )
+{
+    VI srcDims { 7, 5, 4 };
+    VI perm { 2, 0, 1 };
+    PermutedView view( makeCube( srcDims ), perm );
+    REQUIRE( view.dims() == VI( { 4, 7, 5 } ) );
+
+    // buffer sizes that split rows and planes in various places
+    for ( int64_t buffElements : { 1, 3, 11, 28, 140 } ) {
+        REQUIRE( readAll( view, buffElements ) == expected( srcDims, perm ) );
+    }
+
+    // random access
+    double v;
+    std::memcpy( & v, view.get( { 3, 6, 2 } ), sizeof( v ) );
+    REQUIRE( v == value( { 6, 2, 3 } ) );
+
+    // the optimal order is the order of the source
+    std::vector < double > optimal;
+    view.forEach( 1000, [&optimal] ( const char * data, int64_t count ) {
+                      const double * d = reinterpret_cast < const double * > ( data );
+                      optimal.insert( optimal.end(), d, d + count );
+                  }, nullptr, NdArray::RawViewInterface::Traversal::Optimal );
+    REQUIRE( optimal == expected( srcDims, { 0, 1, 2 } ) );
+}
+
+TEST_CASE( "PermutedView reads sources that deliver several chunks", "[permute]" )
+{
+    // the source copies every chunk to the start of the buffer, like the tile readers
+    VI srcDims { 7, 5, 4 };
+    VI perm { 1, 2, 0 };
+    PermutedView view( new DoubleView( srcDims, expected( srcDims, { 0, 1, 2 } ), 3 ), perm );
+    for ( int64_t buffElements : { 1, 11, 140 } ) {
+        REQUIRE( readAll( view, buffElements ) == expected( srcDims, perm ) );
+    }
+}
+
+TEST_CASE( "PermutedView slices translate to the source", "[permute]" )
+{
+    VI srcDims { 7, 5, 4 };
+    PermutedView view( makeCube( srcDims ), { 2, 0, 1 } );
+
+    // one spectrum at x = 3, y = 1 along the first axis of the view
+    SliceND slice;
+    slice.next().index( 3 ).next().index( 1 );
+    std::unique_ptr < NdArray::RawViewInterface > profile( view.getView( slice ) );
+    std::vector < double > values = readAll( * profile, 2 );
+    REQUIRE( values.size() == 4 );
+    for ( int z = 0 ; z < 4 ; z++ ) {
+        REQUIRE( values[z] == value( { 3, 1, z } ) );
+    }
+
+    // stateful reads continue where the previous one stopped
+    std::vector < double > buff( 3 );
+    profile-> seek( 0 );
+    REQUIRE( profile-> read( 3 * 8, reinterpret_cast < char * > ( buff.data() ) ) == 3 * 8 );
+    REQUIRE( profile-> read( 3 * 8, reinterpret_cast < char * > ( buff.data() ) ) == 1 * 8 );
+    REQUIRE( buff[0] == value( { 3, 1, 3 } ) );
+}
@@ -0,0 +1,36 @@
+#include "catch.h"
+#include "core/Algorithms/PipelineLutCache.h"
+#include "CartaLib/PixelPipeline/CustomizablePixelPipeline.h"
+#include "core/GrayColormap.h"
+
+using namespace Carta;
+
+TEST_CASE( "Pipeline lookup tables are shared", "[lutcache]" ) {
+
+    Core::Algorithms::PipelineLutCache cache;
+    Lib::PixelPipeline::CustomizablePixelPipeline pp;
+    pp.setColormap( std::make_shared<Core::GrayColormap>());
+    pp.setMinMax( -2, 2);
+
+    SECTION( "same settings share one table") {
+        auto lut1 = cache.interpolated( pp, Core::CacheKey::fromString( pp.cacheId()), 1000, -2, 2);
+        auto lut2 = cache.interpolated( pp, Core::CacheKey::fromString( pp.cacheId()), 1000, -2, 2);
+        REQUIRE( lut1 == lut2);
+        REQUIRE( cache.buildCount() == 1);
+    }
+
+    SECTION( "any change in the key builds a new table") {
+        auto lut1 = cache.interpolated( pp, Core::CacheKey::fromString( pp.cacheId()), 1000, -2, 2);
+        REQUIRE( cache.nearest( pp, Core::CacheKey::fromString( pp.cacheId()), 1000, -2, 2) != nullptr);
+        REQUIRE( cache.interpolated( pp, Core::CacheKey::fromString( pp.cacheId()), 500, -2, 2) != lut1);
+        pp.setMinMax( -1, 2);
+        REQUIRE( cache.interpolated( pp, Core::CacheKey::fromString( pp.cacheId()), 1000, -1, 2) != lut1);
+        REQUIRE( cache.buildCount() == 4);
+    }
+
+    SECTION( "pipelines without a cache id are not shared") {
+        auto lut1 = cache.interpolated( pp, Core::CacheKey(), 1000, -2, 2);
+        auto lut2 = cache.interpolated( pp, Core::CacheKey(), 1000, -2, 2);
+        REQUIRE( lut1 != lut2);
+    }
+}
@@ -0,0 +1,129 @@
+#include "catch.h"
+#include "core/Algorithms/PixelRowCache.h"
+
+using namespace Carta::Core::Algorithms;
+
+namespace
+{
+/// 2D image where pixel (x,y) has value 100*y+x, answering only row queries
+class RowImage : public Image::ImageInterface
+{
+public:
+
+    /// \param packed if true, rows are read as floats and widened in place
+    RowImage( int width, int height, bool packed = false )
+        : m_dims { width, height }, m_unit( "Jy" ), m_packed( packed ) { }
+
+    virtual const Unit &
+    getPixelUnit() const override { return m_unit; }
+
+    virtual std::shared_ptr < Image::ImageInterface >
+    getPermuted( const std::vector < int > & ) override { return nullptr; }
+
+    virtual const VI &
+    dims() const override { return m_dims; }
+
+    virtual bool
+    hasMask() const override { return false; }
+
+    virtual bool
+    hasErrorsInfo() const override { return false; }
+
+    virtual PixelType
+    pixelType() const override { return PixelType::Real64; }
+
+    virtual PixelType
+    errorType() const override { return PixelType::Real64; }
+
+    virtual NdArray::RawViewInterface *
+    getDataSlice( const SliceND & ) override { return nullptr; }
+
+    virtual NdArray::Byte *
+    getMaskSlice( const SliceND & ) override { return nullptr; }
+
+    virtual NdArray::RawViewInterface *
+    getErrorSlice( const SliceND & ) override { return nullptr; }
+
+    virtual bool
+    getRow( const VI & pos, double * row ) override
+    {
+        rowReads++;
+        if ( m_packed ) {
+            float * values = reinterpret_cast < float * > ( row );
+            for ( int x = 0 ; x < m_dims[0] ; x++ ) {
+                values[x] = 100 * pos[1] + x;
+            }
+            widenRow < float > ( row, m_dims[0] );
+            return true;
+        }
+        for ( int x = 0 ; x < m_dims[0] ; x++ ) {
+            row[x] = 100 * pos[1] + x;
+        }
+        return true;
+    }
+
+    virtual Image::MetaDataInterface::SharedPtr
+    metaData() override { return nullptr; }
+
+    int rowReads = 0;
+
+private:
+
+    VI m_dims;
+    Unit m_unit;
+    bool m_packed = false;
+};
+}
+
+TEST_CASE( "Pixel row cache testing", "[rowcache]" ) {
+
+    RowImage image( 50, 40 );
+    PixelRowCache cache( 2 );
+    double val = 0;
+
+    SECTION( "Values and bounds" ) {
+        REQUIRE( cache.value( & image, { 3, 7 }, val ) );
+        REQUIRE( val == 703 );
+        REQUIRE( cache.value( & image, { 49, 39 }, val ) );
+        REQUIRE( val == 3949 );
+        REQUIRE_FALSE( cache.value( & image, { 50, 0 }, val ) );
+        REQUIRE_FALSE( cache.value( & image, { 0, - 1 }, val ) );
+        REQUIRE_FALSE( cache.value( & image, { 0 }, val ) );
+    }
+
+    SECTION( "Moving along a row reads it once" ) {
+        for ( int x = 0 ; x < 50 ; x++ ) {
+            REQUIRE( cache.value( & image, { x, 5 }, val ) );
+            REQUIRE( val == 500 + x );
+        }
+        REQUIRE( image.rowReads == 1 );
+        REQUIRE( cache.rowReads() == 1 );
+    }
+
+    SECTION( "Least recently used row is replaced" ) {
+        cache.value( & image, { 0, 1 }, val );
+        cache.value( & image, { 0, 2 }, val );
+        cache.value( & image, { 0, 1 }, val );
+        cache.value( & image, { 0, 3 }, val );
+        REQUIRE( image.rowReads == 3 );
+        cache.value( & image, { 0, 1 }, val );
+        REQUIRE( image.rowReads == 3 );
+        cache.value( & image, { 0, 2 }, val );
+        REQUIRE( image.rowReads == 4 );
+        cache.clear();
+        cache.value( & image, { 0, 2 }, val );
+        REQUIRE( image.rowReads == 5 );
+    }
+}
+
+TEST_CASE( "Pixel rows read as floats are widened in place", "[rowcache]" ) {
+
+    RowImage image( 50, 40, true );
+    PixelRowCache cache;
+    double val = 0;
+    for ( int x = 0 ; x < 50 ; x++ ) {
+        REQUIRE( cache.value( & image, { x, 9 }, val ) );
+        REQUIRE( val == 900 + x );
+    }
+    REQUIRE( image.rowReads == 1 );
+}
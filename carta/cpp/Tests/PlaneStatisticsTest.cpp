@@ -0,0 +1,134 @@
+#include "catch.h"
+#include "MemoryView.h"
+#include "core/Algorithms/PlaneStatistics.h"
+#include "core/Algorithms/quantileAlgorithms.h"
+#include <QBuffer>
+#include <random>
+
+using namespace Carta::Core::Algorithms;
+
+namespace
+{
+typedef std::vector < int > VI;
+
+std::vector < float >
+makeData()
+{
+    std::mt19937 gen( 5 );
+    std::normal_distribution < float > normal( 10, 3 );
+    std::vector < float > data;
+    for ( int i = 0 ; i < 100000 ; i++ ) {
+        data.push_back( i % 50 == 0 ? NAN : normal( gen ) );
+    }
+    return data;
+}
+}
+
+TEST_CASE( "Plane statistics sketch is exact", "[statistics]" )
+{
+    FloatView raw( makeData() );
+    PlaneStatistics::SharedPtr stats = PlaneStatistics::compute( & raw );
+    REQUIRE( stats-> count() == 98000 );
+    REQUIRE( stats-> nanCount() == 2000 );
+
+    NdArray::TypedView < float > view( & raw, false );
+    std::vector < float > exact = quantiles2pixels( view, PlaneStatistics::sketchQuantiles() );
+    for ( size_t k = 0 ; k < exact.size() ; k++ ) {
+        REQUIRE( stats-> quantile( PlaneStatistics::sketchQuantiles()[k] ) == exact[k] );
+    }
+    REQUIRE( stats-> min() == exact.front() );
+    REQUIRE( stats-> max() == exact.back() );
+
+    // values between the sketch quantiles come from the histogram
+    double width = ( stats-> max() - stats-> min() ) / PlaneStatistics::HistogramBins;
+    double median = stats-> quantile( 0.5 );
+    REQUIRE( std::fabs( stats-> quantile( 0.6 ) - quantiles2pixels( view, { 0.6 } )[0] ) <= width );
+    REQUIRE( std::fabs( stats-> percentile( median ) - 0.5 ) < 0.001 );
+    REQUIRE( stats-> percentile( stats-> min() - 1 ) == 0 );
+    REQUIRE( stats-> percentile( stats-> max() ) == 1 );
+}
+
+TEST_CASE( "Plane statistics rank infinities like the exact quantiles", "[statistics]" )
+{
+    // 5% -inf and 10% +inf
+    std::vector < float > data = makeData();
+    for ( size_t i = 0 ; i < data.size() ; i++ ) {
+        if ( i % 20 == 1 ) {
+            data[i] = - INFINITY;
+        }
+        else if ( i % 10 == 3 ) {
+            data[i] = INFINITY;
+        }
+    }
+    FloatView raw( data );
+    PlaneStatistics::SharedPtr stats = PlaneStatistics::compute( & raw );
+    REQUIRE( stats-> negativeInfiniteCount() == 5000 );
+    REQUIRE( stats-> positiveInfiniteCount() == 10000 );
+    REQUIRE( std::isfinite( stats-> min() ) );
+    REQUIRE( std::isfinite( stats-> max() ) );
+
+    NdArray::TypedView < float > view( & raw, false );
+    std::vector < float > exact = quantiles2pixels( view, PlaneStatistics::sketchQuantiles() );
+    for ( size_t k = 0 ; k < exact.size() ; k++ ) {
+        REQUIRE( stats-> quantile( PlaneStatistics::sketchQuantiles()[k] ) == exact[k] );
+    }
+
+    // the histogram answers skip the infinities in the same way
+    double width = ( stats-> max() - stats-> min() ) / PlaneStatistics::HistogramBins;
+    REQUIRE( stats-> quantile( 0.03 ) == - INFINITY );
+    REQUIRE( stats-> quantile( 0.93 ) == INFINITY );
+    REQUIRE( std::fabs( stats-> quantile( 0.6 ) - quantiles2pixels( view, { 0.6 } )[0] ) <= width );
+    double total = stats-> count() + 15000;
+    REQUIRE( stats-> percentile( stats-> min() - 1 ) == Approx( 5000 / total ) );
+    REQUIRE( stats-> percentile( stats-> max() ) == Approx( ( 5000 + stats-> count() ) / total ) );
+    REQUIRE( stats-> percentile( INFINITY ) == 1 );
+}
+
+TEST_CASE( "Plane statistics of a range too narrow to split", "[statistics]" )
+{
+    // the width of the range is a denormal, so the histogram scale would overflow
+    const double tiny = std::numeric_limits < double >::denorm_min();
+    std::vector < double > data;
+    for ( int i = 0 ; i < 1000 ; i++ ) {
+        data.push_back( i % 4 == 0 ? tiny : 0 );
+    }
+    DoubleView raw( data );
+    PlaneStatistics::SharedPtr stats = PlaneStatistics::compute( & raw );
+    REQUIRE( stats-> count() == 1000 );
+    REQUIRE( stats-> min() == 0 );
+    REQUIRE( stats-> max() == tiny );
+    REQUIRE( stats-> histogram()[0] == 1000 );
+    REQUIRE( stats-> quantile( 0.5 ) == 0 );
+    REQUIRE( stats-> quantile( 0.9 ) == tiny );
+}
+
+TEST_CASE( "Plane statistics survive a round trip", "[statistics]" )
+{
+    FloatView raw( makeData() );
+    PlaneStatistics::SharedPtr stats = PlaneStatistics::compute( & raw );
+
+    QByteArray bytes;
+    QBuffer buffer( & bytes );
+    buffer.open( QIODevice::WriteOnly );
+    QDataStream out( & buffer );
+    stats-> write( out );
+    buffer.close();
+
+    buffer.open( QIODevice::ReadOnly );
+    QDataStream in( & buffer );
+    PlaneStatistics::SharedPtr copy = PlaneStatistics::read( in );
+    REQUIRE( copy );
+    REQUIRE( copy-> count() == stats-> count() );
+    REQUIRE( copy-> nanCount() == stats-> nanCount() );
+    REQUIRE( copy-> sum() == stats-> sum() );
+    REQUIRE( copy-> histogram() == stats-> histogram() );
+    REQUIRE( copy-> sketch() == stats-> sketch() );
+    REQUIRE( copy-> quantile( 0.3 ) == stats-> quantile( 0.3 ) );
+
+    // truncated data is rejected
+    buffer.close();
+    bytes.truncate( bytes.size() / 2 );
+    buffer.open( QIODevice::ReadOnly );
+    QDataStream truncated( & buffer );
+    REQUIRE( ! PlaneStatistics::read( truncated ) );
+}
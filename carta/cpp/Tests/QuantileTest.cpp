@@ -0,0 +1,119 @@
+#include "catch.h"
+#include "MemoryView.h"
+#include "core/Algorithms/quantileAlgorithms.h"
+#include <cstring>
+#include <random>
+
+using namespace Carta::Core::Algorithms;
+
+namespace
+{
+typedef std::vector < int > VI;
+
+/// number of finite values <= v
+int64_t
+countBelow( const std::vector < float > & data, double v )
+{
+    int64_t result = 0;
+    for ( float x : data ) {
+        if ( std::isfinite( x ) && x <= v ) {
+            result++;
+        }
+    }
+    return result;
+}
+}
+
+TEST_CASE( "Histogram quantiles are within the rank error", "[quantiles]" )
+{
+    std::mt19937 gen( 7 );
+    std::vector < std::vector < float > > datasets( 3 );
+    std::normal_distribution < float > normal( 5, 2 );
+    std::lognormal_distribution < float > lognormal( 0, 3 );
+    std::uniform_int_distribution < int > discrete( 0, 9 );
+    for ( int i = 0 ; i < 200000 ; i++ ) {
+        datasets[0].push_back( normal( gen ) );
+        datasets[1].push_back( i % 10 == 0 ? NAN : lognormal( gen ) );
+        datasets[2].push_back( discrete( gen ) );
+    }
+    std::vector < double > quant { 0.0, 0.001, 0.025, 0.5, 0.975, 0.999, 1.0 };
+    for ( auto & data : datasets ) {
+        FloatView raw( data );
+        NdArray::TypedView < float > view( & raw, false );
+        std::vector < float > approx = histogramQuantiles( view, quant );
+        std::vector < float > exact = quantiles2pixels( view, quant );
+        REQUIRE( approx.size() == quant.size() );
+        int64_t total = countBelow( data, INFINITY );
+        for ( size_t k = 0 ; k < quant.size() ; k++ ) {
+            // the approximation lies in a bin that contains the exact quantile, and
+            // that bin holds at most HistogramQuantileRankError of the values
+            int64_t error = std::abs( countBelow( data, approx[k] ) - countBelow( data, exact[k] ) );
+            REQUIRE( error <= total * HistogramQuantileRankError + 1 );
+        }
+        REQUIRE( approx.front() == exact.front() );
+        REQUIRE( approx.back() == exact.back() );
+    }
+}
+
+TEST_CASE( "Histogram quantiles of degenerate data", "[quantiles]" )
+{
+    FloatView constant( std::vector < float > ( 1000, 3.5f ) );
+    NdArray::TypedView < float > constantView( & constant, false );
+    REQUIRE( histogramQuantiles( constantView, { 0.1, 0.9 } ) == std::vector < float > ( { 3.5f, 3.5f } ) );
+
+    FloatView nans( std::vector < float > ( 1000, NAN ) );
+    NdArray::TypedView < float > nanView( & nans, false );
+    std::vector < float > result = histogramQuantiles( nanView, { 0.5 } );
+    REQUIRE( result.size() == 1 );
+    REQUIRE( std::isnan( result[0] ) );
+}
+
+TEST_CASE( "Bucket quantiles match quickselect", "[quantiles]" )
+{
+    std::mt19937 gen( 11 );
+    std::normal_distribution < float > normal( 0, 1 );
+    std::uniform_int_distribution < int > discrete( 0, 3 );
+    std::vector < double > quant { 0.0, 0.0001, 0.025, 0.3, 0.5, 0.975, 0.9999, 1.0 };
+    for ( int kind = 0 ; kind < 4 ; kind++ ) {
+        std::vector < float > data;
+        for ( int i = 0 ; i < 100000 ; i++ ) {
+            float v = kind == 1 ? discrete( gen ) : normal( gen );
+            if ( kind == 2 && i % 100 == 0 ) {
+                v = i % 200 == 0 ? NAN : 1e30f;
+            }
+            if ( kind == 3 && i % 1000 == 0 ) {
+                v = i % 3000 == 0 ? - INFINITY : INFINITY;
+            }
+            data.push_back( v );
+        }
+        FloatView raw( data );
+        NdArray::TypedView < float > view( & raw, false );
+        REQUIRE( bucketQuantiles( view, quant ) == quantiles2pixels( view, quant ) );
+    }
+}
+
+TEST_CASE( "Bucket quantiles of a range too narrow to split", "[quantiles]" )
+{
+    // the width of the range is a denormal, so the bucket scale would overflow
+    const double tiny = std::numeric_limits < double >::denorm_min();
+    std::vector < double > data;
+    for ( int i = 0 ; i < 1000 ; i++ ) {
+        data.push_back( i % 3 == 0 ? tiny : 0 );
+    }
+    DoubleView raw( data );
+    NdArray::TypedView < double > view( & raw, false );
+    std::vector < double > quant { 0.0, 0.5, 0.9, 1.0 };
+    REQUIRE( bucketQuantiles( view, quant ) == quantiles2pixels( view, quant ) );
+    REQUIRE( bucketQuantiles( view, quant ) == std::vector < double > ( { 0, 0, tiny, tiny } ) );
+}
+
+TEST_CASE( "Auto quantiles are exact for small views", "[quantiles]" )
+{
+    std::vector < float > data;
+    for ( int i = 0 ; i < 1000 ; i++ ) {
+        data.push_back( ( i * 7919 ) % 1000 );
+    }
+    FloatView raw( data );
+    std::vector < double > result = quantiles2pixels( & raw, { 0.025, 0.975 }, QuantileMethod::Auto );
+    REQUIRE( result == std::vector < double > ( { 25, 975 } ) );
+}
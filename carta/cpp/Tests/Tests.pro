@@ -3,7 +3,8 @@
 }
 
 QT      +=  core
-HEADERS += catch.h
+HEADERS += catch.h \
+    MemoryView.h
 
 SOURCES += \
     TopoSortTest.cpp \
@@ -11,7 +12,19 @@ SOURCES += \
     SliceTester.cpp \
     StateTester.cpp \
     pixelPipelineTest.cpp \
-    LineCombinerTest.cpp
+    LineCombinerTest.cpp \
+    MipmapPyramidTest.cpp \
+    BatchConvertTest.cpp \
+    PipelineLutCacheTest.cpp \
+    IndexImageTest.cpp \
+    CacheManagerTest.cpp \
+    PixelRowCacheTest.cpp \
+    PermutedImageTest.cpp \
+    ImageRegistryTest.cpp \
+    QuantileTest.cpp \
+    PlaneStatisticsTest.cpp \
+    CumulativeDistributionTest.cpp \
+    FineHistogramTest.cpp
 
 #CONFIG += precompile_header
 #PRECOMPILED_HEADER = catch.h
@@ -32,3 +32,54 @@ TEST_CASE( "Cached Pixel Pipeline testing", "[pp]" ) {
     }
 
 }
+
+TEST_CASE( "Fused pipeline matches the chained stages", "[pp]" ) {
+
+    using namespace Lib::PixelPipeline;
+    Core::GrayColormap::SharedPtr grayCmap = std::make_shared<Core::GrayColormap>();
+    std::vector<ScaleType> scales = {
+        ScaleType::Linear, ScaleType::Polynomial, ScaleType::Sqr, ScaleType::Sqrt, ScaleType::Log };
+
+    for( ScaleType scale : scales) {
+        for( double gamma : { 1.0, 0.5, 2.5 }) {
+            for( int flags = 0 ; flags < 4 ; flags ++) {
+                bool reverse = flags & 1;
+                bool invert = flags & 2;
+
+                // reference: the stages chained in a composite
+                auto scaleStage = std::make_shared<ScaleStage>();
+                scaleStage-> setType( scale);
+                scaleStage-> setGamma( gamma);
+                auto reversible = std::make_shared<ReversableStage1>();
+                reversible-> setReversed( reverse);
+                auto invertible = std::make_shared<InvertibleStage4>();
+                invertible-> setInverted( invert);
+                Composite ref;
+                ref.addStage1( scaleStage);
+                ref.addStage1( reversible);
+                ref.setStage3( grayCmap);
+                ref.addStage4( invertible);
+                ref.setMinMax( -2, 3);
+
+                CustomizablePixelPipeline pp;
+                pp.setColormap( grayCmap);
+                pp.setScale( scale);
+                pp.setGamma( gamma);
+                pp.setReverse( reverse);
+                pp.setInvert( invert);
+                pp.setMinMax( -2, 3);
+
+                for( double x = -3 ; x < 4 ; x += 0.01) {
+                    NormRgb c1, c2;
+                    ref.convert( x, c1);
+                    pp.convert( x, c2);
+                    INFO( "x=" << x << " scale=" << int(scale) << " gamma=" << gamma
+                          << " reverse=" << reverse << " invert=" << invert);
+                    REQUIRE( std::abs( c1[0] - c2[0]) < 1e-9);
+                    REQUIRE( std::abs( c1[1] - c2[1]) < 1e-9);
+                    REQUIRE( std::abs( c1[2] - c2[2]) < 1e-9);
+                }
+            }
+        }
+    }
+}
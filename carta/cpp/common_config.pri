@@ -8,6 +8,7 @@ CASACOREDIR=../../ThirdParty/casacore-2.0.1-shared
 ASTLIBDIR = ../../ThirdParty/ast-8.0.2
 WCSLIBDIR=../../ThirdParty/wcslib-4.23-shared
 CFITSIODIR=../../ThirdParty/cfitsio-3360-shared
+HDF5DIR=../../ThirdParty/hdf5-1.8.16-shared
 
 # don't edit these:
 # relative links are replaced by absolute paths
@@ -15,3 +16,4 @@ CASACOREDIR=$$absolute_path($${CASACOREDIR})
 ASTLIBDIR=$$absolute_path($${ASTLIBDIR})
 WCSLIBDIR=$$absolute_path($${WCSLIBDIR})
 CFITSIODIR=$$absolute_path($${CFITSIODIR})
+HDF5DIR=$$absolute_path($${HDF5DIR})
@@ -0,0 +1,363 @@
+/**
+ *
+ **/
+
+#include "CumulativeDistribution.h"
+#include "ParallelForEach.h"
+#include "quantileAlgorithms.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+namespace
+{
+/// range and counts of the values seen by one thread
+struct CountPartial {
+    double min = std::numeric_limits < double >::infinity();
+    double max = - std::numeric_limits < double >::infinity();
+    int64_t finite = 0;
+    int64_t negativeInfinite = 0;
+    int64_t positiveInfinite = 0;
+};
+
+/// range of the values of a bin seen by one thread, and the values themselves
+struct BinPartial {
+    double min = std::numeric_limits < double >::infinity();
+    double max = - std::numeric_limits < double >::infinity();
+    std::vector < double > values;
+};
+}
+
+constexpr int CumulativeDistribution::Bins;
+constexpr int64_t CumulativeDistribution::LeafSize;
+
+template < typename Scalar >
+CumulativeDistribution::SharedPtr
+CumulativeDistribution::computeTyped( NdArray::RawViewInterface * rawView )
+{
+    NdArray::TypedView < Scalar > view( rawView, false );
+    std::vector < CountPartial > counts( parallelSliceCount() );
+    parallelForEach < Scalar, CountPartial > (
+        view, QuantileChunkSize, counts,
+        [] ( const Scalar * data, int64_t count, CountPartial & partial ) {
+            CountPartial local = partial;
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                double v = data[i];
+                if ( std::isfinite( v ) ) {
+                    local.finite++;
+                    local.min = std::min( local.min, v );
+                    local.max = std::max( local.max, v );
+                }
+                else if ( v < 0 ) {
+                    local.negativeInfinite++;
+                }
+                else if ( v > 0 ) {
+                    local.positiveInfinite++;
+                }
+            }
+            partial = local;
+        } );
+    CountPartial total;
+    for ( const CountPartial & partial : counts ) {
+        total.min = std::min( total.min, partial.min );
+        total.max = std::max( total.max, partial.max );
+        total.finite += partial.finite;
+        total.negativeInfinite += partial.negativeInfinite;
+        total.positiveInfinite += partial.positiveInfinite;
+    }
+
+    CumulativeDistribution::SharedPtr distribution = std::make_shared < CumulativeDistribution > ();
+    distribution-> m_negativeInfinite = total.negativeInfinite;
+    distribution-> m_positiveInfinite = total.positiveInfinite;
+    if ( total.finite > 0 ) {
+        distribution-> m_top = build( view, total.min, total.max, total.finite );
+    }
+    else {
+        distribution-> m_top.reset( new Level() );
+    }
+    return distribution;
+} // computeTyped
+
+CumulativeDistribution::SharedPtr
+CumulativeDistribution::compute( NdArray::RawViewInterface * view )
+{
+    if ( view-> pixelType() == Image::PixelType::Real32 ) {
+        return computeTyped < float > ( view );
+    }
+    return computeTyped < double > ( view );
+}
+
+int64_t
+CumulativeDistribution::count() const
+{
+    QMutexLocker locker( & m_mutex );
+    return m_negativeInfinite + m_top-> count + m_positiveInfinite;
+}
+
+double
+CumulativeDistribution::percentile( double value, double maxRankError, ViewFunc makeView )
+{
+    QMutexLocker locker( & m_mutex );
+    const int64_t total = m_negativeInfinite + m_top-> count + m_positiveInfinite;
+    if ( total == 0 || std::isnan( value ) ) {
+        return 0;
+    }
+    if ( value < - std::numeric_limits < double >::max() ) {
+        return double( m_negativeInfinite ) / total;
+    }
+    if ( value > std::numeric_limits < double >::max() ) {
+        return 1;
+    }
+    Lookup lookup { int64_t( maxRankError * total ), makeView, nullptr };
+    return ( m_negativeInfinite + below( * m_top, value, lookup ) ) / total;
+}
+
+double
+CumulativeDistribution::quantile( double q, double maxRankError, ViewFunc makeView )
+{
+    QMutexLocker locker( & m_mutex );
+    const int64_t total = m_negativeInfinite + m_top-> count + m_positiveInfinite;
+    if ( total == 0 ) {
+        return std::numeric_limits < double >::quiet_NaN();
+    }
+
+    // same rank as quantiles2pixels()
+    int64_t rank = Carta::Lib::clamp < int64_t > ( total * q, 0, total - 1 );
+    rank -= m_negativeInfinite;
+    if ( rank < 0 ) {
+        return - std::numeric_limits < double >::infinity();
+    }
+    if ( rank >= m_top-> count ) {
+        return std::numeric_limits < double >::infinity();
+    }
+    Lookup lookup { int64_t( maxRankError * total ), makeView, nullptr };
+    return valueAt( * m_top, rank, lookup );
+}
+
+int64_t
+CumulativeDistribution::bytes() const
+{
+    QMutexLocker locker( & m_mutex );
+    return sizeof( CumulativeDistribution ) + bytes( * m_top );
+}
+
+int
+CumulativeDistribution::binOf( const Level & level, double value )
+{
+    return std::min < int > ( ( value - level.lo ) * level.scale, Bins - 1 );
+}
+
+CumulativeDistribution::Level *
+CumulativeDistribution::refine( Level & level, int bin, Lookup & lookup )
+{
+    auto iter = level.refined.find( bin );
+    if ( iter != level.refined.end() ) {
+        return iter-> second.get();
+    }
+    int64_t binCount = level.cumulative[bin + 1] - level.cumulative[bin];
+    if ( binCount <= lookup.maxBinCount || ! lookup.makeView ) {
+        return nullptr;
+    }
+
+    // the view is made once per lookup, a lookup may refine several levels
+    if ( ! lookup.view ) {
+        lookup.view.reset( lookup.makeView() );
+        if ( ! lookup.view ) {
+            return nullptr;
+        }
+    }
+    std::unique_ptr < Level > binLevel;
+    if ( lookup.view-> pixelType() == Image::PixelType::Real32 ) {
+        NdArray::TypedView < float > view( lookup.view.get(), false );
+        binLevel = buildBin( view, level, bin );
+    }
+    else {
+        NdArray::TypedView < double > view( lookup.view.get(), false );
+        binLevel = buildBin( view, level, bin );
+    }
+    Level * result = binLevel.get();
+    level.refined[bin] = std::move( binLevel );
+    return result;
+} // refine
+
+double
+CumulativeDistribution::below( Level & level, double value, Lookup & lookup )
+{
+    if ( level.count == 0 || value < level.lo ) {
+        return 0;
+    }
+    if ( value >= level.hi ) {
+        return level.count;
+    }
+    if ( ! level.values.empty() ) {
+        return std::upper_bound( level.values.begin(), level.values.end(), value )
+               - level.values.begin();
+    }
+    int bin = binOf( level, value );
+    Level * binLevel = refine( level, bin, lookup );
+    if ( binLevel ) {
+        return level.cumulative[bin] + below( * binLevel, value, lookup );
+    }
+
+    // interpolate within the bin
+    double fraction = Carta::Lib::clamp( ( value - level.lo ) * level.scale - bin, 0.0, 1.0 );
+    return level.cumulative[bin] + fraction * ( level.cumulative[bin + 1] - level.cumulative[bin] );
+}
+
+double
+CumulativeDistribution::valueAt( Level & level, int64_t rank, Lookup & lookup )
+{
+    if ( ! level.values.empty() ) {
+        return level.values[rank];
+    }
+
+    // the range is exact, so is a level with a single value
+    if ( rank == 0 || level.cumulative.empty() ) {
+        return level.lo;
+    }
+    if ( rank == level.count - 1 ) {
+        return level.hi;
+    }
+    int bin = std::upper_bound( level.cumulative.begin(), level.cumulative.end(), rank )
+              - level.cumulative.begin() - 1;
+    Level * binLevel = refine( level, bin, lookup );
+    if ( binLevel ) {
+        return valueAt( * binLevel, rank - level.cumulative[bin], lookup );
+    }
+
+    // interpolate within the bin
+    int64_t binCount = level.cumulative[bin + 1] - level.cumulative[bin];
+    double fraction = ( rank - level.cumulative[bin] + 0.5 ) / binCount;
+    return Carta::Lib::clamp( level.lo + ( bin + fraction ) / level.scale, level.lo, level.hi );
+}
+
+template < typename Scalar >
+std::unique_ptr < CumulativeDistribution::Level >
+CumulativeDistribution::build( NdArray::TypedView < Scalar > & view, double lo, double hi,
+                               int64_t count )
+{
+    std::unique_ptr < Level > level( new Level() );
+    level-> lo = lo;
+    level-> hi = hi;
+    level-> count = count;
+    if ( lo == hi ) {
+        return level;
+    }
+    const int nSlices = parallelSliceCount();
+
+    // few values (or a range too narrow to split) are kept as they are
+    if ( count <= LeafSize || ! canSplitRange < Scalar > ( lo, hi, Bins ) ) {
+        std::vector < std::vector < double > > gathered( nSlices );
+        parallelForEach < Scalar, std::vector < double > > (
+            view, QuantileChunkSize, gathered,
+            [lo, hi] ( const Scalar * data, int64_t n, std::vector < double > & values ) {
+                for ( int64_t i = 0 ; i < n ; ++i ) {
+                    if ( data[i] >= lo && data[i] <= hi ) {
+                        values.push_back( data[i] );
+                    }
+                }
+            } );
+        level-> values.reserve( count );
+        for ( auto & values : gathered ) {
+            level-> values.insert( level-> values.end(), values.begin(), values.end() );
+        }
+        CARTA_ASSERT( int64_t( level-> values.size() ) == count );
+        std::sort( level-> values.begin(), level-> values.end() );
+        return level;
+    }
+
+    level-> scale = Bins / ( hi - lo );
+    const Level & bins = * level;
+    std::vector < std::vector < int64_t > > histograms( nSlices );
+    parallelForEach < Scalar, std::vector < int64_t > > (
+        view, QuantileChunkSize, histograms,
+        [lo, hi, &bins] ( const Scalar * data, int64_t n, std::vector < int64_t > & hist ) {
+            if ( hist.empty() ) {
+                hist.resize( Bins, 0 );
+            }
+            for ( int64_t i = 0 ; i < n ; ++i ) {
+                if ( data[i] >= lo && data[i] <= hi ) {
+                    hist[binOf( bins, data[i] )]++;
+                }
+            }
+        } );
+    level-> cumulative.assign( Bins + 1, 0 );
+    for ( int b = 0 ; b < Bins ; ++b ) {
+        int64_t binCount = 0;
+        for ( const auto & hist : histograms ) {
+            binCount += hist.empty() ? 0 : hist[b];
+        }
+        level-> cumulative[b + 1] = level-> cumulative[b] + binCount;
+    }
+    CARTA_ASSERT( level-> cumulative[Bins] == count );
+    return level;
+} // build
+
+template < typename Scalar >
+std::unique_ptr < CumulativeDistribution::Level >
+CumulativeDistribution::buildBin( NdArray::TypedView < Scalar > & view, const Level & level,
+                                  int bin )
+{
+    // find the range of the values in the bin, and gather them if there are few
+    const int64_t count = level.cumulative[bin + 1] - level.cumulative[bin];
+    const bool gather = count <= LeafSize;
+    std::vector < BinPartial > partials( parallelSliceCount() );
+    parallelForEach < Scalar, BinPartial > (
+        view, QuantileChunkSize, partials,
+        [&level, bin, gather] ( const Scalar * data, int64_t n, BinPartial & partial ) {
+            for ( int64_t i = 0 ; i < n ; ++i ) {
+                double v = data[i];
+                if ( v >= level.lo && v <= level.hi && binOf( level, v ) == bin ) {
+                    partial.min = std::min( partial.min, v );
+                    partial.max = std::max( partial.max, v );
+                    if ( gather ) {
+                        partial.values.push_back( v );
+                    }
+                }
+            }
+        } );
+    double lo = std::numeric_limits < double >::infinity();
+    double hi = - std::numeric_limits < double >::infinity();
+    for ( const BinPartial & partial : partials ) {
+        lo = std::min( lo, partial.min );
+        hi = std::max( hi, partial.max );
+    }
+    if ( ! gather ) {
+        return build( view, lo, hi, count );
+    }
+
+    std::unique_ptr < Level > binLevel( new Level() );
+    binLevel-> lo = lo;
+    binLevel-> hi = hi;
+    binLevel-> count = count;
+    binLevel-> values.reserve( count );
+    for ( BinPartial & partial : partials ) {
+        binLevel-> values.insert( binLevel-> values.end(), partial.values.begin(),
+                                  partial.values.end() );
+    }
+    CARTA_ASSERT( int64_t( binLevel-> values.size() ) == count );
+    std::sort( binLevel-> values.begin(), binLevel-> values.end() );
+    return binLevel;
+} // buildBin
+
+int64_t
+CumulativeDistribution::bytes( const Level & level )
+{
+    int64_t result = sizeof( Level )
+                     + level.values.size() * sizeof( double )
+                     + level.cumulative.size() * sizeof( int64_t );
+    for ( const auto & binLevel : level.refined ) {
+        result += bytes( * binLevel.second );
+    }
+    return result;
+}
+}
+}
+}
@@ -0,0 +1,145 @@
+/**
+ * Cumulative distribution of the values of a view, for repeated percentile lookups.
+ *
+ * Computing the percentile of a value, or the value at a percentile, used to read all the
+ * data every time, which is too slow for the histogram while the clip handles are
+ * dragged over a range of many channels. The distribution is built once (two passes
+ * over the view), and answers both questions with a binary search in a cumulative
+ * histogram of Bins bins, interpolating within the bin.
+ *
+ * The answers can be refined: when the bin that holds the answer has too many values,
+ * the view is read again, and the values of that bin get their own level, i.e. another
+ * cumulative histogram over the range of that bin, or, once there are at most LeafSize
+ * of them, the sorted values themselves. Refined bins are kept, so later lookups in the
+ * same bin don't read the view again. With maxRankError = 0 the answers are exact, i.e.
+ * the same as quantiles2pixels() and pixel2quantile().
+ *
+ * Like quantiles2pixels(), NaNs are ignored and infinities are counted.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include <QMutex>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+class CumulativeDistribution
+{
+    CLASS_BOILERPLATE( CumulativeDistribution );
+
+public:
+
+    /// function used to make a view of the same data when a bin is refined
+    typedef std::function < NdArray::RawViewInterface * () > ViewFunc;
+
+    /// number of bins of each histogram level
+    static constexpr int Bins = 65536;
+
+    /// levels with at most this many values keep the sorted values instead of a histogram
+    static constexpr int64_t LeafSize = 65536;
+
+    /// build the distribution of a view, reading it in parallel
+    static CumulativeDistribution::SharedPtr
+    compute( NdArray::RawViewInterface * view );
+
+    /// number of values that are not nan
+    int64_t
+    count() const;
+
+    /// fraction of the values that are <= value, same as pixel2quantile()
+    /// \param maxRankError if the bin holding value has more than this fraction of the
+    ///        values, it is refined, using makeView to read the data
+    /// \param makeView used to read the data, if null, nothing is refined
+    double
+    percentile( double value, double maxRankError = 1, ViewFunc makeView = nullptr );
+
+    /// value at a quantile, same as quantiles2pixels() if refined down to the values
+    /// \param maxRankError if the bin holding the quantile has more than this fraction
+    ///        of the values, it is refined, using makeView to read the data
+    /// \param makeView used to read the data, if null, nothing is refined
+    /// \return the value, nan if there are no values
+    double
+    quantile( double q, double maxRankError = 1, ViewFunc makeView = nullptr );
+
+    /// approximate number of bytes used, including the refined bins
+    int64_t
+    bytes() const;
+
+private:
+
+    /// the finite values within [lo, hi]
+    struct Level {
+        double lo = 0, hi = 0;
+        int64_t count = 0;
+
+        /// bins per unit of value, for a histogram
+        double scale = 0;
+
+        /// the sorted values, for a leaf
+        std::vector < double > values;
+
+        /// cumulative histogram (Bins + 1 entries), empty for a leaf or a constant
+        std::vector < int64_t > cumulative;
+
+        /// levels of the refined bins
+        std::map < int, std::unique_ptr < Level > > refined;
+    };
+
+    /// state of a lookup that may refine bins
+    struct Lookup {
+        int64_t maxBinCount;
+        ViewFunc makeView;
+        std::unique_ptr < NdArray::RawViewInterface > view;
+    };
+
+    /// bin of a value in a histogram level
+    static int
+    binOf( const Level & level, double value );
+
+    /// the refined level of a bin, refining it if needed, nullptr if it's not refined
+    Level *
+    refine( Level & level, int bin, Lookup & lookup );
+
+    /// number of values of the level that are <= value
+    double
+    below( Level & level, double value, Lookup & lookup );
+
+    /// value at a rank within the level
+    double
+    valueAt( Level & level, int64_t rank, Lookup & lookup );
+
+    template < typename Scalar >
+    static CumulativeDistribution::SharedPtr
+    computeTyped( NdArray::RawViewInterface * view );
+
+    /// build a level from the count finite values in [lo, hi] of the view
+    template < typename Scalar >
+    static std::unique_ptr < Level >
+    build( NdArray::TypedView < Scalar > & view, double lo, double hi, int64_t count );
+
+    /// build the level of a bin of a histogram level
+    template < typename Scalar >
+    static std::unique_ptr < Level >
+    buildBin( NdArray::TypedView < Scalar > & view, const Level & level, int bin );
+
+    static int64_t
+    bytes( const Level & level );
+
+    mutable QMutex m_mutex;
+    int64_t m_negativeInfinite = 0;
+    int64_t m_positiveInfinite = 0;
+    std::unique_ptr < Level > m_top;
+};
+}
+}
+}
@@ -0,0 +1,223 @@
+/**
+ *
+ **/
+
+#include "FineHistogram.h"
+#include "ParallelForEach.h"
+#include "quantileAlgorithms.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+namespace
+{
+/// range of the values seen by one thread
+struct RangePartial {
+    double min = std::numeric_limits < double >::infinity();
+    double max = - std::numeric_limits < double >::infinity();
+};
+
+/// fine bins of the values seen by one thread
+struct BinPartial {
+    std::vector < int64_t > bins;
+};
+}
+
+constexpr int FineHistogram::Bins;
+constexpr int FineHistogram::MinFineBins;
+
+template < typename Scalar >
+FineHistogram::SharedPtr
+FineHistogram::computeTyped( NdArray::RawViewInterface * rawView, double lo, double hi )
+{
+    NdArray::TypedView < Scalar > view( rawView, false );
+    FineHistogram::SharedPtr histogram = std::make_shared < FineHistogram > ();
+    histogram-> m_includeLo = lo;
+    histogram-> m_includeHi = hi;
+    histogram-> m_min = std::numeric_limits < double >::quiet_NaN();
+    histogram-> m_max = std::numeric_limits < double >::quiet_NaN();
+    histogram-> m_bins.assign( Bins, 0 );
+    histogram-> m_cumulative.assign( Bins + 1, 0 );
+    if ( ! ( lo <= hi ) ) {
+        return histogram;
+    }
+
+    // the fine bins span the values within the range, not the range itself, so that
+    // they are as fine as possible when the values only fill a part of the range
+    std::vector < RangePartial > ranges( parallelSliceCount() );
+    parallelForEach < Scalar, RangePartial > (
+        view, QuantileChunkSize, ranges,
+        [lo, hi] ( const Scalar * data, int64_t count, RangePartial & partial ) {
+            RangePartial local = partial;
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                double v = data[i];
+                if ( std::isfinite( v ) && v >= lo && v <= hi ) {
+                    local.min = std::min( local.min, v );
+                    local.max = std::max( local.max, v );
+                }
+            }
+            partial = local;
+        } );
+    double min = std::numeric_limits < double >::infinity();
+    double max = - std::numeric_limits < double >::infinity();
+    for ( const RangePartial & partial : ranges ) {
+        min = std::min( min, partial.min );
+        max = std::max( max, partial.max );
+    }
+    if ( min > max ) {
+        return histogram;
+    }
+
+    // both bounds are finite, so the test also drops nans and infinities, a range too
+    // narrow to split is a single bin
+    const double scale = canSplitRange < Scalar > ( min, max, Bins ) ? Bins / ( max - min ) : 0;
+    std::vector < BinPartial > partials( parallelSliceCount() );
+    parallelForEach < Scalar, BinPartial > (
+        view, QuantileChunkSize, partials,
+        [min, max, scale] ( const Scalar * data, int64_t count, BinPartial & partial ) {
+            if ( partial.bins.empty() ) {
+                partial.bins.assign( Bins, 0 );
+            }
+            int64_t * bins = partial.bins.data();
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                double v = data[i];
+                if ( v >= min && v <= max ) {
+                    bins[std::min < int > ( ( v - min ) * scale, Bins - 1 )]++;
+                }
+            }
+        } );
+
+    for ( const BinPartial & partial : partials ) {
+        if ( partial.bins.empty() ) {
+            continue;
+        }
+        for ( int bin = 0 ; bin < Bins ; ++bin ) {
+            histogram-> m_bins[bin] += partial.bins[bin];
+        }
+    }
+    for ( int bin = 0 ; bin < Bins ; ++bin ) {
+        histogram-> m_cumulative[bin + 1] = histogram-> m_cumulative[bin] + histogram-> m_bins[bin];
+    }
+    histogram-> m_count = histogram-> m_cumulative.back();
+    histogram-> m_min = min;
+    histogram-> m_max = max;
+    return histogram;
+} // computeTyped
+
+FineHistogram::SharedPtr
+FineHistogram::compute( NdArray::RawViewInterface * view, double lo, double hi )
+{
+    if ( view-> pixelType() == Image::PixelType::Real32 ) {
+        return computeTyped < float > ( view, lo, hi );
+    }
+    return computeTyped < double > ( view, lo, hi );
+}
+
+int64_t
+FineHistogram::count() const
+{
+    return m_count;
+}
+
+double
+FineHistogram::min() const
+{
+    return m_min;
+}
+
+double
+FineHistogram::max() const
+{
+    return m_max;
+}
+
+const std::vector < int64_t > &
+FineHistogram::bins() const
+{
+    return m_bins;
+}
+
+bool
+FineHistogram::covers( int binCount, double lo, double hi ) const
+{
+    if ( lo < m_includeLo || hi > m_includeHi ) {
+        return false;
+    }
+
+    // counting the same range again would not make the bins any finer
+    if ( lo == m_includeLo && hi == m_includeHi ) {
+        return true;
+    }
+    if ( m_count == 0 || m_max <= m_min ) {
+        return true;
+    }
+    std::pair < double, double > range = rebinRange( lo, hi );
+    if ( range.first >= range.second ) {
+        return true;
+    }
+    double fineBins = ( range.second - range.first ) * Bins / ( m_max - m_min );
+    return fineBins >= double( binCount ) * MinFineBins;
+}
+
+std::pair < double, double >
+FineHistogram::rebinRange( double lo, double hi ) const
+{
+    return std::make_pair( std::isfinite( lo ) ? lo : m_min, std::isfinite( hi ) ? hi : m_max );
+}
+
+double
+FineHistogram::below( double value ) const
+{
+    if ( value <= m_min ) {
+        return 0;
+    }
+    if ( value >= m_max ) {
+        return m_count;
+    }
+    double pos = ( value - m_min ) * Bins / ( m_max - m_min );
+    int bin = Carta::Lib::clamp < int > ( pos, 0, Bins - 1 );
+    return m_cumulative[bin] + ( pos - bin ) * m_bins[bin];
+}
+
+std::vector < std::pair < double, double > >
+FineHistogram::rebin( int binCount, double lo, double hi ) const
+{
+    std::vector < std::pair < double, double > > result;
+    if ( binCount <= 0 || m_count == 0 ) {
+        return result;
+    }
+    std::pair < double, double > range = rebinRange( lo, hi );
+    double rangeLo = range.first;
+    double rangeHi = range.second;
+    if ( ! ( rangeLo <= rangeHi ) ) {
+        return result;
+    }
+    if ( rangeLo == rangeHi ) {
+        // a single value can only be binned if it's the only one
+        if ( m_min == m_max && m_min == rangeLo ) {
+            result.push_back( std::make_pair( m_min, double( m_count ) ) );
+        }
+        return result;
+    }
+
+    // rounding the cumulative counts at the edges keeps the counts whole, and their
+    // sum equal to the number of values in the range
+    const double width = ( rangeHi - rangeLo ) / binCount;
+    result.reserve( binCount );
+    double previous = std::round( below( rangeLo ) );
+    for ( int bin = 0 ; bin < binCount ; ++bin ) {
+        double edge = bin + 1 < binCount ? rangeLo + ( bin + 1 ) * width : rangeHi;
+        double next = edge >= m_max ? m_count : std::round( below( edge ) );
+        result.push_back( std::make_pair( rangeLo + ( bin + 0.5 ) * width, next - previous ) );
+        previous = next;
+    }
+    return result;
+} // rebin
+}
+}
+}
@@ -0,0 +1,111 @@
+/**
+ * Fine-grained histogram of a view, from which coarser histograms are derived.
+ *
+ * The histogram plugin used to ask casa::LatticeHistograms for a new histogram every time
+ * the bin count or the intensity range changed, reading all the pixels of the channel
+ * range again. The fine histogram counts the finite values of a view once, in Bins bins,
+ * reading the view in parallel with one partial histogram per thread. Histograms with
+ * fewer bins, over any range within the one that was counted, are then computed from the
+ * cumulative counts by rebin(), without reading the view.
+ *
+ * Rebinned counts are interpolated within the fine bins that straddle the edges of the
+ * coarse bins, so covers() only accepts coarse bins that span at least MinFineBins fine
+ * bins. Otherwise, the histogram should be computed again over the narrower range. The
+ * fine bins span the values within that range, so they are finer than the coarse bins
+ * even when the values only fill a small part of the range.
+ *
+ * NaNs and infinities are not counted.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+class FineHistogram
+{
+    CLASS_BOILERPLATE( FineHistogram );
+
+public:
+
+    /// number of fine bins
+    static constexpr int Bins = 65536;
+
+    /// minimum number of fine bins per coarse bin, see covers()
+    static constexpr int MinFineBins = 16;
+
+    /// count the finite values of a view within [lo, hi], reading it in parallel
+    /// \note the view is read twice, to find the range of the values first
+    static FineHistogram::SharedPtr
+    compute( NdArray::RawViewInterface * view,
+             double lo = - std::numeric_limits < double >::infinity(),
+             double hi = std::numeric_limits < double >::infinity() );
+
+    /// number of values counted
+    int64_t
+    count() const;
+
+    /// smallest value counted, nan if there are none
+    double
+    min() const;
+
+    /// largest value counted, nan if there are none
+    double
+    max() const;
+
+    /// the fine bin counts
+    const std::vector < int64_t > &
+    bins() const;
+
+    /// can rebin() compute a histogram of binCount bins over [lo, hi] accurately,
+    /// i.e. were all the values in [lo, hi] counted, and do the coarse bins span enough
+    /// fine bins (or was the histogram counted for exactly [lo, hi])
+    bool
+    covers( int binCount, double lo, double hi ) const;
+
+    /// histogram of binCount bins over [lo, hi], an infinite bound is replaced by
+    /// min() or max()
+    /// \return (bin center, count) pairs, empty if there are no values
+    std::vector < std::pair < double, double > >
+    rebin( int binCount,
+           double lo = - std::numeric_limits < double >::infinity(),
+           double hi = std::numeric_limits < double >::infinity() ) const;
+
+private:
+
+    template < typename Scalar >
+    static FineHistogram::SharedPtr
+    computeTyped( NdArray::RawViewInterface * view, double lo, double hi );
+
+    /// the range rebin() uses for [lo, hi]
+    std::pair < double, double >
+    rebinRange( double lo, double hi ) const;
+
+    /// number of values counted that are below value, interpolated within the fine bin
+    double
+    below( double value ) const;
+
+    /// the range that was asked for
+    double m_includeLo = 0, m_includeHi = 0;
+
+    /// the range of the values counted, which is also the range of the fine bins
+    double m_min = 0, m_max = 0;
+    int64_t m_count = 0;
+
+    /// cumulative counts of the fine bins (Bins + 1 entries)
+    std::vector < int64_t > m_cumulative;
+
+    std::vector < int64_t > m_bins;
+};
+}
+}
+}
@@ -0,0 +1,115 @@
+/**
+ *
+ **/
+
+#include "IndexImage.h"
+#include <cmath>
+#include <limits>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+constexpr uint16_t IndexImage::NanIndex;
+constexpr uint16_t IndexImage::MaxIndex;
+constexpr int IndexImage::ColorTableSize;
+
+IndexImage::IndexImage( int width, int height, double clipMin, double clipMax )
+{
+    m_width = width;
+    m_height = height;
+    m_clipMin = clipMin;
+    m_clipMax = clipMax;
+    m_data.resize( int64_t( width ) * height, NanIndex );
+}
+
+int
+IndexImage::width() const
+{
+    return m_width;
+}
+
+int
+IndexImage::height() const
+{
+    return m_height;
+}
+
+double
+IndexImage::clipMin() const
+{
+    return m_clipMin;
+}
+
+double
+IndexImage::clipMax() const
+{
+    return m_clipMax;
+}
+
+int64_t
+IndexImage::byteSize() const
+{
+    return m_data.size() * sizeof( uint16_t );
+}
+
+double
+IndexImage::value( uint16_t index ) const
+{
+    if ( index == NanIndex ) {
+        return std::numeric_limits < double >::quiet_NaN();
+    }
+    return m_clipMin + ( m_clipMax - m_clipMin ) * index / MaxIndex;
+}
+
+void
+IndexImage::quantizeRows( const float * data, int y1, int y2 )
+{
+    quantize( data, y1, y2 );
+}
+
+void
+IndexImage::quantizeRows( const double * data, int y1, int y2 )
+{
+    quantize( data, y1, y2 );
+}
+
+template < typename Scalar >
+void
+IndexImage::quantize( const Scalar * data, int y1, int y2 )
+{
+    CARTA_ASSERT( y1 >= 0 && y2 <= m_height );
+    double scale = m_clipMax > m_clipMin ? MaxIndex / ( m_clipMax - m_clipMin ) : 0.0;
+    int64_t start = int64_t( y1 ) * m_width;
+    int64_t end = int64_t( y2 ) * m_width;
+    for ( int64_t i = start ; i < end ; ++i ) {
+        double val = data[i];
+        if ( Q_UNLIKELY( std::isnan( val ) ) ) {
+            m_data[i] = NanIndex;
+            continue;
+        }
+        val = Carta::Lib::clamp( val, m_clipMin, m_clipMax );
+        m_data[i] = uint16_t( ( val - m_clipMin ) * scale + 0.5 );
+    }
+}
+
+void
+IndexImage::colorize( const std::vector < QRgb > & colorTable, int y1, int y2,
+                      uchar * bits ) const
+{
+    CARTA_ASSERT( int( colorTable.size() ) == ColorTableSize );
+    const QRgb * table = colorTable.data();
+    for ( int y = y1 ; y < y2 ; ++y ) {
+        const uint16_t * inPtr = m_data.data() + int64_t( y ) * m_width;
+        QRgb * outPtr = reinterpret_cast < QRgb * > (
+            bits + int64_t( m_height - 1 - y ) * m_width * 4 );
+        for ( int x = 0 ; x < m_width ; ++x ) {
+            outPtr[x] = table[inPtr[x]];
+        }
+    }
+}
+}
+}
+}
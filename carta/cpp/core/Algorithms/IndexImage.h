@@ -0,0 +1,120 @@
+/**
+ * Colormap independent representation of a frame.
+ *
+ * Every pixel of the frame is clamped to the clip range and quantized into a 16 bit
+ * index, with one index reserved for NaNs. Since the colormap, invert, reverse, scale
+ * and color mix only change how the clip range maps to colors, a frame can be
+ * re-colored from its index image with a single table lookup per pixel, without
+ * touching the raw data.
+ *
+ * The quantization step is 1/65534 of the clip range, which is much finer than
+ * the lookup tables of the cached pixel pipelines.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include <QRgb>
+#include <QtGlobal>
+#include <cstdint>
+#include <vector>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+class IndexImage
+{
+    CLASS_BOILERPLATE( IndexImage );
+
+public:
+
+    /// index used for NaNs
+    static constexpr uint16_t NanIndex = 65535;
+
+    /// index of the clip maximum
+    static constexpr uint16_t MaxIndex = 65534;
+
+    /// number of entries a color table must have
+    static constexpr int ColorTableSize = 65536;
+
+    /// \param width width of the frame
+    /// \param height height of the frame
+    /// \param clipMin value corresponding to index 0
+    /// \param clipMax value corresponding to MaxIndex
+    IndexImage( int width, int height, double clipMin, double clipMax );
+
+    int
+    width() const;
+
+    int
+    height() const;
+
+    double
+    clipMin() const;
+
+    double
+    clipMax() const;
+
+    /// how much memory does the index image occupy (in bytes)
+    int64_t
+    byteSize() const;
+
+    /// value represented by the given index (NaN for NanIndex)
+    double
+    value( uint16_t index ) const;
+
+    /// quantize a range of rows of raw data
+    /// \param data raw data of the whole frame in row-major order, first row is the bottom one
+    /// \param y1 first row to quantize
+    /// \param y2 one past the last row to quantize
+    /// \note different ranges of rows can be quantized from different threads
+    void
+    quantizeRows( const float * data, int y1, int y2 );
+
+    /// double version of quantizeRows()
+    void
+    quantizeRows( const double * data, int y1, int y2 );
+
+    /// convert a range of rows to colors
+    /// \param colorTable color for every index, see colorTable()
+    /// \param y1 first row to convert
+    /// \param y2 one past the last row to convert
+    /// \param bits pixels of a width() x height() ARGB32 image, which is built bottom-up
+    void
+    colorize( const std::vector < QRgb > & colorTable, int y1, int y2, uchar * bits ) const;
+
+    /// build the color table for the given pipeline
+    /// \param pipe pipeline to use, anything with convertqBatch()
+    /// \param nanColor color for NaNs
+    /// \return color for every index
+    template < class Pipeline >
+    std::vector < QRgb >
+    colorTable( Pipeline & pipe, QRgb nanColor ) const
+    {
+        std::vector < double > values( ColorTableSize );
+        for ( int i = 0 ; i < ColorTableSize ; ++i ) {
+            values[i] = value( i );
+        }
+        std::vector < QRgb > table( ColorTableSize );
+        pipe.convertqBatch( values.data(), table.data(), ColorTableSize, nanColor );
+        return table;
+    }
+
+private:
+
+    template < typename Scalar >
+    void
+    quantize( const Scalar * data, int y1, int y2 );
+
+    int m_width, m_height;
+    double m_clipMin, m_clipMax;
+
+    /// indices in row-major order, first row is the bottom one
+    std::vector < uint16_t > m_data;
+};
+}
+}
+}
@@ -0,0 +1,213 @@
+/**
+ *
+ **/
+
+#include "MipmapPyramid.h"
+#include <cmath>
+#include <limits>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+namespace
+{
+/// accumulates one row of output pixels, where each output pixel collects the values
+/// of a block of input pixels
+class RowAccumulator
+{
+public:
+
+    RowAccumulator( int width, MipmapPyramid::Reduction reduction )
+        : m_reduction( reduction )
+          , m_acc( width, 0.0 )
+          , m_count( width, 0 )
+    { }
+
+    /// add a value to the output pixel x
+    void
+    add( int x, double val )
+    {
+        if ( std::isnan( val ) ) {
+            return;
+        }
+        if ( m_reduction == MipmapPyramid::Reduction::Mean ) {
+            m_acc[x] += val;
+        }
+        else if ( m_count[x] == 0 || val > m_acc[x] ) {
+            m_acc[x] = val;
+        }
+        m_count[x]++;
+    }
+
+    /// write out the accumulated row and reset the accumulators
+    void
+    flush( float * out )
+    {
+        for ( size_t x = 0 ; x < m_acc.size() ; ++x ) {
+            if ( m_count[x] == 0 ) {
+                out[x] = std::numeric_limits < float >::quiet_NaN();
+            }
+            else if ( m_reduction == MipmapPyramid::Reduction::Mean ) {
+                out[x] = m_acc[x] / m_count[x];
+            }
+            else {
+                out[x] = m_acc[x];
+            }
+            m_acc[x] = 0.0;
+            m_count[x] = 0;
+        }
+    }
+
+private:
+
+    MipmapPyramid::Reduction m_reduction;
+    std::vector < double > m_acc;
+    std::vector < int64_t > m_count;
+};
+}
+
+MipmapPyramid::MipmapPyramid( int width, int height, Reduction reduction )
+{
+    m_width = width;
+    m_height = height;
+    m_reduction = reduction;
+}
+
+int
+MipmapPyramid::width() const
+{
+    return m_width;
+}
+
+int
+MipmapPyramid::height() const
+{
+    return m_height;
+}
+
+MipmapPyramid::Reduction
+MipmapPyramid::reduction() const
+{
+    return m_reduction;
+}
+
+int
+MipmapPyramid::maxLevel() const
+{
+    int n = 0;
+    int64_t size = std::max( m_width, m_height );
+    while ( size > 1 ) {
+        size = ( size + 1 ) / 2;
+        n++;
+    }
+    return n;
+}
+
+int
+MipmapPyramid::levelForZoom( double zoom ) const
+{
+    if ( ! ( zoom > 0 ) || zoom >= 1 ) {
+        return 0;
+    }
+    int n = std::floor( std::log2( 1.0 / zoom ) );
+    return Carta::Lib::clamp( n, 0, maxLevel() );
+}
+
+bool
+MipmapPyramid::hasLevel( int n ) const
+{
+    return m_levels.find( n ) != m_levels.end();
+}
+
+const MipmapPyramid::Level &
+MipmapPyramid::level( int n, NdArray::RawViewInterface * view )
+{
+    CARTA_ASSERT( n >= 1 && n <= maxLevel() );
+
+    auto iter = m_levels.find( n );
+    if ( iter != m_levels.end() ) {
+        return iter-> second;
+    }
+
+    // find the closest finer level we already have
+    int src = n - 1;
+    while ( src > 0 && ! hasLevel( src ) ) {
+        src--;
+    }
+    if ( src > 0 ) {
+        m_levels[n] = reduce( m_levels[src], 1 << ( n - src ), m_reduction );
+    }
+    else {
+        CARTA_ASSERT( view && view-> dims().size() >= 2 );
+        CARTA_ASSERT( view-> dims()[0] == m_width && view-> dims()[1] == m_height );
+        m_levels[n] = reduceView( view, 1 << n );
+    }
+    return m_levels[n];
+} // level
+
+int64_t
+MipmapPyramid::byteSize() const
+{
+    int64_t result = 0;
+    for ( auto & entry : m_levels ) {
+        result += entry.second.data.size() * sizeof( float );
+    }
+    return result;
+}
+
+MipmapPyramid::Level
+MipmapPyramid::reduce( const Level & src, int factor, Reduction reduction )
+{
+    Level dst;
+    dst.width = ( src.width + factor - 1 ) / factor;
+    dst.height = ( src.height + factor - 1 ) / factor;
+    dst.data.resize( int64_t( dst.width ) * dst.height );
+
+    RowAccumulator acc( dst.width, reduction );
+    for ( int y = 0 ; y < src.height ; ++y ) {
+        const float * row = src.data.data() + int64_t( y ) * src.width;
+        for ( int x = 0 ; x < src.width ; ++x ) {
+            acc.add( x / factor, row[x] );
+        }
+        if ( ( y + 1 ) % factor == 0 || y + 1 == src.height ) {
+            acc.flush( dst.data.data() + int64_t( y / factor ) * dst.width );
+        }
+    }
+    return dst;
+} // reduce
+
+MipmapPyramid::Level
+MipmapPyramid::reduceView( NdArray::RawViewInterface * view, int factor )
+{
+    Level dst;
+    dst.width = ( m_width + factor - 1 ) / factor;
+    dst.height = ( m_height + factor - 1 ) / factor;
+    dst.data.resize( int64_t( dst.width ) * dst.height );
+
+    // stream through the view, only keeping one row of accumulators in memory
+    RowAccumulator acc( dst.width, m_reduction );
+    int x = 0, y = 0;
+    NdArray::TypedView < double > typedView( view, false );
+    typedView.forEach(
+        int64_t( m_width ) * factor,
+        [&] ( const double * data, int64_t count ) {
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                acc.add( x / factor, data[i] );
+                if ( ++x == m_width ) {
+                    x = 0;
+                    ++y;
+                    if ( y % factor == 0 || y == m_height ) {
+                        acc.flush( dst.data.data() + int64_t( ( y - 1 ) / factor ) * dst.width );
+                    }
+                }
+            }
+        }
+        );
+    return dst;
+} // reduceView
+}
+}
+}
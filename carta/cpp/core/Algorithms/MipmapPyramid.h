@@ -0,0 +1,118 @@
+/**
+ * Multiresolution (mipmap) pyramid of a 2D plane.
+ *
+ * Level n of the pyramid is the plane downsampled by a factor of 2^n in both directions,
+ * i.e. every pixel of level n represents a 2^n x 2^n block of the original data (the
+ * blocks at the right/top edges can be smaller). Level 0 is the original data, which
+ * is never stored in the pyramid.
+ *
+ * Levels are computed lazily, when they are first requested, either from the closest
+ * finer level that is already available, or from the raw view if there isn't one.
+ * Note that a mean computed from a finer level is the mean of the block means, which
+ * is only an approximation near NaNs and at the edges.
+ *
+ * Computed levels are kept until the pyramid is destroyed, so zooming back in does not
+ * read the view again. All the levels together are at most a third of the size of the
+ * plane (in floats).
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include <map>
+#include <vector>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+class MipmapPyramid
+{
+    CLASS_BOILERPLATE( MipmapPyramid );
+
+public:
+
+    /// how a block of pixels is reduced into a single pixel
+    /// in both cases NaNs are ignored, and only blocks that are all NaNs produce a NaN
+    enum class Reduction {
+        Mean,
+        Max
+    };
+
+    /// single level of the pyramid
+    struct Level {
+        int width = 0;
+        int height = 0;
+
+        /// values in row-major order, first row is the bottom one
+        std::vector < float > data;
+    };
+
+    /// \param width width of the plane
+    /// \param height height of the plane
+    /// \param reduction how to reduce blocks of pixels
+    MipmapPyramid( int width, int height, Reduction reduction = Reduction::Mean );
+
+    /// width of the plane (level 0)
+    int
+    width() const;
+
+    /// height of the plane (level 0)
+    int
+    height() const;
+
+    /// reduction used by this pyramid
+    Reduction
+    reduction() const;
+
+    /// the coarsest level that makes sense, i.e. the one with a single pixel
+    int
+    maxLevel() const;
+
+    /// find the coarsest level that still has at least one pixel per screen pixel
+    /// \param zoom how many screen pixels does a data pixel occupy
+    /// \return level, 0 means the original data should be used
+    int
+    levelForZoom( double zoom ) const;
+
+    /// is the given level already computed?
+    bool
+    hasLevel( int n ) const;
+
+    /// get the level, computing it if needed
+    /// \param n the level (1 .. maxLevel())
+    /// \param view raw view of the plane, only used if there is no finer level computed
+    /// yet, it must have the dimensions given in the constructor
+    const Level &
+    level( int n, NdArray::RawViewInterface * view );
+
+    /// how much memory do the computed levels occupy (in bytes)
+    int64_t
+    byteSize() const;
+
+    /// reduce the source level by the given factor
+    /// \param src data to reduce
+    /// \param factor size of the blocks
+    /// \param reduction how to reduce the blocks
+    /// \return the reduced level
+    static Level
+    reduce( const Level & src, int factor, Reduction reduction );
+
+private:
+
+    /// compute level by reading the raw view
+    Level
+    reduceView( NdArray::RawViewInterface * view, int factor );
+
+    int m_width, m_height;
+    Reduction m_reduction;
+
+    /// computed levels, indexed by level number
+    std::map < int, Level > m_levels;
+};
+}
+}
+}
@@ -0,0 +1,63 @@
+/**
+ * Parallel processing of a typed view.
+ *
+ * Views can't be read from several threads at once, so the view is read chunk by chunk
+ * as usual, and each chunk is split between the threads of the global thread pool.
+ * Every thread accumulates into its own partial result, which the caller merges after
+ * the traversal.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+/// number of partial results to use for parallelForEach()
+inline int
+parallelSliceCount()
+{
+    return std::max( 1, QThreadPool::globalInstance()-> maxThreadCount() );
+}
+
+/// read the view in chunks of chunkSize elements, and split each chunk between the
+/// threads of the global thread pool, one slice per partial result
+/// \param view the view to process (in Traversal::Optimal order)
+/// \param chunkSize number of elements read from the view at once
+/// \param partials one partial result per slice, see parallelSliceCount()
+/// \param func called with a slice of a chunk and the partial result of that slice
+template < typename Scalar, typename Partial >
+void
+parallelForEach( NdArray::TypedView < Scalar > & view, int64_t chunkSize,
+                 std::vector < Partial > & partials,
+                 const std::function < void (const Scalar *, int64_t, Partial &) > & func )
+{
+    std::vector < int > slices( partials.size() );
+    std::iota( slices.begin(), slices.end(), 0 );
+    view.forEach(
+        chunkSize,
+        [&] ( const Scalar * data, int64_t count ) {
+            const int64_t n = slices.size();
+            QtConcurrent::blockingMap( slices, [&] ( int & slice ) {
+                int64_t begin = count * slice / n;
+                int64_t end = count * ( slice + 1 ) / n;
+                func( data + begin, end - begin, partials[slice] );
+            } );
+        },
+        NdArray::RawViewInterface::Traversal::Optimal
+        );
+}
+}
+}
+}
@@ -0,0 +1,106 @@
+/**
+ *
+ **/
+
+#include "PipelineLutCache.h"
+#include <QMutexLocker>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+PipelineLutCache &
+PipelineLutCache::instance()
+{
+    static PipelineLutCache cache;
+    return cache;
+}
+
+PipelineLutCache::PipelineLutCache()
+{ }
+
+PipelineLutCache::InterpolatedLut
+PipelineLutCache::interpolated( Lib::PixelPipeline::IPixelPipeline & pipeline,
+                                const CacheKey & pipelineKey,
+                                int size, double clipMin, double clipMax )
+{
+    if ( pipelineKey.isNull() ) {
+        return build < true > ( pipeline, size, clipMin, clipMax );
+    }
+    CacheKey k = key( pipelineKey, size, clipMin, clipMax, true );
+    QMutexLocker locker( & m_mutex );
+    std::shared_ptr < Entry > entry = m_cache.object( k );
+    if ( entry ) {
+        return entry-> interpolated;
+    }
+    entry = std::make_shared < Entry > ();
+    entry-> interpolated = build < true > ( pipeline, size, clipMin, clipMax );
+    InterpolatedLut result = entry-> interpolated;
+    m_cache.insert( k, entry, cost( size ) );
+    return result;
+}
+
+PipelineLutCache::NearestLut
+PipelineLutCache::nearest( Lib::PixelPipeline::IPixelPipeline & pipeline,
+                           const CacheKey & pipelineKey,
+                           int size, double clipMin, double clipMax )
+{
+    if ( pipelineKey.isNull() ) {
+        return build < false > ( pipeline, size, clipMin, clipMax );
+    }
+    CacheKey k = key( pipelineKey, size, clipMin, clipMax, false );
+    QMutexLocker locker( & m_mutex );
+    std::shared_ptr < Entry > entry = m_cache.object( k );
+    if ( entry ) {
+        return entry-> nearest;
+    }
+    entry = std::make_shared < Entry > ();
+    entry-> nearest = build < false > ( pipeline, size, clipMin, clipMax );
+    NearestLut result = entry-> nearest;
+    m_cache.insert( k, entry, cost( size ) );
+    return result;
+}
+
+int64_t
+PipelineLutCache::buildCount() const
+{
+    return m_buildCount;
+}
+
+void
+PipelineLutCache::clear()
+{
+    QMutexLocker locker( & m_mutex );
+    m_cache.clear();
+}
+
+template < bool interpolated >
+std::shared_ptr < const Lib::PixelPipeline::CachedPipeline < interpolated > >
+PipelineLutCache::build( Lib::PixelPipeline::IPixelPipeline & pipeline, int size,
+                         double clipMin, double clipMax )
+{
+    auto lut = std::make_shared < Lib::PixelPipeline::CachedPipeline < interpolated > > ();
+    lut-> cache( pipeline, size, clipMin, clipMax );
+    m_buildCount++;
+    return lut;
+}
+
+CacheKey
+PipelineLutCache::key( const CacheKey & pipelineKey, int size, double clipMin,
+                       double clipMax, bool interpolated )
+{
+    return pipelineKey.with( clipMin ).with( clipMax ).with( size ).with( interpolated );
+}
+
+int64_t
+PipelineLutCache::cost( int size )
+{
+    // normalized rgb, QRgb and 3 channels used for interpolation per entry
+    return int64_t( size ) *
+           ( sizeof( Lib::PixelPipeline::NormRgb ) + sizeof( QRgb ) + 3 * sizeof( double ) );
+}
+}
+}
+}
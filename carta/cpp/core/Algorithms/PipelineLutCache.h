@@ -0,0 +1,97 @@
+/**
+ * Process-wide cache of pixel pipeline lookup tables.
+ *
+ * Building a CachedPipeline means running the (slow) pixel pipeline for every entry
+ * of the table. Views with the same colormap settings would all build identical
+ * tables, so instead they ask this cache, which hands out one immutable table per
+ * (pipeline cache id, clip range, size, interpolation) combination.
+ *
+ * The tables count against the "lut" budget of the CacheManager.
+ *
+ * Pipelines without a cache id cannot be identified, so their tables are built every
+ * time and not shared.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/PixelPipeline/IPixelPipeline.h"
+#include "core/CacheManager.h"
+#include <QMutex>
+#include <atomic>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+class PipelineLutCache
+{
+    CLASS_BOILERPLATE( PipelineLutCache );
+
+public:
+
+    typedef std::shared_ptr < const Lib::PixelPipeline::CachedPipeline < true > > InterpolatedLut;
+    typedef std::shared_ptr < const Lib::PixelPipeline::CachedPipeline < false > > NearestLut;
+
+    /// the process-wide instance
+    static PipelineLutCache &
+    instance();
+
+    PipelineLutCache();
+
+    /// get the interpolated table for the pipeline, building it if needed
+    /// \param pipeline pipeline to cache, prepped with the clip range
+    /// \param pipelineKey key of the pipeline's cache id, null if it does not have one
+    /// \param size number of entries
+    /// \param clipMin first value of the table
+    /// \param clipMax last value of the table
+    /// \return the table
+    InterpolatedLut
+    interpolated( Lib::PixelPipeline::IPixelPipeline & pipeline, const CacheKey & pipelineKey,
+                  int size, double clipMin, double clipMax );
+
+    /// get the non-interpolated table for the pipeline, building it if needed
+    /// \see interpolated()
+    NearestLut
+    nearest( Lib::PixelPipeline::IPixelPipeline & pipeline, const CacheKey & pipelineKey,
+             int size, double clipMin, double clipMax );
+
+    /// number of tables built so far
+    int64_t
+    buildCount() const;
+
+    /// remove all tables
+    void
+    clear();
+
+private:
+
+    /// cache entry, only one of the pointers is set
+    struct Entry {
+        InterpolatedLut interpolated;
+        NearestLut nearest;
+    };
+
+    template < bool interpolated >
+    std::shared_ptr < const Lib::PixelPipeline::CachedPipeline < interpolated > >
+    build( Lib::PixelPipeline::IPixelPipeline & pipeline, int size, double clipMin,
+           double clipMax );
+
+    /// compute the key of a table
+    static CacheKey
+    key( const CacheKey & pipelineKey, int size, double clipMin, double clipMax,
+         bool interpolated );
+
+    /// memory used by a table with the given number of entries (in bytes)
+    static int64_t
+    cost( int size );
+
+    mutable QMutex m_mutex;
+    ManagedCache < Entry > m_cache { "lut" };
+    std::atomic < int64_t > m_buildCount { 0 };
+};
+}
+}
+}
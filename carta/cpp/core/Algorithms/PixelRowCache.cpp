@@ -0,0 +1,95 @@
+/**
+ *
+ **/
+
+#include "PixelRowCache.h"
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+PixelRowCache::PixelRowCache( int capacity )
+{
+    CARTA_ASSERT( capacity > 0 );
+    m_rows.resize( capacity );
+}
+
+void
+PixelRowCache::clear()
+{
+    for ( Row & row : m_rows ) {
+        row.lastUse = - 1;
+    }
+}
+
+bool
+PixelRowCache::value( Image::ImageInterface * image, const std::vector < int > & pos, double & value )
+{
+    if ( ! image ) {
+        return false;
+    }
+    if ( image != m_image ) {
+        clear();
+        m_image = image;
+    }
+    const std::vector < int > & dims = image-> dims();
+    if ( pos.size() != dims.size() || dims.empty() ) {
+        return false;
+    }
+    for ( size_t i = 0 ; i < pos.size() ; ++i ) {
+        if ( pos[i] < 0 || pos[i] >= dims[i] ) {
+            return false;
+        }
+    }
+
+    // look for the row, remembering the least recently used one in case it's not there
+    m_clock++;
+    Row * victim = & m_rows[0];
+    for ( Row & row : m_rows ) {
+        if ( contains( row, pos ) ) {
+            row.lastUse = m_clock;
+            value = row.values[pos[0]];
+            return true;
+        }
+        if ( row.lastUse < victim-> lastUse ) {
+            victim = & row;
+        }
+    }
+
+    // read the row, reusing the memory of the replaced one
+    victim-> pos = pos;
+    victim-> values.resize( dims[0] );
+    m_rowReads++;
+    if ( ! image-> getRow( pos, victim-> values.data() ) ) {
+        victim-> lastUse = - 1;
+        return false;
+    }
+    victim-> lastUse = m_clock;
+    value = victim-> values[pos[0]];
+    return true;
+} // value
+
+int64_t
+PixelRowCache::rowReads() const
+{
+    return m_rowReads;
+}
+
+bool
+PixelRowCache::contains( const Row & row, const std::vector < int > & pos )
+{
+    if ( row.lastUse < 0 || row.pos.size() != pos.size() ) {
+        return false;
+    }
+    for ( size_t i = 1 ; i < pos.size() ; ++i ) {
+        if ( row.pos[i] != pos[i] ) {
+            return false;
+        }
+    }
+    return true;
+}
+}
+}
+}
@@ -0,0 +1,69 @@
+/**
+ * Small cache of image rows for cursor readout.
+ *
+ * The cursor readout asks for a single pixel on every mouse move. Instead of creating
+ * a view of the current plane for each query, the rows around the cursor are kept in
+ * memory, so consecutive queries are a lookup in a handful of rows. Rows are read with
+ * Image::ImageInterface::getRow() when they are not in the cache, and the least recently
+ * used row is replaced. Once all the rows are allocated, queries do not allocate memory.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include <vector>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+class PixelRowCache
+{
+    CLASS_BOILERPLATE( PixelRowCache );
+
+public:
+
+    /// \param capacity how many rows to keep
+    PixelRowCache( int capacity = 16 );
+
+    /// forget all the rows
+    void
+    clear();
+
+    /// get the value of a pixel
+    /// \param image image to read from, if it's not the image used by the previous
+    /// query, the cache is cleared first
+    /// \param pos position of the pixel, one index per axis
+    /// \param value where to store the result
+    /// \return false if pos is outside of the image
+    bool
+    value( Image::ImageInterface * image, const std::vector < int > & pos, double & value );
+
+    /// how many rows were read from the image so far
+    int64_t
+    rowReads() const;
+
+private:
+
+    struct Row {
+        /// position of the row, the first index is not used
+        std::vector < int > pos;
+        std::vector < double > values;
+        int64_t lastUse = - 1;
+    };
+
+    /// does the row contain the pixel at pos
+    static bool
+    contains( const Row & row, const std::vector < int > & pos );
+
+    std::vector < Row > m_rows;
+    Image::ImageInterface * m_image = nullptr;
+    int64_t m_clock = 0;
+    int64_t m_rowReads = 0;
+};
+}
+}
+}
@@ -0,0 +1,299 @@
+/**
+ *
+ **/
+
+#include "PlaneStatistics.h"
+#include "ParallelForEach.h"
+#include "quantileAlgorithms.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+namespace
+{
+/// moments of the values seen by one thread
+struct MomentsPartial {
+    int64_t count = 0;
+    int64_t nanCount = 0;
+    int64_t negativeInfinite = 0;
+    int64_t positiveInfinite = 0;
+    double min = std::numeric_limits < double >::infinity();
+    double max = - std::numeric_limits < double >::infinity();
+    double sum = 0;
+    double sumSq = 0;
+};
+
+/// quantiles closer than this are considered the same
+constexpr double QuantileTolerance = 1e-9;
+}
+
+constexpr int PlaneStatistics::HistogramBins;
+
+const std::vector < double > &
+PlaneStatistics::sketchQuantiles()
+{
+    // both ends of the clips offered by the Clips object, plus a coarse grid
+    static const std::vector < double > quantiles {
+        0, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5,
+        0.75, 0.9, 0.95, 0.975, 0.99, 0.995, 0.9975, 0.999, 0.9995, 1
+    };
+    return quantiles;
+}
+
+template < typename Scalar >
+PlaneStatistics::SharedPtr
+PlaneStatistics::computeTyped( NdArray::RawViewInterface * rawView )
+{
+    NdArray::TypedView < Scalar > view( rawView, false );
+    const int nSlices = parallelSliceCount();
+    PlaneStatistics::SharedPtr stats = std::make_shared < PlaneStatistics > ();
+
+    // moments and range
+    std::vector < MomentsPartial > moments( nSlices );
+    parallelForEach < Scalar, MomentsPartial > (
+        view, QuantileChunkSize, moments,
+        [] ( const Scalar * data, int64_t count, MomentsPartial & partial ) {
+            MomentsPartial local = partial;
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                double v = data[i];
+                if ( std::isfinite( v ) ) {
+                    local.count++;
+                    local.min = std::min( local.min, v );
+                    local.max = std::max( local.max, v );
+                    local.sum += v;
+                    local.sumSq += v * v;
+                }
+                else if ( std::isnan( v ) ) {
+                    local.nanCount++;
+                }
+                else if ( v < 0 ) {
+                    local.negativeInfinite++;
+                }
+                else {
+                    local.positiveInfinite++;
+                }
+            }
+            partial = local;
+        } );
+    MomentsPartial total;
+    for ( const MomentsPartial & partial : moments ) {
+        total.count += partial.count;
+        total.nanCount += partial.nanCount;
+        total.negativeInfinite += partial.negativeInfinite;
+        total.positiveInfinite += partial.positiveInfinite;
+        total.min = std::min( total.min, partial.min );
+        total.max = std::max( total.max, partial.max );
+        total.sum += partial.sum;
+        total.sumSq += partial.sumSq;
+    }
+    stats-> m_count = total.count;
+    stats-> m_nanCount = total.nanCount;
+    stats-> m_negativeInfinite = total.negativeInfinite;
+    stats-> m_positiveInfinite = total.positiveInfinite;
+    stats-> m_sum = total.sum;
+    stats-> m_sumSq = total.sumSq;
+    stats-> m_histogram.assign( HistogramBins, 0 );
+    stats-> m_min = total.min;
+    stats-> m_max = total.max;
+    if ( total.count == 0 ) {
+        stats-> m_min = stats-> m_max = std::numeric_limits < double >::quiet_NaN();
+    }
+
+    // histogram, a range too narrow to split is a single bin
+    const double lo = total.min;
+    const double scale = total.count > 0 && canSplitRange < Scalar > ( total.min, total.max, HistogramBins ) ?
+                         HistogramBins / ( total.max - total.min ) : 0;
+    std::vector < std::vector < int64_t > > histograms( nSlices );
+    parallelForEach < Scalar, std::vector < int64_t > > (
+        view, QuantileChunkSize, histograms,
+        [lo, scale] ( const Scalar * data, int64_t count, std::vector < int64_t > & hist ) {
+            if ( hist.empty() ) {
+                hist.resize( HistogramBins, 0 );
+            }
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                if ( std::isfinite( data[i] ) ) {
+                    hist[std::min < int > ( ( data[i] - lo ) * scale, HistogramBins - 1 )]++;
+                }
+            }
+        } );
+    for ( const auto & hist : histograms ) {
+        for ( size_t b = 0 ; b < hist.size() ; ++b ) {
+            stats-> m_histogram[b] += hist[b];
+        }
+    }
+    stats-> accumulate();
+
+    // sketch, which ranks the infinities too
+    std::vector < Scalar > sketch = bucketQuantiles( view, sketchQuantiles() );
+    stats-> m_sketch.assign( sketch.begin(), sketch.end() );
+    return stats;
+} // computeTyped
+
+PlaneStatistics::SharedPtr
+PlaneStatistics::compute( NdArray::RawViewInterface * view )
+{
+    if ( view-> pixelType() == Image::PixelType::Real32 ) {
+        return computeTyped < float > ( view );
+    }
+    return computeTyped < double > ( view );
+}
+
+PlaneStatistics::SharedPtr
+PlaneStatistics::read( QDataStream & in )
+{
+    PlaneStatistics::SharedPtr stats = std::make_shared < PlaneStatistics > ();
+    qint64 count = 0, nanCount = 0, negativeInfinite = 0, positiveInfinite = 0;
+    quint32 bins = 0, sketchSize = 0;
+    in >> count >> nanCount >> negativeInfinite >> positiveInfinite >> stats-> m_min >> stats-> m_max >> stats-> m_sum >> stats-> m_sumSq;
+    in >> bins;
+    if ( in.status() != QDataStream::Ok || bins != HistogramBins ) {
+        return nullptr;
+    }
+    stats-> m_count = count;
+    stats-> m_nanCount = nanCount;
+    stats-> m_negativeInfinite = negativeInfinite;
+    stats-> m_positiveInfinite = positiveInfinite;
+    stats-> m_histogram.resize( bins );
+    for ( int64_t & value : stats-> m_histogram ) {
+        qint64 v = 0;
+        in >> v;
+        value = v;
+    }
+    in >> sketchSize;
+    if ( in.status() != QDataStream::Ok || sketchSize != sketchQuantiles().size() ) {
+        return nullptr;
+    }
+    stats-> m_sketch.resize( sketchSize );
+    for ( double & value : stats-> m_sketch ) {
+        in >> value;
+    }
+    if ( in.status() != QDataStream::Ok ) {
+        return nullptr;
+    }
+    stats-> accumulate();
+    return stats;
+}
+
+void
+PlaneStatistics::write( QDataStream & out ) const
+{
+    out << qint64( m_count ) << qint64( m_nanCount ) << qint64( m_negativeInfinite )
+        << qint64( m_positiveInfinite ) << m_min << m_max << m_sum << m_sumSq;
+    out << quint32( m_histogram.size() );
+    for ( int64_t value : m_histogram ) {
+        out << qint64( value );
+    }
+    out << quint32( m_sketch.size() );
+    for ( double value : m_sketch ) {
+        out << value;
+    }
+}
+
+size_t
+PlaneStatistics::sketchPosition( double q )
+{
+    const std::vector < double > & quantiles = sketchQuantiles();
+    return std::lower_bound( quantiles.begin(), quantiles.end(), q - QuantileTolerance )
+           - quantiles.begin();
+}
+
+bool
+PlaneStatistics::isSketchQuantile( double q )
+{
+    const std::vector < double > & quantiles = sketchQuantiles();
+    size_t k = sketchPosition( q );
+    return k < quantiles.size() && std::fabs( quantiles[k] - q ) <= QuantileTolerance;
+}
+
+double
+PlaneStatistics::quantile( double q ) const
+{
+    const int64_t total = m_negativeInfinite + m_count + m_positiveInfinite;
+    if ( total == 0 ) {
+        return std::numeric_limits < double >::quiet_NaN();
+    }
+
+    // the sketch has the exact values
+    size_t k = sketchPosition( q );
+    if ( isSketchQuantile( q ) ) {
+        return m_sketch[k];
+    }
+
+    // same rank as quantiles2pixels()
+    int64_t rank = Carta::Lib::clamp < int64_t > ( total * q, 0, total - 1 );
+    rank -= m_negativeInfinite;
+    if ( rank < 0 ) {
+        return - std::numeric_limits < double >::infinity();
+    }
+    if ( rank >= m_count ) {
+        return std::numeric_limits < double >::infinity();
+    }
+
+    // otherwise interpolate within the bin holding the rank
+    int bin = std::upper_bound( m_cumulative.begin(), m_cumulative.end(), rank )
+              - m_cumulative.begin() - 1;
+    bin = Carta::Lib::clamp( bin, 0, HistogramBins - 1 );
+    double width = ( m_max - m_min ) / HistogramBins;
+    double fraction = m_histogram[bin] > 0
+                      ? ( rank - m_cumulative[bin] + 0.5 ) / m_histogram[bin] : 0.5;
+    double value = m_min + ( bin + fraction ) * width;
+
+    // and keep it between the neighbouring sketch values
+    if ( k > 0 && k < m_sketch.size() ) {
+        if ( std::isfinite( m_sketch[k - 1] ) && std::isfinite( m_sketch[k] ) ) {
+            value = Carta::Lib::clamp( value, m_sketch[k - 1], m_sketch[k] );
+        }
+    }
+    return value;
+} // quantile
+
+double
+PlaneStatistics::percentile( double value ) const
+{
+    const int64_t total = m_negativeInfinite + m_count + m_positiveInfinite;
+    if ( total == 0 || std::isnan( value ) ) {
+        return 0;
+    }
+    if ( value > std::numeric_limits < double >::max() ) {
+        return 1;
+    }
+
+    // finite values <= value, interpolated within the bin
+    double below = 0;
+    if ( m_count > 0 && value >= m_max ) {
+        below = m_count;
+    }
+    else if ( m_count > 0 && value >= m_min ) {
+        double position = ( value - m_min ) * HistogramBins / ( m_max - m_min );
+        int bin = std::min < int > ( position, HistogramBins - 1 );
+        double fraction = Carta::Lib::clamp( position - bin, 0.0, 1.0 );
+        below = m_cumulative[bin] + fraction * m_histogram[bin];
+    }
+    return ( m_negativeInfinite + below ) / total;
+} // percentile
+
+int64_t
+PlaneStatistics::bytes() const
+{
+    return sizeof( PlaneStatistics )
+           + ( m_histogram.size() + m_cumulative.size() ) * sizeof( int64_t )
+           + m_sketch.size() * sizeof( double );
+}
+
+void
+PlaneStatistics::accumulate()
+{
+    m_cumulative.assign( m_histogram.size() + 1, 0 );
+    for ( size_t b = 0 ; b < m_histogram.size() ; ++b ) {
+        m_cumulative[b + 1] = m_cumulative[b] + m_histogram[b];
+    }
+}
+}
+}
+}
@@ -0,0 +1,171 @@
+/**
+ * Statistics of one plane of an image.
+ *
+ * Besides the count, NaN count, range, sum and sum of squares, the statistics keep a
+ * histogram with HistogramBins bins between the minimum and the maximum, and a sketch
+ * of the distribution: the exact values at the quantiles listed by sketchQuantiles(),
+ * which include the clip percentiles offered by the user interface.
+ *
+ * Quantiles in the sketch are answered exactly, i.e. the same as quantiles2pixels()
+ * with QuantileMethod::Exact. Other quantiles, and percentiles of arbitrary values, are
+ * interpolated from the histogram, so they are within one bin of the exact answer.
+ *
+ * Like quantiles2pixels(), NaNs are ignored and infinities are counted: they are kept
+ * out of the moments and the histogram, but their numbers are stored, so that all the
+ * quantiles and percentiles rank them below or above the finite values.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include <QDataStream>
+#include <cstdint>
+#include <vector>
+
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+class PlaneStatistics
+{
+    CLASS_BOILERPLATE( PlaneStatistics );
+
+public:
+
+    /// number of bins of the histogram
+    static constexpr int HistogramBins = 4096;
+
+    /// quantiles stored in the sketch, sorted
+    static const std::vector < double > &
+    sketchQuantiles();
+
+    /// compute the statistics of a view, reading it in parallel
+    static PlaneStatistics::SharedPtr
+    compute( NdArray::RawViewInterface * view );
+
+    /// read statistics written by write()
+    /// \return the statistics, or nullptr if the data is not valid
+    static PlaneStatistics::SharedPtr
+    read( QDataStream & in );
+
+    /// write the statistics to a stream
+    void
+    write( QDataStream & out ) const;
+
+    /// number of finite values
+    int64_t
+    count() const
+    {
+        return m_count;
+    }
+
+    /// number of NaNs
+    int64_t
+    nanCount() const
+    {
+        return m_nanCount;
+    }
+
+    /// number of -inf values
+    int64_t
+    negativeInfiniteCount() const
+    {
+        return m_negativeInfinite;
+    }
+
+    /// number of +inf values
+    int64_t
+    positiveInfiniteCount() const
+    {
+        return m_positiveInfinite;
+    }
+
+    /// smallest finite value (nan if there are none)
+    double
+    min() const
+    {
+        return m_min;
+    }
+
+    /// largest finite value (nan if there are none)
+    double
+    max() const
+    {
+        return m_max;
+    }
+
+    double
+    sum() const
+    {
+        return m_sum;
+    }
+
+    double
+    sumSq() const
+    {
+        return m_sumSq;
+    }
+
+    /// histogram of the finite values, HistogramBins bins between min() and max()
+    const std::vector < int64_t > &
+    histogram() const
+    {
+        return m_histogram;
+    }
+
+    /// values at sketchQuantiles()
+    const std::vector < double > &
+    sketch() const
+    {
+        return m_sketch;
+    }
+
+    /// is the quantile in the sketch, i.e. is quantile() exact for it
+    static bool
+    isSketchQuantile( double q );
+
+    /// value at a quantile, exact if the quantile is in the sketch
+    /// \return the value, nan if there are no values
+    double
+    quantile( double q ) const;
+
+    /// fraction of the values that are <= value, interpolated within a bin
+    double
+    percentile( double value ) const;
+
+    /// approximate number of bytes used
+    int64_t
+    bytes() const;
+
+private:
+
+    template < typename Scalar >
+    static PlaneStatistics::SharedPtr
+    computeTyped( NdArray::RawViewInterface * view );
+
+    /// index of the first sketch quantile that is not below q (less the tolerance)
+    static size_t
+    sketchPosition( double q );
+
+    /// number of values in the bins before each bin (computed from the histogram)
+    void
+    accumulate();
+
+    int64_t m_count = 0;
+    int64_t m_nanCount = 0;
+    int64_t m_negativeInfinite = 0;
+    int64_t m_positiveInfinite = 0;
+    double m_min = 0, m_max = 0;
+    double m_sum = 0, m_sumSq = 0;
+    std::vector < int64_t > m_histogram;
+    std::vector < double > m_sketch;
+
+    /// m_cumulative[i] = number of values in bins 0..i-1
+    std::vector < int64_t > m_cumulative;
+};
+}
+}
+}
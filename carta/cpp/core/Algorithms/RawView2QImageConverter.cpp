@@ -8,6 +8,7 @@
 #include "GrayColormap.h"
 #include "RawView2QImageConverter.h"
 
+#include <algorithm>
 #include <functional>
 #include <array>
 #include <QColor>
@@ -28,19 +29,14 @@ computeClips(
 }
 
 
-/// algorithm for converting an instance of image interface to qimage
-/// using the pixel pipeline
-///
-/// \tparam Pipeline
-/// \param m_rawView
-/// \param pipe
-/// \param m_qImage
-template < class Pipeline >
+/// number of rows rawView2QImage() reads from the view at once
+static const int64_t RowsPerChunk = 64;
+
+/// rawView2QImage() with the data processed as the given Scalar type
+template < typename Scalar, class Pipeline >
 static void
-rawView2QImage( NdArray::RawViewInterface * rawView, Pipeline & pipe, QImage & qImage )
+rawView2QImageTyped( NdArray::RawViewInterface * rawView, Pipeline & pipe, QImage & qImage )
 {
-    qDebug() << "rv2qi" << rawView-> dims();
-    typedef double Scalar;
     QSize size( rawView->dims()[0], rawView->dims()[1] );
 
     if ( qImage.format() != QImage::Format_ARGB32_Premultiplied ||
@@ -57,30 +53,50 @@ rawView2QImage( NdArray::RawViewInterface * rawView, Pipeline & pipe, QImage & q
     QRgb * outPtr = reinterpret_cast < QRgb * > (
         qImage.bits() + size.width() * ( size.height() - 1 ) * 4 );
 
-    // make a double view
+    // read the view in blocks of rows and convert each row (or the part of it that
+    // is in the block) using the batch api
     NdArray::TypedView < Scalar > typedView( rawView, false );
-
-    /// @todo for more efficiency we should switch to the higher performance view apis
-    /// and apply some basic openmp/cilk
-    int64_t counter = 0;
+    int64_t x = 0;
     QRgb nanColor = qRgb( 255, 0, 0);
-    auto lambda = [&] ( const Scalar & ival )
+    auto lambda = [&] ( const Scalar * data, int64_t count )
     {
-        if( ! std::isnan( ival)) {
-            pipe.convertq( ival, * outPtr );
-        }
-        else {
-             * outPtr = nanColor;
-        }
-        outPtr++;
-        counter++;
-
-        // build the image bottom-up
-        if ( counter % size.width() == 0 ) {
-            outPtr -= size.width() * 2;
+        while ( count > 0 ) {
+            int64_t n = std::min < int64_t > ( count, size.width() - x );
+            pipe.convertqBatch( data, outPtr + x, n, nanColor );
+            data += n;
+            count -= n;
+            x += n;
+
+            // build the image bottom-up
+            if ( x == size.width() ) {
+                outPtr -= size.width();
+                x = 0;
+            }
         }
     };
-    typedView.forEach( lambda );
+    typedView.forEach( RowsPerChunk * int64_t( size.width() ), lambda );
+} // rawView2QImageTyped
+
+/// algorithm for converting an instance of image interface to qimage
+/// using the pixel pipeline
+///
+/// float views are converted without promoting the data to double
+///
+/// \tparam Pipeline
+/// \param m_rawView
+/// \param pipe
+/// \param m_qImage
+template < class Pipeline >
+static void
+rawView2QImage( NdArray::RawViewInterface * rawView, Pipeline & pipe, QImage & qImage )
+{
+    qDebug() << "rv2qi" << rawView-> dims();
+    if ( rawView-> pixelType() == Image::PixelType::Real32 ) {
+        rawView2QImageTyped < float > ( rawView, pipe, qImage );
+    }
+    else {
+        rawView2QImageTyped < double > ( rawView, pipe, qImage );
+    }
 } // rawView2QImage
 
 
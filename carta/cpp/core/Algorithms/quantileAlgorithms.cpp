@@ -4,4 +4,201 @@
 
 
 #include "quantileAlgorithms.h"
+#include "ParallelForEach.h"
 
+namespace Carta
+{
+namespace Core
+{
+namespace Algorithms
+{
+namespace
+{
+/// range and counts of the values seen by one thread
+struct RangePartial {
+    double min = std::numeric_limits < double >::infinity();
+    double max = - std::numeric_limits < double >::infinity();
+    int64_t finite = 0;
+    int64_t negativeInfinite = 0;
+    int64_t positiveInfinite = 0;
+};
+
+/// values of the gathered buckets seen by one thread
+template < typename Scalar >
+struct GatherPartial {
+    std::vector < std::vector < Scalar > > buckets;
+};
+
+template < typename Scalar >
+std::vector < Scalar >
+bucketQuantilesTyped( NdArray::TypedView < Scalar > & view, const std::vector < double > & quant )
+{
+    const int nBuckets = QuantileBuckets;
+    const int nThreads = parallelSliceCount();
+
+    // find the range of the finite values, and count the infinities (like nans they
+    // can't be put into buckets, but unlike nans they have a rank)
+    std::vector < RangePartial > ranges( nThreads );
+    parallelForEach < Scalar, RangePartial > (
+        view, QuantileChunkSize, ranges,
+        [] ( const Scalar * data, int64_t count, RangePartial & partial ) {
+            RangePartial local = partial;
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                double v = data[i];
+                if ( std::isfinite( v ) ) {
+                    local.finite++;
+                    local.min = std::min( local.min, v );
+                    local.max = std::max( local.max, v );
+                }
+                else if ( v < 0 ) {
+                    local.negativeInfinite++;
+                }
+                else if ( v > 0 ) {
+                    local.positiveInfinite++;
+                }
+            }
+            partial = local;
+        } );
+    RangePartial range;
+    for ( const RangePartial & partial : ranges ) {
+        range.min = std::min( range.min, partial.min );
+        range.max = std::max( range.max, partial.max );
+        range.finite += partial.finite;
+        range.negativeInfinite += partial.negativeInfinite;
+        range.positiveInfinite += partial.positiveInfinite;
+    }
+    const int64_t total = range.finite + range.negativeInfinite + range.positiveInfinite;
+    std::vector < Scalar > result( quant.size(), std::numeric_limits < Scalar >::quiet_NaN() );
+    if ( total == 0 ) {
+        return result;
+    }
+
+    // rank of each quantile among the finite values, same as quantiles2pixels() uses
+    std::vector < int64_t > ranks( quant.size(), - 1 );
+    bool needBuckets = false;
+    for ( size_t k = 0 ; k < quant.size() ; ++k ) {
+        int64_t rank = Carta::Lib::clamp < int64_t > ( total * quant[k], 0, total - 1 );
+        rank -= range.negativeInfinite;
+        if ( rank < 0 ) {
+            result[k] = - std::numeric_limits < Scalar >::infinity();
+        }
+        else if ( rank >= range.finite ) {
+            result[k] = std::numeric_limits < Scalar >::infinity();
+        }
+        else if ( range.min == range.max ) {
+            result[k] = range.min;
+        }
+        else {
+            ranks[k] = rank;
+            needBuckets = true;
+        }
+    }
+    if ( ! needBuckets ) {
+        return result;
+    }
+
+    // build a histogram of the finite values, each thread into its own one, a range too
+    // narrow to split is a single bucket
+    const double lo = range.min;
+    const double scale = canSplitRange < Scalar > ( range.min, range.max, nBuckets ) ?
+                         nBuckets / ( range.max - range.min ) : 0;
+    auto bucketOf = [lo, scale, nBuckets] ( double v ) {
+        return std::min < int > ( ( v - lo ) * scale, nBuckets - 1 );
+    };
+    std::vector < std::vector < int64_t > > histograms( nThreads );
+    parallelForEach < Scalar, std::vector < int64_t > > (
+        view, QuantileChunkSize, histograms,
+        [&] ( const Scalar * data, int64_t count, std::vector < int64_t > & hist ) {
+            if ( hist.empty() ) {
+                hist.resize( nBuckets, 0 );
+            }
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                if ( std::isfinite( data[i] ) ) {
+                    hist[bucketOf( data[i] )]++;
+                }
+            }
+        } );
+    std::vector < int64_t > histogram( nBuckets, 0 );
+    for ( const auto & hist : histograms ) {
+        for ( size_t b = 0 ; b < hist.size() ; ++b ) {
+            histogram[b] += hist[b];
+        }
+    }
+
+    // find the bucket of each rank, and the rank within that bucket
+    std::vector < int64_t > firstRank( nBuckets + 1, 0 );
+    for ( int b = 0 ; b < nBuckets ; ++b ) {
+        firstRank[b + 1] = firstRank[b] + histogram[b];
+    }
+    std::vector < int > slotOfBucket( nBuckets, - 1 );
+    std::vector < int > gathered;
+    std::vector < int > bucketOfQuantile( quant.size(), - 1 );
+    for ( size_t k = 0 ; k < quant.size() ; ++k ) {
+        if ( ranks[k] < 0 ) {
+            continue;
+        }
+        int bucket = std::upper_bound( firstRank.begin(), firstRank.end(), ranks[k] )
+                     - firstRank.begin() - 1;
+        if ( slotOfBucket[bucket] < 0 ) {
+            slotOfBucket[bucket] = gathered.size();
+            gathered.push_back( bucket );
+        }
+        bucketOfQuantile[k] = bucket;
+    }
+
+    // gather the values of those buckets, and do quickselect on them
+    std::vector < GatherPartial < Scalar > > gathers( nThreads );
+    parallelForEach < Scalar, GatherPartial < Scalar > > (
+        view, QuantileChunkSize, gathers,
+        [&] ( const Scalar * data, int64_t count, GatherPartial < Scalar > & partial ) {
+            if ( partial.buckets.empty() ) {
+                partial.buckets.resize( gathered.size() );
+            }
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                if ( std::isfinite( data[i] ) ) {
+                    int slot = slotOfBucket[bucketOf( data[i] )];
+                    if ( slot >= 0 ) {
+                        partial.buckets[slot].push_back( data[i] );
+                    }
+                }
+            }
+        } );
+    std::vector < std::vector < Scalar > > values( gathered.size() );
+    for ( size_t slot = 0 ; slot < gathered.size() ; ++slot ) {
+        values[slot].reserve( histogram[gathered[slot]] );
+        for ( auto & partial : gathers ) {
+            if ( ! partial.buckets.empty() ) {
+                values[slot].insert( values[slot].end(), partial.buckets[slot].begin(),
+                                     partial.buckets[slot].end() );
+                std::vector < Scalar > ().swap( partial.buckets[slot] );
+            }
+        }
+        CARTA_ASSERT( int64_t( values[slot].size() ) == histogram[gathered[slot]] );
+    }
+    for ( size_t k = 0 ; k < quant.size() ; ++k ) {
+        if ( bucketOfQuantile[k] < 0 ) {
+            continue;
+        }
+        std::vector < Scalar > & bucketValues = values[slotOfBucket[bucketOfQuantile[k]]];
+        int64_t index = ranks[k] - firstRank[bucketOfQuantile[k]];
+        std::nth_element( bucketValues.begin(), bucketValues.begin() + index, bucketValues.end() );
+        result[k] = bucketValues[index];
+    }
+    return result;
+} // bucketQuantilesTyped
+}
+
+std::vector < float >
+bucketQuantiles( NdArray::TypedView < float > & view, const std::vector < double > & quant )
+{
+    return bucketQuantilesTyped( view, quant );
+}
+
+std::vector < double >
+bucketQuantiles( NdArray::TypedView < double > & view, const std::vector < double > & quant )
+{
+    return bucketQuantilesTyped( view, quant );
+}
+}
+}
+}
@@ -18,6 +18,283 @@ namespace Core
 {
 namespace Algorithms
 {
+/// number of elements the quantile algorithms read from a view at once
+static const int64_t QuantileChunkSize = 1024 * 1024;
+
+/// how quantiles2pixels() computes the quantiles
+enum class QuantileMethod
+{
+    /// Exact for views with up to ExactQuantileLimit elements, Approximate otherwise
+    Auto,
+
+    /// quickselect on a copy of all values for views with up to ExactQuantileLimit
+    /// elements, bucketQuantiles() for larger views
+    Exact,
+
+    /// histogramQuantiles(), memory use does not depend on the size of the view
+    Approximate
+};
+
+/// largest view for which QuantileMethod::Auto computes exact quantiles, and for which
+/// QuantileMethod::Exact copies all values
+static const int64_t ExactQuantileLimit = 4 * 1024 * 1024;
+
+/// number of buckets of the histogram built by bucketQuantiles()
+static const int QuantileBuckets = 65536;
+
+/// number of bins of the histograms built by histogramQuantiles()
+static const int HistogramQuantileBins = 4096;
+
+/// default rank error of histogramQuantiles(), as a fraction of the number of values
+static const double HistogramQuantileRankError = 1e-4;
+
+/// default maximum number of histogram passes of histogramQuantiles()
+static const int HistogramQuantilePasses = 4;
+
+/// does the range [lo,hi] hold more than one Scalar value, so that splitting it into
+/// \a bins bins makes sense (and bins / (hi - lo) is finite)?
+template < typename Scalar >
+static inline bool
+canSplitRange( double lo, double hi, int bins = HistogramQuantileBins )
+{
+    double width = hi - lo;
+    double magnitude = std::max( std::fabs( lo ), std::fabs( hi ) );
+    return lo < hi
+           && width > magnitude * std::numeric_limits < Scalar >::epsilon()
+           && std::isfinite( bins / width );
+}
+
+/// compute approximate quantiles by histogram refinement, reading the view a few times
+/// instead of copying it
+/// \param view the input dataset
+/// \param quant which quantiles to compute, same meaning as for quantiles2pixels()
+/// \param maxRankError acceptable error of the rank of the result, as a fraction of the
+/// number of values
+/// \param maxPasses maximum number of histogram passes
+/// \return the computed quantiles. If there are no finite values, the result will be nans.
+///
+/// The first pass finds the range of the values. Every following pass builds a histogram
+/// over the current range of each quantile, and narrows that range to the bin holding
+/// the rank of the quantile. This stops once the bin holds at most maxRankError of all
+/// values, or can't be split any further, or after maxPasses histogram passes. The
+/// result is interpolated within the final bin, so it is off by at most the width of
+/// that bin, and its rank by at most the number of values in it. With the defaults,
+/// the clip percentiles of typical images need two histogram passes.
+///
+/// Memory use is at most one histogram per quantile, independent of the size of the view.
+///
+/// \note NANs and infinities are treated as if they did not exist
+template < typename Scalar >
+static
+typename std::vector < Scalar >
+histogramQuantiles(
+    NdArray::TypedView < Scalar > & view,
+    const std::vector < double > & quant,
+    double maxRankError = HistogramQuantileRankError,
+    int maxPasses = HistogramQuantilePasses
+    )
+{
+    const int nBins = HistogramQuantileBins;
+
+    // find the range and count the values
+    double minValue = std::numeric_limits < double >::infinity();
+    double maxValue = - std::numeric_limits < double >::infinity();
+    int64_t total = 0;
+    view.forEach(
+        QuantileChunkSize,
+        [&] ( const Scalar * data, int64_t count ) {
+            double vMin = minValue, vMax = maxValue;
+            int64_t finite = 0;
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                if ( std::isfinite( data[i] ) ) {
+                    finite++;
+                    vMin = std::min < double > ( vMin, data[i] );
+                    vMax = std::max < double > ( vMax, data[i] );
+                }
+            }
+            total += finite;
+            minValue = vMin;
+            maxValue = vMax;
+        },
+        NdArray::RawViewInterface::Traversal::Optimal
+        );
+
+    std::vector < Scalar > result( quant.size(), std::numeric_limits < Scalar >::quiet_NaN() );
+    if ( total == 0 ) {
+        return result;
+    }
+
+    // the range of values that still contains each quantile
+    struct Target {
+        int64_t rank;
+        double lo, hi;
+        bool done;
+    };
+    std::vector < Target > targets;
+    for ( size_t k = 0 ; k < quant.size() ; ++k ) {
+        Target target;
+        target.rank = Carta::Lib::clamp < int64_t > ( total * quant[k], 0, total - 1 );
+        target.lo = minValue;
+        target.hi = maxValue;
+        target.done = true;
+
+        // the extremes are known exactly after the first pass
+        if ( target.rank == 0 || ! canSplitRange < Scalar > ( minValue, maxValue ) ) {
+            result[k] = minValue;
+        }
+        else if ( target.rank == total - 1 ) {
+            result[k] = maxValue;
+        }
+        else {
+            target.done = false;
+        }
+        targets.push_back( target );
+    }
+    const int64_t maxBinCount = std::max < int64_t > ( 1, total * maxRankError );
+
+    // quantiles whose ranges are the same (e.g. all of them in the first histogram
+    // pass) share a histogram
+    struct Range {
+        double lo, hi, scale;
+        int64_t below;
+        double valueMin, valueMax;
+    };
+    std::vector < Range > ranges;
+    std::vector < int64_t > histogram;
+    std::vector < size_t > rangeOf( targets.size() );
+    for ( int pass = 0 ; pass < maxPasses ; ++pass ) {
+        ranges.clear();
+        for ( size_t k = 0 ; k < targets.size() ; ++k ) {
+            if ( targets[k].done ) {
+                continue;
+            }
+            size_t r = 0;
+            while ( r < ranges.size()
+                    && ( ranges[r].lo != targets[k].lo || ranges[r].hi != targets[k].hi ) ) {
+                r++;
+            }
+            if ( r == ranges.size() ) {
+                Range range;
+                range.lo = targets[k].lo;
+                range.hi = targets[k].hi;
+                range.scale = nBins / ( range.hi - range.lo );
+                range.below = 0;
+                range.valueMin = std::numeric_limits < double >::infinity();
+                range.valueMax = - std::numeric_limits < double >::infinity();
+                ranges.push_back( range );
+            }
+            rangeOf[k] = r;
+        }
+        if ( ranges.empty() ) {
+            break;
+        }
+        histogram.assign( ranges.size() * nBins, 0 );
+
+        view.forEach(
+            QuantileChunkSize,
+            [&] ( const Scalar * data, int64_t count ) {
+                for ( size_t r = 0 ; r < ranges.size() ; ++r ) {
+                    const double lo = ranges[r].lo;
+                    const double hi = ranges[r].hi;
+                    const double scale = ranges[r].scale;
+                    int64_t * bins = & histogram[r * nBins];
+                    int64_t below = 0;
+                    double vMin = ranges[r].valueMin, vMax = ranges[r].valueMax;
+                    for ( int64_t i = 0 ; i < count ; ++i ) {
+                        // nans and +inf fail both comparisons
+                        double v = data[i];
+                        if ( v < lo ) {
+                            if ( std::isfinite( v ) ) {
+                                below++;
+                            }
+                        }
+                        else if ( v <= hi ) {
+                            int bin = std::min < int > ( ( v - lo ) * scale, nBins - 1 );
+                            bins[bin]++;
+                            vMin = std::min( vMin, v );
+                            vMax = std::max( vMax, v );
+                        }
+                    }
+                    ranges[r].below += below;
+                    ranges[r].valueMin = vMin;
+                    ranges[r].valueMax = vMax;
+                }
+            },
+            NdArray::RawViewInterface::Traversal::Optimal
+            );
+
+        // narrow down the range of each quantile to the bin containing its rank
+        for ( size_t k = 0 ; k < targets.size() ; ++k ) {
+            Target & target = targets[k];
+            if ( target.done ) {
+                continue;
+            }
+            const Range & range = ranges[rangeOf[k]];
+            const int64_t * bins = & histogram[rangeOf[k] * nBins];
+            int64_t rank = target.rank - range.below;
+            int64_t cumulative = 0;
+            int bin = 0;
+            while ( bin < nBins && cumulative + bins[bin] <= rank ) {
+                cumulative += bins[bin];
+                bin++;
+            }
+
+            // values on the edge of a bin can end up on the other side when the range
+            // is narrowed, in which case the quantile is at the edge
+            if ( rank < 0 || bin == nBins ) {
+                result[k] = rank < 0 ? target.lo : target.hi;
+                target.done = true;
+                continue;
+            }
+
+            // all values in the range are the same, e.g. for integer data
+            if ( range.valueMin == range.valueMax ) {
+                result[k] = range.valueMin;
+                target.done = true;
+                continue;
+            }
+            double width = ( target.hi - target.lo ) / nBins;
+            double binLo = target.lo + bin * width;
+            double binHi = bin == nBins - 1 ? target.hi : binLo + width;
+            if ( bins[bin] <= maxBinCount || pass == maxPasses - 1
+                 || ! canSplitRange < Scalar > ( binLo, binHi ) ) {
+                double fraction = ( rank - cumulative + 0.5 ) / bins[bin];
+                result[k] = binLo + fraction * ( binHi - binLo );
+                target.done = true;
+            }
+            else {
+                // the values in the bin are also within the range of the values seen in
+                // this pass, which matters when a few outliers stretch the histogram
+                target.lo = std::max( binLo, range.valueMin );
+                target.hi = std::min( binHi, range.valueMax );
+            }
+        }
+    }
+    return result;
+} // histogramQuantiles
+
+/// compute exact quantiles, processing the view in parallel on the global thread pool
+/// \param view the input dataset
+/// \param quant which quantiles to compute, same meaning as for quantiles2pixels()
+/// \return the computed quantiles, exactly the same as the ones quantiles2pixels() finds
+/// by quickselect on a copy of all values
+///
+/// The view is read three times. The first pass finds the range of the finite values,
+/// the second one builds a histogram with QuantileBuckets buckets, and the last one
+/// gathers the values of the buckets holding the requested ranks, so that quickselect
+/// only runs on those. Every chunk read from the view is split between the threads,
+/// each with its own partial result, and the partial results are merged at the end
+/// of the pass.
+///
+/// Memory use is proportional to the number of values in the gathered buckets, which is
+/// a small fraction of the view unless a few outliers squeeze most values into a single
+/// bucket.
+std::vector < float >
+bucketQuantiles( NdArray::TypedView < float > & view, const std::vector < double > & quant );
+
+std::vector < double >
+bucketQuantiles( NdArray::TypedView < double > & view, const std::vector < double > & quant );
+
 /// compute requested quantiles
 /// \param view the input dataset
 /// \param quant which quantiles to compute
@@ -26,9 +303,11 @@ namespace Algorithms
 /// Example: [0.1] will compute a value such that 10% of all values are smaller than the returned
 /// value.
 ///
-/// \note this is a dumb algorithm using quickselect. It really only works on datasets that
-/// are small enough to store in memory. For really big datasets we need a lot more sophisticated
-/// algorithm.
+/// \param method how to compute them, see QuantileMethod
+///
+/// \note for small views the exact method is a dumb algorithm using quickselect on a copy
+/// of the data, larger views go through bucketQuantiles(). If approximate quantiles are
+/// good enough, use QuantileMethod::Approximate (or Auto), which is faster still.
 ///
 /// \note NANs are treated as if they did not exist
 ///
@@ -38,7 +317,8 @@ static
 typename std::vector < Scalar >
 quantiles2pixels(
     NdArray::TypedView < Scalar > & view,
-    std::vector < double > quant
+    std::vector < double > quant,
+    QuantileMethod method = QuantileMethod::Exact
     )
 {
     qDebug() << "computeClips" << view.dims();
@@ -50,19 +330,38 @@ quantiles2pixels(
         }
     }
 
+    int64_t size = 1;
+    for ( int dim : view.dims() ) {
+        size *= dim;
+    }
+    if ( method == QuantileMethod::Auto ) {
+        method = size <= ExactQuantileLimit ? QuantileMethod::Exact : QuantileMethod::Approximate;
+    }
+    if ( method == QuantileMethod::Approximate ) {
+        return histogramQuantiles( view, quant );
+    }
+    if ( size > ExactQuantileLimit ) {
+        return bucketQuantiles( view, quant );
+    }
+
     // read in all values from the view into memory so that we can do quickselect on it
+    // (the order does not matter, so the view can be read tile by tile)
     std::vector < Scalar > allValues;
     view.forEach(
-        [& allValues] ( const Scalar & val ) {
-            if ( ! std::isnan( val ) ) {
-                allValues.push_back( val );
+        QuantileChunkSize,
+        [& allValues] ( const Scalar * data, int64_t count ) {
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                if ( ! std::isnan( data[i] ) ) {
+                    allValues.push_back( data[i] );
+                }
             }
-        }
+        },
+        NdArray::RawViewInterface::Traversal::Optimal
         );
 
     // indicate bad clip if no finite numbers were found
     if ( allValues.size() == 0 ) {
-        return std::vector < Scalar > ( std::numeric_limits < Scalar >::quiet_NaN(), quant.size() );
+        return std::vector < Scalar > ( quant.size(), std::numeric_limits < Scalar >::quiet_NaN() );
     }
 
     // for every input quantile, do quickselect and store the result
@@ -95,21 +394,56 @@ quantiles2pixels(
     return result;
 } // computeClips
 
+/// compute requested quantiles of a raw view
+/// same as the templated version, but the data is processed in its native type, i.e.
+/// float data is not promoted to double (which would double the memory needed)
+static inline
+std::vector < double >
+quantiles2pixels(
+    NdArray::RawViewInterface * rawView,
+    std::vector < double > quant,
+    QuantileMethod method = QuantileMethod::Exact
+    )
+{
+    if ( rawView-> pixelType() == Image::PixelType::Real32 ) {
+        NdArray::TypedView < float > view( rawView, false );
+        std::vector < float > result = quantiles2pixels( view, quant, method );
+        return std::vector < double > ( result.begin(), result.end() );
+    }
+    NdArray::TypedView < double > view( rawView, false );
+    return quantiles2pixels( view, quant, method );
+}
+
 /// algorithm for finding quantile from pixel value
+/// (this reads all the data, for repeated lookups see CumulativeDistribution)
 template < typename Scalar >
 static
-double pixel2quantile ( NdArray::TypedView < Scalar > & view, Scalar pixel)
+double pixel2quantile ( NdArray::TypedView < Scalar > & view, double pixel)
 {
     u_int64_t totalCount = 0;
     u_int64_t countBelow = 0;
-    view.forEach([&](const Scalar & val) {
-        if( Q_UNLIKELY( std::isnan(val))) return;
-        totalCount ++;
-        if( val <= pixel) countBelow++;
-    });
+    view.forEach( QuantileChunkSize, [&](const Scalar * data, int64_t count) {
+        for( int64_t i = 0 ; i < count ; ++ i) {
+            if( Q_UNLIKELY( std::isnan(data[i]))) continue;
+            totalCount ++;
+            if( data[i] <= pixel) countBelow++;
+        }
+    }, NdArray::RawViewInterface::Traversal::Optimal);
     return double(countBelow) / totalCount;
 }
 
+/// pixel2quantile() for a raw view, processing the data in its native type
+static inline
+double pixel2quantile ( NdArray::RawViewInterface * rawView, double pixel)
+{
+    if ( rawView-> pixelType() == Image::PixelType::Real32 ) {
+        NdArray::TypedView < float > view( rawView, false );
+        return pixel2quantile( view, pixel );
+    }
+    NdArray::TypedView < double > view( rawView, false );
+    return pixel2quantile( view, pixel );
+}
+
 }
 }
 }
@@ -0,0 +1,164 @@
+/**
+ * Compact, hashed key for the render caches.
+ *
+ * A key is a 128 bit hash, built by feeding it the values that identify a cached
+ * object (strings, integers, doubles, or other keys). Strings are hashed only once,
+ * when the key is created, so keys built on every render (e.g. frame keys) are just
+ * a handful of integer operations, without any allocations.
+ *
+ * With 128 bits, accidental collisions are not a practical concern.
+ *
+ * A default constructed key is null, which means "cannot be cached".
+ **/
+
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <cstdint>
+#include <cstring>
+
+namespace Carta
+{
+namespace Core
+{
+class CacheKey
+{
+public:
+
+    /// creates a null key
+    CacheKey() { }
+
+    /// hash a string, an empty string results in a null key
+    static CacheKey
+    fromString( const QString & str )
+    {
+        CacheKey key;
+        if ( str.isEmpty() ) {
+            return key;
+        }
+        key.m_h1 = Seed1;
+        key.m_h2 = Seed2;
+        const QChar * data = str.constData();
+        for ( int i = 0 ; i < str.size() ; ++i ) {
+            key.mix( data[i].unicode() );
+        }
+        return key;
+    }
+
+    /// is this the null key
+    bool
+    isNull() const
+    {
+        return m_h1 == 0 && m_h2 == 0;
+    }
+
+    /// return a new key with the value added
+    CacheKey
+    with( uint64_t val ) const
+    {
+        CacheKey key = * this;
+        if ( key.isNull() ) {
+            key.m_h1 = Seed1;
+            key.m_h2 = Seed2;
+        }
+        key.mix( val );
+        return key;
+    }
+
+    CacheKey
+    with( int64_t val ) const
+    {
+        return with( uint64_t( val ) );
+    }
+
+    CacheKey
+    with( int val ) const
+    {
+        return with( uint64_t( int64_t( val ) ) );
+    }
+
+    CacheKey
+    with( bool val ) const
+    {
+        return with( uint64_t( val ) );
+    }
+
+    CacheKey
+    with( double val ) const
+    {
+        uint64_t bits;
+        std::memcpy( & bits, & val, sizeof( bits ) );
+        return with( bits );
+    }
+
+    CacheKey
+    with( const CacheKey & other ) const
+    {
+        return with( other.m_h1 ).with( other.m_h2 );
+    }
+
+    /// 64 bit hash of the key
+    uint64_t
+    hash() const
+    {
+        return m_h1 ^ ( m_h2 * 0x9e3779b97f4a7c15ULL );
+    }
+
+    bool
+    operator== ( const CacheKey & other ) const
+    {
+        return m_h1 == other.m_h1 && m_h2 == other.m_h2;
+    }
+
+    bool
+    operator!= ( const CacheKey & other ) const
+    {
+        return ! ( * this == other );
+    }
+
+    bool
+    operator< ( const CacheKey & other ) const
+    {
+        return m_h1 < other.m_h1 || ( m_h1 == other.m_h1 && m_h2 < other.m_h2 );
+    }
+
+    /// string representation (for debugging)
+    QString
+    toString() const
+    {
+        return QString( "%1%2" ).arg( m_h1, 16, 16, QChar( '0' ) ).arg( m_h2, 16, 16, QChar( '0' ) );
+    }
+
+private:
+
+    static constexpr uint64_t Seed1 = 0xcbf29ce484222325ULL;
+    static constexpr uint64_t Seed2 = 0x84222325cbf29ce4ULL;
+
+    /// add a value to both lanes, each with a different mixing function
+    void
+    mix( uint64_t val )
+    {
+        // FNV-1a on whole words, followed by an xorshift to spread the high bits
+        m_h1 = ( m_h1 ^ val ) * 0x100000001b3ULL;
+        m_h1 ^= m_h1 >> 29;
+
+        // splitmix64 step
+        uint64_t z = m_h2 + val + 0x9e3779b97f4a7c15ULL;
+        z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+        z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+        m_h2 = z ^ ( z >> 31 );
+    }
+
+    uint64_t m_h1 = 0, m_h2 = 0;
+};
+
+/// hash function for QHash
+inline uint
+qHash( const CacheKey & key, uint seed = 0 )
+{
+    uint64_t h = key.hash();
+    return uint( h ^ ( h >> 32 ) ) ^ seed;
+}
+}
+}
@@ -0,0 +1,246 @@
+/**
+ *
+ **/
+
+#include "CacheManager.h"
+#include "MainConfig.h"
+#include <QDebug>
+#include <QMutexLocker>
+
+namespace Carta
+{
+namespace Core
+{
+/// defaults, in megabytes
+static constexpr int64_t DefaultBudgetMb = 2048;
+static constexpr int64_t DefaultFrameBudgetMb = 1024;
+static constexpr int64_t DefaultIndexBudgetMb = 256;
+static constexpr int64_t DefaultPyramidBudgetMb = 256;
+static constexpr int64_t DefaultLutBudgetMb = 32;
+static constexpr int64_t DefaultTileBudgetMb = 512;
+static constexpr int64_t DefaultStatisticsBudgetMb = 64;
+static constexpr int64_t DefaultDistributionBudgetMb = 128;
+
+static constexpr int64_t MB = 1024 * 1024;
+
+CacheManager &
+CacheManager::instance()
+{
+    static CacheManager manager;
+    return manager;
+}
+
+CacheManager::CacheManager()
+{
+    m_budget = DefaultBudgetMb * MB;
+    setCategoryBudget( "frame", DefaultFrameBudgetMb * MB );
+    setCategoryBudget( "index", DefaultIndexBudgetMb * MB );
+    setCategoryBudget( "pyramid", DefaultPyramidBudgetMb * MB );
+    setCategoryBudget( "lut", DefaultLutBudgetMb * MB );
+    setCategoryBudget( "tile", DefaultTileBudgetMb * MB );
+    setCategoryBudget( "statistics", DefaultStatisticsBudgetMb * MB );
+    setCategoryBudget( "distribution", DefaultDistributionBudgetMb * MB );
+}
+
+void
+CacheManager::setBudget( int64_t bytes )
+{
+    QMutexLocker locker( & m_mutex );
+    m_budget = std::max < int64_t > ( 0, bytes );
+    evict( QString() );
+}
+
+int64_t
+CacheManager::budget() const
+{
+    QMutexLocker locker( & m_mutex );
+    return m_budget;
+}
+
+void
+CacheManager::setCategoryBudget( const QString & category, int64_t bytes )
+{
+    QMutexLocker locker( & m_mutex );
+    Statistics & stats = m_stats[category];
+    stats.category = category;
+    stats.budget = std::max < int64_t > ( - 1, bytes );
+    evict( category );
+}
+
+int64_t
+CacheManager::categoryBudget( const QString & category ) const
+{
+    QMutexLocker locker( & m_mutex );
+    auto iter = m_stats.find( category );
+    return iter == m_stats.end() ? - 1 : iter-> second.budget;
+}
+
+int64_t
+CacheManager::totalBytes() const
+{
+    QMutexLocker locker( & m_mutex );
+    return m_totalBytes;
+}
+
+std::vector < CacheManager::Statistics >
+CacheManager::statistics() const
+{
+    QMutexLocker locker( & m_mutex );
+    std::vector < Statistics > result;
+    for ( auto & entry : m_stats ) {
+        result.push_back( entry.second );
+    }
+    return result;
+}
+
+void
+CacheManager::configure( const MainConfig::ParsedInfo & config )
+{
+    if ( config.getCacheSizeMb() >= 0 ) {
+        setBudget( config.getCacheSizeMb() * MB );
+    }
+    if ( config.getFrameCacheSizeMb() >= 0 ) {
+        setCategoryBudget( "frame", config.getFrameCacheSizeMb() * MB );
+    }
+    if ( config.getIndexCacheSizeMb() >= 0 ) {
+        setCategoryBudget( "index", config.getIndexCacheSizeMb() * MB );
+    }
+    if ( config.getPyramidCacheSizeMb() >= 0 ) {
+        setCategoryBudget( "pyramid", config.getPyramidCacheSizeMb() * MB );
+    }
+    if ( config.getTileCacheSizeMb() >= 0 ) {
+        setCategoryBudget( "tile", config.getTileCacheSizeMb() * MB );
+    }
+    if ( config.getStatisticsCacheSizeMb() >= 0 ) {
+        setCategoryBudget( "statistics", config.getStatisticsCacheSizeMb() * MB );
+    }
+    if ( config.getDistributionCacheSizeMb() >= 0 ) {
+        setCategoryBudget( "distribution", config.getDistributionCacheSizeMb() * MB );
+    }
+    qDebug() << "Cache budget:" << budget() / MB << "MB";
+}
+
+int64_t
+CacheManager::newOwnerId()
+{
+    QMutexLocker locker( & m_mutex );
+    return ++m_lastOwnerId;
+}
+
+std::shared_ptr < void >
+CacheManager::find( int64_t owner, const QString & category, const CacheKey & key, bool take )
+{
+    QMutexLocker locker( & m_mutex );
+    Statistics & stats = m_stats[category];
+    stats.category = category;
+    auto indexIter = m_index.find( fullKey( owner, key ) );
+    if ( indexIter == m_index.end() ) {
+        stats.misses++;
+        return nullptr;
+    }
+    stats.hits++;
+    EntryList::iterator iter = indexIter.value();
+    std::shared_ptr < void > result = iter-> object;
+    if ( take ) {
+        erase( iter );
+    }
+    else {
+        // move to the front of the LRU list
+        m_entries.splice( m_entries.begin(), m_entries, iter );
+    }
+    return result;
+} // find
+
+void
+CacheManager::insert( int64_t owner, const QString & category, const CacheKey & key,
+                      std::shared_ptr < void > object, int64_t bytes )
+{
+    QMutexLocker locker( & m_mutex );
+    CacheKey k = fullKey( owner, key );
+    auto indexIter = m_index.find( k );
+    if ( indexIter != m_index.end() ) {
+        erase( indexIter.value() );
+    }
+
+    Statistics & stats = m_stats[category];
+    stats.category = category;
+
+    // entries that could never fit are not inserted at all
+    if ( ( stats.budget >= 0 && bytes > stats.budget ) || bytes > m_budget ) {
+        return;
+    }
+
+    m_entries.push_front( Entry { owner, key, category, object, bytes }
+                          );
+    m_index.insert( k, m_entries.begin() );
+    stats.bytes += bytes;
+    stats.entries++;
+    m_totalBytes += bytes;
+    evict( category );
+} // insert
+
+void
+CacheManager::remove( int64_t owner, const CacheKey & key )
+{
+    QMutexLocker locker( & m_mutex );
+    auto indexIter = m_index.find( fullKey( owner, key ) );
+    if ( indexIter != m_index.end() ) {
+        erase( indexIter.value() );
+    }
+}
+
+void
+CacheManager::removeOwner( int64_t owner )
+{
+    QMutexLocker locker( & m_mutex );
+    for ( auto iter = m_entries.begin() ; iter != m_entries.end() ; ) {
+        auto next = std::next( iter );
+        if ( iter-> owner == owner ) {
+            erase( iter );
+        }
+        iter = next;
+    }
+}
+
+CacheKey
+CacheManager::fullKey( int64_t owner, const CacheKey & key )
+{
+    return key.with( owner );
+}
+
+void
+CacheManager::erase( EntryList::iterator iter )
+{
+    Statistics & stats = m_stats[iter-> category];
+    stats.bytes -= iter-> bytes;
+    stats.entries--;
+    m_totalBytes -= iter-> bytes;
+    m_index.remove( fullKey( iter-> owner, iter-> key ) );
+    m_entries.erase( iter );
+}
+
+void
+CacheManager::evict( const QString & category )
+{
+    // first enforce the budget of the category, then the process-wide budget
+    auto catIter = m_stats.find( category );
+    if ( catIter != m_stats.end() && catIter-> second.budget >= 0 ) {
+        Statistics & stats = catIter-> second;
+        for ( auto iter = m_entries.end() ;
+              stats.bytes > stats.budget && iter != m_entries.begin() ; ) {
+            --iter;
+            if ( iter-> category == category ) {
+                auto toErase = iter++;
+                stats.evictions++;
+                erase( toErase );
+            }
+        }
+    }
+    while ( m_totalBytes > m_budget && ! m_entries.empty() ) {
+        auto iter = std::prev( m_entries.end() );
+        m_stats[iter-> category].evictions++;
+        erase( iter );
+    }
+} // evict
+}
+}
@@ -0,0 +1,239 @@
+/**
+ * Process-wide memory budget for the caches of the rendering services.
+ *
+ * Every DataSource (and ImageSaveService) owns its own render service, and each
+ * service used to have its own caches with their own limits, so the memory used
+ * grew with the number of open sessions. Instead, all the entries now live in the
+ * CacheManager, which keeps them in a single LRU list and evicts the least recently
+ * used ones when either the budget of their category (e.g. "frame", "index", "tile") or the
+ * process-wide budget is exceeded.
+ *
+ * Services access the manager through ManagedCache, which looks like a small QCache
+ * and keeps the entries of different owners apart.
+ *
+ * For sizing, the manager keeps hits, misses, evictions and bytes per category, see
+ * statistics(). The budgets come from the main config file, see configure().
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CacheKey.h"
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <list>
+#include <map>
+#include <memory>
+
+namespace MainConfig
+{
+class ParsedInfo;
+}
+
+namespace Carta
+{
+namespace Core
+{
+class CacheManager
+{
+    CLASS_BOILERPLATE( CacheManager );
+
+public:
+
+    /// counters of a single category
+    struct Statistics {
+        QString category;
+
+        /// how many bytes can this category use, -1 means no limit of its own
+        int64_t budget = - 1;
+
+        /// how many bytes are used right now
+        int64_t bytes = 0;
+
+        /// how many entries are there right now
+        int64_t entries = 0;
+
+        int64_t hits = 0;
+        int64_t misses = 0;
+        int64_t evictions = 0;
+    };
+
+    /// the process-wide instance
+    static CacheManager &
+    instance();
+
+    CacheManager();
+
+    /// set the process-wide budget (in bytes)
+    void
+    setBudget( int64_t bytes );
+
+    /// get the process-wide budget (in bytes)
+    int64_t
+    budget() const;
+
+    /// set the budget of a category (in bytes), -1 means only the process-wide budget
+    /// applies, 0 disables the category
+    void
+    setCategoryBudget( const QString & category, int64_t bytes );
+
+    /// get the budget of a category (in bytes)
+    int64_t
+    categoryBudget( const QString & category ) const;
+
+    /// how many bytes are used by all categories together
+    int64_t
+    totalBytes() const;
+
+    /// counters for all categories seen so far
+    std::vector < Statistics >
+    statistics() const;
+
+    /// set the budgets from the main config file, any settings not specified
+    /// there are left at their defaults
+    void
+    configure( const MainConfig::ParsedInfo & config );
+
+    /// \name low level API used by ManagedCache
+    ///@{
+
+    /// return an id not used by any other owner
+    int64_t
+    newOwnerId();
+
+    /// find an entry, optionally removing it from the cache
+    std::shared_ptr < void >
+    find( int64_t owner, const QString & category, const CacheKey & key, bool take );
+
+    /// insert an entry, replacing any previous entry with the same key
+    void
+    insert( int64_t owner, const QString & category, const CacheKey & key,
+            std::shared_ptr < void > object, int64_t bytes );
+
+    /// remove an entry
+    void
+    remove( int64_t owner, const CacheKey & key );
+
+    /// remove all entries of an owner
+    void
+    removeOwner( int64_t owner );
+
+    ///@}
+
+private:
+
+    struct Entry {
+        int64_t owner;
+        CacheKey key;
+        QString category;
+        std::shared_ptr < void > object;
+        int64_t bytes;
+    };
+
+    typedef std::list < Entry > EntryList;
+
+    /// key for the index
+    static CacheKey
+    fullKey( int64_t owner, const CacheKey & key );
+
+    /// remove an entry from the list and update counters (caller must hold the mutex)
+    void
+    erase( EntryList::iterator iter );
+
+    /// evict entries until the budgets are satisfied (caller must hold the mutex)
+    void
+    evict( const QString & category );
+
+    mutable QMutex m_mutex;
+
+    /// entries, most recently used first
+    EntryList m_entries;
+    QHash < CacheKey, EntryList::iterator > m_index;
+
+    std::map < QString, Statistics > m_stats;
+    int64_t m_budget;
+    int64_t m_totalBytes = 0;
+    int64_t m_lastOwnerId = 0;
+};
+
+/// QCache-like view of the entries of a single owner and category in the CacheManager
+/// entries are removed when the ManagedCache is destroyed
+template < typename T >
+class ManagedCache
+{
+public:
+
+    typedef std::shared_ptr < T > Pointer;
+
+    /// \param category category of the entries, used for budgets and statistics
+    /// \param manager the manager to use
+    ManagedCache( const QString & category, CacheManager & manager = CacheManager::instance() )
+        : m_manager( manager )
+          , m_category( category )
+    {
+        m_owner = m_manager.newOwnerId();
+    }
+
+    ManagedCache( const ManagedCache & ) = delete;
+
+    ManagedCache &
+    operator= ( const ManagedCache & ) = delete;
+
+    ~ManagedCache()
+    {
+        clear();
+    }
+
+    /// find an entry, nullptr if it's not in the cache
+    Pointer
+    object( const CacheKey & key )
+    {
+        return std::static_pointer_cast < T > ( m_manager.find( m_owner, m_category, key, false ) );
+    }
+
+    /// find an entry and remove it from the cache
+    Pointer
+    take( const CacheKey & key )
+    {
+        return std::static_pointer_cast < T > ( m_manager.find( m_owner, m_category, key, true ) );
+    }
+
+    /// insert an entry
+    /// \param bytes how much memory the entry occupies
+    void
+    insert( const CacheKey & key, Pointer object, int64_t bytes )
+    {
+        m_manager.insert( m_owner, m_category, key, object, bytes );
+    }
+
+    /// remove an entry
+    void
+    remove( const CacheKey & key )
+    {
+        m_manager.remove( m_owner, key );
+    }
+
+    /// remove all entries
+    void
+    clear()
+    {
+        m_manager.removeOwner( m_owner );
+    }
+
+    /// is the category enabled (i.e. its budget is not 0)
+    bool
+    enabled() const
+    {
+        return m_manager.categoryBudget( m_category ) != 0;
+    }
+
+private:
+
+    CacheManager & m_manager;
+    QString m_category;
+    int64_t m_owner;
+};
+}
+}
@@ -23,6 +23,7 @@
 #include <QtCore/QDebug>
 #include <QtCore/QList>
 #include <QtCore/QDir>
+#include <QtConcurrent>
 #include <memory>
 #include <set>
 
@@ -54,6 +55,15 @@ const QString Controller::POINTER_MOVE = "pointer-move";
 const QString Controller::ZOOM = "zoom";
 const QString Controller::REGIONS = "regions";
 const QString Controller::PLUGIN_NAME = "CasaImageLoader";
+const QString Controller::LOAD_PROGRESS = "loadProgress";
+const QString Controller::LOAD_FILE = "file";
+const QString Controller::LOAD_STATUS = "status";
+const QString Controller::LOAD_FRACTION = "progress";
+const QString Controller::LOAD_OPENING = "opening";
+const QString Controller::LOAD_RENDERING = "rendering";
+const QString Controller::LOAD_DONE = "done";
+const QString Controller::LOAD_FAILED = "failed";
+const QString Controller::LOAD_CANCELLED = "cancelled";
 
 const QString Controller::CLASS_NAME = "Controller";
 bool Controller::m_registered =
@@ -75,6 +85,7 @@ Controller::Controller( const QString& path, const QString& id ) :
     
     m_reloadFrameQueued = false;
     m_repaintFrameQueued = false;
+    m_loadRendering = false;
 
     _initializeSelections();
 
@@ -82,6 +93,7 @@ Controller::Controller( const QString& path, const QString& id ) :
      registerView(m_view.get());
 
      connect( m_view.get(), SIGNAL(resize(const QSize&)), this, SLOT(_viewResize(const QSize&)));
+     connect( &m_loadWatcher, SIGNAL(finished()), this, SLOT(_loadFinished()));
 
      Carta::State::ObjectManager* objMan = Carta::State::ObjectManager::objectManager();
      GridControls* gridObj = objMan->createObject<GridControls>();
@@ -109,60 +121,141 @@ Controller::Controller( const QString& path, const QString& id ) :
 
 bool Controller::addData(const QString& fileName) {
     //Find the location of the data, if it already exists.
-    int targetIndex = -1;
-    for (int i = 0; i < m_datas.size(); i++) {
-        if (m_datas[i]->_contains(fileName)) {
-            targetIndex = i;
-            break;
-        }
-    }
+    int targetIndex = _findData( fileName );
 
     //Add the data if it is not already there.
     if (targetIndex == -1) {
-
-        Carta::State::ObjectManager* objMan = Carta::State::ObjectManager::objectManager();
-        ControllerData* targetSource = objMan->createObject<ControllerData>();
-        DataContours* contourObj = objMan->createObject<DataContours>();
-        std::shared_ptr<DataContours> contourPtr( contourObj );
-        //Controller Data is in charge of drawing the contours.
-        targetSource->_setContours( contourPtr );
-        //Contour controls is in charge of setting the UI for the contours.
-        m_contourControls->_setDrawContours( contourPtr );
-        targetIndex = m_datas.size();
-        connect( targetSource, SIGNAL(renderingDone(QImage)), this, SLOT(_renderingDone(QImage)));
-        connect( targetSource, & ControllerData::saveImageResult, this, & Controller::saveImageResultCB );
-        m_datas.append(std::shared_ptr<ControllerData>(targetSource));
-        targetSource->_viewResize( m_viewSize );
-
-        //Update the data selectors upper bound based on the data.
-        m_selectImage->setUpperBound(m_datas.size());
+        targetIndex = _makeData();
     }
 
     bool successfulLoad = m_datas[targetIndex]->_setFileName(fileName );
     if ( successfulLoad ){
-        int selectCount = m_selects.size();
-        for ( int i = 0; i < selectCount; i++ ){
-            AxisInfo::KnownType type = static_cast<AxisInfo::KnownType>(i);
-            int frameCount = m_datas[targetIndex]->_getFrameCount( type );
-            m_selects[i]->setUpperBound( frameCount );
-        }
-        m_selectImage->setIndex(targetIndex);
+        _dataLoaded( targetIndex );
+    }
+    else {
+        QString error = "Unable to load image: "+fileName+".  Please check the file is a supported image format.";
+        Util::commandPostProcess( error );
+        _removeData( targetIndex );
+    }
+    return successfulLoad;
+}
 
-        saveState();
+void Controller::addDataAsync( const QString& fileName ){
+    //Data that is already there does not need to be opened again.
+    if ( _findData( fileName ) >= 0 ){
+        addData( fileName );
+        return;
+    }
+    if ( m_loadWatcher.isRunning() && !m_loadWatcher.isCanceled() && fileName == m_loadFile ){
+        return;
+    }
 
-        //Refresh the view of the data.
-        _scheduleFrameReload();
+    //A previous load that has not finished is abandoned.
+    m_loadWatcher.cancel();
+    m_loadFile = fileName;
+    m_loadRendering = false;
+    _setLoadProgress( LOAD_OPENING, 0 );
+    m_loadWatcher.setFuture( QtConcurrent::run( &DataSource::loadImage, fileName ) );
+}
 
-        //Notify others there has been a change to the data.
-        emit dataChanged( this );
-        _updateDisplayAxes( targetIndex );
+QString Controller::cancelLoad(){
+    QString result;
+    if ( m_loadWatcher.isRunning() && !m_loadWatcher.isCanceled() ){
+        //The plugins cannot be interrupted while they open the image, so the
+        //result is just ignored when it arrives.
+        m_loadWatcher.cancel();
+        _setLoadProgress( LOAD_CANCELLED, 0 );
     }
     else {
-        QString error = "Unable to load image: "+fileName+".  Please check the file is a supported image format.";
+        result = "There is no image being loaded.";
+    }
+    return result;
+}
+
+void Controller::_loadFinished(){
+    if ( m_loadWatcher.isCanceled() ){
+        return;
+    }
+    std::shared_ptr<Image::ImageInterface> image = m_loadWatcher.result();
+    if ( !image ){
+        _setLoadProgress( LOAD_FAILED, 0 );
+        QString error = "Unable to load image: "+m_loadFile+".  Please check the file is a supported image format.";
         Util::commandPostProcess( error );
+        return;
+    }
+
+    //The dimensions and meta data are available, so the image can be added
+    //and its first plane rendered.
+    int targetIndex = _findData( m_loadFile );
+    if ( targetIndex == -1 ){
+        targetIndex = _makeData();
+    }
+    if ( m_datas[targetIndex]->_setImage( m_loadFile, image ) ){
+        m_loadRendering = true;
+        _setLoadProgress( LOAD_RENDERING, 0.5 );
+        _dataLoaded( targetIndex );
+    }
+    else {
+        _setLoadProgress( LOAD_FAILED, 0 );
         _removeData( targetIndex );
     }
-    return successfulLoad;
+}
+
+int Controller::_findData( const QString& fileName ) const {
+    int targetIndex = -1;
+    for (int i = 0; i < m_datas.size(); i++) {
+        if (m_datas[i]->_contains(fileName)) {
+            targetIndex = i;
+            break;
+        }
+    }
+    return targetIndex;
+}
+
+int Controller::_makeData(){
+    Carta::State::ObjectManager* objMan = Carta::State::ObjectManager::objectManager();
+    ControllerData* targetSource = objMan->createObject<ControllerData>();
+    DataContours* contourObj = objMan->createObject<DataContours>();
+    std::shared_ptr<DataContours> contourPtr( contourObj );
+    //Controller Data is in charge of drawing the contours.
+    targetSource->_setContours( contourPtr );
+    //Contour controls is in charge of setting the UI for the contours.
+    m_contourControls->_setDrawContours( contourPtr );
+    int targetIndex = m_datas.size();
+    connect( targetSource, SIGNAL(renderingDone(QImage)), this, SLOT(_renderingDone(QImage)));
+    connect( targetSource, & ControllerData::saveImageResult, this, & Controller::saveImageResultCB );
+    m_datas.append(std::shared_ptr<ControllerData>(targetSource));
+    targetSource->_viewResize( m_viewSize );
+
+    //Update the data selectors upper bound based on the data.
+    m_selectImage->setUpperBound(m_datas.size());
+    return targetIndex;
+}
+
+void Controller::_dataLoaded( int targetIndex ){
+    int selectCount = m_selects.size();
+    for ( int i = 0; i < selectCount; i++ ){
+        AxisInfo::KnownType type = static_cast<AxisInfo::KnownType>(i);
+        int frameCount = m_datas[targetIndex]->_getFrameCount( type );
+        m_selects[i]->setUpperBound( frameCount );
+    }
+    m_selectImage->setIndex(targetIndex);
+
+    saveState();
+
+    //Refresh the view of the data.
+    _scheduleFrameReload();
+
+    //Notify others there has been a change to the data.
+    emit dataChanged( this );
+    _updateDisplayAxes( targetIndex );
+}
+
+void Controller::_setLoadProgress( const QString& status, double progress ){
+    m_stateData.setValue<QString>( UtilState::getLookup( LOAD_PROGRESS, LOAD_FILE ), m_loadFile );
+    m_stateData.setValue<QString>( UtilState::getLookup( LOAD_PROGRESS, LOAD_STATUS ), status );
+    m_stateData.setValue<double>( UtilState::getLookup( LOAD_PROGRESS, LOAD_FRACTION ), progress );
+    m_stateData.flushState();
 }
 
 
@@ -649,6 +742,12 @@ void Controller::_initializeCallbacks(){
                 return result;
             });
 
+    addCommandCallback( "cancelLoad", [=] (const QString & /*cmd*/,
+                    const QString & /*params*/, const QString & /*sessionId*/) ->QString {
+        QString result = cancelLoad();
+        return result;
+    });
+
     addCommandCallback( CENTER, [=] (const QString & /*cmd*/,
                 const QString & params, const QString & /*sessionId*/) ->QString {
             auto vals = Util::string2VectorDouble( params );
@@ -774,6 +873,12 @@ void Controller::_initializeState(){
     //Now the data state.
     m_stateData.insertArray(DATA, 0 );
 
+    //Progress of loading an image in the background.
+    m_stateData.insertObject( LOAD_PROGRESS );
+    m_stateData.insertValue<QString>( UtilState::getLookup( LOAD_PROGRESS, LOAD_FILE ), "" );
+    m_stateData.insertValue<QString>( UtilState::getLookup( LOAD_PROGRESS, LOAD_STATUS ), "" );
+    m_stateData.insertValue<double>( UtilState::getLookup( LOAD_PROGRESS, LOAD_FRACTION ), 0 );
+
     //For testing only.
     //_makeRegion( RegionRectangle::CLASS_NAME );
     int regionCount = m_regions.size();
@@ -891,6 +996,11 @@ void Controller::_render(){
 }
 
 void Controller::_renderingDone( QImage img){
+    //The first plane of an image loaded in the background is on its way to the clients.
+    if ( m_loadRendering ){
+        m_loadRendering = false;
+        _setLoadProgress( LOAD_DONE, 1 );
+    }
     _scheduleFrameRepaint( img );
 }
 
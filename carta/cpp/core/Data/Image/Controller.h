@@ -15,6 +15,7 @@
 #include <QList>
 #include <QObject>
 #include <QImage>
+#include <QFutureWatcher>
 
 #include <set>
 
@@ -66,6 +67,22 @@ public:
      */
     bool addData(const QString& fileName);
 
+    /**
+     * Start loading data into this controller without waiting for it.
+     * The image is opened in the background. It is added to the controller as soon as
+     * its dimensions and meta data are available, and its first plane is rendered right
+     * after that. The progress is reported in the loadProgress field of the data state.
+     * @param fileName the location of the data;
+     *        this could represent a url or an absolute path on a local filesystem.
+     */
+    void addDataAsync( const QString& fileName );
+
+    /**
+     * Abandon the image that is being loaded in the background, if any.
+     * @return an error message if no image was being loaded; an empty string otherwise.
+     */
+    QString cancelLoad();
+
     /**
      * Apply the indicated clips to managed images.
      * @param minIntensityPercentile the minimum clip percentile [0,1].
@@ -376,6 +393,7 @@ public:
 
     static const QString CLASS_NAME;
     static const QString CURSOR;
+    static const QString LOAD_PROGRESS;
     static const QString PLUGIN_NAME;
 
 signals:
@@ -427,6 +445,11 @@ private slots:
     //The parameter newClips is set if the clip values have changed and need to be recomputed.
     void _loadView( bool newClips = false );
 
+    /**
+     * An image opened by addDataAsync() is available.
+     */
+    void _loadFinished();
+
     /**
      * The rendering service has finished and produced a new QImage for display.
      */
@@ -470,6 +493,19 @@ private:
     void _initializeSelections();
 
     void _clearData();
+
+    //Returns the index of the data with the given file name or -1 if there is no such data.
+    int _findData( const QString& fileName ) const;
+
+    //Make a new data source and return its index.
+    int _makeData();
+
+    //Update the selections and view after data was loaded into the indicated data source.
+    void _dataLoaded( int targetIndex );
+
+    //Report the progress of loading an image in the background.
+    void _setLoadProgress( const QString& status, double progress );
+
     QString _makeRegion( const QString& regionType );
     void _removeData( int index );
     void _render();
@@ -501,6 +537,14 @@ private:
     static const QString CENTER;
     static const QString POINTER_MOVE;
     static const QString ZOOM;
+    static const QString LOAD_FILE;
+    static const QString LOAD_STATUS;
+    static const QString LOAD_FRACTION;
+    static const QString LOAD_OPENING;
+    static const QString LOAD_RENDERING;
+    static const QString LOAD_DONE;
+    static const QString LOAD_FAILED;
+    static const QString LOAD_CANCELLED;
 
     //Data Selections
     Selection* m_selectImage;
@@ -534,6 +578,12 @@ private:
     bool m_reloadFrameQueued;
     bool m_repaintFrameQueued;
 
+    //Image being opened in the background by addDataAsync().
+    QFutureWatcher<std::shared_ptr<Image::ImageInterface> > m_loadWatcher;
+    QString m_loadFile;
+    //Set while waiting for the first plane of a newly loaded image.
+    bool m_loadRendering;
+
     Controller(const Controller& other);
     Controller& operator=(const Controller& other);
 
@@ -479,7 +479,7 @@ QString ControllerData::_saveImage( const QString& saveName, double scale,
 
         std::shared_ptr<NdArray::RawViewInterface> view( m_dataSource->_getRawData( frames ));
         if ( view != nullptr ){
-            QString viewId = m_dataSource->_getViewIdCurrent( frames );
+            Carta::Core::CacheKey viewId = m_dataSource->_getViewIdCurrent( frames );
             m_saveService->setInputView( view, viewId );
             PreferencesSave* prefSave = Util::findSingletonObject<PreferencesSave>();
             int width = prefSave->getWidth();
@@ -537,6 +537,14 @@ bool ControllerData::_setFileName( const QString& fileName ){
     return successfulLoad;
 }
 
+bool ControllerData::_setImage( const QString& fileName, std::shared_ptr<Image::ImageInterface> image ){
+    bool successfulLoad = m_dataSource->_setImage( fileName, image );
+    if ( successfulLoad ){
+        m_state.setValue<QString>(DataSource::DATA_PATH, fileName);
+    }
+    return successfulLoad;
+}
+
 void ControllerData::setColorMap( const QString& name ){
     if ( m_dataSource ){
         m_dataSource->setColorMap( name );
@@ -369,6 +369,14 @@ private:
      */
     bool _setFileName( const QString& fileName );
 
+    /**
+     * Start displaying an image that was opened in the background.
+     * @param fileName the location the image was loaded from.
+     * @param image the image that was loaded.
+     * @return true if the image was valid; false otherwise.
+     */
+    bool _setImage( const QString& fileName, std::shared_ptr<Image::ImageInterface> image );
+
 
     /**
      * Set the data transform.
@@ -3,6 +3,8 @@
 #include "Data/Colormap/Colormaps.h"
 #include "Globals.h"
 #include "PluginManager.h"
+#include "ImageRegistry.h"
+#include "StatisticsIndex.h"
 #include "GrayColormap.h"
 #include "CartaLib/IImage.h"
 #include "Data/Util.h"
@@ -16,6 +18,10 @@
 using Carta::Lib::AxisInfo;
 using Carta::Lib::AxisDisplayInfo;
 
+/// Percentile lookups refine bins holding more than this fraction of the values, so
+/// skewed data (where a few bins hold most of the values) is still answered precisely.
+static constexpr double PERCENTILE_RANK_ERROR = 0.001;
+
 namespace Carta {
 
 namespace Data {
@@ -27,6 +33,7 @@ const double DataSource::ZOOM_DEFAULT = 1.0;
 CoordinateSystems* DataSource::m_coords = nullptr;
 
 DataSource::DataSource() :
+    m_distributions( "distribution" ),
     m_image( nullptr ),
     m_permuteImage( nullptr),
     m_axisIndexX( 0 ),
@@ -39,6 +46,8 @@ DataSource::DataSource() :
 
         //Initialize the rendering service
         m_renderService.reset( new Carta::Core::ImageRenderService::Service() );
+        // only colormap the part of the image that is on screen
+        m_renderService-> setRenderMode( Carta::Core::ImageRenderService::RenderMode::Viewport );
 
         // assign a default colormap to the view
         auto rawCmap = std::make_shared < Carta::Core::GrayColormap > ();
@@ -267,11 +276,30 @@ QString DataSource::_getPixelValue( double x, double y, const std::vector<int>&
     QString pixelValue = "";
     int valX = (int)(round(x));
     int valY = (int)(round(y));
-    if ( valX >= 0 && valX < m_image->dims()[m_axisIndexX] && valY >= 0 && valY < m_image->dims()[m_axisIndexY] ) {
-        NdArray::RawViewInterface* rawData = _getRawData( frames );
-        if ( rawData != nullptr ){
-            NdArray::TypedView<double> view( rawData, false );
-            double val =  view.get( { valX, valY } );
+    if ( m_permuteImage ){
+        //Since the image has been permuted the first two indices represent
+        //the display axes, the rest are the current frames.
+        int imageDim = m_permuteImage->dims().size();
+        m_cursorPos.resize( imageDim );
+        for ( int i = 0; i < imageDim; i++ ){
+            if ( i == 0 ){
+                m_cursorPos[i] = valX;
+            }
+            else if ( i == 1 ){
+                m_cursorPos[i] = valY;
+            }
+            else {
+                //The frame axes were looked up when the display axes were set.
+                int frameIndex = 0;
+                const std::pair<int,int>& frameAxis = m_cursorFrameAxes[i];
+                if ( frameAxis.second > 0 ){
+                    frameIndex = Carta::Lib::clamp( frames[frameAxis.first], 0, frameAxis.second - 1 );
+                }
+                m_cursorPos[i] = frameIndex;
+            }
+        }
+        double val = 0;
+        if ( m_cursorRows.value( m_permuteImage.get(), m_cursorPos, val ) ){
             pixelValue = QString::number( val );
         }
     }
@@ -337,6 +365,30 @@ QString DataSource::_getFileName() const {
     return m_fileName;
 }
 
+Carta::Core::Algorithms::CumulativeDistribution::SharedPtr DataSource::_getDistribution(
+        int frameLow, int frameHigh, Carta::Core::CacheKey* key ) const {
+    Carta::Core::Algorithms::CumulativeDistribution::SharedPtr distribution;
+    if ( m_image ){
+        //The raw data of the frame range is the whole image if the range is not valid.
+        int spectralIndex = _getAxisIndex( AxisInfo::KnownType::SPECTRAL );
+        int frameCount = spectralIndex >= 0 ? m_image->dims()[spectralIndex] : 1;
+        if ( frameLow < 0 || frameLow >= frameCount || frameHigh < 0 || frameHigh >= frameCount ){
+            frameLow = -1;
+            frameHigh = -1;
+        }
+        *key = m_distributionKey.with( m_axisIndexX ).with( m_axisIndexY ).with( frameLow ).with( frameHigh );
+        distribution = m_distributions.object( *key );
+        if ( !distribution ){
+            std::unique_ptr<NdArray::RawViewInterface> rawData( _getRawData( frameLow, frameHigh, spectralIndex ) );
+            if ( rawData != nullptr ){
+                distribution = Carta::Core::Algorithms::CumulativeDistribution::compute( rawData.get() );
+                m_distributions.insert( *key, distribution, distribution->bytes() );
+            }
+        }
+    }
+    return distribution;
+}
+
 std::shared_ptr<Image::ImageInterface> DataSource::_getImage(){
     return m_image;
 }
@@ -353,56 +405,46 @@ std::shared_ptr<Carta::Core::ImageRenderService::Service> DataSource::_getRender
 
 bool DataSource::_getIntensity( int frameLow, int frameHigh, double percentile, double* intensity ) const {
     bool intensityFound = false;
-    int spectralIndex = _getAxisIndex( AxisInfo::KnownType::SPECTRAL );
-    NdArray::RawViewInterface* rawData = _getRawData( frameLow, frameHigh, spectralIndex );
-    if ( rawData != nullptr ){
-        NdArray::TypedView<double> view( rawData, false );
-        // read in all values from the view into an array
-        // we need our own copy because we'll do quickselect on it...
-        std::vector < double > allValues;
-        view.forEach( [& allValues] ( const double  val ) {
-            if ( std::isfinite( val ) ) {
-                allValues.push_back( val );
-            }
-        }
-        );
-
-        // indicate bad clip if no finite numbers were found
-        if ( allValues.size() > 0 ) {
-            int locationIndex = allValues.size() * percentile - 1;
-            if ( locationIndex < 0 ){
-                locationIndex = 0;
-            }
-            std::nth_element( allValues.begin(), allValues.begin()+locationIndex, allValues.end() );
-            *intensity = allValues[locationIndex];
-            intensityFound = true;
+    double quantile = Carta::Lib::clamp( percentile, 0.0, 1.0 );
+    double value = std::numeric_limits<double>::quiet_NaN();
+    Carta::Core::Algorithms::PlaneStatistics::SharedPtr stats = _getPlaneStatistics( frameLow, frameHigh );
+    if ( stats && Carta::Core::Algorithms::PlaneStatistics::isSketchQuantile( quantile ) ){
+        value = stats->quantile( quantile );
+    }
+    else {
+        //The distribution is refined down to the exact value, refined bins are kept
+        //so this only reads the data the first time.
+        Carta::Core::CacheKey key;
+        Carta::Core::Algorithms::CumulativeDistribution::SharedPtr distribution =
+                _getDistribution( frameLow, frameHigh, &key );
+        if ( distribution ){
+            int spectralIndex = _getAxisIndex( AxisInfo::KnownType::SPECTRAL );
+            value = distribution->quantile( quantile, 0,
+                    [this, frameLow, frameHigh, spectralIndex] () {
+                return _getRawData( frameLow, frameHigh, spectralIndex );
+            });
+            m_distributions.insert( key, distribution, distribution->bytes() );
         }
     }
+    if ( !std::isnan( value ) ){
+        *intensity = value;
+        intensityFound = true;
+    }
     return intensityFound;
 }
 
 double DataSource::_getPercentile( int frameLow, int frameHigh, double intensity ) const {
     double percentile = 0;
-    int spectralIndex = _getAxisIndex( AxisInfo::KnownType::SPECTRAL);
-    NdArray::RawViewInterface* rawData = _getRawData( frameLow, frameHigh, spectralIndex );
-    if ( rawData != nullptr ){
-        u_int64_t totalCount = 0;
-        u_int64_t countBelow = 0;
-        NdArray::TypedView<double> view( rawData, false );
-        view.forEach([&](const double& val) {
-            if( Q_UNLIKELY( std::isnan(val))){
-                return;
-            }
-            totalCount ++;
-            if( val <= intensity){
-                countBelow++;
-            }
-            return;
+    Carta::Core::CacheKey key;
+    Carta::Core::Algorithms::CumulativeDistribution::SharedPtr distribution =
+            _getDistribution( frameLow, frameHigh, &key );
+    if ( distribution ){
+        int spectralIndex = _getAxisIndex( AxisInfo::KnownType::SPECTRAL );
+        percentile = distribution->percentile( intensity, PERCENTILE_RANK_ERROR,
+                [this, frameLow, frameHigh, spectralIndex] () {
+            return _getRawData( frameLow, frameHigh, spectralIndex );
         });
-
-        if ( totalCount > 0 ){
-            percentile = double(countBelow) / totalCount;
-        }
+        m_distributions.insert( key, distribution, distribution->bytes() );
     }
     return percentile;
 }
@@ -461,8 +503,8 @@ NdArray::RawViewInterface* DataSource::_getRawData( int frameStart, int frameEnd
 }
 
 
-int DataSource::_getQuantileCacheIndex( const std::vector<int>& frames) const {
-    int cacheIndex = 0;
+int64_t DataSource::_getPlaneIndex( const std::vector<int>& frames) const {
+    int64_t planeIndex = 0;
     if ( m_image ){
         int imageSize = m_image->dims().size();
         int mult = 1;
@@ -474,13 +516,72 @@ int DataSource::_getQuantileCacheIndex( const std::vector<int>& frames) const {
                     int index = static_cast<int>( axisType );
                     frame = frames[index];
                 }
-                cacheIndex = cacheIndex + mult * frame;
+                planeIndex = planeIndex + mult * frame;
                 int frameCount = m_image->dims()[i];
                 mult = mult * frameCount;
             }
         }
     }
-    return cacheIndex;
+    return planeIndex;
+}
+
+Carta::Core::StatisticsIndex::PlaneId DataSource::_getPlaneId( const std::vector<int>& frames ) const {
+    Carta::Core::StatisticsIndex::PlaneId plane;
+    plane.axisX = m_axisIndexX;
+    plane.axisY = m_axisIndexY;
+    plane.index = _getPlaneIndex( frames );
+    return plane;
+}
+
+Carta::Core::Algorithms::PlaneStatistics::SharedPtr DataSource::_getPlaneStatistics(
+        const std::vector<int>& frames, bool computeMissing ) const {
+    Carta::Core::Algorithms::PlaneStatistics::SharedPtr stats;
+    if ( m_permuteImage && !m_statisticsKey.isEmpty() ){
+        std::vector<int> mFrames = _fitFramesToImage( frames );
+        Carta::Core::StatisticsIndex::ViewFunc makeView;
+        if ( computeMissing ){
+            //The view is made on a background thread, so it must not refer to this object.
+            std::shared_ptr<Image::ImageInterface> image = m_permuteImage;
+            SliceND slice = _getPlaneSlice( mFrames );
+            makeView = [image, slice] () { return image->getDataSlice( slice ); };
+        }
+        stats = Carta::Core::StatisticsIndex::instance().find( m_statisticsKey,
+                _getPlaneId( mFrames ), makeView );
+    }
+    return stats;
+}
+
+void DataSource::_setPlaneStatistics( const std::vector<int>& frames,
+        Carta::Core::Algorithms::PlaneStatistics::SharedPtr stats ) const {
+    if ( m_permuteImage && !m_statisticsKey.isEmpty() ){
+        std::vector<int> mFrames = _fitFramesToImage( frames );
+        Carta::Core::StatisticsIndex::instance().insert( m_statisticsKey,
+                _getPlaneId( mFrames ), stats );
+    }
+}
+
+Carta::Core::Algorithms::PlaneStatistics::SharedPtr DataSource::_getPlaneStatistics(
+        int frameLow, int frameHigh ) const {
+    Carta::Core::Algorithms::PlaneStatistics::SharedPtr stats;
+    if ( m_image ){
+        //The index only has single planes of the display axes.
+        int spectralIndex = _getAxisIndex( AxisInfo::KnownType::SPECTRAL );
+        int imageDim = m_image->dims().size();
+        for ( int i = 0; i < imageDim; i++ ){
+            if ( i != m_axisIndexX && i != m_axisIndexY ){
+                int sliceSize = m_image->dims()[i];
+                bool singleFrame = i == spectralIndex && frameLow == frameHigh &&
+                        0 <= frameLow && frameLow < sliceSize;
+                if ( sliceSize > 1 && !singleFrame ){
+                    return stats;
+                }
+            }
+        }
+        std::vector<int> frames( static_cast<int>( AxisInfo::KnownType::OTHER ), 0 );
+        frames[static_cast<int>( AxisInfo::KnownType::SPECTRAL )] = std::max( frameLow, 0 );
+        stats = _getPlaneStatistics( frames );
+    }
+    return stats;
 }
 
 std::shared_ptr<Image::ImageInterface> DataSource::_getPermutedImage() const {
@@ -506,10 +607,17 @@ std::shared_ptr<Image::ImageInterface> DataSource::_getPermutedImage() const {
 
 NdArray::RawViewInterface* DataSource::_getRawData( const std::vector<int> frames ) const {
     NdArray::RawViewInterface* rawData = nullptr;
-    std::vector<int> mFrames = _fitFramesToImage( frames );
+    if ( m_permuteImage ){
+        std::vector<int> mFrames = _fitFramesToImage( frames );
+        rawData = m_permuteImage->getDataSlice( _getPlaneSlice( mFrames ) );
+    }
+    return rawData;
+}
+
+SliceND DataSource::_getPlaneSlice( const std::vector<int>& frames ) const {
+    SliceND nextSlice = SliceND();
     if ( m_permuteImage ){
         int imageDim =m_permuteImage->dims().size();
-        SliceND nextSlice = SliceND();
         SliceND& slice = nextSlice;
         for ( int i = 0; i < imageDim; i++ ){
             //Since the image has been permuted the first two indices represent
@@ -520,7 +628,7 @@ NdArray::RawViewInterface* DataSource::_getRawData( const std::vector<int> frame
                 AxisInfo::KnownType type = _getAxisType( i );
                 if ( AxisInfo::KnownType::OTHER != type ){
                     int axisIndex = static_cast<int>( type );
-                    frameIndex = mFrames[axisIndex];
+                    frameIndex = frames[axisIndex];
                 }
                 slice.start( frameIndex );
                 slice.end( frameIndex + 1);
@@ -529,37 +637,36 @@ NdArray::RawViewInterface* DataSource::_getRawData( const std::vector<int> frame
                 slice.next();
             }
         }
-        rawData = m_permuteImage->getDataSlice( nextSlice );
     }
-    return rawData;
+    return nextSlice;
 }
 
 
-QString DataSource::_getViewIdCurrent( const std::vector<int>& frames ) const {
-   // We create an identifier consisting of the file name and -1 for the two display axes
-   // and frame indices for the other axes.
-   QString renderId = m_fileName;
+Carta::Core::CacheKey DataSource::_getViewIdCurrent( const std::vector<int>& frames ) const {
+   // We create an identifier consisting of the file name and the actual axis for the two
+   // display axes and frame indices for the other axes.
+   Carta::Core::CacheKey renderId = m_fileNameKey;
    if ( m_image ){
        int imageSize = m_image->dims().size();
        for ( int i = 0; i < imageSize; i++ ){
            AxisInfo::KnownType axisType = _getAxisType( i );
            int axisFrame = frames[static_cast<int>(axisType)];
-           QString prefix;
-           //Hidden axis identified with an "f" and the index of the frame.
+           int prefix;
+           //Hidden axis identified with a 0 and the index of the frame.
            if ( i != m_axisIndexX && i != m_axisIndexY ){
-               prefix = "h";
+               prefix = 0;
            }
-           //Display axis identified by a "d" plus the actual axis in the image.
+           //Display axis identified by 1 (x) or 2 (y) plus the actual axis in the image.
            else {
                if ( i == m_axisIndexX ){
-                   prefix = "dX";
+                   prefix = 1;
                }
                else {
-                   prefix = "dY";
+                   prefix = 2;
                }
                axisFrame = i;
            }
-           renderId = renderId + "//"+prefix + QString::number(axisFrame );
+           renderId = renderId.with( prefix ).with( axisFrame );
        }
    }
    return renderId;
@@ -604,7 +711,7 @@ void DataSource::_load(std::vector<int> frames, bool recomputeClipsOnNewFrame,
 
     m_renderService-> setPixelPipeline( m_pixelPipeline, m_pixelPipeline-> cacheId());
 
-    QString renderId = _getViewIdCurrent( mFrames );
+    Carta::Core::CacheKey renderId = _getViewIdCurrent( mFrames );
     m_renderService-> setInputView( view, renderId );
 }
 
@@ -613,6 +720,27 @@ void DataSource::_resetZoom(){
     m_renderService-> setZoom( ZOOM_DEFAULT );
 }
 
+void DataSource::_resetCursor(){
+    m_cursorRows.clear();
+
+    //The same lookups as _getFrameIndex(), once per axis instead of on every mouse move.
+    m_cursorFrameAxes.clear();
+    if ( m_permuteImage ){
+        int imageDim = m_permuteImage->dims().size();
+        m_cursorFrameAxes.resize( imageDim, std::make_pair( 0, 0 ) );
+        for ( int i = 2; i < imageDim; i++ ){
+            AxisInfo::KnownType type = _getAxisType( i );
+            if ( AxisInfo::KnownType::OTHER != type ){
+                int axisIndex = _getAxisIndex( type );
+                if ( axisIndex >= 0 ){
+                    m_cursorFrameAxes[i] = std::make_pair( static_cast<int>( type ),
+                            m_image->dims()[axisIndex] );
+                }
+            }
+        }
+    }
+}
+
 void DataSource::_resetPan(){
     if ( m_permuteImage != nullptr ){
         double xCenter =  m_permuteImage-> dims()[0] / 2.0;
@@ -623,36 +751,35 @@ void DataSource::_resetPan(){
 
 
 
+std::shared_ptr<Image::ImageInterface> DataSource::loadImage( const QString& fileName ){
+    //Images that are already open (in another view, or recently closed) are shared.
+    QString file = fileName.trimmed();
+    return Carta::Core::ImageRegistry::instance().acquire( file, [] ( const QString& name ){
+        std::shared_ptr<Image::ImageInterface> image;
+        try {
+            auto res = Globals::instance()-> pluginManager()
+                                  -> prepare <Carta::Lib::Hooks::LoadAstroImage>( name )
+                                  .first();
+            if (!res.isNull()){
+                image = res.val();
+            }
+            else {
+                qWarning( "Could not find any plugin to load image");
+            }
+        }
+        catch( std::logic_error& err ){
+            qDebug() << "Failed to load image "<<name;
+        }
+        return image;
+    });
+}
+
 bool DataSource::_setFileName( const QString& fileName ){
     QString file = fileName.trimmed();
     bool successfulLoad = true;
     if (file.length() > 0) {
         if ( file != m_fileName ){
-            try {
-                auto res = Globals::instance()-> pluginManager()
-                                      -> prepare <Carta::Lib::Hooks::LoadAstroImage>( file )
-                                      .first();
-                if (!res.isNull()){
-                    m_image = res.val();
-                    m_permuteImage = m_image;
-                    // reset zoom/pan
-                    _resetZoom();
-                    _resetPan();
-
-                    // clear quantile cache
-                    _resizeQuantileCache();
-                    m_fileName = file;
-                }
-                else {
-                    qWarning( "Could not find any plugin to load image");
-                    successfulLoad = false;
-                }
-
-            }
-            catch( std::logic_error& err ){
-                qDebug() << "Failed to load image "<<fileName;
-                successfulLoad = false;
-            }
+            successfulLoad = _setImage( file, loadImage( file ) );
         }
     }
     else {
@@ -662,17 +789,24 @@ bool DataSource::_setFileName( const QString& fileName ){
     return successfulLoad;
 }
 
-
-void DataSource::_resizeQuantileCache(){
-    m_quantileCache.resize(0);
-    int nf = 1;
-    int imageSize = m_image->dims().size();
-    for ( int i = 0; i < imageSize; i++ ){
-        if ( i != m_axisIndexX && i != m_axisIndexY ){
-            nf = nf * m_image->dims()[i];
-        }
+bool DataSource::_setImage( const QString& fileName, std::shared_ptr<Image::ImageInterface> image ){
+    if ( !image ){
+        return false;
     }
-    m_quantileCache.resize( nf);
+    m_image = image;
+    m_permuteImage = m_image;
+    _resetCursor();
+    // reset zoom/pan
+    _resetZoom();
+    _resetPan();
+
+    m_fileName = fileName.trimmed();
+    m_fileNameKey = Carta::Core::CacheKey::fromString( m_fileName );
+    m_statisticsKey = Carta::Core::ImageRegistry::key( m_fileName );
+    //Images that are not files have nothing to go stale.
+    m_distributionKey = m_statisticsKey.isEmpty() ? m_fileNameKey :
+            Carta::Core::CacheKey::fromString( m_statisticsKey );
+    return true;
 }
 
 void DataSource::setColorMap( const QString& name ){
@@ -725,8 +859,8 @@ void DataSource::_setDisplayAxes(std::vector<AxisInfo::KnownType> displayAxisTyp
     bool axisYChanged = _setDisplayAxis( displayAxisTypes[1], &m_axisIndexY );
     if ( axisXChanged || axisYChanged ){
         m_permuteImage = _getPermutedImage();
+        _resetCursor();
         _resetPan();
-        _resizeQuantileCache();
         std::vector<int> mFrames = _fitFramesToImage( frames );
         _updateRenderedView( mFrames );
     }
@@ -758,32 +892,25 @@ void DataSource::setGamma( double gamma ){
 
 void DataSource::_updateClips( std::shared_ptr<NdArray::RawViewInterface>& view,
         double minClipPercentile, double maxClipPercentile, const std::vector<int>& frames ){
-    std::vector<int> mFrames = _fitFramesToImage( frames );
-    int quantileIndex = _getQuantileCacheIndex( mFrames );
-    std::vector<double> clips = m_quantileCache[ quantileIndex];
-    NdArray::Double doubleView( view.get(), false );
-    std::vector<double> newClips = Carta::Core::Algorithms::quantiles2pixels(
-            doubleView, {minClipPercentile, maxClipPercentile });
-    bool clipsChanged = false;
-    int clipSize = newClips.size();
-    if ( clipSize >= 2 ){
-        if ( clips.size() >= 2 ){
-            double ERROR_MARGIN = 0.000001;
-            if ( qAbs( newClips[0] - clips[0]) > ERROR_MARGIN ||
-                qAbs( newClips[1] - clips[1]) > ERROR_MARGIN ){
-                clipsChanged = true;
-            }
-        }
-        else {
-            clipsChanged = true;
-        }
+    //Planes that were seen before (possibly in an earlier session) are answered by the
+    //statistics index. Otherwise the plane is read once here, for the clips and for the
+    //statistics that are then handed to the index.
+    std::vector<double> clips;
+    Carta::Core::Algorithms::PlaneStatistics::SharedPtr stats = _getPlaneStatistics( frames, false );
+    if ( !stats && !m_statisticsKey.isEmpty() ){
+        stats = Carta::Core::Algorithms::PlaneStatistics::compute( view.get() );
+        _setPlaneStatistics( frames, stats );
+    }
+    if ( stats ){
+        clips = { stats->quantile( minClipPercentile ), stats->quantile( maxClipPercentile ) };
     }
-
-    if ( clipsChanged ){
-        if ( newClips.size() >= 2 && newClips[0] != newClips[1] ){
-            m_quantileCache[ quantileIndex ] = newClips;
-            m_pixelPipeline-> setMinMax( newClips[0], newClips[1] );
-        }
+    else {
+        clips = Carta::Core::Algorithms::quantiles2pixels(
+                view.get(), {minClipPercentile, maxClipPercentile },
+                Carta::Core::Algorithms::QuantileMethod::Auto );
+    }
+    if ( clips.size() >= 2 && clips[0] != clips[1] ){
+        m_pixelPipeline-> setMinMax( clips[0], clips[1] );
     }
 }
 
@@ -791,7 +918,7 @@ std::shared_ptr<NdArray::RawViewInterface> DataSource::_updateRenderedView( cons
     // get a view of the data using the slice description and make a shared pointer out of it
     std::shared_ptr<NdArray::RawViewInterface> view( _getRawData( frames ) );
     // tell the render service to render this job
-    QString renderId = _getViewIdCurrent( frames );
+    Carta::Core::CacheKey renderId = _getViewIdCurrent( frames );
     m_renderService-> setInputView( view, renderId/*, m_axisIndexX, m_axisIndexY*/ );
     return view;
 }
@@ -9,6 +9,12 @@
 #include "CartaLib/AxisDisplayInfo.h"
 #include "CartaLib/CartaLib.h"
 #include "CartaLib/AxisInfo.h"
+#include "CacheKey.h"
+#include "Algorithms/PixelRowCache.h"
+#include "Algorithms/PlaneStatistics.h"
+#include "Algorithms/CumulativeDistribution.h"
+#include "CacheManager.h"
+#include "StatisticsIndex.h"
 
 
 #include <QImage>
@@ -83,6 +89,16 @@ public:
         */
        virtual void setGamma( double gamma )  Q_DECL_OVERRIDE;
 
+       /**
+        * Open the image at the given location with the image loader plugins.
+        * Images that are already open are shared, see Carta::Core::ImageRegistry.
+        * This does not change any data source, so it can be called from a
+        * background thread while the image is opened.
+        * @param fileName an identifier for the location of a data source.
+        * @return the image, or nullptr if no plugin could load it.
+        */
+       static std::shared_ptr<Image::ImageInterface> loadImage( const QString& fileName );
+
        static const QString CLASS_NAME;
        static const double ZOOM_DEFAULT;
        static const QString DATA_PATH;
@@ -234,6 +250,17 @@ private:
      */
     int _getFrameIndex( int sourceFrameIndex, const std::vector<int>& sourceFrames ) const;
 
+    /**
+     * Returns the cumulative distribution of the values in a range of frames, building
+     * it the first time.
+     * @param frameLow a lower bound for the frames or -1 if there is no lower bound.
+     * @param frameHigh an upper bound for the frames or -1 if there is no upper bound.
+     * @param key set to the cache key of the distribution.
+     * @return the distribution or nullptr if there is no data.
+     */
+    Carta::Core::Algorithms::CumulativeDistribution::SharedPtr _getDistribution(
+            int frameLow, int frameHigh, Carta::Core::CacheKey* key ) const;
+
     /**
      * Return the percentile corresponding to the given intensity.
      * @param frameLow a lower bound for the frames or -1 if there is no lower bound.
@@ -332,8 +359,53 @@ private:
     std::shared_ptr<Image::ImageInterface> _getPermutedImage() const;
 
     //Returns an identifier for the current image slice being rendered.
-    QString _getViewIdCurrent( const std::vector<int>& frames ) const;
-    int _getQuantileCacheIndex( const std::vector<int>& frames ) const;
+    Carta::Core::CacheKey _getViewIdCurrent( const std::vector<int>& frames ) const;
+
+    //Returns the index of the plane shown for the frames, among all the planes of the
+    //non-display axes.
+    int64_t _getPlaneIndex( const std::vector<int>& frames ) const;
+
+    /**
+     * Returns the slice of the permuted image for a plane.
+     * @param frames - a list of image frames, already fit to the image.
+     * @return the slice of the plane.
+     */
+    SliceND _getPlaneSlice( const std::vector<int>& frames ) const;
+
+    /**
+     * Returns the id of a plane in the statistics index.
+     * @param frames - a list of image frames.
+     * @return the id of the plane of the display axes at the frames.
+     */
+    Carta::Core::StatisticsIndex::PlaneId _getPlaneId( const std::vector<int>& frames ) const;
+
+    /**
+     * Returns the statistics of a plane from the statistics index.
+     * @param frames - a list of image frames.
+     * @param computeMissing - whether statistics that are not known yet should be
+     *      computed in the background.
+     * @return the statistics of the plane, or nullptr if they are not known yet.
+     */
+    Carta::Core::Algorithms::PlaneStatistics::SharedPtr _getPlaneStatistics(
+            const std::vector<int>& frames, bool computeMissing = true ) const;
+
+    /**
+     * Adds statistics computed from a plane to the statistics index.
+     * @param frames - a list of image frames.
+     * @param stats - the statistics of the plane.
+     */
+    void _setPlaneStatistics( const std::vector<int>& frames,
+            Carta::Core::Algorithms::PlaneStatistics::SharedPtr stats ) const;
+
+    /**
+     * Returns the statistics of a range of spectral frames from the statistics index.
+     * @param frameLow the lower bound for the frames or -1 for the whole image.
+     * @param frameHigh the upper bound for the frames or -1 for the whole image.
+     * @return the statistics, or nullptr if the range is not a single plane, or if
+     *      the statistics of the plane are not known yet.
+     */
+    Carta::Core::Algorithms::PlaneStatistics::SharedPtr _getPlaneStatistics(
+            int frameLow, int frameHigh ) const;
 
     //Initialize static objects.
     void _initializeSingletons( );
@@ -349,6 +421,12 @@ private:
     void _load( std::vector<int> frames, bool recomputeClipsOnNewFrame,
             double clipMinPercentile, double clipMaxPercentile );
 
+    /**
+     * Forget the rows around the cursor and look up the frame axes of the
+     * permuted image again.
+     */
+    void _resetCursor();
+
     /**
      * Center the image.
      */
@@ -359,8 +437,6 @@ private:
      */
     void _resetZoom();
 
-    void _resizeQuantileCache();
-
     /**
      * Set the x-, y-, and z- axes that are to be displayed.
      * @param displayAxisTypes - the list of display axes.
@@ -398,6 +474,14 @@ private:
      */
     bool _setFileName( const QString& fileName );
 
+    /**
+     * Start using an image that was already opened with loadImage().
+     * @param fileName the location the image was loaded from.
+     * @param image the image to display.
+     * @return true if the image was valid; false otherwise.
+     */
+    bool _setImage( const QString& fileName, std::shared_ptr<Image::ImageInterface> image );
+
 
     /**
      * Set the data transform.
@@ -427,6 +511,21 @@ private:
     DataSource();
 
     QString m_fileName;
+    //Hash of the file name, precomputed so view keys only need to mix in the frames.
+    Carta::Core::CacheKey m_fileNameKey;
+
+    //Rows around the cursor, so the cursor readout does not need to create a view
+    //of the plane on every mouse move.
+    mutable Carta::Core::Algorithms::PixelRowCache m_cursorRows;
+    mutable std::vector<int> m_cursorPos;
+    //For each axis of the permuted image past the display axes, the index of its
+    //type in the frames and the number of frames (0 if it has no frames).
+    std::vector<std::pair<int,int> > m_cursorFrameAxes;
+
+    //Cumulative distributions of frame ranges, for percentile lookups, keyed by the
+    //contents of the file so a file that changed on disk is not answered from them.
+    Carta::Core::CacheKey m_distributionKey;
+    mutable Carta::Core::ManagedCache<Carta::Core::Algorithms::CumulativeDistribution> m_distributions;
     bool m_cmapUseCaching;
     bool m_cmapUseInterpolatedCaching;
     int m_cmapCacheSize;
@@ -441,8 +540,8 @@ private:
     /// coordinate formatter
     std::shared_ptr<CoordinateFormatterInterface> m_coordinateFormatter;
 
-    /// clip cache, hard-coded to single quantile
-    std::vector< std::vector<double> > m_quantileCache;
+    //Key of the image in the statistics index, empty if the image is not indexed.
+    QString m_statisticsKey;
 
     /// the rendering service
     std::shared_ptr<Carta::Core::ImageRenderService::Service> m_renderService;
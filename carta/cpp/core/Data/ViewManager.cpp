@@ -292,7 +292,7 @@ void ViewManager::_initCallbacks(){
         const QString DATA( "data");
         std::set<QString> keys = {ID,DATA};
         std::map<QString,QString> dataValues = Carta::State::UtilState::parseParamMap( params, keys );
-        loadFile( dataValues[ID], dataValues[DATA]);
+        loadFile( dataValues[ID], dataValues[DATA], true );
         return "";
     });
 
@@ -457,7 +457,7 @@ QString ViewManager::linkRemove( const QString& sourceId, const QString& destId
     return result;
 }
 
-bool ViewManager::loadFile( const QString& controlId, const QString& fileName){
+bool ViewManager::loadFile( const QString& controlId, const QString& fileName, bool background ){
     bool result = false;
     int controlCount = getControllerCount();
     for ( int i = 0; i < controlCount; i++ ){
@@ -466,7 +466,13 @@ bool ViewManager::loadFile( const QString& controlId, const QString& fileName){
            //Add the data to it
             _makeDataLoader();
            QString path = m_dataLoader->getFile( fileName, "" );
-           result = m_controllers[i]->addData( path );
+           if ( background ){
+               m_controllers[i]->addDataAsync( path );
+               result = true;
+           }
+           else {
+               result = m_controllers[i]->addData( path );
+           }
            break;
         }
     }
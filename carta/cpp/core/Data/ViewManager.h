@@ -79,9 +79,11 @@ public:
      * @param fileName a locater for the data to load.
      * @param objectId the unique server side id of the controller which is
      * responsible for displaying the file.
-     * @return true if successful, false otherwise.
+     * @param background true if the file should be opened without waiting for it;
+     *      the controller reports the progress in its data state.
+     * @return true if successful (or if a background load was started), false otherwise.
      */
-    bool loadFile( const QString& objectId, const QString& fileName);
+    bool loadFile( const QString& objectId, const QString& fileName, bool background = false );
 
 
     /**
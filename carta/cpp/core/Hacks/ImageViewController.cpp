@@ -434,9 +434,8 @@ ImageViewController::loadFrame( int frame )
     // compute 95% clip values, unless we already have them in the cache
     std::vector < double > clips = m_quantileCache[m_currentFrame];
     if ( clips.size() < 2 ) {
-        NdArray::Double doubleView( view.get(), false );
         clips = Carta::Core::Algorithms::quantiles2pixels(
-            doubleView, { 0.025, 0.975 }
+            view.get(), { 0.025, 0.975 }
             );
         qDebug() << "recomputed clips" << clips;
         m_quantileCache[m_currentFrame] = clips;
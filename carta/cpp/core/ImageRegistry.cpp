@@ -0,0 +1,297 @@
+/**
+ *
+ **/
+
+#include "ImageRegistry.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace Carta
+{
+namespace Core
+{
+/// defaults
+static constexpr int64_t DefaultIdleTimeoutMs = 5 * 60 * 1000;
+static constexpr int DefaultMaxIdle = 4;
+
+ImageRegistry &
+ImageRegistry::instance()
+{
+    // never destroyed, the handles may outlive static destruction
+    static ImageRegistry * registry = new ImageRegistry();
+    return * registry;
+}
+
+ImageRegistry::ImageRegistry()
+{
+    m_idleTimeout = DefaultIdleTimeoutMs;
+    m_maxIdle = DefaultMaxIdle;
+
+    // the timer needs an event loop, so it lives in the main thread
+    m_timer.setSingleShot( true );
+    if ( QCoreApplication::instance() ) {
+        m_timer.moveToThread( QCoreApplication::instance()-> thread() );
+    }
+    QObject::connect( & m_timer, & QTimer::timeout, [this] () {
+                          evictIdle();
+                      }
+                      );
+}
+
+Image::ImageInterface::SharedPtr
+ImageRegistry::acquire( const QString & fileName, OpenFunc open )
+{
+    return acquireKey( key( fileName ), fileName, open );
+}
+
+Image::ImageInterface::SharedPtr
+ImageRegistry::acquireKey( const QString & key, const QString & fileName, OpenFunc open )
+{
+    if ( key.isEmpty() ) {
+        return open( fileName );
+    }
+
+    // evicted images are closed after the lock is released
+    std::vector < Image::ImageInterface::SharedPtr > evicted;
+    {
+        QMutexLocker locker( & m_mutex );
+        auto iter = m_entries.find( key );
+        if ( iter != m_entries.end() ) {
+            Image::ImageInterface::SharedPtr handle = iter-> second.handle.lock();
+            if ( ! handle ) {
+                handle = makeHandle( key, iter-> second );
+            }
+            evict( evicted );
+            return handle;
+        }
+    }
+
+    // open the image without holding the lock, opening can take a while
+    Image::ImageInterface::SharedPtr image = open( fileName );
+    if ( ! image ) {
+        return nullptr;
+    }
+
+    Image::ImageInterface::SharedPtr handle;
+    {
+        QMutexLocker locker( & m_mutex );
+
+        // somebody else may have opened the same file in the meantime, in which case
+        // our copy is dropped (outside of the lock)
+        auto iter = m_entries.find( key );
+        if ( iter == m_entries.end() ) {
+            Entry & entry = m_entries[key];
+            entry.image = image;
+            handle = makeHandle( key, entry );
+        }
+        else {
+            handle = iter-> second.handle.lock();
+            if ( ! handle ) {
+                handle = makeHandle( key, iter-> second );
+            }
+        }
+        evict( evicted );
+    }
+    return handle;
+} // acquireKey
+
+QString
+ImageRegistry::key( const QString & fileName )
+{
+    QFileInfo info( fileName.trimmed() );
+    if ( ! info.exists() ) {
+        return QString();
+    }
+    QString path = info.canonicalFilePath();
+    if ( path.isEmpty() ) {
+        return QString();
+    }
+
+    // casa paged images are directories, the table.dat inside changes on every write
+    QDateTime modified = info.lastModified();
+    if ( info.isDir() ) {
+        QFileInfo table( path + "/table.dat" );
+        if ( table.exists() ) {
+            modified = table.lastModified();
+        }
+    }
+    return QString( "%1|%2|%3" ).arg( path ).arg( modified.toMSecsSinceEpoch() ).arg( info.size() );
+}
+
+void
+ImageRegistry::setIdleTimeout( int64_t msecs )
+{
+    std::vector < Image::ImageInterface::SharedPtr > evicted;
+    {
+        QMutexLocker locker( & m_mutex );
+        m_idleTimeout = std::max < int64_t > ( 0, msecs );
+        evict( evicted );
+    }
+}
+
+int64_t
+ImageRegistry::idleTimeout() const
+{
+    QMutexLocker locker( & m_mutex );
+    return m_idleTimeout;
+}
+
+void
+ImageRegistry::setMaxIdle( int count )
+{
+    std::vector < Image::ImageInterface::SharedPtr > evicted;
+    {
+        QMutexLocker locker( & m_mutex );
+        m_maxIdle = std::max( 0, count );
+        evict( evicted );
+    }
+}
+
+int
+ImageRegistry::maxIdle() const
+{
+    QMutexLocker locker( & m_mutex );
+    return m_maxIdle;
+}
+
+int
+ImageRegistry::size() const
+{
+    QMutexLocker locker( & m_mutex );
+    return m_entries.size();
+}
+
+int
+ImageRegistry::idleCount() const
+{
+    QMutexLocker locker( & m_mutex );
+    int count = 0;
+    for ( auto & entry : m_entries ) {
+        if ( entry.second.handle.expired() ) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void
+ImageRegistry::clearIdle()
+{
+    std::vector < Image::ImageInterface::SharedPtr > evicted;
+    {
+        QMutexLocker locker( & m_mutex );
+        for ( auto iter = m_entries.begin() ; iter != m_entries.end() ; ) {
+            if ( iter-> second.handle.expired() ) {
+                evicted.push_back( iter-> second.image );
+                iter = m_entries.erase( iter );
+            }
+            else {
+                ++iter;
+            }
+        }
+    }
+}
+
+int64_t
+ImageRegistry::now()
+{
+    return std::chrono::duration_cast < std::chrono::milliseconds > (
+        std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+Image::ImageInterface::SharedPtr
+ImageRegistry::makeHandle( const QString & key, Entry & entry )
+{
+    // the handle shares the image, and tells the registry when the last copy is gone
+    Image::ImageInterface::SharedPtr image = entry.image;
+    Image::ImageInterface::SharedPtr handle(
+        image.get(), [this, key, image] ( Image::ImageInterface * ptr ) {
+            release( key, ptr );
+        }
+        );
+    entry.handle = handle;
+    return handle;
+}
+
+void
+ImageRegistry::release( const QString & key, Image::ImageInterface * image )
+{
+    std::vector < Image::ImageInterface::SharedPtr > evicted;
+    {
+        QMutexLocker locker( & m_mutex );
+        auto iter = m_entries.find( key );
+
+        // a new handle may have been made since this one expired
+        if ( iter != m_entries.end() && iter-> second.image.get() == image
+             && iter-> second.handle.expired() ) {
+            iter-> second.idleSince = now();
+        }
+        evict( evicted );
+    }
+}
+
+void
+ImageRegistry::evict( std::vector < Image::ImageInterface::SharedPtr > & evicted )
+{
+    int64_t time = now();
+
+    // collect the idle entries, dropping the ones that timed out
+    std::vector < std::map < QString, Entry >::iterator > idle;
+    for ( auto iter = m_entries.begin() ; iter != m_entries.end() ; ) {
+        auto next = std::next( iter );
+        if ( iter-> second.handle.expired() ) {
+            if ( time - iter-> second.idleSince >= m_idleTimeout ) {
+                evicted.push_back( iter-> second.image );
+                m_entries.erase( iter );
+            }
+            else {
+                idle.push_back( iter );
+            }
+        }
+        iter = next;
+    }
+
+    // too many idle entries, drop the ones that have been idle the longest
+    if ( int( idle.size() ) > m_maxIdle ) {
+        std::sort( idle.begin(), idle.end(), [] ( const std::map < QString, Entry >::iterator & a,
+                                                   const std::map < QString, Entry >::iterator & b ) {
+                       return a-> second.idleSince < b-> second.idleSince;
+                   }
+                   );
+        for ( size_t i = 0 ; i < idle.size() - m_maxIdle ; i++ ) {
+            evicted.push_back( idle[i]-> second.image );
+            m_entries.erase( idle[i] );
+        }
+    }
+
+    // wake up when the next idle entry times out
+    int64_t deadline = std::numeric_limits < int64_t >::max();
+    for ( auto & entry : m_entries ) {
+        if ( entry.second.handle.expired() ) {
+            deadline = std::min( deadline, entry.second.idleSince + m_idleTimeout );
+        }
+    }
+    if ( deadline != std::numeric_limits < int64_t >::max() ) {
+        int delay = Carta::Lib::clamp < int64_t > ( deadline - time, 0,
+                                                    std::numeric_limits < int >::max() );
+        QMetaObject::invokeMethod( & m_timer, "start", Qt::QueuedConnection,
+                                   Q_ARG( int, delay ) );
+    }
+} // evict
+
+void
+ImageRegistry::evictIdle()
+{
+    std::vector < Image::ImageInterface::SharedPtr > evicted;
+    {
+        QMutexLocker locker( & m_mutex );
+        evict( evicted );
+    }
+}
+}
+}
@@ -0,0 +1,139 @@
+/**
+ * Process-wide registry of open images.
+ *
+ * Opening an image is not free: the loader plugins reopen the file, parse the header and
+ * build a new image with its own caches. When the same file is shown in several views,
+ * or closed and loaded again (e.g. when a snapshot is restored), all of that was done
+ * again each time.
+ *
+ * The registry hands out shared instances instead, keyed by the canonical path of the
+ * file together with its modification time and size, so a file that changed on disk is
+ * opened again. The handles are reference counted. When the last handle of an image is
+ * released, the image stays open for a while, so that it can be handed out again
+ * quickly. Idle images are evicted when they have not been used for idleTimeout()
+ * milliseconds, or when there are more than maxIdle() of them. Eviction is done
+ * whenever an image is acquired or released, and by a timer in the main thread when
+ * the next idle image times out.
+ *
+ * Files that can't be found on the local filesystem (e.g. urls) are not registered.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include <QMutex>
+#include <QString>
+#include <QTimer>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Carta
+{
+namespace Core
+{
+class ImageRegistry
+{
+    CLASS_BOILERPLATE( ImageRegistry );
+
+public:
+
+    /// function used to open an image that is not in the registry
+    typedef std::function < Image::ImageInterface::SharedPtr ( const QString & fileName ) >
+        OpenFunc;
+
+    /// the process-wide instance
+    static ImageRegistry &
+    instance();
+
+    ImageRegistry();
+
+    /// return the image for the file, opening it with open if it's not registered
+    /// \param fileName the location of the image
+    /// \param open used to open the image if needed
+    /// \return a handle to the image, or nullptr if it could not be opened
+    Image::ImageInterface::SharedPtr
+    acquire( const QString & fileName, OpenFunc open );
+
+    /// same as above, with the key already computed (see key())
+    /// an empty key means the image is not registered
+    Image::ImageInterface::SharedPtr
+    acquireKey( const QString & key, const QString & fileName, OpenFunc open );
+
+    /// key of the file: canonical path, modification time and size,
+    /// or an empty string if the file does not exist
+    static QString
+    key( const QString & fileName );
+
+    /// how long (in milliseconds) images are kept open after their last handle
+    /// was released
+    void
+    setIdleTimeout( int64_t msecs );
+
+    int64_t
+    idleTimeout() const;
+
+    /// how many images are kept open after their last handle was released
+    void
+    setMaxIdle( int count );
+
+    int
+    maxIdle() const;
+
+    /// number of registered images, including the idle ones
+    int
+    size() const;
+
+    /// number of registered images without any handles
+    int
+    idleCount() const;
+
+    /// close all idle images
+    void
+    clearIdle();
+
+private:
+
+    struct Entry {
+        /// the image, held for as long as the entry exists
+        Image::ImageInterface::SharedPtr image;
+
+        /// the handle given out to the users, when it expires the image is idle
+        std::weak_ptr < Image::ImageInterface > handle;
+
+        /// when the last handle was released
+        int64_t idleSince = 0;
+    };
+
+    /// milliseconds on a monotonic clock
+    static int64_t
+    now();
+
+    /// make a new handle for the entry (caller must hold the mutex)
+    Image::ImageInterface::SharedPtr
+    makeHandle( const QString & key, Entry & entry );
+
+    /// called when the last handle of an image is gone
+    void
+    release( const QString & key, Image::ImageInterface * image );
+
+    /// remove idle entries that are too old, or too many (caller must hold the mutex)
+    /// the images are moved to evicted, so that they are closed after the lock is released
+    /// also restarts the timer for the next idle entry to time out
+    void
+    evict( std::vector < Image::ImageInterface::SharedPtr > & evicted );
+
+    /// evict when the timer fires
+    void
+    evictIdle();
+
+    mutable QMutex m_mutex;
+    std::map < QString, Entry > m_entries;
+    int64_t m_idleTimeout;
+    int m_maxIdle;
+    QTimer m_timer;
+};
+}
+}
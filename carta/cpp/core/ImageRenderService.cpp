@@ -6,6 +6,9 @@
 #include "CartaLib/LinearMap.h"
 #include <QColor>
 #include <QPainter>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
 
 // most optimal Qt format seems to be Format_ARGB32_Premultiplied
 static constexpr QImage::Format OptimalQImageFormat = QImage::Format_ARGB32_Premultiplied;
@@ -17,76 +20,56 @@ static constexpr QImage::Format OptimalQImageFormat = QImage::Format_ARGB32_Prem
 /// \todo check if the bug is still there in Qt5.4+, it definitely is there in Qt5.3
 static constexpr bool QtPremultipliedBugStillExists = true;
 
-/// internal algorithm for converting an instance of image interface to qimage
+/// minimum number of rows in a band converted by a single task
+static constexpr int MinRowsPerBand = 16;
+
+/// how many bands per thread to aim for, more bands give better load balancing
+/// and more frequent progress reports
+static constexpr int BandsPerThread = 4;
+
+/// internal algorithm for converting a range of rows of raw data to qimage
 /// using the pixel pipeline
 ///
+/// \tparam Scalar type of the raw data (float or double)
 /// \tparam Pipeline
-/// \param m_rawView
-/// \param pipe
-/// \param m_qImage
-template < class Pipeline >
+/// \param data raw data of the whole frame in row-major order (first row is the bottom one)
+/// \param width number of columns of the frame
+/// \param y1 first row to convert
+/// \param y2 one past the last row to convert
+/// \param pipe pixel pipeline to use
+/// \param bits pointer to the pixels of the output image
+/// \param height number of rows of the output image
+///
+/// \note this is called from multiple threads at the same time, each with a different
+/// range of rows, so the pipeline must not be modified while this runs
+template < typename Scalar, class Pipeline >
 static void
-iView2qImage( NdArray::RawViewInterface * rawView, Pipeline & pipe, QImage & qImage )
+band2qImage( const Scalar * data, int width, int y1, int y2, Pipeline & pipe,
+             uchar * bits, int height )
 {
-    //qDebug() << "rv2qi2" << rawView-> dims();
-    typedef double Scalar;
-
-    QSize size( rawView->dims()[0], rawView->dims()[1] );
-
-    QImage::Format desiredFormat = OptimalQImageFormat;
-    if ( QtPremultipliedBugStillExists ) {
-        desiredFormat = QImage::Format_ARGB32;
-    }
-
-    // QImage::Format desiredFormat = QImage::Format_ARGB32;
-    if ( qImage.format() != desiredFormat ||
-         qImage.size() != size ) {
-        qImage = QImage( size, desiredFormat );
-    }
-    auto bytesPerLine = qImage.bytesPerLine();
-    CARTA_ASSERT( bytesPerLine == size.width() * 4 );
-
-    // start with a pointer to the beginning of last row (we are constructing image
-    // bottom-up)
-    QRgb * outPtr = reinterpret_cast < QRgb * > (
-        qImage.bits() + size.width() * ( size.height() - 1 ) * 4 );
-
-    if( 0) {
-        CARTA_ASSERT( qImage.bits() + size.width() * (size.height() - 1) * 4 == qImage.scanLine( size.height() - 1));
-        // sanity check
-        for( int y = 0 ; y < size.height() ; y ++ ) {
-            CARTA_ASSERT( qImage.bits() + size.width() * 4 * y == qImage.scanLine(y) );
-        }
-    }
-
-    // make a double view
-    NdArray::TypedView < Scalar > typedView( rawView, false );
-
-    /// @todo for more efficiency, instead of forEach() we should switch to one of the
-    /// higher performance APIs and maybe even sprinkle it with some openmp/cilk magic :)
-    int64_t counter = 0;
     QRgb nanColor = qRgb( 255, 0, 0 );
-    auto lambda = [&] ( const Scalar & ival )
-    {
-        if ( Q_LIKELY( ! std::isnan( ival ) ) ) {
-            pipe.convertq( ival, * outPtr );
-        }
-        else {
-            * outPtr = nanColor;
-        }
-        outPtr++;
-        counter++;
+    for ( int y = y1 ; y < y2 ; ++y ) {
+        const Scalar * inPtr = data + int64_t( y ) * width;
 
         // build the image bottom-up
-        if ( counter % size.width() == 0 ) {
-            outPtr -= size.width() * 2;
-        }
-    };
-    typedView.forEach( lambda );
-
-    CARTA_ASSERT( counter == size.width() * size.height());
+        QRgb * outPtr = reinterpret_cast < QRgb * > (
+            bits + int64_t( height - 1 - y ) * width * 4 );
+        pipe.convertqBatch( inPtr, outPtr, width, nanColor );
+    }
+} // band2qImage
 
-} // rawView2QImage
+/// read in all values of the raw view into the buffer, converting them to Scalar
+template < typename Scalar >
+static void
+readRawView( NdArray::RawViewInterface * rawView, Scalar * buffer )
+{
+    // copy the view in contiguous blocks of up to 1M elements
+    NdArray::TypedView < Scalar > typedView( rawView, false );
+    typedView.forEach( 1024 * 1024, [& buffer] ( const Scalar * data, int64_t count ) {
+                           buffer = std::copy( data, data + count, buffer );
+                       }
+                       );
+}
 
 namespace Carta
 {
@@ -94,13 +77,117 @@ namespace Core
 {
 namespace ImageRenderService
 {
+/// a single band of rows of the frame
+struct Band {
+    int y1, y2;
+};
+
+/// everything a frame conversion needs, shared between the service and the worker
+/// threads, so that it stays alive even if the service moves on to a different job
+struct Service::FrameJob {
+    /// frame generation this job is computing
+    int64_t generation = - 1;
+
+    /// raw data of the frame, read in on the service's thread
+    /// float data (and mipmap levels, which are always float) is kept as float, anything
+    /// else is converted to double
+    std::vector < double > data;
+    std::vector < float > floatData;
+    bool useFloat = false;
+
+    /// rectangle of the input view this frame represents
+    QRect rect;
+
+    /// mipmap level of the frame
+    int level = 0;
+
+    /// dimensions of the frame
+    int width = 0, height = 0;
+
+    /// destination image, each band writes into its own rows
+    QImage frameImage;
+
+    /// pointer to the pixels of frameImage, obtained before the workers start so that
+    /// nobody calls the detaching QImage accessors from the worker threads
+    uchar * bits = nullptr;
+
+    /// list of bands to convert
+    std::vector < Band > bands;
+
+    /// index image of the frame, if the frame is converted through one
+    Algorithms::IndexImage::SharedPtr index = nullptr;
+
+    /// whether the index image needs to be computed from the raw data, or whether
+    /// it came from the cache
+    bool computeIndex = false;
+
+    /// key of the index image in the index cache
+    CacheKey indexCacheKey;
+
+    /// colors for the index image
+    std::vector < QRgb > colorTable;
+
+    /// converts a single band, captures whichever pipeline is being used
+    std::function < void (const Band &) > convertBand;
+
+    /// set up convertBand to go through the index image
+    /// \param pipe pipeline used to build the color table
+    template < class Pipeline >
+    void
+    setIndexPipeline( std::shared_ptr < Pipeline > pipe )
+    {
+        colorTable = index-> colorTable( * pipe, qRgb( 255, 0, 0 ) );
+        convertBand = [this] ( const Band & band ) {
+            if ( computeIndex ) {
+                if ( useFloat ) {
+                    index-> quantizeRows( floatData.data(), band.y1, band.y2 );
+                }
+                else {
+                    index-> quantizeRows( data.data(), band.y1, band.y2 );
+                }
+            }
+            index-> colorize( colorTable, band.y1, band.y2, bits );
+        };
+    }
+
+    /// set up convertBand to use the given pipeline
+    template < class Pipeline >
+    void
+    setPipeline( std::shared_ptr < Pipeline > pipe )
+    {
+        convertBand = [this, pipe] ( const Band & band ) {
+            if ( useFloat ) {
+                ::band2qImage( floatData.data(), width, band.y1, band.y2, * pipe, bits, height );
+            }
+            else {
+                ::band2qImage( data.data(), width, band.y1, band.y2, * pipe, bits, height );
+            }
+        };
+    }
+};
+
 void
-Service::setInputView( NdArray::RawViewInterface::SharedPtr view, QString cacheId )
+Service::setInputView( NdArray::RawViewInterface::SharedPtr view, CacheKey cacheKey )
 {
+    // remember the pyramid of the previous view, in case it comes back (e.g. movies)
+    if ( m_pyramid && ! m_inputViewKey.isNull() ) {
+        m_pyramidCache.insert( m_inputViewKey, m_pyramid, m_pyramid-> byteSize() );
+    }
+    m_pyramid = nullptr;
+    if ( ! cacheKey.isNull() ) {
+        m_pyramid = m_pyramidCache.take( cacheKey );
+    }
+
     m_inputView = view;
 
-    m_inputViewCacheId = cacheId;
-    m_frameImage = QImage(); // indicate a need to recompute
+    m_inputViewKey = cacheKey;
+    invalidateFrame(); // indicate a need to recompute
+}
+
+void
+Service::setInputView( NdArray::RawViewInterface::SharedPtr view, const QString & cacheId )
+{
+    setInputView( view, CacheKey::fromString( cacheId ) );
 }
 
 void
@@ -146,11 +233,18 @@ void
 Service::setPixelPipeline( IClippedPixelPipeline::SharedPtr pixelPipeline,
                            QString cacheId = QString() )
 {
+    // same settings as before, the cached tables and the frame are still good
     m_pixelPipelineRaw = pixelPipeline;
+    if ( ! cacheId.isEmpty() && cacheId == m_pixelPipelineCacheId ) {
+        return;
+    }
+
+    // the id is only hashed when it changes
     m_pixelPipelineCacheId = cacheId;
+    m_pixelPipelineKey = CacheKey::fromString( cacheId );
 
     // invalidate frame cache
-    m_frameImage = QImage();
+    invalidateFrame();
 
     // invalidate pixel pipeline cache
     m_cachedPP = nullptr;
@@ -163,7 +257,7 @@ Service::setPixelPipelineCacheSettings( const PixelPipelineCacheSettings & param
     m_pixelPipelineCacheSettings = params;
 
     // invalidate frame cache
-    m_frameImage = QImage();
+    invalidateFrame();
 
     // invalidate pixel pipeline cache
     m_cachedPP = nullptr;
@@ -176,6 +270,39 @@ Service::pixelPipelineCacheSettings() const
     return m_pixelPipelineCacheSettings;
 }
 
+void
+Service::setMipmapSettings( const MipmapSettings & params )
+{
+    if ( params.reduction != m_mipmapSettings.reduction ) {
+        m_pyramid = nullptr;
+        m_pyramidCache.clear();
+    }
+    m_mipmapSettings = params;
+    invalidateFrame();
+}
+
+const MipmapSettings &
+Service::mipmapSettings() const
+{
+    return m_mipmapSettings;
+}
+
+void
+Service::setRenderMode( RenderMode mode )
+{
+    if ( mode == m_renderMode ) {
+        return;
+    }
+    m_renderMode = mode;
+    invalidateFrame();
+}
+
+RenderMode
+Service::renderMode() const
+{
+    return m_renderMode;
+}
+
 JobId
 Service::render( JobId jobId )
 {
@@ -203,11 +330,19 @@ Service::Service( QObject * parent ) : QObject( parent )
     m_renderTimer.setInterval( 1 );
     connect( & m_renderTimer, & QTimer::timeout, this, & Me::internalRenderSlot );
 
-    m_frameCache.setMaxCost( 1 * 1024 * 1024 * 1024 ); // 1 gig
+    connect( & m_frameJobWatcher, & QFutureWatcher < void >::progressValueChanged,
+             this, & Me::frameJobProgressSlot );
+    connect( & m_frameJobWatcher, & QFutureWatcher < void >::finished,
+             this, & Me::frameJobFinishedSlot );
+
 }
 
 Service::~Service()
-{ }
+{
+    // workers that are already running keep the job alive, we just make sure
+    // no new bands get started
+    m_frameJobWatcher.cancel();
+}
 
 QPointF
 Service::img2screen( const QPointF & p )
@@ -245,51 +380,98 @@ Service::screen2img( const QPointF & p )
 }
 
 void
-Service::internalRenderSlot()
+Service::invalidateFrame()
 {
-    static int renderCount = 0;
-    qDebug() << "Image render" << renderCount++ << "xyz";
+    m_frameImage = QImage();
+    m_frameRect = QRect();
+    m_frameLevel = 0;
+    m_frameGeneration++;
+}
 
-    // raw double to base64 converter
-    auto d2hex = [] (double x) -> QString {
-        return QByteArray( (char *) ( & x ), sizeof( x ) ).toBase64();
-    };
+int
+Service::neededMipmapLevel()
+{
+    if ( ! m_mipmapSettings.enabled || m_zoom >= 1 ) {
+        return 0;
+    }
+    if ( ! m_pyramid ) {
+        m_pyramid = std::make_shared < Algorithms::MipmapPyramid > (
+            m_inputView-> dims()[0], m_inputView-> dims()[1], m_mipmapSettings.reduction );
+    }
+    return m_pyramid-> levelForZoom( m_zoom );
+}
+
+QRect
+Service::neededFrameRect()
+{
+    QRect imageRect( 0, 0, m_inputView-> dims()[0], m_inputView-> dims()[1] );
+    if ( m_renderMode == RenderMode::FullFrame ) {
+        return imageRect;
+    }
+
+    // find the data pixels covering the corners of the output
+    // (pixel i covers the interval [i-1/2,i+1/2])
+    QPointF tl = screen2img( QPointF( 0, 0 ) );
+    QPointF br = screen2img( QPointF( m_outputSize.width(), m_outputSize.height() ) );
+    int x1 = std::floor( std::min( tl.x(), br.x() ) + 0.5 );
+    int x2 = std::floor( std::max( tl.x(), br.x() ) + 0.5 );
+    int y1 = std::floor( std::min( tl.y(), br.y() ) + 0.5 );
+    int y2 = std::floor( std::max( tl.y(), br.y() ) + 0.5 );
 
-    // cache id will be concatenation of:
-    // view id
-    // pipeline id
-    // output size
-    // pan
-    // zoom
-    // pixel pipeline cache settings
-    // Floats are binary-encoded (base64)
-    QString cacheId = QString( "%1/%2/%3x%4/%5,%6/%7" )
-                          .arg( m_inputViewCacheId )
-                          .arg( m_pixelPipelineCacheId )
-                          .arg( m_outputSize.width() )
-                          .arg( m_outputSize.height() )
-                          .arg( d2hex( m_pan.x() ) )
-                          .arg( d2hex( m_pan.y() ) )
-                          .arg( d2hex( m_zoom ) );
+    return imageRect.intersected( QRect( QPoint( x1, y1 ), QPoint( x2, y2 ) ) );
+} // neededFrameRect
 
+CacheKey
+Service::frameCacheKey()
+{
+    // the view and pipeline keys are precomputed, so this is just a few integer mixes
+    // frames of views without a key cannot be told apart, so they are not cached
+    if ( m_inputViewKey.isNull() ) {
+        return CacheKey();
+    }
+    CacheKey key = m_inputViewKey
+                       .with( m_pixelPipelineKey )
+                       .with( m_outputSize.width() )
+                       .with( m_outputSize.height() )
+                       .with( m_pan.x() )
+                       .with( m_pan.y() )
+                       .with( m_zoom )
+                       .with( m_pixelPipelineCacheSettings.enabled );
     if ( m_pixelPipelineCacheSettings.enabled ) {
-        cacheId += QString( "/1/%1/%2" )
-                       .arg( int (m_pixelPipelineCacheSettings.interpolated) )
-                       .arg( m_pixelPipelineCacheSettings.size );
+        key = key.with( m_pixelPipelineCacheSettings.interpolated )
+                  .with( m_pixelPipelineCacheSettings.size );
     }
-    else {
-        cacheId += "/0";
+    return key;
+} // frameCacheKey
+
+CacheKey
+Service::indexCacheKey( const QRect & rect, int level, double clipMin, double clipMax )
+{
+    if ( m_inputViewKey.isNull() || ! m_indexCache.enabled() ) {
+        return CacheKey();
     }
+    return m_inputViewKey
+               .with( level )
+               .with( rect.left() )
+               .with( rect.top() )
+               .with( rect.width() )
+               .with( rect.height() )
+               .with( clipMin )
+               .with( clipMax );
+}
+
+void
+Service::internalRenderSlot()
+{
+    static int renderCount = 0;
+    qDebug() << "Image render" << renderCount++ << "xyz";
 
-//    qDebug() << "internalRenderSlot... cache size: "
-//             << m_frameCache.totalCost() * 100.0 / m_frameCache.maxCost() << "% "
-//             << m_frameCache.size() << "entries";
-//    qDebug() << "id:" << cacheId;
     struct Scope {
         ~Scope() { /*qDebug() << "internalRenderSlot done";*/ } }
     debugScopeGuard;
 
-    auto cachedImage = m_frameCache.object( cacheId );
+    CacheKey frameKey = frameCacheKey();
+    auto cachedImage = frameKey.isNull() ? nullptr : m_frameCache.object( frameKey );
     if ( cachedImage ) {
         qDebug() << "frame cache hit";
         emit done( * cachedImage, m_lastSubmittedJobId );
@@ -308,35 +490,220 @@ Service::internalRenderSlot()
         return;
     }
 
+    QRect neededRect = neededFrameRect();
+    int neededLevel = neededMipmapLevel();
+
+    // nothing of the image is visible
+    if ( neededRect.isEmpty() ) {
+        reportResult( composeOutput( QImage(), QRect() ) );
+        return;
+    }
+
+    // if the frame is still valid we only need to redo pan/zoom
+    if ( ! m_frameImage.isNull() && m_frameLevel == neededLevel &&
+         m_frameRect.contains( neededRect ) ) {
+        reportResult( composeOutput( m_frameImage, m_frameRect ) );
+        return;
+    }
+
+    // if there is a job already computing the frame we need, it will report the result
+    // for the latest job id when it's done, otherwise the running job is superseded
+    if ( m_frameJob ) {
+        if ( m_frameJob-> generation == m_frameGeneration &&
+             m_frameJob-> level == neededLevel &&
+             m_frameJob-> rect.contains( neededRect ) ) {
+            return;
+        }
+        m_frameJobWatcher.cancel();
+        m_frameJob = nullptr;
+    }
+
+    startFrameJob( neededRect, neededLevel );
+} // internalRenderSlot
+
+void
+Service::startFrameJob( const QRect & rect, int level )
+{
+    auto job = std::make_shared < FrameJob > ();
+    job-> generation = m_frameGeneration;
+    job-> level = level;
+
+    // at mipmap level n every frame pixel covers a block of 2^n x 2^n data pixels, so
+    // the rect can reach past the image where the edge blocks are partial
+    int factor = 1 << level;
+    QRect levelRect( QPoint( rect.left() / factor, rect.top() / factor ),
+                     QPoint( rect.right() / factor, rect.bottom() / factor ) );
+    job-> rect = QRect( levelRect.left() * factor, levelRect.top() * factor,
+                        levelRect.width() * factor, levelRect.height() * factor );
+    job-> width = levelRect.width();
+    job-> height = levelRect.height();
+
+    QImage::Format desiredFormat = OptimalQImageFormat;
+    if ( QtPremultipliedBugStillExists ) {
+        desiredFormat = QImage::Format_ARGB32;
+    }
+    job-> frameImage = QImage( job-> width, job-> height, desiredFormat );
+    job-> frameImage.fill( QColor( 50, 50, 50 ) );
+    CARTA_ASSERT( job-> frameImage.bytesPerLine() == job-> width * 4 );
+    job-> bits = job-> frameImage.bits();
+
+    // if the index image of this frame is cached, the raw data is not needed at all
     double clipMin, clipMax;
     m_pixelPipelineRaw-> getClips( clipMin, clipMax );
+    if ( pixelPipelineCacheSettings().enabled ) {
+        job-> indexCacheKey = indexCacheKey( job-> rect, level, clipMin, clipMax );
+        if ( ! job-> indexCacheKey.isNull() ) {
+            job-> index = m_indexCache.object( job-> indexCacheKey );
+        }
+        if ( ! job-> index ) {
+            job-> index = std::make_shared < Algorithms::IndexImage > (
+                job-> width, job-> height, clipMin, clipMax );
+            job-> computeIndex = true;
+        }
+    }
 
-    // render the frame if needed
-    if ( m_frameImage.isNull() ) {
+    // read in the raw data, this has to happen on our thread
+    int64_t frameSize = int64_t( job-> width ) * job-> height;
+    if ( job-> index && ! job-> computeIndex ) {
+        // the index came from the cache, there is nothing to read
+    }
+    else if ( level > 0 ) {
+        const Algorithms::MipmapPyramid::Level & pyramidLevel =
+            m_pyramid-> level( level, m_inputView.get() );
+        job-> useFloat = true;
+        job-> floatData.resize( frameSize );
+        float * ptr = job-> floatData.data();
+        for ( int y = levelRect.top() ; y <= levelRect.bottom() ; ++y ) {
+            const float * row = pyramidLevel.data.data() + int64_t( y ) * pyramidLevel.width;
+            ptr = std::copy( row + levelRect.left(), row + levelRect.right() + 1, ptr );
+        }
+    }
+    else {
+        // in viewport mode only read in the part of the view we need
+        NdArray::RawViewInterface * rawView = m_inputView.get();
+        std::unique_ptr < NdArray::RawViewInterface > subView;
+        if ( rect.width() != m_inputView-> dims()[0] ||
+             rect.height() != m_inputView-> dims()[1] ) {
+            SliceND slice;
+            slice.start( rect.left() ).end( rect.right() + 1 )
+                .next().start( rect.top() ).end( rect.bottom() + 1 );
+            subView.reset( m_inputView-> getView( slice ) );
+            rawView = subView.get();
+        }
+        if ( rawView-> pixelType() == Image::PixelType::Real32 ) {
+            job-> useFloat = true;
+            job-> floatData.resize( frameSize );
+            ::readRawView( rawView, job-> floatData.data() );
+        }
+        else {
+            job-> data.resize( frameSize );
+            ::readRawView( rawView, job-> data.data() );
+        }
+    }
 
-        if ( pixelPipelineCacheSettings().enabled ) {
-            if ( pixelPipelineCacheSettings().interpolated ) {
-                if ( ! m_cachedPPinterp ) {
-                    m_cachedPPinterp.reset( new Lib::PixelPipeline::CachedPipeline < true > () );
-                    m_cachedPPinterp-> cache( * m_pixelPipelineRaw,
-                                              pixelPipelineCacheSettings().size, clipMin, clipMax );
-                }
-                ::iView2qImage( m_inputView.get(), * m_cachedPPinterp, m_frameImage );
-            }
-            else {
-                if ( ! m_cachedPP ) {
-                    m_cachedPP.reset( new Lib::PixelPipeline::CachedPipeline < false > () );
-                    m_cachedPP-> cache( * m_pixelPipelineRaw,
-                                        pixelPipelineCacheSettings().size, clipMin, clipMax );
-                }
-                ::iView2qImage( m_inputView.get(), * m_cachedPP, m_frameImage );
+    // split the frame into bands
+    int nThreads = std::max( 1, QThreadPool::globalInstance()-> maxThreadCount() );
+    int rowsPerBand = std::max( MinRowsPerBand,
+                                job-> height / ( nThreads * BandsPerThread ) + 1 );
+    for ( int y = 0 ; y < job-> height ; y += rowsPerBand ) {
+        job-> bands.push_back( { y, std::min( y + rowsPerBand, job-> height ) }
+                               );
+    }
+
+    // pick the pipeline
+    // the worker threads only ever see the cached pipelines, which are never modified
+    // after they are created. The raw pipeline can be modified at any time by
+    // the owner, so if it's used we have to wait for the job to finish.
+    bool synchronous = false;
+    if ( pixelPipelineCacheSettings().enabled ) {
+        if ( pixelPipelineCacheSettings().interpolated ) {
+            if ( ! m_cachedPPinterp ) {
+                m_cachedPPinterp = Algorithms::PipelineLutCache::instance().interpolated(
+                    * m_pixelPipelineRaw, m_pixelPipelineKey,
+                    pixelPipelineCacheSettings().size, clipMin, clipMax );
             }
+            job-> setIndexPipeline( m_cachedPPinterp );
         }
         else {
-            ::iView2qImage( m_inputView.get(), * m_pixelPipelineRaw, m_frameImage );
+            if ( ! m_cachedPP ) {
+                m_cachedPP = Algorithms::PipelineLutCache::instance().nearest(
+                    * m_pixelPipelineRaw, m_pixelPipelineKey,
+                    pixelPipelineCacheSettings().size, clipMin, clipMax );
+            }
+            job-> setIndexPipeline( m_cachedPP );
         }
     }
+    else {
+        job-> setPipeline( m_pixelPipelineRaw );
+        synchronous = true;
+    }
+
+    // the map functor holds on to the job, so that bands still running after a cancel
+    // have valid memory to write to
+    auto bandFunctor = [job] ( const Band & band ) {
+        job-> convertBand( band );
+    };
+
+    if ( synchronous ) {
+        QtConcurrent::blockingMap( job-> bands, bandFunctor );
+        m_frameImage = job-> frameImage;
+        m_frameRect = job-> rect;
+        m_frameLevel = job-> level;
+        reportResult( composeOutput( m_frameImage, m_frameRect ) );
+        return;
+    }
+
+    m_frameJob = job;
+    m_frameJobWatcher.setFuture( QtConcurrent::map( job-> bands, bandFunctor ) );
+} // startFrameJob
+
+void
+Service::frameJobProgressSlot()
+{
+    if ( ! m_frameJob || m_frameJobWatcher.isFinished() ) {
+        return;
+    }
+
+    // partially converted bands may show up half-drawn, which is fine for a preview
+    emit progress( composeOutput( m_frameJob-> frameImage, m_frameJob-> rect ),
+                   m_lastSubmittedJobId );
+}
 
+void
+Service::frameJobFinishedSlot()
+{
+    if ( ! m_frameJob || m_frameJobWatcher.isCanceled() ) {
+        return;
+    }
+    std::shared_ptr < FrameJob > job = m_frameJob;
+    m_frameJob = nullptr;
+
+    // the index image is useful regardless of whether the inputs changed
+    if ( job-> computeIndex && ! job-> indexCacheKey.isNull() ) {
+        m_indexCache.insert( job-> indexCacheKey, job-> index, job-> index-> byteSize() );
+    }
+
+    // the inputs could have changed while the job was running, in which case the
+    // result is useless, but a new render was already requested
+    if ( job-> generation != m_frameGeneration ) {
+        return;
+    }
+
+    m_frameImage = job-> frameImage;
+    m_frameRect = job-> rect;
+    m_frameLevel = job-> level;
+
+    // pan/zoom could have changed while the job was running
+    if ( m_frameLevel != neededMipmapLevel() || ! m_frameRect.contains( neededFrameRect() ) ) {
+        internalRenderSlot();
+        return;
+    }
+    reportResult( composeOutput( m_frameImage, m_frameRect ) );
+}
+
+QImage
+Service::composeOutput( const QImage & frameImage, const QRect & frameRect )
+{
     // prepare output
     QImage img( m_outputSize, OptimalQImageFormat );
 
@@ -346,21 +713,32 @@ Service::internalRenderSlot()
 
     // draw the frame image to satisfy zoom/pan
 //    QPointF p1 = img2screen( QPointF( -0.5, -0.5 ) );
-//    QPointF p2 = img2screen( QPointF( m_frameImage.width()-0.5, m_frameImage.height()-0.5));
+//    QPointF p2 = img2screen( QPointF( frameImage.width()-0.5, frameImage.height()-0.5));
 
-    int imageHeight = m_frameImage.height();
-    QPointF p1 = img2screen( QPointF( - 0.5, imageHeight - 0.5 ) );
-    QPointF p2 = img2screen( QPointF( m_frameImage.width() - 0.5, - 0.5 ) );
+    QPointF p1 = img2screen( QPointF( frameRect.left() - 0.5,
+                                      frameRect.top() + frameRect.height() - 0.5 ) );
+    QPointF p2 = img2screen( QPointF( frameRect.left() + frameRect.width() - 0.5,
+                                      frameRect.top() - 0.5 ) );
 
     QRectF rectf( p1, p2 );
     p.setRenderHint( QPainter::SmoothPixmapTransform, false );
 
 //    rectf = rectf.normalized();
-    p.drawImage( rectf, m_frameImage );
+    if ( ! frameImage.isNull() ) {
+        // frame pixels of a mipmap level cover whole blocks, but the blocks at the
+        // right/top edges of the image are cut short, so clip to the image
+        if ( m_inputView ) {
+            QPointF i1 = img2screen( QPointF( - 0.5, m_inputView-> dims()[1] - 0.5 ) );
+            QPointF i2 = img2screen( QPointF( m_inputView-> dims()[0] - 0.5, - 0.5 ) );
+            p.setClipRect( QRectF( i1, i2 ).normalized() );
+        }
+        p.drawImage( rectf, frameImage );
+        p.setClipping( false );
+    }
 
-//    qDebug() << "m_frameImage" << m_frameImage.size();
-//    qDebug() << "m_frameImage" << zoom() << rectf.width() / m_frameImage.width()
-//             << rectf.height() / m_frameImage.height();
+//    qDebug() << "frameImage" << frameImage.size();
+//    qDebug() << "frameImage" << zoom() << rectf.width() / frameImage.width()
+//             << rectf.height() / frameImage.height();
 
     // debugging rectangle
     if ( 0 ) {
@@ -393,19 +771,29 @@ Service::internalRenderSlot()
         }
     }
 
+    return img;
+} // composeOutput
+
+void
+Service::reportResult( QImage img )
+{
     // report result
     emit done( img, m_lastSubmittedJobId );
 
     // debuggin: put a yellow stamp on the image, so that next time it's recalled
     // it'll have 'cached' stamped on it
     if ( CARTA_RUNTIME_CHECKS ) {
+        QPainter p( & img );
         p.setPen( QColor( "yellow" ) );
         p.drawText( img.rect(), Qt::AlignRight | Qt::AlignBottom, "Cached" );
     }
 
     // insert this image into frame cache
-    m_frameCache.insert( cacheId, new QImage( img ), img.byteCount() );
-} // internalRenderSlot
+    CacheKey frameKey = frameCacheKey();
+    if ( ! frameKey.isNull() ) {
+        m_frameCache.insert( frameKey, std::make_shared < QImage > ( img ), img.byteCount() );
+    }
+} // reportResult
 }
 }
 }
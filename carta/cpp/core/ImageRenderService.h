@@ -15,11 +15,35 @@
  * caching considerations (internal notes)
  *   eg. when zooming/panning there is no need to re-apply colormap
  *   or when switching between frames, maybe we can cache some frames to make this faster
- *   or when looking at really large 2d data, we could use mipmaps (future optimization)
+ *   or when looking at really large 2d data, we use mipmaps: when zoomed out, a level
+ *   of a lazily computed MipmapPyramid matching zoom() is colormapped instead of the
+ *   full resolution data. Pyramids of recently seen views are kept, keyed by view id.
+ *
+ * memory
+ *   the frame, index image and pyramid caches of all services share the process-wide
+ *   budget of the CacheManager, see CacheManager.h
  *
  * asynchronous result reporting
  *   the render service might possibly live in a separate thread
  *
+ * multithreaded rendering
+ *   raw data is read on the thread that owns the service (raw views are not thread
+ *   safe), but the conversion to RGB is split into horizontal bands of rows, which
+ *   are converted in parallel on the global thread pool. Partial results are reported
+ *   via progress() as bands complete, and a job that is superseded by a request
+ *   needing a different frame is canceled.
+ *
+ * index images
+ *   when a cached pixel pipeline is used, frames are first quantized into a colormap
+ *   independent IndexImage (per view, mipmap level, frame rectangle and clip range),
+ *   which is kept in its own cache. Colormap, invert, reverse and color mix changes then
+ *   only need a table lookup per pixel, without reading the raw data again.
+ *
+ * pixel pipeline caching
+ *   the lookup tables of the cached pixel pipelines come from the process-wide
+ *   PipelineLutCache, so views with identical colormap settings share a single table.
+ *   Setting a pipeline with the same cache id as the current one is a no-op.
+ *
  * Note that the rendering service does not have any convenience APIs for manipulating
  * colormaps/pixel pipelines. It is up to the caller to set this up. The reason is to keep
  * the responisibilities to a minimum. Also, this class would not benefit from knowing the
@@ -32,11 +56,15 @@
 #include "CartaLib/IImage.h"
 #include "CartaLib/PixelPipeline/IPixelPipeline.h"
 #include "CartaLib/Nullable.h"
+#include "Algorithms/MipmapPyramid.h"
+#include "Algorithms/PipelineLutCache.h"
+#include "Algorithms/IndexImage.h"
+#include "CacheManager.h"
 #include <QImage>
 #include <QObject>
 #include <QStringList>
-#include <QCache>
 #include <QTimer>
+#include <QFutureWatcher>
 
 namespace Carta
 {
@@ -108,6 +136,26 @@ struct PixelPipelineCacheSettings {
     bool interpolated = true;
 };
 
+/// mipmap settings
+struct MipmapSettings {
+    /// whether pyramid levels are used when zoomed out
+    bool enabled = true;
+
+    /// how are blocks of pixels reduced into one
+    Algorithms::MipmapPyramid::Reduction reduction = Algorithms::MipmapPyramid::Reduction::Mean;
+};
+
+/// what part of the input view gets converted to RGB
+enum class RenderMode {
+    /// the whole input view is converted and then scaled to the output,
+    /// panning/zooming is cheap after that
+    FullFrame,
+
+    /// only the data visible in the output is converted, so the cost is
+    /// proportional to the size of the viewport rather than the size of the data
+    Viewport
+};
+
 /// Implementation of the rendering service
 /// \warning this object could potentially live it a separate thread, so make all connections
 /// to it as explicitly queued
@@ -146,12 +194,16 @@ public:
     ///
     /// \brief sets the input data (view) for rendering
     /// \param view pointer to the view
-    /// \param cacheId unique id for this view, used for caching some information
+    /// \param cacheKey unique key for this view, used for caching some information
     /// if not supplied, it will be assumed it's different from any views seen before (i.e.
     /// caching will not be used)
     ///
     void
-    setInputView( NdArray::RawViewInterface::SharedPtr view, QString cacheId = QString() );
+    setInputView( NdArray::RawViewInterface::SharedPtr view, CacheKey cacheKey = CacheKey() );
+
+    /// convenience version of setInputView() taking a string id, which is hashed
+    void
+    setInputView( NdArray::RawViewInterface::SharedPtr view, const QString & cacheId );
 
     ///
     /// \brief set the desired output size of the image
@@ -188,6 +240,8 @@ public:
     /// \brief sets the pixel pipeline (non-cached) to be used to render the image
     /// \param pixelPipeline
     ///
+    /// \param cacheId cache id of the pipeline, it is only hashed when it changes
+    ///
     /// if pixel pipeline caching is enabled, the cache will be updated
     void
     setPixelPipeline( IClippedPixelPipeline::SharedPtr pixelPipeline, QString cacheId );
@@ -200,6 +254,22 @@ public:
     const PixelPipelineCacheSettings &
     pixelPipelineCacheSettings() const;
 
+    /// set settings that control the use of mipmaps
+    void
+    setMipmapSettings( const MipmapSettings & params );
+
+    /// get the current mipmap settings
+    const MipmapSettings &
+    mipmapSettings() const;
+
+    /// set the render mode (see RenderMode)
+    void
+    setRenderMode( RenderMode mode );
+
+    /// get the current render mode
+    RenderMode
+    renderMode() const;
+
     /// convert image coordinates to screen coordinates
     /// \param p coordinates to convert
     /// \return converted coordinates
@@ -253,11 +323,63 @@ protected slots:
     /// internal helper, this will execute in our own thread
     void internalRenderSlot();
 
+    /// internal helper, called when some bands of the frame job have been converted
+    void frameJobProgressSlot();
+
+    /// internal helper, called when all bands of the frame job have been converted
+    void frameJobFinishedSlot();
+
 private:
 
+    /// state of a frame being converted on the thread pool (defined in .cpp)
+    struct FrameJob;
+
+    /// mark the frame image as needing to be recomputed
+    void
+    invalidateFrame();
+
+    /// compute the frame cache key from the current rendering parameters
+    /// \return the key, null if the frame cannot be cached
+    CacheKey
+    frameCacheKey();
+
+    /// compute the rectangle of the input view (in image coordinates) that needs to be
+    /// converted, i.e. the whole view in full frame mode, or the visible part of it
+    /// in viewport mode
+    QRect
+    neededFrameRect();
+
+    /// figure out which mipmap level should be rendered for the current zoom, creating
+    /// the pyramid for the input view if needed
+    /// \return the level, 0 for full resolution
+    int
+    neededMipmapLevel();
+
+    /// compute the key of the index image for the given frame, null if the index
+    /// image cannot be cached
+    CacheKey
+    indexCacheKey( const QRect & rect, int level, double clipMin, double clipMax );
+
+    /// start converting the given rectangle of the input view into a frame image
+    /// on the thread pool, using the given mipmap level
+    void
+    startFrameJob( const QRect & rect, int level );
+
+    /// draw the frame image, representing the given rectangle of the input, into
+    /// an output image, applying the current pan/zoom
+    QImage
+    composeOutput( const QImage & frameImage, const QRect & frameRect );
+
+    /// emit done() with the output image and insert it into the frame cache
+    void
+    reportResult( QImage img );
+
     // the following are rendering parameters
     NdArray::RawViewInterface::SharedPtr m_inputView = nullptr;
-    QString m_inputViewCacheId;
+    CacheKey m_inputViewKey;
+    CacheKey m_pixelPipelineKey;
+
+    /// the id m_pixelPipelineKey was hashed from
     QString m_pixelPipelineCacheId;
     QSize m_outputSize = QSize( 10, 10 );
 
@@ -270,21 +392,54 @@ private:
     /// current pan (coordinates of the image pixel that is to be centered on the screen)
     QPointF m_pan = QPointF( 0, 0 );
 
-    // cached pipelines
-    Lib::PixelPipeline::CachedPipeline < true >::UniquePtr m_cachedPPinterp = nullptr;
-    Lib::PixelPipeline::CachedPipeline < false >::UniquePtr m_cachedPP = nullptr;
+    // cached pipelines, obtained from the PipelineLutCache
+    // these are immutable and shared with the frame job, as the worker threads keep
+    // using them even if the pipeline is replaced in the meantime
+    Algorithms::PipelineLutCache::InterpolatedLut m_cachedPPinterp = nullptr;
+    Algorithms::PipelineLutCache::NearestLut m_cachedPP = nullptr;
     PixelPipelineCacheSettings m_pixelPipelineCacheSettings;
 
-    /// here we store the whole frame rendered, it is essentially a cache to make
-    /// pan/zoom to work faster
+    /// here we store the rendered frame (the whole input view, or just the visible part
+    /// of it in viewport mode), it is essentially a cache to make pan/zoom to work faster
     QImage m_frameImage;
 
+    /// rectangle of the input view represented by m_frameImage
+    QRect m_frameRect;
+
+    /// mipmap level of m_frameImage
+    int m_frameLevel = 0;
+
+    /// mipmap settings
+    MipmapSettings m_mipmapSettings;
+
+    /// mipmap pyramid of the current input view (created lazily)
+    Algorithms::MipmapPyramid::SharedPtr m_pyramid = nullptr;
+
+    /// pyramids of the views we have seen recently, keyed by view id
+    ManagedCache < Algorithms::MipmapPyramid > m_pyramidCache { "pyramid" };
+
+    /// current render mode
+    RenderMode m_renderMode = RenderMode::FullFrame;
+
     /// cache for individual frames (to make movie playing little bit faster)
-    QCache < QString, QImage > m_frameCache;
+    ManagedCache < QImage > m_frameCache { "frame" };
+
+    /// cache for index images
+    ManagedCache < Algorithms::IndexImage > m_indexCache { "index" };
 
     /// last requested job id
     JobId m_lastSubmittedJobId = -1;
 
+    /// incremented every time the frame image needs to be recomputed, used to
+    /// figure out whether a running frame job is still useful
+    int64_t m_frameGeneration = 0;
+
+    /// the frame job currently running on the thread pool, if any
+    std::shared_ptr < FrameJob > m_frameJob = nullptr;
+
+    /// watcher for the running frame job
+    QFutureWatcher < void > m_frameJobWatcher;
+
     /// timer to make sure we only fire one render signal even if multiple requests
     /// are submitted
     QTimer m_renderTimer;
@@ -38,7 +38,7 @@ void ImageSaveService::setOutputSize( QSize size ){
 }
 
 
-void ImageSaveService::setInputView( std::shared_ptr<NdArray::RawViewInterface> view, const QString& viewId ){
+void ImageSaveService::setInputView( std::shared_ptr<NdArray::RawViewInterface> view, const Carta::Core::CacheKey& viewId ){
     m_inputView = view;
     m_inputViewId = viewId;
 }
@@ -66,7 +66,7 @@ public:
     /// data being displayed.
     /// \param view - the data
     /// \param viewId - an identifier for the data being displayed.
-    void setInputView( std::shared_ptr<NdArray::RawViewInterface> view, const QString& viewId );
+    void setInputView( std::shared_ptr<NdArray::RawViewInterface> view, const Carta::Core::CacheKey& viewId );
 
     /// specify zoom
     /// \param zoom how many screen pixels does a data pixel occupy on screen
@@ -108,7 +108,7 @@ private:
 
     /// Input data and id.
     std::shared_ptr<NdArray::RawViewInterface> m_inputView;
-    QString m_inputViewId;
+    Carta::Core::CacheKey m_inputViewId;
 
     /// Full path of the output image
     QString m_outputFilename;
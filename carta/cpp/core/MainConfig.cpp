@@ -15,6 +15,24 @@
 
 namespace MainConfig {
 
+/// parse an optional non-negative integer setting, given as a string
+/// \return the value, or -1 if the setting is missing or invalid
+static int parseSize( const QJsonObject & json, const QString & key )
+{
+    if ( ! json.contains( key ) ){
+        return -1;
+    }
+    // accept both numbers and strings
+    QJsonValue jsonValue = json[ key];
+    bool validInt = jsonValue.isDouble();
+    int value = validInt ? jsonValue.toInt() : jsonValue.toString().toInt( &validInt );
+    if ( ! validInt || value < 0 ){
+        qWarning() << key << "must be a non-negative integer.";
+        return -1;
+    }
+    return value;
+}
+
 ParsedInfo parse(const QString & filePath)
 {
     qDebug() << "Parsing global settings from" << filePath;
@@ -98,6 +116,22 @@ ParsedInfo parse(const QString & filePath)
         qWarning() << "Maximum contour level count must be a number.";
     }
 
+    // cache budgets
+    info.m_cacheSizeMb = parseSize( json, "cacheSizeMb" );
+    info.m_frameCacheSizeMb = parseSize( json, "frameCacheSizeMb" );
+    info.m_indexCacheSizeMb = parseSize( json, "indexCacheSizeMb" );
+    info.m_pyramidCacheSizeMb = parseSize( json, "pyramidCacheSizeMb" );
+    info.m_tileCacheSizeMb = parseSize( json, "tileCacheSizeMb" );
+    info.m_statisticsCacheSizeMb = parseSize( json, "statisticsCacheSizeMb" );
+    info.m_distributionCacheSizeMb = parseSize( json, "distributionCacheSizeMb" );
+
+    // statistics index
+    if ( json.contains( "statisticsDir" ) ){
+        QString raw = json[ "statisticsDir"].toString();
+        raw.replace( "$(HOME)", QDir::homePath());
+        info.m_statisticsDirectory = raw.isEmpty() ? QString( "" ) : QDir::cleanPath( raw );
+    }
+
     return info;
 }
 
@@ -123,6 +157,38 @@ int ParsedInfo::getHistogramBinCountMax() const {
     return m_histogramBinCountMax;
 }
 
+int ParsedInfo::getCacheSizeMb() const {
+    return m_cacheSizeMb;
+}
+
+int ParsedInfo::getFrameCacheSizeMb() const {
+    return m_frameCacheSizeMb;
+}
+
+int ParsedInfo::getIndexCacheSizeMb() const {
+    return m_indexCacheSizeMb;
+}
+
+int ParsedInfo::getPyramidCacheSizeMb() const {
+    return m_pyramidCacheSizeMb;
+}
+
+int ParsedInfo::getTileCacheSizeMb() const {
+    return m_tileCacheSizeMb;
+}
+
+int ParsedInfo::getStatisticsCacheSizeMb() const {
+    return m_statisticsCacheSizeMb;
+}
+
+int ParsedInfo::getDistributionCacheSizeMb() const {
+    return m_distributionCacheSizeMb;
+}
+
+QString ParsedInfo::getStatisticsDirectory() const {
+    return m_statisticsDirectory;
+}
+
 } // namespace MainConfig
 
 
@@ -5,8 +5,8 @@
 
 #pragma once
 
+#include <QString>
 #include <QStringList>
-class QString;
 
 namespace MainConfig {
 
@@ -39,6 +39,54 @@ public:
      */
     int getContourLevelCountMax() const;
 
+    /**
+     * Returns the process-wide memory budget of the render caches in megabytes,
+     * or -1 if no valid value has been provided.
+     */
+    int getCacheSizeMb() const;
+
+    /**
+     * Returns the memory budget of the rendered frame cache in megabytes,
+     * or -1 if no valid value has been provided.
+     */
+    int getFrameCacheSizeMb() const;
+
+    /**
+     * Returns the memory budget of the index image cache in megabytes (0 disables
+     * the index images), or -1 if no valid value has been provided.
+     */
+    int getIndexCacheSizeMb() const;
+
+    /**
+     * Returns the memory budget of the mipmap pyramid cache in megabytes,
+     * or -1 if no valid value has been provided.
+     */
+    int getPyramidCacheSizeMb() const;
+
+    /**
+     * Returns the memory budget of the decoded image tile cache in megabytes (0 disables
+     * the tile cache), or -1 if no valid value has been provided.
+     */
+    int getTileCacheSizeMb() const;
+
+    /**
+     * Returns the memory budget of the plane statistics cache in megabytes (0 keeps
+     * them in the statistics files only), or -1 if no valid value has been provided.
+     */
+    int getStatisticsCacheSizeMb() const;
+
+    /**
+     * Returns the memory budget of the cumulative distribution cache, used for percentile
+     * lookups, in megabytes, or -1 if no valid value has been provided.
+     */
+    int getDistributionCacheSizeMb() const;
+
+    /**
+     * Returns the directory of the per-image statistics files, an empty string if
+     * the statistics should not be saved, or a null string if no value has been provided.
+     */
+    QString getStatisticsDirectory() const;
+
     /// whether hacks are enabled or not
     bool hacksEnabled() const;
 
@@ -55,6 +103,14 @@ protected:
     bool m_developerLayout = false;
     int m_histogramBinCountMax = -1;
     int m_contourLevelCountMax = -1;
+    int m_cacheSizeMb = -1;
+    int m_frameCacheSizeMb = -1;
+    int m_indexCacheSizeMb = -1;
+    int m_pyramidCacheSizeMb = -1;
+    int m_tileCacheSizeMb = -1;
+    int m_statisticsCacheSizeMb = -1;
+    int m_distributionCacheSizeMb = -1;
+    QString m_statisticsDirectory;
 
     friend ParsedInfo parse( const QString & filePath);
 };
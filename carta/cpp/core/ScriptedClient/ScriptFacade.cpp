@@ -14,6 +14,7 @@
 //#include "Data/Statistics.h"
 #include "Data/Image/Grid/GridControls.h"
 #include "Data/Image/Contour/ContourControls.h"
+#include "CacheManager.h"
 
 #include <QDebug>
 #include <cmath>
@@ -160,6 +161,19 @@ QStringList ScriptFacade::getPluginList() const {
     return resultList;
 }
 
+QStringList ScriptFacade::getCacheStatistics() const {
+    const Carta::Core::CacheManager & manager = Carta::Core::CacheManager::instance();
+    QStringList resultList;
+    resultList.append( QString( "total %1 %2" ).arg( manager.budget() ).arg( manager.totalBytes() ) );
+    for ( const Carta::Core::CacheManager::Statistics & stats : manager.statistics() ){
+        resultList.append( QString( "%1 %2 %3 %4 %5 %6 %7" )
+                .arg( stats.category ).arg( stats.budget ).arg( stats.bytes )
+                .arg( stats.entries ).arg( stats.hits ).arg( stats.misses )
+                .arg( stats.evictions ) );
+    }
+    return resultList;
+}
+
 QStringList ScriptFacade::loadFile( const QString& objectId, const QString& fileName ){
     QStringList resultList("");
     bool result = m_viewManager->loadFile( objectId, fileName );
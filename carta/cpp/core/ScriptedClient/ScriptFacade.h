@@ -214,6 +214,14 @@ public:
      */
     QStringList getPluginList() const;
 
+    /**
+     * Returns the usage counters of the render caches, one line per cache category
+     * in the form "category budget bytes entries hits misses evictions", preceded by
+     * a line with the process-wide budget and usage.
+     * @return a list of cache counters.
+     */
+    QStringList getCacheStatistics() const;
+
     /**
      * Set the image channel to the specified value.
      * @param animatorId the unique server-side id of an object managing an animator.
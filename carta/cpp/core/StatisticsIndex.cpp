@@ -0,0 +1,346 @@
+/**
+ *
+ **/
+
+#include "StatisticsIndex.h"
+#include "MainConfig.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <memory>
+
+namespace Carta
+{
+namespace Core
+{
+namespace
+{
+/// sidecar file format
+constexpr quint32 SidecarMagic = 0x43535458;
+constexpr quint32 SidecarVersion = 2;
+constexpr int SidecarStreamVersion = QDataStream::Qt_5_3;
+
+/// runs a function on a thread pool
+class Task : public QRunnable
+{
+public:
+
+    Task( std::function < void () > func ) : m_func( func ) { }
+
+    virtual void
+    run() override
+    {
+        m_func();
+    }
+
+private:
+
+    std::function < void () > m_func;
+};
+}
+
+StatisticsIndex &
+StatisticsIndex::instance()
+{
+    // never destroyed, background computations may outlive static destruction
+    static StatisticsIndex * index = new StatisticsIndex();
+    return * index;
+}
+
+StatisticsIndex::StatisticsIndex()
+    : m_cache( "statistics" )
+      , m_entries( "statistics" )
+{
+    m_directory = QDir::homePath() + "/.cartavis/statistics";
+    m_pool.setMaxThreadCount( 1 );
+}
+
+void
+StatisticsIndex::configure( const MainConfig::ParsedInfo & config )
+{
+    QString directory = config.getStatisticsDirectory();
+    if ( ! directory.isNull() ) {
+        setDirectory( directory );
+    }
+    qDebug() << "Statistics directory:" << this-> directory();
+}
+
+void
+StatisticsIndex::setDirectory( const QString & directory )
+{
+    QMutexLocker locker( & m_mutex );
+    m_directory = directory;
+
+    // the sidecar files have to be read again
+    m_entries.clear();
+}
+
+QString
+StatisticsIndex::directory() const
+{
+    QMutexLocker locker( & m_mutex );
+    return m_directory;
+}
+
+Algorithms::PlaneStatistics::SharedPtr
+StatisticsIndex::find( const QString & imageKey, const PlaneId & plane, ViewFunc makeView )
+{
+    if ( imageKey.isEmpty() ) {
+        return nullptr;
+    }
+    CacheKey key = cacheKey( imageKey, plane );
+    Algorithms::PlaneStatistics::SharedPtr stats = m_cache.object( key );
+    if ( stats ) {
+        return stats;
+    }
+
+    QString path;
+    {
+        QMutexLocker locker( & m_mutex );
+        path = sidecarPath( imageKey );
+    }
+    if ( ! path.isEmpty() ) {
+        std::shared_ptr < ImageEntry > imageEntry = entry( imageKey, path );
+        auto iter = imageEntry-> offsets.find( plane );
+        if ( iter != imageEntry-> offsets.end() ) {
+            stats = load( path, iter-> second );
+            if ( stats ) {
+                m_cache.insert( key, stats, stats-> bytes() );
+                return stats;
+            }
+        }
+    }
+
+    // with nowhere to keep the statistics, computing them would be wasted
+    if ( ! m_cache.enabled() && path.isEmpty() ) {
+        return nullptr;
+    }
+    QMutexLocker locker( & m_mutex );
+    if ( makeView && m_pending.insert( std::make_pair( imageKey, plane ) ).second ) {
+        m_pool.start( new Task( [this, imageKey, plane, makeView] () {
+                                    compute( imageKey, plane, makeView );
+                                }
+                                ) );
+    }
+    return nullptr;
+} // find
+
+void
+StatisticsIndex::insert( const QString & imageKey, const PlaneId & plane,
+                         Algorithms::PlaneStatistics::SharedPtr stats )
+{
+    if ( imageKey.isEmpty() || ! stats ) {
+        return;
+    }
+    m_cache.insert( cacheKey( imageKey, plane ), stats, stats-> bytes() );
+
+    // a plane computed in the background right now is written by that computation
+    QMutexLocker locker( & m_mutex );
+    if ( ! sidecarPath( imageKey ).isEmpty()
+         && m_pending.insert( std::make_pair( imageKey, plane ) ).second ) {
+        m_pool.start( new Task( [this, imageKey, plane, stats] () {
+                                    publish( imageKey, plane, stats );
+                                }
+                                ) );
+    }
+}
+
+void
+StatisticsIndex::waitForDone()
+{
+    m_pool.waitForDone();
+}
+
+CacheKey
+StatisticsIndex::cacheKey( const QString & imageKey, const PlaneId & plane )
+{
+    return CacheKey::fromString( imageKey ).with( plane.axisX ).with( plane.axisY )
+               .with( plane.index );
+}
+
+QString
+StatisticsIndex::sidecarPath( const QString & imageKey ) const
+{
+    if ( m_directory.isEmpty() ) {
+        return QString();
+    }
+
+    // one file per path, so that the file of a modified image is rewritten instead
+    // of left behind
+    QString path = imageKey.section( '|', 0, - 3 );
+    QByteArray hash = QCryptographicHash::hash( path.toUtf8(), QCryptographicHash::Sha1 );
+    return m_directory + "/" + QString::fromLatin1( hash.toHex() ) + ".stats";
+}
+
+int64_t
+StatisticsIndex::ImageEntry::bytes() const
+{
+    return sizeof( ImageEntry ) + offsets.size() * sizeof( std::pair < const PlaneId, qint64 > );
+}
+
+std::shared_ptr < StatisticsIndex::ImageEntry >
+StatisticsIndex::entry( const QString & imageKey, const QString & path )
+{
+    CacheKey key = CacheKey::fromString( imageKey );
+    std::shared_ptr < ImageEntry > imageEntry = m_entries.object( key );
+    if ( imageEntry ) {
+        return imageEntry;
+    }
+    imageEntry = scan( path, imageKey );
+
+    // unless the directory changed in the meantime
+    QMutexLocker locker( & m_mutex );
+    if ( sidecarPath( imageKey ) == path ) {
+        m_entries.insert( key, imageEntry, imageEntry-> bytes() );
+    }
+    return imageEntry;
+}
+
+std::shared_ptr < StatisticsIndex::ImageEntry >
+StatisticsIndex::scan( const QString & path, const QString & imageKey )
+{
+    std::shared_ptr < ImageEntry > entry = std::make_shared < ImageEntry > ();
+    QFile file( path );
+    if ( ! file.open( QIODevice::ReadOnly ) ) {
+        return entry;
+    }
+    QDataStream in( & file );
+    in.setVersion( SidecarStreamVersion );
+    quint32 magic = 0, version = 0;
+    QString key;
+    in >> magic >> version >> key;
+    if ( in.status() != QDataStream::Ok || magic != SidecarMagic
+         || version != SidecarVersion || key != imageKey ) {
+        return entry;
+    }
+    entry-> headerValid = true;
+
+    // note where the records are, a truncated record ends the scan
+    const qint64 size = file.size();
+    while ( ! in.atEnd() ) {
+        PlaneId plane;
+        qint32 axisX = 0, axisY = 0;
+        qint64 index = 0, length = 0;
+        in >> axisX >> axisY >> index >> length;
+        qint64 offset = file.pos();
+        if ( in.status() != QDataStream::Ok || length < 0 || offset + length > size ) {
+            break;
+        }
+        plane.axisX = axisX;
+        plane.axisY = axisY;
+        plane.index = index;
+        entry-> offsets[plane] = offset;
+        file.seek( offset + length );
+    }
+    return entry;
+} // scan
+
+Algorithms::PlaneStatistics::SharedPtr
+StatisticsIndex::load( const QString & path, qint64 offset )
+{
+    QFile file( path );
+    if ( ! file.open( QIODevice::ReadOnly ) || ! file.seek( offset ) ) {
+        return nullptr;
+    }
+    QDataStream in( & file );
+    in.setVersion( SidecarStreamVersion );
+    return Algorithms::PlaneStatistics::read( in );
+}
+
+bool
+StatisticsIndex::store( const QString & path, const QString & imageKey, ImageEntry & entry,
+                        const PlaneId & plane, const Algorithms::PlaneStatistics & stats )
+{
+    if ( ! QDir().mkpath( QFileInfo( path ).absolutePath() ) ) {
+        return false;
+    }
+    QByteArray record;
+    {
+        QDataStream out( & record, QIODevice::WriteOnly );
+        out.setVersion( SidecarStreamVersion );
+        stats.write( out );
+    }
+
+    // start a new file if there is none, or if it belongs to an older version of the image
+    QFile file( path );
+    if ( ! entry.headerValid ) {
+        if ( ! file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+            qWarning() << "Could not write statistics to" << path;
+            return false;
+        }
+        QDataStream out( & file );
+        out.setVersion( SidecarStreamVersion );
+        out << SidecarMagic << SidecarVersion << imageKey;
+        entry.headerValid = true;
+        entry.offsets.clear();
+    }
+    else if ( ! file.open( QIODevice::WriteOnly | QIODevice::Append ) ) {
+        qWarning() << "Could not write statistics to" << path;
+        return false;
+    }
+    QDataStream out( & file );
+    out.setVersion( SidecarStreamVersion );
+    out << qint32( plane.axisX ) << qint32( plane.axisY ) << qint64( plane.index )
+        << qint64( record.size() );
+    qint64 offset = file.pos();
+    if ( file.write( record ) != record.size() ) {
+        return false;
+    }
+    entry.offsets[plane] = offset;
+    return true;
+} // store
+
+void
+StatisticsIndex::compute( const QString & imageKey, const PlaneId & plane, ViewFunc makeView )
+{
+    Algorithms::PlaneStatistics::SharedPtr stats;
+    try {
+        std::unique_ptr < NdArray::RawViewInterface > view( makeView() );
+        if ( view ) {
+            stats = Algorithms::PlaneStatistics::compute( view.get() );
+        }
+    }
+    catch ( std::exception & err ) {
+        qWarning() << "Could not compute plane statistics:" << err.what();
+    }
+
+    publish( imageKey, plane, stats );
+} // compute
+
+void
+StatisticsIndex::publish( const QString & imageKey, const PlaneId & plane,
+                          Algorithms::PlaneStatistics::SharedPtr stats )
+{
+    if ( stats ) {
+        m_cache.insert( cacheKey( imageKey, plane ), stats, stats-> bytes() );
+    }
+    QString path;
+    {
+        QMutexLocker locker( & m_mutex );
+        m_pending.erase( std::make_pair( imageKey, plane ) );
+        path = sidecarPath( imageKey );
+    }
+    if ( ! stats || path.isEmpty() ) {
+        return;
+    }
+
+    // only planes find() missed get here, so the record is missing or unreadable: append
+    // it to a copy of the entry, and publish the copy once the record is written (the
+    // background tasks run one at a time, so there is only one writer)
+    std::shared_ptr < ImageEntry > updated =
+        std::make_shared < ImageEntry > ( * entry( imageKey, path ) );
+    if ( ! store( path, imageKey, * updated, plane, * stats ) ) {
+        return;
+    }
+    QMutexLocker locker( & m_mutex );
+    if ( sidecarPath( imageKey ) == path ) {
+        m_entries.insert( CacheKey::fromString( imageKey ), updated, updated-> bytes() );
+    }
+} // publish
+}
+}
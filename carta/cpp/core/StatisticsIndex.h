@@ -0,0 +1,183 @@
+/**
+ * Process-wide index of per-plane image statistics.
+ *
+ * Auto-clip, getIntensity() and getPercentile() used to read the whole plane every time
+ * they were asked, and the few clip values that were remembered were forgotten as soon
+ * as another file was loaded. The index keeps the PlaneStatistics of every plane that
+ * was looked at instead: the count, NaN count, range, sums, a histogram and a quantile
+ * sketch, from which those questions are answered without touching the pixels.
+ *
+ * Statistics are computed lazily: find() returns what is known, and schedules the
+ * computation of a missing plane on a background thread, unless the caller reads the plane
+ * anyway and computes them itself, see insert(). Computed statistics are kept in
+ * the "statistics" category of the CacheManager, and appended to a sidecar file in
+ * directory(), one per image, so they are still there after a restart. The images are
+ * identified by ImageRegistry::key(), i.e. their canonical path, modification time and
+ * size, so the statistics of a file that changed on disk are computed again.
+ *
+ * A sidecar file has a header (magic, version and image key) followed by records of a
+ * plane id and its statistics. Files with a different header are rewritten, and a
+ * truncated last record (e.g. after a crash) is ignored.
+ *
+ * The record offsets of a sidecar file are kept in the cache as well, so the index of an
+ * image that is no longer used is evicted with its statistics. The files are read and
+ * written without holding the mutex, which only guards the published state: find() may
+ * read a sidecar file on the calling thread, but never waits for a background write.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include "CacheManager.h"
+#include "Algorithms/PlaneStatistics.h"
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <utility>
+
+namespace MainConfig
+{
+class ParsedInfo;
+}
+
+namespace Carta
+{
+namespace Core
+{
+class StatisticsIndex
+{
+    CLASS_BOILERPLATE( StatisticsIndex );
+
+public:
+
+    /// identifies a plane of an image
+    struct PlaneId {
+        /// the display axes
+        int axisX = 0;
+        int axisY = 1;
+
+        /// index of the plane among all the planes of the other axes, in the order of
+        /// the image axes, with the first axis varying fastest
+        int64_t index = 0;
+
+        bool
+        operator< ( const PlaneId & other ) const
+        {
+            return std::tie( axisX, axisY, index )
+                   < std::tie( other.axisX, other.axisY, other.index );
+        }
+    };
+
+    /// function used to make a view of a plane, called on a background thread
+    typedef std::function < NdArray::RawViewInterface * () > ViewFunc;
+
+    /// the process-wide instance
+    static StatisticsIndex &
+    instance();
+
+    StatisticsIndex();
+
+    /// set the directory of the sidecar files from the main config file
+    void
+    configure( const MainConfig::ParsedInfo & config );
+
+    /// set the directory of the sidecar files, an empty string disables them
+    void
+    setDirectory( const QString & directory );
+
+    QString
+    directory() const;
+
+    /// find the statistics of a plane, from memory or from the sidecar file
+    /// \param imageKey the key of the image (see ImageRegistry::key()), if empty
+    ///        there are no statistics
+    /// \param plane the plane
+    /// \param makeView if not null and the statistics are not known, used to compute
+    ///        them in the background
+    /// \return the statistics, or nullptr if they are not known (yet)
+    Algorithms::PlaneStatistics::SharedPtr
+    find( const QString & imageKey, const PlaneId & plane, ViewFunc makeView = nullptr );
+
+    /// add the statistics of a plane computed by the caller (e.g. while it was reading
+    /// the plane anyway), they are written to the sidecar file in the background
+    void
+    insert( const QString & imageKey, const PlaneId & plane,
+            Algorithms::PlaneStatistics::SharedPtr stats );
+
+    /// wait for all the background computations to finish
+    void
+    waitForDone();
+
+private:
+
+    /// what is known about the sidecar file of an image, never modified once it is
+    /// in the cache, so it can be used without holding the mutex
+    struct ImageEntry {
+        /// does the sidecar file have the right header
+        bool headerValid = false;
+
+        /// offsets of the records in the sidecar file
+        std::map < PlaneId, qint64 > offsets;
+
+        /// how much memory the entry occupies
+        int64_t
+        bytes() const;
+    };
+
+    /// the memory cache key of a plane
+    static CacheKey
+    cacheKey( const QString & imageKey, const PlaneId & plane );
+
+    /// path of the sidecar file of an image, empty if they are disabled
+    /// (caller must hold the mutex)
+    QString
+    sidecarPath( const QString & imageKey ) const;
+
+    /// the entry of an image, from the cache or from its sidecar file
+    /// \param path the sidecar file, as returned by sidecarPath()
+    std::shared_ptr < ImageEntry >
+    entry( const QString & imageKey, const QString & path );
+
+    /// read the header and the record offsets of a sidecar file
+    static std::shared_ptr < ImageEntry >
+    scan( const QString & path, const QString & imageKey );
+
+    /// read a record of a sidecar file
+    static Algorithms::PlaneStatistics::SharedPtr
+    load( const QString & path, qint64 offset );
+
+    /// append a record to a sidecar file, and note its offset in the entry
+    /// \return was the record written
+    static bool
+    store( const QString & path, const QString & imageKey, ImageEntry & entry,
+           const PlaneId & plane, const Algorithms::PlaneStatistics & stats );
+
+    /// compute the statistics of a plane, on a background thread
+    void
+    compute( const QString & imageKey, const PlaneId & plane, ViewFunc makeView );
+
+    /// keep the statistics of a plane and append them to the sidecar file, on a
+    /// background thread, the plane is no longer pending afterwards
+    void
+    publish( const QString & imageKey, const PlaneId & plane,
+             Algorithms::PlaneStatistics::SharedPtr stats );
+
+    mutable QMutex m_mutex;
+    ManagedCache < Algorithms::PlaneStatistics > m_cache;
+    ManagedCache < ImageEntry > m_entries;
+    QString m_directory;
+
+    /// planes computed in the background right now
+    std::set < std::pair < QString, PlaneId > > m_pending;
+
+    /// background computations, one at a time, each of them is parallel already
+    QThreadPool m_pool;
+};
+}
+}
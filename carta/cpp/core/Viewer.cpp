@@ -110,7 +110,7 @@ Viewer::start()
 
     if ( fname.length() > 0 ) {
         QString controlId = m_viewManager->getObjectId( Carta::Data::Controller::PLUGIN_NAME, 0);
-        m_viewManager->loadFile( controlId, fname );
+        m_viewManager->loadFile( controlId, fname, true );
     }
 
     qDebug() << "Viewer has been initialized.";
@@ -7,6 +7,7 @@ TEMPLATE = lib
 ###CONFIG += staticlib
 QT += widgets network
 QT += xml
+QT += concurrent
 
 HEADERS += \
     IConnector.h \
@@ -19,9 +20,17 @@ HEADERS += \
     Globals.h \
     Algorithms/Graphs/TopoSort.h \
     Algorithms/RawView2QImageConverter.h \
+    Algorithms/MipmapPyramid.h \
+    Algorithms/PixelRowCache.h \
+    Algorithms/PipelineLutCache.h \
+    Algorithms/IndexImage.h \
     stable.h \
     CmdLine.h \
     MainConfig.h \
+    CacheKey.h \
+    CacheManager.h \
+    ImageRegistry.h \
+    StatisticsIndex.h \
     State/ObjectManager.h \
     State/StateInterface.h \
     State/UtilState.h \
@@ -89,6 +98,10 @@ HEADERS += \
     ScriptedClient/ScriptedCommandListener.h \
     ScriptedClient/ScriptFacade.h \
     Algorithms/quantileAlgorithms.h \
+    Algorithms/ParallelForEach.h \
+    Algorithms/PlaneStatistics.h \
+    Algorithms/CumulativeDistribution.h \
+    Algorithms/FineHistogram.h \
     ScriptedClient/Listener.h \
     ScriptedClient/ScriptedCommandInterpreter.h \
     ScriptedClient/VarLengthMessage.h \
@@ -115,6 +128,9 @@ SOURCES += \
     Algorithms/Graphs/TopoSort.cpp \
     CmdLine.cpp \
     MainConfig.cpp \
+    CacheManager.cpp \
+    ImageRegistry.cpp \
+    StatisticsIndex.cpp \
     State/ObjectManager.cpp\
     State/StateInterface.cpp \
     State/UtilState.cpp \
@@ -169,6 +185,10 @@ SOURCES += \
     Data/ViewPlugins.cpp \
     GrayColormap.cpp \
     Algorithms/RawView2QImageConverter.cpp \
+    Algorithms/MipmapPyramid.cpp \
+    Algorithms/PixelRowCache.cpp \
+    Algorithms/PipelineLutCache.cpp \
+    Algorithms/IndexImage.cpp \
     Histogram/HistogramGenerator.cpp \
     Histogram/HistogramSelection.cpp \
     Histogram/HistogramPlot.cpp \
@@ -177,6 +197,9 @@ SOURCES += \
     ImageRenderService.cpp \
     ImageSaveService.cpp \
     Algorithms/quantileAlgorithms.cpp \
+    Algorithms/PlaneStatistics.cpp \
+    Algorithms/CumulativeDistribution.cpp \
+    Algorithms/FineHistogram.cpp \
     ScriptedClient/Listener.cpp \
     ScriptedClient/ScriptedCommandInterpreter.cpp \
     ScriptedClient/VarLengthMessage.cpp \
@@ -9,6 +9,8 @@
 #include "core/CmdLine.h"
 #include "core/MainConfig.h"
 #include "core/Globals.h"
+#include "core/CacheManager.h"
+#include "core/StatisticsIndex.h"
 #include <QDebug>
 
 ///
@@ -49,6 +51,8 @@ int main(int argc, char ** argv)
     QString configFilePath = cmdLineInfo.configFilePath();
     auto mainConfig = MainConfig::parse( configFilePath);
     globals.setMainConfig( & mainConfig);
+    Carta::Core::CacheManager::instance().configure( mainConfig);
+    Carta::Core::StatisticsIndex::instance().configure( mainConfig);
     qDebug() << "plugin directories:\n - " + mainConfig.pluginDirectories().join( "\n - ");
 
     // initialize platform
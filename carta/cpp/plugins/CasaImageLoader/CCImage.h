@@ -9,13 +9,13 @@
 #include "CartaLib/AxisInfo.h"
 #include "CCRawView.h"
 #include "CCMetaDataInterface.h"
+#include "CartaLib/PermutedImage.h"
 #include "casacore/images/Images/ImageInterface.h"
-#include "casacore/images/Images/ImageUtilities.h"
-#include "casacore/images/Images/TempImage.h"
 
 #include <QDebug>
 #include <memory>
 #include <set>
+#include <vector>
 
 /// helper base class so that we can easily determine if this is a an image
 /// interface created by this plugin if we ever want to down-cast it...
@@ -62,6 +62,9 @@ public:
         return m_unit;
     }
 
+    /// The permuted image is a Carta::Lib::PermutedImage reading from this one, so no
+    /// data is copied, and the decoded tiles are shared with this image. Only the
+    /// coordinate system is transposed.
     virtual std::shared_ptr<Image::ImageInterface>
     getPermuted(const std::vector<int> & indices ) override{
 
@@ -85,27 +88,15 @@ public:
             newOrder[i] = indices[i];
         }
         //Change the order of the axes in the coordinate system
-        casa::CoordinateSystem coordSys = m_casaII->coordinates();
-        coordSys.transpose( newOrder, newOrder );
-        casa::IPosition oldShape = m_casaII->shape();
-        casa::IPosition newShape( indexCount );
-        for ( int i = 0; i < indexCount; i++ ){
-            newShape[i] = oldShape[newOrder[i]];
-        }
-
-        //Make a new image and copy the data into it.
-        casa::ImageInterface<PType>* newImage = new casa::TempImage<PType>(casa::TiledShape( newShape), coordSys);
-        casa::Array<PType> dataCopy = m_casaII->get();
-        newImage->put( reorderArray( dataCopy, newOrder ));
-        if ( m_casaII->hasPixelMask()){
-            std::unique_ptr<casa::Lattice<casa::Bool> > maskLattice( m_casaII->pixelMask().clone());
-            casa::Array<casa::Bool> maskCopy = maskLattice->get();
-            dynamic_cast< casa::TempImage<PType> *>(newImage)->attachMask( casa::ArrayLattice<casa::Bool>(reorderArray( maskCopy, newOrder )));
-        }
-
-        //Finish the copy and create a CARTA image with permuted axes.
-        casa::ImageUtilities::copyMiscellaneous( *newImage, *m_casaII );
-        std::shared_ptr<Image::ImageInterface> permuteImage =  create( newImage);
+        std::shared_ptr<casa::CoordinateSystem> coordSys(
+                    new casa::CoordinateSystem( m_casaII->coordinates() ) );
+        coordSys->transpose( newOrder, newOrder );
+        auto meta = std::make_shared < CCMetaDataInterface > (
+                    m_meta->title( Carta::Lib::TextFormat::Html ), coordSys );
+
+        //Create a CARTA image with permuted axes that reads from this one.
+        std::shared_ptr<Image::ImageInterface> permuteImage =
+                std::make_shared < Carta::Lib::PermutedImage > ( this->shared_from_this(), indices, meta );
         return permuteImage;
     }
 
@@ -163,6 +154,38 @@ public:
         qFatal( "not implemented" );
     }
 
+    /// reads the pixel through the tile cache, so neighbouring queries (e.g. cursor
+    /// movements) do not go back to casacore
+    virtual bool
+    getPixel( const VI & pos, double & value ) override
+    {
+        if ( ! isInside( pos, 0 ) ) {
+            return false;
+        }
+        casa::IPosition blc( pos );
+        casa::IPosition unit( pos.size(), 1 );
+        PType pixel;
+        m_tileCache-> readBox( blc, unit, unit, & pixel );
+        value = pixel;
+        return true;
+    }
+
+    virtual bool
+    getRow( const VI & pos, double * row ) override
+    {
+        if ( ! isInside( pos, 1 ) ) {
+            return false;
+        }
+        casa::IPosition blc( pos );
+        blc( 0 ) = 0;
+        casa::IPosition shape( pos.size(), 1 );
+        shape( 0 ) = m_dims[0];
+        casa::IPosition unit( pos.size(), 1 );
+        m_tileCache-> readBox( blc, shape, unit, reinterpret_cast < PType * > ( row ) );
+        widenRow < PType > ( row, m_dims[0] );
+        return true;
+    }
+
     virtual Image::MetaDataInterface::SharedPtr
     metaData() override
     {
@@ -180,6 +203,7 @@ public:
         img-> m_pixelType = Image::CType2PixelType < PType >::type;
         img-> m_dims      = casaImage-> shape().asStdVector();
         img-> m_casaII    = casaImage;
+        img-> m_tileCache.reset( new CCTileCache < PType > ( casaImage ) );
         img-> m_unit      = Unit( casaImage-> units().getName().c_str() );
 
         // get title and escape html characters in case there are any
@@ -217,6 +241,22 @@ public:
     ~CCImage() { }
 
 protected:
+
+    /// is pos inside of the image, checking axes from firstAxis on
+    bool
+    isInside( const VI & pos, size_t firstAxis ) const
+    {
+        if ( pos.size() != m_dims.size() || m_dims.empty() ) {
+            return false;
+        }
+        for ( size_t i = firstAxis ; i < pos.size() ; i++ ) {
+            if ( pos[i] < 0 || pos[i] >= m_dims[i] ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     /// type of the image data
     Image::PixelType m_pixelType;
 
@@ -226,6 +266,9 @@ protected:
     /// pointer to the actual casa::ImageInterface
     casa::ImageInterface < PType > * m_casaII;
 
+    /// decoded tiles of the image, shared by all views
+    typename CCTileCache < PType >::UniquePtr m_tileCache;
+
     /// cached unit
     Unit m_unit;
 
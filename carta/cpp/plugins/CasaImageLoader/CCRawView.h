@@ -5,15 +5,19 @@
 #pragma once
 
 #include "CartaLib/IImage.h"
-#include <casacore/lattices/Lattices/LatticeStepper.h>
-#include <casacore/lattices/Lattices/LatticeIterator.h>
+#include "CCTileCache.h"
 #include <casacore/casa/Arrays/IPosition.h>
+#include <algorithm>
+#include <vector>
 
 template < typename PType >
 class CCImage;
 
 /// CasaImageLoader plugin's implementation of the raw view
 ///
+/// All data is read through the tile cache of the image, so views of the same plane
+/// share the decoded data.
+///
 /// \warning We are not handling negative step
 /// \warning We are not handling 'index' slices, i.e. axis removal
 ///
@@ -65,56 +69,59 @@ public:
         return new CCRawView( m_ccimage, newAr);
     }
 
+    /// read the next buffSize bytes of the view, starting at the position set by seek()
     virtual int64_t
     read( int64_t buffSize, char * buff,
-          Traversal traversal = Traversal::Sequential ) override
-    {
-        Q_UNUSED( buffSize);
-        Q_UNUSED( buff);
-        Q_UNUSED( traversal);
-        qFatal( "not implemented");
-    }
+          Traversal traversal = Traversal::Sequential ) override;
 
+    /// set the position (in elements) of the next read()
     virtual void
-    seek(int64_t ind) override
-    {
-        Q_UNUSED( ind);
-        qFatal( "not implemented");
-    }
+    seek( int64_t ind ) override;
 
     /// another high performance accessor to data
     /// motivated by unix read() but stateless (i.e. one needs to supply the
     /// chunk number)
     virtual int64_t
     read( int64_t chunk, int64_t buffSize, char * buff,
-          Traversal traversal = Traversal::Sequential ) override
-    {
-        Q_UNUSED( chunk );
-        Q_UNUSED( buffSize );
-        Q_UNUSED( buff );
-        Q_UNUSED( traversal );
-        qFatal( "not implemented" );
-    }
+          Traversal traversal = Traversal::Sequential ) override;
 
     /// yet another high performance accessor... similar to forEach above,
     /// but this time the supplied function gets called with whatever number
     /// elements that fit into the buffer
+    ///
+    /// The view is read in blocks of at most buffSize bytes, so the memory used does
+    /// not depend on the size of the view.
+    ///
+    /// With Traversal::Optimal the blocks follow the tiles of the image, so every tile
+    /// is visited only once, but the blocks are not in sequential order.
     virtual void
     forEach(
         int64_t buffSize,
         std::function < void (const char *, int64_t count) > func,
         char * buff = nullptr,
-        Traversal traversal = Traversal::Sequential ) override
-    {
-        Q_UNUSED( buffSize );
-        Q_UNUSED( func );
-        Q_UNUSED( buff );
-        Q_UNUSED( traversal );
-        qFatal( "not implemented" );
-    }
+        Traversal traversal = Traversal::Sequential ) override;
 
 protected:
 
+    /// default block size (in elements) used by the element-wise forEach()
+    static constexpr int64_t DefaultChunkSize = 1024 * 1024;
+
+    /// total number of elements in the view
+    int64_t
+    nElements() const;
+
+    /// forEach() for Traversal::Optimal, visits the view tile by tile
+    void
+    forEachTile(
+        int64_t maxElements,
+        std::function < void (const char *, int64_t count) > func,
+        char * buff );
+
+    /// read elements [start, start+count) of the view in sequential order
+    /// \return number of elements read
+    int64_t
+    readElements( int64_t start, int64_t count, PType * out );
+
     /// construct a view directly from applied slice
     CCRawView( CCImage < PType > * ccimage, const SliceND::ApplyResult & applyResult );
 
@@ -127,7 +134,10 @@ protected:
     PType m_buff;
 
     // minicache to make get() a little bit faster
-    VI m_destPos;
+    casa::IPosition m_destPos, m_unitShape;
+
+    // position (in elements) of the next stateful read()
+    int64_t m_readPos = 0;
 };
 
 // public constructor
@@ -147,6 +157,7 @@ CCRawView < PType >::CCRawView( CCImage < PType > * ccimage, const SliceND & sli
 
     // prepare destPos mini cache
     m_destPos.resize( m_viewDims.size());
+    m_unitShape = casa::IPosition( m_viewDims.size(), 1 );
 }
 
 // protected constructor
@@ -169,6 +180,7 @@ CCRawView < PType >::CCRawView( CCImage < PType > * ccimage, const SliceND::Appl
 
     // prepare destPos mini cache
     m_destPos.resize( m_viewDims.size());
+    m_unitShape = casa::IPosition( m_viewDims.size(), 1 );
 }
 
 template < typename PType >
@@ -195,11 +207,9 @@ CCRawView < PType >::get( const NdArray::RawViewInterface::VI & pos )
                        + p * m_appliedSlice.dims()[i].step;
     }
 
-    // for some reason casa::ImageInterface::operator() returns the result by value
-    // so in order to return reference (to satisfy our API) we need to store this
-    // in a buffer first...
-    m_buff = m_ccimage-> m_casaII->
-                 operator() ( m_destPos );
+    // we need to return a pointer (to satisfy our API), so the value is read into
+    // a buffer first... from its tile if that is cached, otherwise from casacore
+    m_ccimage-> m_tileCache-> readBox( m_destPos, m_unitShape, m_unitShape, & m_buff );
 
     return reinterpret_cast < const char * > ( & m_buff );
 } // get
@@ -210,48 +220,208 @@ CCRawView < PType >::forEach(
     std::function < void (const char *) > func,
     NdArray::RawViewInterface::Traversal traversal )
 {
+    // visit the elements block by block, instead of reading the whole view at once
+    auto chunkFunc = [&func] ( const char * data, int64_t count ) {
+        const PType * ptr = reinterpret_cast < const PType * > ( data );
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            func( reinterpret_cast < const char * > ( ptr + i ) );
+        }
+    };
+    forEach( DefaultChunkSize * sizeof( PType ), chunkFunc, nullptr, traversal );
+} // forEach
+
+template < typename PType >
+void
+CCRawView < PType >::forEach(
+    int64_t buffSize,
+    std::function < void (const char *, int64_t count) > func,
+    char * buff,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    CARTA_ASSERT( buffSize >= int64_t( sizeof( PType ) ) );
+    int64_t maxElements = buffSize / sizeof( PType );
+    int64_t total = nElements();
+    if ( total == 0 ) {
+        return;
+    }
     if ( traversal == NdArray::RawViewInterface::Traversal::Optimal ) {
-        qFatal( "sorry, not implemented yet" );
+        forEachTile( maxElements, func, buff );
+        return;
+    }
+
+    std::vector < PType > localBuff;
+    PType * out = reinterpret_cast < PType * > ( buff );
+    if ( ! out ) {
+        localBuff.resize( std::min( maxElements, total ) );
+        out = localBuff.data();
     }
-    auto casaII     = m_ccimage-> m_casaII;
-    int imgDims     = casaII-> ndim();
-    auto imageShape = casaII-> shape();
-
-//    qDebug() << "CCRawView::forEach=" << m_appliedSlice.toStr()  ;
-
-    /// \todo I guessed wrong as to what the cursor shape meant when using subSection()
-    /// \todo the shape refers to the shape within the subsection... so there is no need
-    /// \todo to specify cursor shape to be the whole image, it should instead be
-    /// \todo the shape of the subsection... e.g. [3:7:2,5:6] only needs a cursor
-    /// of size 2x1(x1x1x1....x1) regardless of the image size...
-    auto cursorShape = imageShape;
-    casa::LatticeStepper stepper( imageShape, cursorShape, casa::LatticeStepper::RESIZE );
-    casa::IPosition blc( imgDims, 0 );
-    auto trc = blc;
-    auto inc = blc;
-    for ( size_t i = 0 ; i < imgDims ; i++ ) {
+    for ( int64_t start = 0 ; start < total ; start += maxElements ) {
+        int64_t count = readElements( start, maxElements, out );
+        func( reinterpret_cast < const char * > ( out ), count );
+    }
+} // forEach
+
+template < typename PType >
+void
+CCRawView < PType >::forEachTile(
+    int64_t maxElements,
+    std::function < void (const char *, int64_t count) > func,
+    char * buff )
+{
+    // split every axis of the view into runs of indices that fall into the same tile,
+    // then every combination of runs is a box covered by a single tile
+    const casa::IPosition & tileShape = m_ccimage-> m_tileCache-> tileShape();
+    size_t nDims = m_viewDims.size();
+    std::vector < VI > runs( nDims );
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
         const auto & slice1d = m_appliedSlice.dims()[i];
-        blc( i ) = slice1d.start;
-        trc( i ) = slice1d.end();
-        inc( i ) = slice1d.step;
+        runs[i].push_back( 0 );
+        for ( int j = 1 ; j < m_viewDims[i] ; j++ ) {
+            int64_t prevTile = ( slice1d.start + ( j - 1 ) * slice1d.step ) / tileShape( i );
+            int64_t tile = ( slice1d.start + j * slice1d.step ) / tileShape( i );
+            if ( tile != prevTile ) {
+                runs[i].push_back( j );
+            }
+        }
+        runs[i].push_back( m_viewDims[i] );
+    }
+
+    std::vector < PType > box;
+    casa::IPosition blc( nDims ), shape( nDims ), inc( nDims );
+    VI run( nDims, 0 );
+    while ( true ) {
+        for ( size_t i = 0 ; i < nDims ; i++ ) {
+            const auto & slice1d = m_appliedSlice.dims()[i];
+            blc( i ) = slice1d.start + runs[i][run[i]] * slice1d.step;
+            shape( i ) = runs[i][run[i] + 1] - runs[i][run[i]];
+            inc( i ) = slice1d.step;
+        }
+        box.resize( shape.product() );
+        m_ccimage-> m_tileCache-> readBox( blc, shape, inc, box.data() );
+
+        // hand out the box in pieces that fit into the buffer
+        for ( int64_t start = 0 ; start < int64_t( box.size() ) ; start += maxElements ) {
+            int64_t count = std::min < int64_t > ( maxElements, box.size() - start );
+            const PType * data = box.data() + start;
+            if ( buff ) {
+                std::copy( data, data + count, reinterpret_cast < PType * > ( buff ) );
+                data = reinterpret_cast < const PType * > ( buff );
+            }
+            func( reinterpret_cast < const char * > ( data ), count );
+        }
+
+        size_t i = 0;
+        for ( ; i < nDims ; i++ ) {
+            if ( ++run[i] + 1 < int( runs[i].size() ) ) {
+                break;
+            }
+            run[i] = 0;
+        }
+        if ( i == nDims ) {
+            break;
+        }
+    }
+} // forEachTile
+
+template < typename PType >
+int64_t
+CCRawView < PType >::read(
+    int64_t buffSize,
+    char * buff,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    Q_UNUSED( traversal );
+    int64_t count = readElements( m_readPos, buffSize / sizeof( PType ),
+                                  reinterpret_cast < PType * > ( buff ) );
+    m_readPos += count;
+    return count * sizeof( PType );
+}
+
+template < typename PType >
+void
+CCRawView < PType >::seek( int64_t ind )
+{
+    m_readPos = ind;
+}
+
+template < typename PType >
+int64_t
+CCRawView < PType >::read(
+    int64_t chunk,
+    int64_t buffSize,
+    char * buff,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    Q_UNUSED( traversal );
+    int64_t chunkSize = buffSize / sizeof( PType );
+    int64_t count = readElements( chunk * chunkSize, chunkSize,
+                                  reinterpret_cast < PType * > ( buff ) );
+    return count * sizeof( PType );
+}
+
+template < typename PType >
+int64_t
+CCRawView < PType >::nElements() const
+{
+    int64_t result = 1;
+    for ( auto dim : m_viewDims ) {
+        result *= dim;
     }
-    stepper.subSection( blc, trc, inc );
-    casa::RO_LatticeIterator < PType > iterator( * casaII, stepper );
-
-    bool first = true;
-    for ( iterator.reset() ; ! iterator.atEnd() ; iterator++ ) {
-        if ( ! first ) {
-            // sanity check for now, to make sure I understand casa cursors
-            // if this works, the outer loop is not necessary...
-            qFatal( "something went wrong" );
+    return result;
+}
+
+template < typename PType >
+int64_t
+CCRawView < PType >::readElements( int64_t start, int64_t count, PType * out )
+{
+    int64_t total = nElements();
+    if ( start < 0 || start >= total || count <= 0 ) {
+        return 0;
+    }
+    count = std::min( count, total - start );
+
+    // position of the first element in view coordinates
+    size_t nDims = m_viewDims.size();
+    VI pos( nDims );
+    int64_t rest = start;
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        pos[i] = rest % m_viewDims[i];
+        rest /= m_viewDims[i];
+    }
+
+    // the range is read as a few boxes, each as large as possible while still
+    // contiguous in the sequential order (a partial row, complete rows, complete
+    // planes, ..., then the same in reverse towards the end of the range)
+    int64_t done = 0;
+    while ( done < count ) {
+        int64_t remaining = count - done;
+        size_t k = 0;
+        int64_t plane = 1;
+        while ( k + 1 < nDims && pos[k] == 0 && plane * m_viewDims[k] <= remaining ) {
+            plane *= m_viewDims[k];
+            k++;
         }
-        const auto & cursor = iterator.cursor();
-        for ( const auto & val : cursor ) {
-            func( reinterpret_cast < const char * > ( & val ) );
+        int64_t len = std::min < int64_t > ( m_viewDims[k] - pos[k], remaining / plane );
+
+        casa::IPosition blc( nDims ), shape( nDims ), inc( nDims );
+        for ( size_t i = 0 ; i < nDims ; i++ ) {
+            const auto & slice1d = m_appliedSlice.dims()[i];
+            blc( i ) = slice1d.start + pos[i] * slice1d.step;
+            inc( i ) = slice1d.step;
+            shape( i ) = i < k ? m_viewDims[i] : ( i == k ? len : 1 );
+        }
+        m_ccimage-> m_tileCache-> readBox( blc, shape, inc, out + done );
+        done += len * plane;
+
+        // advance the position, with carry into the higher axes
+        pos[k] += len;
+        for ( size_t i = k ; i + 1 < nDims && pos[i] == m_viewDims[i] ; i++ ) {
+            pos[i] = 0;
+            pos[i + 1]++;
         }
-        first = false;
     }
-} // forEach
+    return count;
+} // readElements
 
 template < typename PType >
 const NdArray::RawViewInterface::VI &
@@ -0,0 +1,285 @@
+/**
+ * Decoded tile cache of a casacore image.
+ *
+ * Rendering, quantiles, cursor readout, contouring and histograms all read the same
+ * plane through their own views, and each of them used to go back to casacore (and the
+ * disk). Instead, the image is split into tiles, i.e. blocks of a single plane that
+ * follow the native layout of the image, and the decoded tiles are kept in the
+ * process-wide CacheManager under the "tile" category. One plane change therefore
+ * results in one read from disk, shared by all views of the image.
+ *
+ * Reads that would need a lot more tile data than they use (e.g. a spectral profile
+ * through a single pixel, or a heavily strided view) bypass the cache. Rows that are at
+ * least a tile wide are the exception: they are what the cursor readout reads, and the
+ * rest of their tiles is usually needed by the next rows or was already read to render
+ * the plane. A small box (e.g. a single pixel) within one tile is read from that tile
+ * if it is cached already, but never pulls a whole tile into the cache.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "core/CacheManager.h"
+#include <casacore/images/Images/ImageInterface.h>
+#include <casacore/casa/Arrays/IPosition.h>
+#include <casacore/casa/Arrays/Slicer.h>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+template < typename PType >
+class CCTileCache
+{
+    CLASS_BOILERPLATE( CCTileCache );
+
+public:
+
+    /// preferred number of elements in a tile
+    static constexpr int64_t TileElements = 256 * 1024;
+
+    /// reads needing more than this many times the tile data they use bypass the
+    /// cache, unless they are rows or their tile is cached already
+    static constexpr int64_t BypassFactor = 8;
+
+    /// \param casaII the image, it has to remain valid for the lifetime of the cache
+    CCTileCache( casa::ImageInterface < PType > * casaII );
+
+    /// shape of the tiles (in image coordinates), the tiles at the edges can be smaller
+    const casa::IPosition &
+    tileShape() const
+    {
+        return m_tileShape;
+    }
+
+    /// read a box of the image, first axis fastest
+    /// \param blc first pixel of the box (image coordinates)
+    /// \param shape number of pixels of the box along each axis
+    /// \param inc step along each axis
+    /// \param out where to store the shape.product() values
+    void
+    readBox( const casa::IPosition & blc, const casa::IPosition & shape,
+             const casa::IPosition & inc, PType * out );
+
+private:
+
+    typedef std::vector < PType > Tile;
+
+    /// cache key of the tile at the given position of the tile grid
+    static Carta::Core::CacheKey
+    tileKey( const casa::IPosition & tilePos );
+
+    /// get the tile at the given position of the tile grid, reading it if needed
+    std::shared_ptr < Tile >
+    tile( const casa::IPosition & tilePos );
+
+    /// copy the part of the box that lies in the given tile
+    void
+    copyFromTile( const casa::IPosition & tilePos, const casa::IPosition & blc,
+                  const casa::IPosition & shape, const casa::IPosition & inc, PType * out );
+
+    /// read the box directly from casacore
+    void
+    readDirect( const casa::IPosition & blc, const casa::IPosition & shape,
+                const casa::IPosition & inc, PType * out );
+
+    casa::ImageInterface < PType > * m_casaII = nullptr; // we don't own this!
+    casa::IPosition m_imageShape, m_tileShape;
+
+    /// decoded tiles, keyed by their position in the tile grid
+    Carta::Core::ManagedCache < Tile > m_cache { "tile" };
+
+    /// casacore images are not thread safe, so the reads are serialized
+    QMutex m_readMutex;
+};
+
+template < typename PType >
+CCTileCache < PType >::CCTileCache( casa::ImageInterface < PType > * casaII )
+{
+    m_casaII = casaII;
+    m_imageShape = casaII-> shape();
+
+    // use casacore's idea of a good cursor in the plane, so that the tiles line up
+    // with the way the data is stored, but never mix planes in a single tile
+    m_tileShape = casaII-> niceCursorShape( TileElements );
+    for ( size_t i = 0 ; i < m_tileShape.nelements() ; i++ ) {
+        if ( i >= 2 ) {
+            m_tileShape( i ) = 1;
+        }
+        m_tileShape( i ) = std::max < int64_t > ( 1, std::min < int64_t > ( m_tileShape( i ), m_imageShape( i ) ) );
+    }
+}
+
+template < typename PType >
+void
+CCTileCache < PType >::readBox(
+    const casa::IPosition & blc,
+    const casa::IPosition & shape,
+    const casa::IPosition & inc,
+    PType * out )
+{
+    size_t nDims = shape.nelements();
+    int64_t boxSize = shape.product();
+    if ( boxSize == 0 ) {
+        return;
+    }
+
+    // range of tiles covering the box, and how much tile data that is
+    casa::IPosition tileLo( nDims ), tileHi( nDims );
+    int64_t tileData = 1;
+    int64_t tileSize = 1;
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        tileLo( i ) = blc( i ) / m_tileShape( i );
+        tileHi( i ) = ( blc( i ) + ( shape( i ) - 1 ) * inc( i ) ) / m_tileShape( i );
+        tileData *= ( tileHi( i ) - tileLo( i ) + 1 ) * m_tileShape( i );
+        tileSize *= m_tileShape( i );
+    }
+    if ( ! m_cache.enabled() ) {
+        readDirect( blc, shape, inc, out );
+        return;
+    }
+    bool row = inc( 0 ) == 1 && boxSize == shape( 0 ) && shape( 0 ) >= m_tileShape( 0 );
+    if ( ! row && tileData > BypassFactor * boxSize ) {
+        bool cached = tileData == tileSize && m_cache.object( tileKey( tileLo ) ) != nullptr;
+        if ( ! cached ) {
+            readDirect( blc, shape, inc, out );
+            return;
+        }
+    }
+
+    // visit the tiles, first axis fastest
+    casa::IPosition tilePos = tileLo;
+    while ( true ) {
+        copyFromTile( tilePos, blc, shape, inc, out );
+        size_t i = 0;
+        for ( ; i < nDims ; i++ ) {
+            if ( ++tilePos( i ) <= tileHi( i ) ) {
+                break;
+            }
+            tilePos( i ) = tileLo( i );
+        }
+        if ( i == nDims ) {
+            break;
+        }
+    }
+} // readBox
+
+template < typename PType >
+Carta::Core::CacheKey
+CCTileCache < PType >::tileKey( const casa::IPosition & tilePos )
+{
+    Carta::Core::CacheKey key;
+    for ( size_t i = 0 ; i < tilePos.nelements() ; i++ ) {
+        key = key.with( int64_t( tilePos( i ) ) );
+    }
+    return key;
+}
+
+template < typename PType >
+std::shared_ptr < typename CCTileCache < PType >::Tile >
+CCTileCache < PType >::tile( const casa::IPosition & tilePos )
+{
+    Carta::Core::CacheKey key = tileKey( tilePos );
+    std::shared_ptr < Tile > result = m_cache.object( key );
+    if ( result ) {
+        return result;
+    }
+
+    QMutexLocker locker( & m_readMutex );
+
+    // another thread may have read the tile while we were waiting
+    result = m_cache.object( key );
+    if ( result ) {
+        return result;
+    }
+    casa::IPosition start( tilePos.nelements() ), extent( tilePos.nelements() );
+    for ( size_t i = 0 ; i < tilePos.nelements() ; i++ ) {
+        start( i ) = tilePos( i ) * m_tileShape( i );
+        extent( i ) = std::min < int64_t > ( m_tileShape( i ), m_imageShape( i ) - start( i ) );
+    }
+    casa::Array < PType > data = m_casaII-> getSlice( start, extent );
+    casa::Bool deleteIt;
+    const PType * ptr = data.getStorage( deleteIt );
+    result = std::make_shared < Tile > ( ptr, ptr + data.nelements() );
+    data.freeStorage( ptr, deleteIt );
+    m_cache.insert( key, result, result-> size() * sizeof( PType ) );
+    return result;
+} // tile
+
+template < typename PType >
+void
+CCTileCache < PType >::copyFromTile(
+    const casa::IPosition & tilePos,
+    const casa::IPosition & blc,
+    const casa::IPosition & shape,
+    const casa::IPosition & inc,
+    PType * out )
+{
+    // the part of the tile inside the image, and the range of box indices in it
+    size_t nDims = shape.nelements();
+    casa::IPosition origin( nDims ), extent( nDims ), jLo( nDims ), jHi( nDims );
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        origin( i ) = tilePos( i ) * m_tileShape( i );
+        extent( i ) = std::min < int64_t > ( m_tileShape( i ), m_imageShape( i ) - origin( i ) );
+        int64_t first = origin( i ) - blc( i );
+        int64_t last = first + extent( i ) - 1;
+        if ( last < 0 ) {
+            return;
+        }
+        jLo( i ) = first <= 0 ? 0 : ( first + inc( i ) - 1 ) / inc( i );
+        jHi( i ) = std::min < int64_t > ( shape( i ) - 1, last / inc( i ) );
+        if ( jLo( i ) > jHi( i ) ) {
+            return;
+        }
+    }
+
+    std::shared_ptr < Tile > data = tile( tilePos );
+
+    // copy along the first axis, for every combination of the other axes
+    casa::IPosition j = jLo;
+    int64_t count = jHi( 0 ) - jLo( 0 ) + 1;
+    while ( true ) {
+        int64_t outOffset = 0, outStride = 1, inOffset = 0, inStride = 1;
+        for ( size_t i = 0 ; i < nDims ; i++ ) {
+            outOffset += j( i ) * outStride;
+            outStride *= shape( i );
+            inOffset += ( blc( i ) + j( i ) * inc( i ) - origin( i ) ) * inStride;
+            inStride *= extent( i );
+        }
+        const PType * src = data-> data() + inOffset;
+        PType * dst = out + outOffset;
+        int64_t step = inc( 0 );
+        for ( int64_t k = 0 ; k < count ; k++ ) {
+            dst[k] = src[k * step];
+        }
+
+        size_t i = 1;
+        for ( ; i < nDims ; i++ ) {
+            if ( ++j( i ) <= jHi( i ) ) {
+                break;
+            }
+            j( i ) = jLo( i );
+        }
+        if ( i >= nDims ) {
+            break;
+        }
+    }
+} // copyFromTile
+
+template < typename PType >
+void
+CCTileCache < PType >::readDirect(
+    const casa::IPosition & blc,
+    const casa::IPosition & shape,
+    const casa::IPosition & inc,
+    PType * out )
+{
+    QMutexLocker locker( & m_readMutex );
+    casa::Array < PType > data = m_casaII-> getSlice(
+        casa::Slicer( blc, shape, inc, casa::Slicer::endIsLength ) );
+    casa::Bool deleteIt;
+    const PType * ptr = data.getStorage( deleteIt );
+    std::copy( ptr, ptr + data.nelements(), out );
+    data.freeStorage( ptr, deleteIt );
+}
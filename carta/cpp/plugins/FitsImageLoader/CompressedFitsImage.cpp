@@ -0,0 +1,846 @@
+/**
+ *
+ **/
+
+#include "CompressedFitsImage.h"
+#include "CompressedFitsRawView.h"
+#include "FitsData.h"
+#include "FitsTileCompression.h"
+#include "CartaLib/PermutedImage.h"
+#include "../WcsPlotter/SimpleFitsParser.h"
+#include <casacore/casa/Exceptions/Error.h>
+#include <casacore/casa/Containers/Record.h>
+#include <casacore/casa/Logging/LogIO.h>
+#include <casacore/images/Images/ImageFITSConverter.h>
+#include <QtConcurrent>
+#include <QDebug>
+#include <QRegularExpression>
+#include <QSet>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <set>
+#include <type_traits>
+
+namespace
+{
+/// how many HDUs are searched for a compressed image
+constexpr int MaxHdus = 16;
+
+/// SUBTRACTIVE_DITHER_2 stores exact zeros with this value
+constexpr int32_t DitherZeroValue = - 2147483646;
+
+/// size in bytes of a value of a binary table column type
+int
+typeSize( char type )
+{
+    switch ( type )
+    {
+    case 'L' :
+    case 'B' :
+    case 'A' :
+    case 'X' :
+        return 1;
+    case 'I' :
+        return 2;
+    case 'J' :
+    case 'E' :
+        return 4;
+    case 'K' :
+    case 'D' :
+    case 'C' :
+        return 8;
+    case 'M' :
+        return 16;
+    default :
+        return 0;
+    }
+}
+
+/// BITPIX equivalent of a binary table column type, 0 if there is none
+int
+typeBitpix( char type )
+{
+    switch ( type )
+    {
+    case 'B' :
+        return 8;
+    case 'I' :
+        return 16;
+    case 'J' :
+        return 32;
+    case 'K' :
+        return 64;
+    case 'E' :
+        return - 32;
+    case 'D' :
+        return - 64;
+    default :
+        return 0;
+    }
+}
+
+/// integer value of a keyword that may not fit into an int
+int64_t
+longValue( WcsPlotterPluginNS::FitsHeader & hdr, const QString & key, int64_t defaultValue )
+{
+    QVariant value = hdr.getValue( key );
+    if ( ! value.isValid() ) {
+        return defaultValue;
+    }
+    bool ok;
+    int64_t result = value.toString().trimmed().toLongLong( & ok );
+    if ( ! ok ) {
+        throw QString( "Found %1=%2 in fits file but expected an integer." )
+                  .arg( key ).arg( value.toString() );
+    }
+    return result;
+}
+
+/// a header card with a value
+QString
+fitsCard( const QString & key, const QString & value )
+{
+    return QString( "%1= %2" ).arg( key, - 8 ).arg( value, 20 ).leftJustified( 80, ' ' );
+}
+
+/// is the keyword one of the table or compression keywords, which are not part of the
+/// header of the uncompressed image
+bool
+isTableKeyword( const QString & key )
+{
+    static const QSet < QString > keys {
+        "XTENSION", "BITPIX", "PCOUNT", "GCOUNT", "TFIELDS", "THEAP", "ZIMAGE", "ZBITPIX",
+        "ZCMPTYPE", "ZQUANTIZ", "ZDITHER0", "ZSIMPLE", "ZEXTEND", "ZTENSION", "ZPCOUNT",
+        "ZGCOUNT", "ZHECKSUM", "ZDATASUM", "CHECKSUM", "DATASUM", "ZBLANK", "END"
+    };
+    static const QRegularExpression indexed(
+        "^(NAXIS|TTYPE|TFORM|TUNIT|TNULL|TSCAL|TZERO|TDIM|TDISP|ZNAXIS|ZTILE|ZNAME|ZVAL)\\d*$" );
+    return keys.contains( key ) || indexed.match( key ).hasMatch();
+}
+
+/// range of k in [0, n) for which lo <= start + k * step <= hi
+/// \return false if the range is empty
+bool
+sampleRange( int start, int step, int n, int lo, int hi, int & kStart, int & kEnd )
+{
+    int64_t a, b;
+    if ( step > 0 ) {
+        a = lo - start;
+        b = hi - start;
+    }
+    else {
+        a = start - hi;
+        b = start - lo;
+        step = - step;
+    }
+    if ( b < 0 ) {
+        return false;
+    }
+    kStart = a <= 0 ? 0 : ( a + step - 1 ) / step;
+    kEnd = std::min < int64_t > ( n - 1, b / step );
+    return kStart <= kEnd;
+}
+
+/// convert stored values of type Stored to pixels
+template < typename Stored >
+void
+storedToPixels( const uint8_t * data, int64_t count, float * out, double bscale, double bzero,
+                bool hasBlank, int64_t blank )
+{
+    const float nan = std::numeric_limits < float >::quiet_NaN();
+    for ( int64_t i = 0 ; i < count ; i++ ) {
+        Stored value = loadBigEndian < Stored > ( data + i * sizeof( Stored ) );
+        if ( std::is_integral < Stored >::value && hasBlank && int64_t( value ) == blank ) {
+            out[i] = nan;
+        }
+        else {
+            out[i] = static_cast < float > ( bzero + bscale * value );
+        }
+    }
+}
+}
+
+CompressedFitsImage::SharedPtr
+CompressedFitsImage::open( const QString & fname )
+{
+    QFile file( fname );
+    if ( ! file.open( QFile::ReadOnly ) ) {
+        return nullptr;
+    }
+    if ( file.peek( 9 ) != "SIMPLE  =" ) {
+        return nullptr;
+    }
+
+    // walk the HDUs until we find a binary table with a compressed image
+    qint64 hduStart = 0;
+    for ( int hdu = 0 ; hdu < MaxHdus && hduStart < file.size() ; hdu++ ) {
+        if ( ! file.seek( hduStart ) ) {
+            return nullptr;
+        }
+        WcsPlotterPluginNS::FitsHeader hdr = WcsPlotterPluginNS::FitsHeader::parse( file );
+        if ( ! hdr.isValid() ) {
+            return nullptr;
+        }
+        try {
+            if ( hdu > 0 && fitsString( hdr.stringValue( "XTENSION", "" ) ) == "BINTABLE"
+                 && hdr.stringValue( "ZIMAGE", "F" ) == "T" ) {
+                CompressedFitsImage::SharedPtr img = std::make_shared < CompressedFitsImage > ();
+                if ( ! img-> parseHeader( hdr ) ) {
+                    return nullptr;
+                }
+                qint64 dataStart = hduStart + hdr.dataOffset();
+                if ( dataStart + img-> m_mappingSize > file.size() ) {
+                    qWarning() << "Invalid fits file size. Maybe accidentally truncated?";
+                    return nullptr;
+                }
+                img-> m_mapping = std::make_shared < FitsMapping > ( fname, dataStart,
+                                                                     img-> m_mappingSize );
+                if ( ! img-> m_mapping-> data() ) {
+                    return nullptr;
+                }
+                return img;
+            }
+
+            // skip the data of this HDU
+            int64_t dataSize = 0;
+            int naxis = hdr.intValue( "NAXIS", 0 );
+            if ( naxis > 0 ) {
+                dataSize = 1;
+                for ( int i = 1 ; i <= naxis ; i++ ) {
+                    dataSize *= longValue( hdr, QString( "NAXIS%1" ).arg( i ), 0 );
+                }
+            }
+            dataSize = std::abs( hdr.intValue( "BITPIX" ) ) / 8 * longValue( hdr, "GCOUNT", 1 )
+                       * ( longValue( hdr, "PCOUNT", 0 ) + dataSize );
+            hduStart += hdr.dataOffset() + ( dataSize + 2879 ) / 2880 * 2880;
+        }
+        catch ( const QString & err ) {
+            qWarning() << err;
+            return nullptr;
+        }
+        catch ( ... ) {
+            return nullptr;
+        }
+    }
+    return nullptr;
+} // open
+
+bool
+CompressedFitsImage::parseHeader( WcsPlotterPluginNS::FitsHeader & hdr )
+{
+    // the uncompressed image
+    m_zbitpix = hdr.intValue( "ZBITPIX" );
+    if ( m_zbitpix != 8 && m_zbitpix != 16 && m_zbitpix != 32 && m_zbitpix != 64
+         && m_zbitpix != - 32 && m_zbitpix != - 64 ) {
+        qWarning() << "Illegal value ZBITPIX =" << m_zbitpix;
+        return false;
+    }
+    int naxis = hdr.intValue( "ZNAXIS" );
+    if ( naxis < 2 ) {
+        return false;
+    }
+    int64_t tiles = 1;
+    for ( int i = 1 ; i <= naxis ; i++ ) {
+        int n = hdr.intValue( QString( "ZNAXIS%1" ).arg( i ) );
+        int tile = hdr.intValue( QString( "ZTILE%1" ).arg( i ), i == 1 ? n : 1 );
+        if ( n < 1 || tile < 1 ) {
+            return false;
+        }
+        m_dims.push_back( n );
+        m_tileShape.push_back( std::min( tile, n ) );
+        m_tileCounts.push_back( ( n + m_tileShape.back() - 1 ) / m_tileShape.back() );
+        tiles *= m_tileCounts.back();
+    }
+
+    // compression algorithm and its parameters
+    QString cmpType = fitsString( hdr.stringValue( "ZCMPTYPE" ) );
+    if ( cmpType == "RICE_1" || cmpType == "RICE_ONE" ) {
+        m_algorithm = Algorithm::Rice;
+    }
+    else if ( cmpType == "GZIP_1" ) {
+        m_algorithm = Algorithm::Gzip1;
+    }
+    else if ( cmpType == "GZIP_2" ) {
+        m_algorithm = Algorithm::Gzip2;
+    }
+    else if ( cmpType == "NOCOMPRESS" ) {
+        m_algorithm = Algorithm::None;
+    }
+    else {
+        qWarning() << "Unsupported tile compression" << cmpType;
+        return false;
+    }
+    for ( int i = 1 ; hdr.getValue( QString( "ZNAME%1" ).arg( i ) ).isValid() ; i++ ) {
+        QString name = fitsString( hdr.stringValue( QString( "ZNAME%1" ).arg( i ) ) );
+        if ( name == "BLOCKSIZE" ) {
+            m_riceBlockSize = hdr.intValue( QString( "ZVAL%1" ).arg( i ) );
+        }
+        else if ( name == "BYTEPIX" ) {
+            m_riceBytePix = hdr.intValue( QString( "ZVAL%1" ).arg( i ) );
+        }
+    }
+    QString quantize = fitsString( hdr.stringValue( "ZQUANTIZ", "'NO_DITHER'" ) );
+    if ( quantize == "SUBTRACTIVE_DITHER_1" ) {
+        m_dither = 1;
+    }
+    else if ( quantize == "SUBTRACTIVE_DITHER_2" ) {
+        m_dither = 2;
+    }
+    m_ditherSeed = std::max( 1, hdr.intValue( "ZDITHER0", 1 ) );
+
+    // null values and scaling
+    if ( hdr.getValue( "ZBLANK" ).isValid() ) {
+        m_hasBlank = true;
+        m_blank = longValue( hdr, "ZBLANK", 0 );
+    }
+    else if ( m_zbitpix > 0 && hdr.getValue( "BLANK" ).isValid() ) {
+        m_hasBlank = true;
+        m_blank = longValue( hdr, "BLANK", 0 );
+    }
+    m_bscale = hdr.doubleValue( "BSCALE", 1 );
+    m_bzero = hdr.doubleValue( "BZERO", 0 );
+    m_unit = Unit( fitsString( hdr.stringValue( "BUNIT", "" ) ) );
+    QString title = fitsString( hdr.stringValue( "OBJECT", "" ) );
+
+    // the layout of the table
+    m_rowBytes = longValue( hdr, "NAXIS1", 0 );
+    m_rows = longValue( hdr, "NAXIS2", 0 );
+    int64_t pcount = longValue( hdr, "PCOUNT", 0 );
+    m_heapOffset = longValue( hdr, "THEAP", m_rowBytes * m_rows );
+    m_mappingSize = m_rowBytes * m_rows + pcount;
+    m_heapSize = m_mappingSize - m_heapOffset;
+    if ( m_rows != tiles || m_heapOffset < m_rowBytes * m_rows || m_heapSize < 0 ) {
+        qWarning() << "The compressed image table does not match the tiles";
+        return false;
+    }
+    QRegularExpression formRe( "^\\s*(\\d*)([PQ]?)([A-Z])" );
+    int64_t offset = 0;
+    int tfields = hdr.intValue( "TFIELDS" );
+    for ( int i = 1 ; i <= tfields ; i++ ) {
+        QString name = fitsString( hdr.stringValue( QString( "TTYPE%1" ).arg( i ), "" ) );
+        QString form = fitsString( hdr.stringValue( QString( "TFORM%1" ).arg( i ) ) );
+        auto match = formRe.match( form );
+        if ( ! match.hasMatch() ) {
+            qWarning() << "Unsupported column format" << form;
+            return false;
+        }
+        Column col;
+        col.offset = offset;
+        col.type = match.captured( 3 ).at( 0 ).toLatin1();
+        col.descriptor = ! match.captured( 2 ).isEmpty();
+        col.longDescriptor = match.captured( 2 ) == "Q";
+        int64_t repeat = match.captured( 1 ).isEmpty() ? 1 : match.captured( 1 ).toLongLong();
+        if ( col.descriptor ) {
+            offset += repeat == 0 ? 0 : ( col.longDescriptor ? 16 : 8 );
+        }
+        else if ( col.type == 'X' ) {
+            offset += ( repeat + 7 ) / 8;
+        }
+        else {
+            offset += repeat * typeSize( col.type );
+        }
+        if ( name == "COMPRESSED_DATA" ) {
+            m_compressedCol = col;
+        }
+        else if ( name == "GZIP_COMPRESSED_DATA" ) {
+            m_gzipCol = col;
+        }
+        else if ( name == "UNCOMPRESSED_DATA" ) {
+            m_uncompressedCol = col;
+        }
+        else if ( name == "ZSCALE" ) {
+            m_scaleCol = col;
+        }
+        else if ( name == "ZZERO" ) {
+            m_zeroCol = col;
+        }
+        else if ( name == "ZBLANK" ) {
+            m_blankCol = col;
+        }
+    }
+    if ( offset > m_rowBytes || ! m_compressedCol.descriptor ) {
+        qWarning() << "The compressed image table has no COMPRESSED_DATA column";
+        return false;
+    }
+
+    // floating point images are usually quantized to integers before compression
+    // (with the scaling in columns, or the same for all tiles in keywords)
+    m_quantized = m_zbitpix < 0 && ( m_scaleCol.exists()
+                                     || hdr.getValue( "ZSCALE" ).isValid() );
+    m_zscale = hdr.doubleValue( "ZSCALE", 1 );
+    m_zzero = hdr.doubleValue( "ZZERO", 0 );
+    if ( m_algorithm == Algorithm::Rice && m_zbitpix < 0 && ! m_quantized ) {
+        qWarning() << "Rice compression of unquantized floating point data is not supported";
+        return false;
+    }
+
+    // build the header of the uncompressed image, so that casacore can make sense of
+    // the world coordinates
+    std::vector < QString > lines;
+    lines.push_back( fitsCard( "SIMPLE", "T" ) );
+    lines.push_back( fitsCard( "BITPIX", QString::number( m_zbitpix ) ) );
+    lines.push_back( fitsCard( "NAXIS", QString::number( naxis ) ) );
+    for ( int i = 0 ; i < naxis ; i++ ) {
+        lines.push_back( fitsCard( QString( "NAXIS%1" ).arg( i + 1 ), QString::number( m_dims[i] ) ) );
+    }
+    for ( auto & line : hdr.lines() ) {
+        if ( ! isTableKeyword( line.key() ) ) {
+            lines.push_back( line.raw() );
+        }
+    }
+    lines.push_back( QString( "END" ).leftJustified( 80, ' ' ) );
+    casa::Vector < casa::String > header( lines.size() );
+    for ( size_t i = 0 ; i < lines.size() ; i++ ) {
+        header[i] = lines[i].toStdString();
+    }
+    try {
+        casa::Record headerRec;
+        casa::LogIO os;
+        casa::Int stokesFITSValue = 1;
+        casa::IPosition shape( m_dims );
+        casa::CoordinateSystem cs = casa::ImageFITSConverter::getCoordinateSystem(
+            stokesFITSValue, headerRec, header, os, 0, shape, false );
+        if ( cs.nPixelAxes() != m_dims.size() ) {
+            qWarning() << "Coordinate system does not match the image axes";
+            return false;
+        }
+        m_casaCS = std::make_shared < casa::CoordinateSystem > ( cs );
+    }
+    catch ( casa::AipsError & e ) {
+        qWarning() << "Could not parse coordinates:" << e.what();
+        return false;
+    }
+    m_htmlTitle = title.toHtmlEscaped();
+    m_meta = std::make_shared < CCMetaDataInterface > ( m_htmlTitle, m_casaCS );
+    return true;
+} // parseHeader
+
+std::shared_ptr < Image::ImageInterface >
+CompressedFitsImage::getPermuted( const std::vector < int > & indices )
+{
+    //Make sure the passed in indices make sense for this image.
+    int axisCount = m_dims.size();
+    int indexCount = indices.size();
+    CARTA_ASSERT( axisCount == indexCount );
+    std::set < int > usedIndices;
+    casa::Vector < int > newOrder( indexCount );
+    for ( int i = 0 ; i < indexCount ; i++ ) {
+        CARTA_ASSERT( 0 <= indices[i] && indices[i] < axisCount );
+        CARTA_ASSERT( usedIndices.count( indices[i] ) == 0 );
+        usedIndices.insert( indices[i] );
+        newOrder[i] = indices[i];
+    }
+
+    //Change the order of the axes in the coordinate system
+    auto coordSys = std::make_shared < casa::CoordinateSystem > ( * m_casaCS );
+    coordSys-> transpose( newOrder, newOrder );
+    auto meta = std::make_shared < CCMetaDataInterface > ( m_htmlTitle, coordSys );
+
+    //Create a CARTA image with permuted axes that reads from this one.
+    return std::make_shared < Carta::Lib::PermutedImage > ( shared_from_this(), indices, meta );
+}
+
+NdArray::RawViewInterface *
+CompressedFitsImage::getDataSlice( const SliceND & sliceInfo )
+{
+    return new CompressedFitsRawView( this, sliceInfo );
+}
+
+bool
+CompressedFitsImage::getPixel( const VI & pos, double & value )
+{
+    if ( pos.size() != m_dims.size() ) {
+        return false;
+    }
+    for ( size_t i = 0 ; i < pos.size() ; i++ ) {
+        if ( pos[i] < 0 || pos[i] >= m_dims[i] ) {
+            return false;
+        }
+    }
+    VI ones( pos.size(), 1 );
+    float pixel;
+    readBox( pos, ones, ones, & pixel );
+    value = pixel;
+    return true;
+}
+
+bool
+CompressedFitsImage::getRow( const VI & pos, double * row )
+{
+    if ( pos.size() != m_dims.size() ) {
+        return false;
+    }
+    for ( size_t i = 1 ; i < pos.size() ; i++ ) {
+        if ( pos[i] < 0 || pos[i] >= m_dims[i] ) {
+            return false;
+        }
+    }
+    VI blc = pos;
+    blc[0] = 0;
+    VI shape( pos.size(), 1 );
+    shape[0] = m_dims[0];
+    VI step( pos.size(), 1 );
+    readBox( blc, shape, step, reinterpret_cast < float * > ( row ) );
+    widenRow < float > ( row, m_dims[0] );
+    return true;
+}
+
+void
+CompressedFitsImage::readBox( const VI & blc, const VI & shape, const VI & step, float * out )
+{
+    size_t nDims = m_dims.size();
+    CARTA_ASSERT( blc.size() == nDims && shape.size() == nDims && step.size() == nDims );
+
+    // tiles touched by the box along each axis (the samples are monotonic, so the
+    // duplicates are next to each other)
+    std::vector < VI > axisTiles( nDims );
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        for ( int k = 0 ; k < shape[i] ; k++ ) {
+            int tile = ( blc[i] + k * step[i] ) / m_tileShape[i];
+            if ( axisTiles[i].empty() || axisTiles[i].back() != tile ) {
+                axisTiles[i].push_back( tile );
+            }
+        }
+        if ( axisTiles[i].empty() ) {
+            return;
+        }
+    }
+
+    // find the tiles in the cache, and collect the ones that have to be decoded
+    struct Job {
+        int64_t index;
+        std::shared_ptr < Tile > tile;
+    };
+    std::vector < Job > jobs;
+    std::vector < Job > missing;
+    VI counter( nDims, 0 );
+    while ( true ) {
+        int64_t index = 0;
+        for ( size_t i = nDims ; i-- > 0 ; ) {
+            index = index * m_tileCounts[i] + axisTiles[i][counter[i]];
+        }
+        Job job { index, m_tiles.object( CacheKey().with( index ) ) };
+        ( job.tile ? jobs : missing ).push_back( job );
+
+        size_t axis = 0;
+        while ( axis < nDims && ++counter[axis] == int( axisTiles[axis].size() ) ) {
+            counter[axis++] = 0;
+        }
+        if ( axis == nDims ) {
+            break;
+        }
+    }
+
+    // decode the missing tiles in parallel
+    auto decodeFunc = [this] ( Job & job ) {
+        job.tile = std::make_shared < Tile > ();
+        if ( ! decodeTile( job.index, * job.tile ) ) {
+            qWarning() << "Corrupted compressed tile" << job.index;
+            std::fill( job.tile-> begin(), job.tile-> end(),
+                       std::numeric_limits < float >::quiet_NaN() );
+        }
+    };
+    if ( missing.size() == 1 ) {
+        decodeFunc( missing[0] );
+    }
+    else if ( missing.size() > 1 ) {
+        QtConcurrent::blockingMap( missing, decodeFunc );
+    }
+    for ( auto & job : missing ) {
+        if ( m_tiles.enabled() ) {
+            m_tiles.insert( CacheKey().with( job.index ), job.tile,
+                            job.tile-> size() * sizeof( float ) );
+        }
+        jobs.push_back( job );
+    }
+
+    for ( auto & job : jobs ) {
+        copyFromTile( job.index, * job.tile, blc, shape, step, out );
+    }
+} // readBox
+
+void
+CompressedFitsImage::tileBox( int64_t index, VI & origin, VI & extent ) const
+{
+    size_t nDims = m_dims.size();
+    origin.resize( nDims );
+    extent.resize( nDims );
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        origin[i] = ( index % m_tileCounts[i] ) * m_tileShape[i];
+        extent[i] = std::min( m_tileShape[i], m_dims[i] - origin[i] );
+        index /= m_tileCounts[i];
+    }
+}
+
+void
+CompressedFitsImage::copyFromTile( int64_t index, const Tile & tile, const VI & blc,
+                                   const VI & shape, const VI & step, float * out ) const
+{
+    VI origin, extent;
+    tileBox( index, origin, extent );
+
+    // range of the samples of the box inside of the tile along each axis
+    size_t nDims = m_dims.size();
+    VI kStart( nDims ), kEnd( nDims );
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        if ( ! sampleRange( blc[i], step[i], shape[i], origin[i], origin[i] + extent[i] - 1,
+                            kStart[i], kEnd[i] ) ) {
+            return;
+        }
+    }
+
+    // distance between neighbours in the output and in the tile
+    std::vector < int64_t > outStrides( nDims ), tileStrides( nDims );
+    int64_t outStride = 1, tileStride = 1;
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        outStrides[i] = outStride;
+        tileStrides[i] = tileStride;
+        outStride *= shape[i];
+        tileStride *= extent[i];
+    }
+
+    // copy one row at a time
+    VI k = kStart;
+    while ( true ) {
+        int64_t outIndex = 0, tileIndex = 0;
+        for ( size_t i = 0 ; i < nDims ; i++ ) {
+            outIndex += k[i] * outStrides[i];
+            tileIndex += ( blc[i] + int64_t( k[i] ) * step[i] - origin[i] ) * tileStrides[i];
+        }
+        for ( int j = 0 ; j <= kEnd[0] - kStart[0] ; j++ ) {
+            out[outIndex + j] = tile[tileIndex + int64_t( j ) * step[0]];
+        }
+
+        size_t axis = 1;
+        while ( axis < nDims && ++k[axis] > kEnd[axis] ) {
+            k[axis] = kStart[axis];
+            axis++;
+        }
+        if ( axis >= nDims ) {
+            break;
+        }
+    }
+} // copyFromTile
+
+bool
+CompressedFitsImage::arrayData( const char * row, const Column & col, int64_t & count,
+                                const uint8_t * & data ) const
+{
+    if ( ! col.exists() || ! col.descriptor ) {
+        return false;
+    }
+    const uint8_t * desc = reinterpret_cast < const uint8_t * > ( row + col.offset );
+    int64_t offset;
+    if ( col.longDescriptor ) {
+        count = loadBigEndian < int64_t > ( desc );
+        offset = loadBigEndian < int64_t > ( desc + 8 );
+    }
+    else {
+        count = loadBigEndian < uint32_t > ( desc );
+        offset = loadBigEndian < uint32_t > ( desc + 4 );
+    }
+    int64_t bytes = count * typeSize( col.type );
+    if ( count <= 0 || offset < 0 || offset + bytes > m_heapSize ) {
+        return false;
+    }
+    data = reinterpret_cast < const uint8_t * > ( m_mapping-> data() + m_heapOffset + offset );
+    count = bytes;
+    return true;
+}
+
+double
+CompressedFitsImage::scalarValue( const char * row, const Column & col, double defaultValue ) const
+{
+    if ( ! col.exists() || col.descriptor ) {
+        return defaultValue;
+    }
+    const uint8_t * ptr = reinterpret_cast < const uint8_t * > ( row + col.offset );
+    switch ( col.type )
+    {
+    case 'I' :
+        return loadBigEndian < int16_t > ( ptr );
+    case 'J' :
+        return loadBigEndian < int32_t > ( ptr );
+    case 'K' :
+        return loadBigEndian < int64_t > ( ptr );
+    case 'E' :
+        return loadBigEndian < float > ( ptr );
+    case 'D' :
+        return loadBigEndian < double > ( ptr );
+    default :
+        return defaultValue;
+    }
+}
+
+bool
+CompressedFitsImage::decodeTile( int64_t index, Tile & out ) const
+{
+    const char * row = m_mapping-> data() + index * m_rowBytes;
+    VI origin, extent;
+    tileBox( index, origin, extent );
+    int64_t count = 1;
+    for ( int n : extent ) {
+        count *= n;
+    }
+    out.resize( count );
+
+    int64_t bytes;
+    const uint8_t * data;
+    if ( arrayData( row, m_compressedCol, bytes, data ) ) {
+        // quantized floats are compressed as 32 bit integers
+        int bitpix = m_quantized ? 32 : m_zbitpix;
+        if ( m_algorithm == Algorithm::Rice ) {
+            std::vector < int32_t > ints( count );
+            if ( ! FitsTileCompression::riceDecode( data, bytes, m_riceBytePix, m_riceBlockSize,
+                                                    count, ints.data() ) ) {
+                return false;
+            }
+            integersToPixels( row, index, ints, out );
+            return true;
+        }
+        int elementSize = std::abs( bitpix ) / 8;
+        std::vector < uint8_t > raw( count * elementSize );
+        if ( m_algorithm == Algorithm::None ) {
+            if ( bytes < int64_t( raw.size() ) ) {
+                return false;
+            }
+            std::copy( data, data + raw.size(), raw.begin() );
+        }
+        else if ( ! FitsTileCompression::gunzip( data, bytes, raw.size(), raw.data() ) ) {
+            return false;
+        }
+        if ( m_algorithm == Algorithm::Gzip2 ) {
+            FitsTileCompression::unshuffle( raw, elementSize );
+        }
+        if ( m_quantized ) {
+            std::vector < int32_t > ints( count );
+            for ( int64_t i = 0 ; i < count ; i++ ) {
+                ints[i] = loadBigEndian < int32_t > ( raw.data() + 4 * i );
+            }
+            integersToPixels( row, index, ints, out );
+        }
+        else {
+            rawToPixels( raw.data(), bitpix, count, out );
+        }
+        return true;
+    }
+
+    // tiles that could not be quantized are stored losslessly in other columns
+    if ( arrayData( row, m_gzipCol, bytes, data ) ) {
+        std::vector < uint8_t > raw( count * std::abs( m_zbitpix ) / 8 );
+        if ( ! FitsTileCompression::gunzip( data, bytes, raw.size(), raw.data() ) ) {
+            return false;
+        }
+        rawToPixels( raw.data(), m_zbitpix, count, out );
+        return true;
+    }
+    if ( arrayData( row, m_uncompressedCol, bytes, data ) ) {
+        int bitpix = typeBitpix( m_uncompressedCol.type );
+        if ( bitpix == 0 || bytes < count * std::abs( bitpix ) / 8 ) {
+            return false;
+        }
+        rawToPixels( data, bitpix, count, out );
+        return true;
+    }
+
+    // a tile without any data is undefined
+    std::fill( out.begin(), out.end(), std::numeric_limits < float >::quiet_NaN() );
+    return true;
+} // decodeTile
+
+void
+CompressedFitsImage::integersToPixels( const char * row, int64_t index,
+                                       const std::vector < int32_t > & ints, Tile & out ) const
+{
+    const float nan = std::numeric_limits < float >::quiet_NaN();
+    bool hasBlank = m_hasBlank;
+    int64_t blank = m_blank;
+    if ( m_blankCol.exists() ) {
+        hasBlank = true;
+        blank = scalarValue( row, m_blankCol, 0 );
+    }
+    size_t count = ints.size();
+
+    if ( ! m_quantized ) {
+        for ( size_t i = 0 ; i < count ; i++ ) {
+            if ( hasBlank && ints[i] == blank ) {
+                out[i] = nan;
+            }
+            else {
+                out[i] = static_cast < float > ( m_bzero + m_bscale * ints[i] );
+            }
+        }
+        return;
+    }
+
+    double scale = scalarValue( row, m_scaleCol, m_zscale );
+    double zero = scalarValue( row, m_zeroCol, m_zzero );
+    if ( m_dither == 0 ) {
+        for ( size_t i = 0 ; i < count ; i++ ) {
+            if ( hasBlank && ints[i] == blank ) {
+                out[i] = nan;
+            }
+            else {
+                out[i] = static_cast < float > ( ints[i] * scale + zero );
+            }
+        }
+        return;
+    }
+
+    // subtractive dithering, the offsets come from the random sequence starting at
+    // a position that depends on the tile (row) number and the seed
+    using FitsTileCompression::randomValue;
+    using FitsTileCompression::RandomCount;
+    int iseed = int( ( index + m_ditherSeed - 1 ) % RandomCount );
+    int nextRand = int( randomValue( iseed ) * 500 );
+    for ( size_t i = 0 ; i < count ; i++ ) {
+        if ( hasBlank && ints[i] == blank ) {
+            out[i] = nan;
+        }
+        else if ( m_dither == 2 && ints[i] == DitherZeroValue ) {
+            out[i] = 0;
+        }
+        else {
+            out[i] = static_cast < float > ( ( ints[i] - randomValue( nextRand ) + 0.5 ) * scale + zero );
+        }
+        if ( ++nextRand == RandomCount ) {
+            if ( ++iseed == RandomCount ) {
+                iseed = 0;
+            }
+            nextRand = int( randomValue( iseed ) * 500 );
+        }
+    }
+} // integersToPixels
+
+void
+CompressedFitsImage::rawToPixels( const uint8_t * data, int bitpix, int64_t count, Tile & out ) const
+{
+    // scaling only applies to integer images
+    double bscale = bitpix > 0 ? m_bscale : 1;
+    double bzero = bitpix > 0 ? m_bzero : 0;
+    switch ( bitpix )
+    {
+    case 8 :
+        storedToPixels < uint8_t > ( data, count, out.data(), bscale, bzero, m_hasBlank, m_blank );
+        break;
+    case 16 :
+        storedToPixels < int16_t > ( data, count, out.data(), bscale, bzero, m_hasBlank, m_blank );
+        break;
+    case 32 :
+        storedToPixels < int32_t > ( data, count, out.data(), bscale, bzero, m_hasBlank, m_blank );
+        break;
+    case 64 :
+        storedToPixels < int64_t > ( data, count, out.data(), bscale, bzero, m_hasBlank, m_blank );
+        break;
+    case - 32 :
+        storedToPixels < float > ( data, count, out.data(), bscale, bzero, false, 0 );
+        break;
+    case - 64 :
+        storedToPixels < double > ( data, count, out.data(), bscale, bzero, false, 0 );
+        break;
+    default :
+        std::fill( out.begin(), out.end(), std::numeric_limits < float >::quiet_NaN() );
+    }
+} // rawToPixels
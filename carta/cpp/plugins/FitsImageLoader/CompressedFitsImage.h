@@ -0,0 +1,253 @@
+/**
+ * Image interface for tile-compressed FITS files (e.g. as written by fpack).
+ *
+ * The image is stored in a binary table extension, one compressed tile per row, see
+ * FitsTileCompression.h for the supported algorithms. The table and its heap are
+ * mapped into memory, and only the tiles that intersect a requested box are
+ * decompressed. Missing tiles are decompressed in parallel on the global thread pool,
+ * and the decoded tiles are kept in the process-wide CacheManager under the "tile"
+ * category, so showing one plane of a compressed cube only decompresses that plane.
+ *
+ * The pixels are always presented as floats, like FitsImage does.
+ *
+ * Casacore can't read tile-compressed images, so getCasaImage() returns nullptr, and
+ * plugins that need a casacore image skip these images.
+ **/
+
+#pragma once
+
+#include "FitsImage.h"
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include "core/CacheManager.h"
+#include "../CasaImageLoader/CCImage.h"
+#include "../CasaImageLoader/CCMetaDataInterface.h"
+#include <QString>
+#include <memory>
+#include <vector>
+
+namespace WcsPlotterPluginNS
+{
+struct FitsHeader;
+}
+
+class CompressedFitsImage
+    : public CCImageBase
+      , public std::enable_shared_from_this < CompressedFitsImage >
+{
+    CLASS_BOILERPLATE( CompressedFitsImage );
+
+public:
+
+    /// find the first tile-compressed image in a FITS file
+    /// \return the image, or nullptr if the file has no tile-compressed image that
+    /// we can read
+    static CompressedFitsImage::SharedPtr
+    open( const QString & fname );
+
+    virtual const Unit &
+    getPixelUnit() const override
+    {
+        return m_unit;
+    }
+
+    /// returns a Carta::Lib::PermutedImage reading from this image
+    virtual std::shared_ptr < Image::ImageInterface >
+    getPermuted( const std::vector < int > & indices ) override;
+
+    virtual const VI &
+    dims() const override
+    {
+        return m_dims;
+    }
+
+    virtual bool
+    hasMask() const override
+    {
+        return false;
+    }
+
+    virtual bool
+    hasErrorsInfo() const override
+    {
+        return false;
+    }
+
+    virtual Image::PixelType
+    pixelType() const override
+    {
+        return Image::PixelType::Real32;
+    }
+
+    virtual Image::PixelType
+    errorType() const override
+    {
+        qFatal( "not implemented" );
+    }
+
+    virtual NdArray::RawViewInterface *
+    getDataSlice( const SliceND & sliceInfo ) override;
+
+    /// \todo implement this
+    virtual NdArray::Byte *
+    getMaskSlice( const SliceND & sliceInfo ) override
+    {
+        Q_UNUSED( sliceInfo );
+        qFatal( "not implemented" );
+    }
+
+    /// \todo implement this
+    virtual NdArray::RawViewInterface *
+    getErrorSlice( const SliceND & sliceInfo ) override
+    {
+        Q_UNUSED( sliceInfo );
+        qFatal( "not implemented" );
+    }
+
+    virtual bool
+    getPixel( const VI & pos, double & value ) override;
+
+    virtual bool
+    getRow( const VI & pos, double * row ) override;
+
+    virtual Image::MetaDataInterface::SharedPtr
+    metaData() override
+    {
+        return m_meta;
+    }
+
+    /// casacore can't read tile-compressed images
+    virtual casa::LatticeBase *
+    getCasaImage() override
+    {
+        return nullptr;
+    }
+
+    /// read a box of the image, first axis fastest
+    /// \param blc first pixel of the box
+    /// \param shape number of pixels of the box along each axis
+    /// \param step step along each axis
+    /// \param out where to store the pixels
+    void
+    readBox( const VI & blc, const VI & shape, const VI & step, float * out );
+
+    CompressedFitsImage() { }
+
+    virtual
+    ~CompressedFitsImage() { }
+
+protected:
+
+    typedef std::vector < float > Tile;
+
+    /// compression algorithms
+    enum class Algorithm
+    {
+        Rice, Gzip1, Gzip2, None
+    };
+
+    /// location of a column in the rows of the table
+    struct Column {
+        /// offset in bytes from the start of the row, -1 if there is no such column
+        int64_t offset = - 1;
+
+        /// FITS type code of the values (or of the array elements for descriptors)
+        char type = 0;
+
+        /// is this a variable length array descriptor (P or Q)?
+        bool descriptor = false;
+
+        /// 64 bit descriptor (Q)?
+        bool longDescriptor = false;
+
+        bool
+        exists() const
+        {
+            return offset >= 0;
+        }
+    };
+
+    /// parse the table and compression parameters from the header of the extension
+    /// \param hdr the header
+    /// \return false if the image can't be read
+    bool
+    parseHeader( WcsPlotterPluginNS::FitsHeader & hdr );
+
+    /// read a variable length array descriptor from a row
+    /// \return false if there is no data, or the descriptor points outside of the heap
+    bool
+    arrayData( const char * row, const Column & col, int64_t & count, const uint8_t * & data ) const;
+
+    /// read a scalar column from a row
+    double
+    scalarValue( const char * row, const Column & col, double defaultValue ) const;
+
+    /// position of the first pixel of a tile, and the size of the tile
+    void
+    tileBox( int64_t index, VI & origin, VI & extent ) const;
+
+    /// decompress a tile
+    /// \return false if the tile is corrupted
+    bool
+    decodeTile( int64_t index, Tile & out ) const;
+
+    /// convert the integers of a tile (quantized floats, or integer pixels) to pixels
+    void
+    integersToPixels( const char * row, int64_t index, const std::vector < int32_t > & ints,
+                      Tile & out ) const;
+
+    /// convert stored big-endian values to pixels
+    /// \param bitpix type of the stored values, same meaning as BITPIX
+    void
+    rawToPixels( const uint8_t * data, int bitpix, int64_t count, Tile & out ) const;
+
+    /// copy the part of a box that lies in a tile
+    void
+    copyFromTile( int64_t index, const Tile & tile, const VI & blc, const VI & shape,
+                  const VI & step, float * out ) const;
+
+    /// the table and the heap
+    FitsMapping::SharedPtr m_mapping;
+    int64_t m_mappingSize = 0;
+    int64_t m_rowBytes = 0;
+    int64_t m_rows = 0;
+    int64_t m_heapOffset = 0;
+    int64_t m_heapSize = 0;
+
+    Column m_compressedCol, m_gzipCol, m_uncompressedCol, m_scaleCol, m_zeroCol, m_blankCol;
+
+    Algorithm m_algorithm = Algorithm::Rice;
+    int m_riceBlockSize = 32;
+    int m_riceBytePix = 4;
+
+    /// BITPIX of the uncompressed image
+    int m_zbitpix = 0;
+
+    /// dimensions of the image and of the tiles, and the number of tiles along each axis
+    VI m_dims, m_tileShape, m_tileCounts;
+
+    /// scaling of integer images
+    double m_bscale = 1, m_bzero = 0;
+
+    /// null value (ZBLANK keyword, or BLANK for integer images)
+    bool m_hasBlank = false;
+    int64_t m_blank = 0;
+
+    /// floating point data stored as quantized integers?
+    bool m_quantized = false;
+
+    /// quantization scaling used for tiles without ZSCALE and ZZERO columns
+    double m_zscale = 1, m_zzero = 0;
+
+    /// 0 = no dithering, 1 = SUBTRACTIVE_DITHER_1, 2 = SUBTRACTIVE_DITHER_2
+    int m_dither = 0;
+    int m_ditherSeed = 1;
+
+    Unit m_unit;
+    std::shared_ptr < casa::CoordinateSystem > m_casaCS;
+    QString m_htmlTitle;
+    CCMetaDataInterface::SharedPtr m_meta;
+
+    /// decoded tiles, keyed by their index
+    Carta::Core::ManagedCache < Tile > m_tiles { "tile" };
+};
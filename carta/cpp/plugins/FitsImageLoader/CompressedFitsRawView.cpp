@@ -0,0 +1,197 @@
+/**
+ *
+ **/
+
+#include "CompressedFitsRawView.h"
+#include "CompressedFitsImage.h"
+#include <algorithm>
+
+CompressedFitsRawView::CompressedFitsRawView( CompressedFitsImage * image, const SliceND & sliceInfo )
+    : CompressedFitsRawView( image, sliceInfo.apply( image-> dims() ) )
+{ }
+
+CompressedFitsRawView::CompressedFitsRawView( CompressedFitsImage * image,
+                                              const SliceND::ApplyResult & applyResult )
+{
+    // remember the pointer to the carta image
+    m_image = image;
+
+    // figure out what data to extract for each of the dimensions
+    m_appliedSlice = applyResult;
+
+    // cache the dimensions of the result, and where it is in the image
+    for ( size_t i = 0 ; i < m_appliedSlice.dims().size() ; i++ ) {
+        const auto & slice1d = m_appliedSlice.dims()[i];
+
+        // single index slices keep the axis, with one element
+        m_viewDims.push_back( std::max < int > ( slice1d.count, 1 ) );
+        m_start.push_back( slice1d.start );
+        m_step.push_back( slice1d.step );
+    }
+    m_currPosView.resize( m_viewDims.size(), 0 );
+}
+
+NdArray::RawViewInterface::PixelType
+CompressedFitsRawView::pixelType()
+{
+    return m_image-> pixelType();
+}
+
+const char *
+CompressedFitsRawView::get( const VI & pos )
+{
+    // preconditions
+    if ( CARTA_RUNTIME_CHECKS && pos.size() > dims().size() ) {
+        throw std::runtime_error( "invalid position" );
+    }
+    VI blc = m_start;
+    for ( size_t i = 0 ; i < pos.size() ; i++ ) {
+        blc[i] += pos[i] * m_step[i];
+    }
+    VI ones( blc.size(), 1 );
+    m_image-> readBox( blc, ones, ones, & m_buff );
+    return reinterpret_cast < const char * > ( & m_buff );
+}
+
+NdArray::RawViewInterface *
+CompressedFitsRawView::getView( const SliceND & sliceInfo )
+{
+    // apply the slice to dimensions of this view
+    SliceND::ApplyResult ar = sliceInfo.apply( dims() );
+
+    // create applied result that combines m_appliedSlice with ar
+    SliceND::ApplyResult newAr = SliceND::ApplyResult::combine( m_appliedSlice, ar );
+
+    // return a new view bases on the new slice
+    return new CompressedFitsRawView( m_image, newAr );
+}
+
+void
+CompressedFitsRawView::forEach(
+    std::function < void (const char *) > func,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    // visit the elements block by block, instead of decoding the whole view at once
+    auto chunkFunc = [&func] ( const char * data, int64_t count ) {
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            func( data + i * sizeof( float ) );
+        }
+    };
+    forEach( DefaultChunkSize * sizeof( float ), chunkFunc, nullptr, traversal );
+}
+
+void
+CompressedFitsRawView::forEach(
+    int64_t buffSize,
+    std::function < void (const char *, int64_t count) > func,
+    char * buff,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    Q_UNUSED( traversal );
+    CARTA_ASSERT( buffSize >= int64_t( sizeof( float ) ) );
+    int64_t maxElements = buffSize / sizeof( float );
+    int64_t total = nElements();
+    if ( total == 0 ) {
+        return;
+    }
+    std::vector < float > localBuff;
+    if ( ! buff ) {
+        localBuff.resize( std::min( maxElements, total ) );
+        buff = reinterpret_cast < char * > ( localBuff.data() );
+    }
+    for ( int64_t start = 0 ; start < total ; start += maxElements ) {
+        int64_t count = readElements( start, maxElements, reinterpret_cast < float * > ( buff ) );
+        func( buff, count );
+    }
+}
+
+int64_t
+CompressedFitsRawView::read(
+    int64_t buffSize,
+    char * buff,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    Q_UNUSED( traversal );
+    int64_t count = readElements( m_readPos, buffSize / sizeof( float ),
+                                  reinterpret_cast < float * > ( buff ) );
+    m_readPos += count;
+    return count * sizeof( float );
+}
+
+int64_t
+CompressedFitsRawView::read(
+    int64_t chunk,
+    int64_t buffSize,
+    char * buff,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    Q_UNUSED( traversal );
+    int64_t chunkSize = buffSize / sizeof( float );
+    int64_t count = readElements( chunk * chunkSize, chunkSize, reinterpret_cast < float * > ( buff ) );
+    return count * sizeof( float );
+}
+
+int64_t
+CompressedFitsRawView::nElements() const
+{
+    int64_t result = 1;
+    for ( auto dim : m_viewDims ) {
+        result *= dim;
+    }
+    return result;
+}
+
+int64_t
+CompressedFitsRawView::readElements( int64_t start, int64_t count, float * out )
+{
+    int64_t total = nElements();
+    if ( start < 0 || start >= total || count <= 0 ) {
+        return 0;
+    }
+    count = std::min( count, total - start );
+
+    // position of the first element in view coordinates
+    size_t nDims = m_viewDims.size();
+    VI pos( nDims );
+    int64_t rest = start;
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        pos[i] = rest % m_viewDims[i];
+        rest /= m_viewDims[i];
+    }
+
+    int64_t done = 0;
+    while ( done < count ) {
+        // the box covers all of the axes below 'axis', and a part of 'axis'
+        int64_t remaining = count - done;
+        size_t axis = 0;
+        int64_t block = 1;
+        while ( axis < nDims && pos[axis] == 0 && block * m_viewDims[axis] <= remaining ) {
+            block *= m_viewDims[axis];
+            axis++;
+        }
+        int64_t len = 1;
+        if ( axis < nDims ) {
+            len = std::min < int64_t > ( m_viewDims[axis] - pos[axis], remaining / block );
+        }
+
+        VI blc( nDims ), shape( nDims );
+        for ( size_t i = 0 ; i < nDims ; i++ ) {
+            int viewStart = i < axis ? 0 : pos[i];
+            blc[i] = m_start[i] + viewStart * m_step[i];
+            shape[i] = i < axis ? m_viewDims[i] : ( i == axis ? len : 1 );
+        }
+        m_image-> readBox( blc, shape, m_step, out + done );
+        done += block * len;
+        if ( axis == nDims ) {
+            break;
+        }
+
+        // advance the position, with carry into the higher axes
+        pos[axis] += len;
+        for ( size_t i = axis ; i + 1 < nDims && pos[i] == m_viewDims[i] ; i++ ) {
+            pos[i] = 0;
+            pos[i + 1]++;
+        }
+    }
+    return count;
+} // readElements
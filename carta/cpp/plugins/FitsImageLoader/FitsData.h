@@ -0,0 +1,43 @@
+/**
+ * Helpers for reading the data and the header values of FITS files, shared by the
+ * uncompressed and the tile-compressed images.
+ **/
+
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+#include <algorithm>
+#include <cstring>
+
+/// load a big-endian value from the file data
+template < typename T >
+inline T
+loadBigEndian( const void * data )
+{
+    const char * ptr = static_cast < const char * > ( data );
+    T result;
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+
+    // no swap, e.g. on power pc
+    std::memcpy( & result, ptr, sizeof( T ) );
+
+#else
+
+    // big to small endian copy. e.g. on intel
+    std::reverse_copy( ptr, ptr + sizeof( T ), reinterpret_cast < char * > ( & result ) );
+
+#endif
+    return result;
+}
+
+/// remove quotes and spaces from a FITS string value
+inline QString
+fitsString( const QString & value )
+{
+    QString result = value.trimmed();
+    if ( result.startsWith( '\'' ) && result.endsWith( '\'' ) && result.length() >= 2 ) {
+        result = result.mid( 1, result.length() - 2 ).replace( "''", "'" );
+    }
+    return result.trimmed();
+}
@@ -0,0 +1,339 @@
+/**
+ *
+ **/
+
+#include "FitsImage.h"
+#include "FitsData.h"
+#include "FitsRawView.h"
+#include "../WcsPlotter/SimpleFitsParser.h"
+#include <casacore/casa/Exceptions/Error.h>
+#include <casacore/casa/Containers/Record.h>
+#include <casacore/casa/Logging/LogIO.h>
+#include <casacore/images/Images/ImageFITSConverter.h>
+#include <casacore/images/Images/SubImage.h>
+#include <casacore/lattices/Lattices/AxesSpecifier.h>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <set>
+#include <type_traits>
+
+namespace
+{
+/// is the value equal to BLANK? (only integer data can have BLANK)
+template < typename Stored >
+inline bool
+isBlank( Stored value, const FitsImage::Scaling & scaling, std::true_type )
+{
+    return scaling.hasBlank && int64_t( value ) == scaling.blank;
+}
+
+template < typename Stored >
+inline bool
+isBlank( Stored, const FitsImage::Scaling &, std::false_type )
+{
+    return false;
+}
+
+/// decode stored values of type Stored into pixels of type Out
+template < typename Stored, typename Out >
+void
+decodeValues( const char * src, int64_t srcStride, int64_t count, char * dst,
+              const FitsImage::Scaling & scaling )
+{
+    Out * out = reinterpret_cast < Out * > ( dst );
+    if ( ! scaling.required ) {
+        for ( int64_t i = 0 ; i < count ; i++ ) {
+            out[i] = static_cast < Out > ( loadBigEndian < Stored > ( src + i * srcStride ) );
+        }
+        return;
+    }
+    for ( int64_t i = 0 ; i < count ; i++ ) {
+        Stored value = loadBigEndian < Stored > ( src + i * srcStride );
+        if ( isBlank( value, scaling, std::is_integral < Stored > () ) ) {
+            out[i] = std::numeric_limits < Out >::quiet_NaN();
+        }
+        else {
+            out[i] = static_cast < Out > ( scaling.bzero + scaling.bscale * value );
+        }
+    }
+}
+}
+
+FitsMapping::FitsMapping( const QString & fname, qint64 offset, qint64 size )
+    : m_file( fname )
+{
+    if ( ! m_file.open( QFile::ReadOnly ) ) {
+        qWarning() << "Could not open" << fname;
+        return;
+    }
+    m_mapped = m_file.map( offset, size );
+    if ( ! m_mapped ) {
+        qWarning() << "Could not map" << fname << ":" << m_file.errorString();
+        return;
+    }
+    m_data = reinterpret_cast < const char * > ( m_mapped );
+}
+
+FitsMapping::~FitsMapping()
+{
+    if ( m_mapped ) {
+        m_file.unmap( m_mapped );
+    }
+}
+
+FitsImage::SharedPtr
+FitsImage::open( const QString & fname )
+{
+    QFile file( fname );
+    if ( ! file.open( QFile::ReadOnly ) ) {
+        return nullptr;
+    }
+
+    // make sure this is a FITS file before trying to parse the header
+    if ( file.peek( 9 ) != "SIMPLE  =" ) {
+        return nullptr;
+    }
+    WcsPlotterPluginNS::FitsHeader hdr = WcsPlotterPluginNS::FitsHeader::parse( file );
+    if ( ! hdr.isValid() ) {
+        return nullptr;
+    }
+
+    FitsImage::SharedPtr img = std::make_shared < FitsImage > ();
+    int bitpix = 0;
+    QString title;
+    try {
+        if ( hdr.stringValue( "SIMPLE" ) != "T" ) {
+            return nullptr;
+        }
+        bitpix = hdr.intValue( "BITPIX" );
+
+        // images without data in the primary HDU (e.g. compressed images, which are
+        // stored in extensions) and random groups are left to other loaders
+        int naxis = hdr.intValue( "NAXIS" );
+        if ( naxis < 2 || hdr.stringValue( "GROUPS", "F" ) == "T" ) {
+            return nullptr;
+        }
+        for ( int i = 1 ; i <= naxis ; i++ ) {
+            int n = hdr.intValue( QString( "NAXIS%1" ).arg( i ) );
+            if ( n < 1 ) {
+                return nullptr;
+            }
+            img-> m_dims.push_back( n );
+        }
+
+        // blank is only supported for BITPIX > 0
+        if ( bitpix > 0 && hdr.getValue( "BLANK" ).isValid() ) {
+            img-> m_scaling.hasBlank = true;
+            img-> m_scaling.blank = hdr.intValue( "BLANK" );
+        }
+        img-> m_scaling.bscale = hdr.doubleValue( "BSCALE", 1 );
+        img-> m_scaling.bzero = hdr.doubleValue( "BZERO", 0 );
+        img-> m_scaling.required = img-> m_scaling.hasBlank || img-> m_scaling.bzero != 0
+                                   || img-> m_scaling.bscale != 1;
+        img-> m_unit = Unit( fitsString( hdr.stringValue( "BUNIT", "" ) ) );
+        title = fitsString( hdr.stringValue( "OBJECT", "" ) );
+    }
+    catch ( const QString & err ) {
+        qWarning() << err;
+        return nullptr;
+    }
+    catch ( ... ) {
+        return nullptr;
+    }
+
+    int storedSize = 0;
+    switch ( bitpix )
+    {
+    case 8 :
+        img-> m_decode = & decodeValues < uint8_t, float >;
+        img-> m_decodeDouble = & decodeValues < uint8_t, double >;
+        storedSize = 1;
+        break;
+    case 16 :
+        img-> m_decode = & decodeValues < int16_t, float >;
+        img-> m_decodeDouble = & decodeValues < int16_t, double >;
+        storedSize = 2;
+        break;
+    case 32 :
+        img-> m_decode = & decodeValues < int32_t, float >;
+        img-> m_decodeDouble = & decodeValues < int32_t, double >;
+        storedSize = 4;
+        break;
+    case 64 :
+        img-> m_decode = & decodeValues < int64_t, float >;
+        img-> m_decodeDouble = & decodeValues < int64_t, double >;
+        storedSize = 8;
+        break;
+    case - 32 :
+        img-> m_decode = & decodeValues < float, float >;
+        img-> m_decodeDouble = & decodeValues < float, double >;
+        storedSize = 4;
+        break;
+    case - 64 :
+        img-> m_decode = & decodeValues < double, float >;
+        img-> m_decodeDouble = & decodeValues < double, double >;
+        storedSize = 8;
+        break;
+    default :
+        qWarning() << "Illegal value BITPIX =" << bitpix;
+        return nullptr;
+    } // switch
+    img-> m_zeroCopy = Q_BYTE_ORDER == Q_BIG_ENDIAN && bitpix == - 32 && ! img-> m_scaling.required;
+
+    // the data is stored with the first axis fastest
+    int64_t dataSize = storedSize;
+    for ( int dim : img-> m_dims ) {
+        img-> m_strides.push_back( dataSize );
+        dataSize *= dim;
+    }
+    if ( hdr.dataOffset() + dataSize > file.size() ) {
+        qWarning() << "Invalid fits file size. Maybe accidentally truncated?";
+        return nullptr;
+    }
+    img-> m_fileName = fname;
+    img-> m_mapping = std::make_shared < FitsMapping > ( fname, hdr.dataOffset(), dataSize );
+    if ( ! img-> m_mapping-> data() ) {
+        return nullptr;
+    }
+
+    // let casacore make sense of the world coordinates
+    casa::Vector < casa::String > header( hdr.lines().size() );
+    for ( size_t i = 0 ; i < hdr.lines().size() ; i++ ) {
+        header[i] = hdr.lines()[i].raw().toStdString();
+    }
+    try {
+        casa::Record headerRec;
+        casa::LogIO os;
+        casa::Int stokesFITSValue = 1;
+        casa::IPosition shape( img-> m_dims );
+        casa::CoordinateSystem cs = casa::ImageFITSConverter::getCoordinateSystem(
+            stokesFITSValue, headerRec, header, os, 0, shape, false );
+        if ( cs.nPixelAxes() != img-> m_dims.size() ) {
+            qWarning() << "Coordinate system does not match the image axes";
+            return nullptr;
+        }
+        img-> m_casaCS = std::make_shared < casa::CoordinateSystem > ( cs );
+    }
+    catch ( casa::AipsError & e ) {
+        qWarning() << "Could not parse coordinates:" << e.what();
+        return nullptr;
+    }
+    img-> m_htmlTitle = title.toHtmlEscaped();
+    img-> m_meta = std::make_shared < CCMetaDataInterface > ( img-> m_htmlTitle, img-> m_casaCS );
+    return img;
+} // open
+
+std::shared_ptr < Image::ImageInterface >
+FitsImage::getPermuted( const std::vector < int > & indices )
+{
+    //Make sure the passed in indices make sense for this image.
+    int axisCount = m_dims.size();
+    int indexCount = indices.size();
+    CARTA_ASSERT( axisCount == indexCount );
+    std::set < int > usedIndices;
+    for ( int i = 0 ; i < indexCount ; i++ ) {
+        CARTA_ASSERT( 0 <= indices[i] && indices[i] < axisCount );
+        CARTA_ASSERT( usedIndices.count( indices[i] ) == 0 );
+        usedIndices.insert( indices[i] );
+    }
+
+    //The permuted image shares the mapping, only the axes are reordered.
+    FitsImage::SharedPtr img = std::make_shared < FitsImage > ( * this );
+    img-> m_fileAxes.resize( indexCount );
+    casa::Vector < int > newOrder( indexCount );
+    for ( int i = 0 ; i < indexCount ; i++ ) {
+        newOrder[i] = indices[i];
+        img-> m_dims[i] = m_dims[indices[i]];
+        img-> m_strides[i] = m_strides[indices[i]];
+        img-> m_fileAxes[i] = m_fileAxes.empty() ? indices[i] : m_fileAxes[indices[i]];
+    }
+
+    //The casacore image has the axes of the file, the copy opens its own.
+    img-> m_casaImage.reset();
+
+    //Change the order of the axes in the coordinate system
+    img-> m_casaCS = std::make_shared < casa::CoordinateSystem > ( * m_casaCS );
+    img-> m_casaCS-> transpose( newOrder, newOrder );
+    img-> m_meta = std::make_shared < CCMetaDataInterface > ( m_htmlTitle, img-> m_casaCS );
+    return img;
+} // getPermuted
+
+casa::LatticeBase *
+FitsImage::getCasaImage()
+{
+    if ( ! m_casaImage ) {
+        try {
+            auto fitsImage = std::make_shared < casa::FITSImage > ( m_fileName.toStdString() );
+            m_casaImage = fitsImage;
+            if ( ! m_fileAxes.empty() ) {
+                casa::IPosition axisPath( m_fileAxes.size() );
+                for ( size_t i = 0 ; i < m_fileAxes.size() ; i++ ) {
+                    axisPath[i] = m_fileAxes[i];
+                }
+                m_casaImage = std::make_shared < casa::SubImage < casa::Float > > (
+                    * fitsImage, casa::AxesSpecifier( axisPath ) );
+            }
+        }
+        catch ( casa::AipsError & e ) {
+            qWarning() << "Could not open" << m_fileName << "with casacore:" << e.what();
+            return nullptr;
+        }
+    }
+    return m_casaImage.get();
+}
+
+NdArray::RawViewInterface *
+FitsImage::getDataSlice( const SliceND & sliceInfo )
+{
+    return new FitsRawView( this, sliceInfo );
+}
+
+bool
+FitsImage::getPixel( const VI & pos, double & value )
+{
+    if ( ! isInside( pos, 0 ) ) {
+        return false;
+    }
+    m_decodeDouble( address( pos ), 0, 1, reinterpret_cast < char * > ( & value ), m_scaling );
+    return true;
+}
+
+bool
+FitsImage::getRow( const VI & pos, double * row )
+{
+    if ( ! isInside( pos, 1 ) ) {
+        return false;
+    }
+    VI start = pos;
+    start[0] = 0;
+    m_decodeDouble( address( start ), m_strides[0], m_dims[0],
+                    reinterpret_cast < char * > ( row ), m_scaling );
+    return true;
+}
+
+bool
+FitsImage::isInside( const VI & pos, size_t firstAxis ) const
+{
+    if ( pos.size() != m_dims.size() || m_dims.empty() ) {
+        return false;
+    }
+    for ( size_t i = firstAxis ; i < pos.size() ; i++ ) {
+        if ( pos[i] < 0 || pos[i] >= m_dims[i] ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char *
+FitsImage::address( const VI & pos ) const
+{
+    const char * result = m_mapping-> data();
+    for ( size_t i = 0 ; i < pos.size() ; i++ ) {
+        result += pos[i] * m_strides[i];
+    }
+    return result;
+}
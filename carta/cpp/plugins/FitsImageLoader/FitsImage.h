@@ -0,0 +1,227 @@
+/**
+ * Image interface for uncompressed FITS files, served directly from a memory mapping.
+ *
+ * Only the data section of the primary HDU is mapped, nothing is read when the image is
+ * opened, so opening even a huge cube only costs parsing the header. Pages of the file
+ * are brought in by the operating system when a view touches them. The data is stored
+ * big-endian in the file, so the views decode it (swap bytes and apply BSCALE, BZERO and
+ * BLANK) while copying it into the caller's buffer. There are no other copies.
+ *
+ * The pixels are always presented as floats, the same as casacore does for FITS images
+ * (this also allows BLANK to be turned into NaN).
+ *
+ * Plugins that need a casacore image (e.g. for the histogram or the WCS grid) still
+ * get one through getCasaImage(), it's only opened when they ask for it.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include "../CasaImageLoader/CCImage.h"
+#include "../CasaImageLoader/CCMetaDataInterface.h"
+#include <casacore/images/Images/FITSImage.h>
+#include <casacore/images/Images/ImageInterface.h>
+#include <QFile>
+#include <QString>
+#include <memory>
+#include <vector>
+
+/// read-only mapping of a part of a file, shared by an image and all its permuted
+/// versions
+class FitsMapping
+{
+    CLASS_BOILERPLATE( FitsMapping );
+
+public:
+
+    /// map size bytes of the file starting at offset
+    FitsMapping( const QString & fname, qint64 offset, qint64 size );
+
+    ~FitsMapping();
+
+    /// the mapped data, or nullptr if the mapping failed
+    const char *
+    data() const
+    {
+        return m_data;
+    }
+
+private:
+
+    QFile m_file;
+    uchar * m_mapped = nullptr;
+    const char * m_data = nullptr;
+};
+
+class FitsRawView;
+
+class FitsImage
+    : public CCImageBase
+{
+    CLASS_BOILERPLATE( FitsImage );
+
+public:
+
+    /// values needed to convert the stored values to pixel values
+    struct Scaling {
+        bool required = false;
+        double bscale = 1;
+        double bzero = 0;
+        bool hasBlank = false;
+        int64_t blank = 0;
+    };
+
+    /// open the primary HDU of a FITS file
+    /// \return the image, or nullptr if the file is not an uncompressed FITS image
+    static FitsImage::SharedPtr
+    open( const QString & fname );
+
+    virtual const Unit &
+    getPixelUnit() const override
+    {
+        return m_unit;
+    }
+
+    /// the permuted image shares the mapping, only the strides are permuted
+    virtual std::shared_ptr < Image::ImageInterface >
+    getPermuted( const std::vector < int > & indices ) override;
+
+    virtual const VI &
+    dims() const override
+    {
+        return m_dims;
+    }
+
+    virtual bool
+    hasMask() const override
+    {
+        return false;
+    }
+
+    virtual bool
+    hasErrorsInfo() const override
+    {
+        return false;
+    }
+
+    virtual Image::PixelType
+    pixelType() const override
+    {
+        return m_pixelType;
+    }
+
+    virtual Image::PixelType
+    errorType() const override
+    {
+        qFatal( "not implemented" );
+    }
+
+    virtual NdArray::RawViewInterface *
+    getDataSlice( const SliceND & sliceInfo ) override;
+
+    /// \todo implement this
+    virtual NdArray::Byte *
+    getMaskSlice( const SliceND & sliceInfo ) override
+    {
+        Q_UNUSED( sliceInfo );
+        qFatal( "not implemented" );
+    }
+
+    /// \todo implement this
+    virtual NdArray::RawViewInterface *
+    getErrorSlice( const SliceND & sliceInfo ) override
+    {
+        Q_UNUSED( sliceInfo );
+        qFatal( "not implemented" );
+    }
+
+    /// decodes the pixel straight from the mapping
+    virtual bool
+    getPixel( const VI & pos, double & value ) override;
+
+    virtual bool
+    getRow( const VI & pos, double * row ) override;
+
+    virtual Image::MetaDataInterface::SharedPtr
+    metaData() override
+    {
+        return m_meta;
+    }
+
+    /// casacore's view of the file, opened on the first call, with its axes in the
+    /// order of this image
+    virtual casa::LatticeBase *
+    getCasaImage() override;
+
+    /// decode stored values into pixels of pixelType()
+    /// \param src first stored value
+    /// \param srcStride distance between the stored values in bytes
+    /// \param count number of values
+    /// \param dst where to store the pixels
+    void
+    decode( const char * src, int64_t srcStride, int64_t count, char * dst ) const
+    {
+        m_decode( src, srcStride, count, dst, m_scaling );
+    }
+
+    /// can the stored values be used as pixels without decoding them?
+    /// (only on big-endian machines, for BITPIX = -32 without scaling)
+    bool
+    isZeroCopy() const
+    {
+        return m_zeroCopy;
+    }
+
+    FitsImage() { }
+
+    virtual
+    ~FitsImage() { }
+
+protected:
+
+    typedef void ( * DecodeFunc )( const char * src, int64_t srcStride, int64_t count,
+                                   char * dst, const Scaling & scaling );
+
+    /// is pos inside of the image, checking axes from firstAxis on
+    bool
+    isInside( const VI & pos, size_t firstAxis ) const;
+
+    /// address of the stored value at pos
+    const char *
+    address( const VI & pos ) const;
+
+    /// the data of the primary HDU
+    FitsMapping::SharedPtr m_mapping;
+
+    QString m_fileName;
+
+    /// type of the pixels, and the size of one in bytes
+    Image::PixelType m_pixelType = Image::PixelType::Real32;
+    int m_pixelSize = sizeof( float );
+
+    /// dimensions of the image, and the distance between neighbours along each axis
+    /// in bytes
+    std::vector < int > m_dims;
+    std::vector < int64_t > m_strides;
+
+    Scaling m_scaling;
+    DecodeFunc m_decode = nullptr;
+    DecodeFunc m_decodeDouble = nullptr;
+    bool m_zeroCopy = false;
+
+    Unit m_unit;
+
+    /// coordinate system, kept so that it can be permuted with the image
+    std::shared_ptr < casa::CoordinateSystem > m_casaCS;
+    QString m_htmlTitle;
+    CCMetaDataInterface::SharedPtr m_meta;
+
+    /// for each axis, the axis of the file it comes from, empty if not permuted
+    std::vector < int > m_fileAxes;
+
+    /// opened by getCasaImage(), not shared with permuted copies
+    std::shared_ptr < casa::ImageInterface < casa::Float > > m_casaImage;
+
+    friend class FitsRawView;
+};
@@ -0,0 +1,62 @@
+#include "FitsImageLoader.h"
+#include "FitsImage.h"
+#include "CompressedFitsImage.h"
+#include "CartaLib/Hooks/LoadAstroImage.h"
+#include <QDebug>
+
+typedef Carta::Lib::Hooks::LoadAstroImage LoadAstroImage;
+
+FitsImageLoader::FitsImageLoader(QObject *parent) :
+    QObject(parent)
+{
+}
+
+bool FitsImageLoader::handleHook(BaseHook & hookData)
+{
+    qDebug() << "FitsImageLoader plugin is handling hook #" << hookData.hookId();
+    if( hookData.is<Initialize>()) {
+        return true;
+    }
+
+    else if( hookData.is<LoadAstroImage>()) {
+        LoadAstroImage & hook = static_cast<LoadAstroImage &>( hookData);
+        auto fname = hook.paramsPtr->fileName;
+        hook.result = loadImage( fname);
+        // return true if result is not null, so that other loaders get a chance
+        // with files we don't understand
+        return hook.result != nullptr;
+    }
+
+    qWarning() << "Sorrry, dont' know how to handle this hook";
+    return false;
+}
+
+std::vector<HookId> FitsImageLoader::getInitialHookList()
+{
+    return {
+        Initialize::staticId,
+        LoadAstroImage::staticId
+    };
+}
+
+///
+/// \brief Attempts to map the primary HDU of a FITS file, or the first
+/// tile-compressed image in its extensions.
+/// \param fname file name with the image
+/// \return the image, or nullptr if the file is not a FITS image we can read
+///
+Image::ImageInterface::SharedPtr FitsImageLoader::loadImage( const QString & fname)
+{
+    qDebug() << "FitsImageLoader plugin trying to load image: " << fname;
+    Image::ImageInterface::SharedPtr res = FitsImage::open( fname);
+    if( ! res) {
+        qDebug() << "\t-not an uncompressed FITS image";
+        res = CompressedFitsImage::open( fname);
+    }
+    if( ! res) {
+        qDebug() << "\t-not a tile-compressed FITS image";
+        return nullptr;
+    }
+    qDebug() << "Created image interface with type=" << Carta::toStr( res->pixelType());
+    return res;
+}
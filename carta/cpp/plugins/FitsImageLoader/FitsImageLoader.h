@@ -0,0 +1,25 @@
+/// This plugin reads uncompressed FITS images by mapping them into memory.
+
+#pragma once
+
+#include "CartaLib/IPlugin.h"
+#include <QObject>
+#include <QString>
+
+
+class FitsImageLoader : public QObject, public IPlugin
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "org.cartaviewer.IPlugin")
+    Q_INTERFACES( IPlugin)
+
+public:
+
+    FitsImageLoader(QObject *parent = 0);
+    virtual bool handleHook(BaseHook & hookData) override;
+    virtual std::vector<HookId> getInitialHookList() override;
+
+private:
+
+    Image::ImageInterface::SharedPtr loadImage(const QString & fname);
+};
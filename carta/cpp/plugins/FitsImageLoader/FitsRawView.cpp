@@ -0,0 +1,251 @@
+/**
+ *
+ **/
+
+#include "FitsRawView.h"
+#include "FitsImage.h"
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <utility>
+
+FitsRawView::FitsRawView( FitsImage * image, const SliceND & sliceInfo )
+    : FitsRawView( image, sliceInfo.apply( image-> dims() ) )
+{ }
+
+FitsRawView::FitsRawView( FitsImage * image, const SliceND::ApplyResult & applyResult )
+{
+    // remember the pointer to the carta image
+    m_image = image;
+
+    // figure out what data to extract for each of the dimensions
+    m_appliedSlice = applyResult;
+
+    // cache the dimensions of the result, and where the data is in the mapping
+    m_origin = m_image-> m_mapping-> data();
+    for ( size_t i = 0 ; i < m_appliedSlice.dims().size() ; i++ ) {
+        const auto & slice1d = m_appliedSlice.dims()[i];
+
+        // single index slices keep the axis, with one element
+        m_viewDims.push_back( std::max < int > ( slice1d.count, 1 ) );
+        m_origin += slice1d.start * m_image-> m_strides[i];
+        m_viewStrides.push_back( slice1d.step * m_image-> m_strides[i] );
+    }
+    m_currPosView.resize( m_viewDims.size(), 0 );
+}
+
+NdArray::RawViewInterface::PixelType
+FitsRawView::pixelType()
+{
+    return m_image-> pixelType();
+}
+
+const char *
+FitsRawView::address( const VI & pos ) const
+{
+    const char * result = m_origin;
+    for ( size_t i = 0 ; i < pos.size() && i < m_viewDims.size() ; i++ ) {
+        result += pos[i] * m_viewStrides[i];
+    }
+    return result;
+}
+
+bool
+FitsRawView::isFileOrder() const
+{
+    // axes with a single element don't change the order
+    int64_t previous = 0;
+    for ( size_t i = 0 ; i < m_viewStrides.size() ; i++ ) {
+        if ( m_viewDims[i] > 1 ) {
+            if ( std::abs( m_viewStrides[i] ) < previous ) {
+                return false;
+            }
+            previous = std::abs( m_viewStrides[i] );
+        }
+    }
+    return true;
+}
+
+FitsRawView
+FitsRawView::fileOrder() const
+{
+    // axes with a single element go last
+    std::vector < size_t > order( m_viewDims.size() );
+    std::iota( order.begin(), order.end(), 0 );
+    std::stable_sort( order.begin(), order.end(), [this] ( size_t a, size_t b ) {
+                          return std::make_pair( m_viewDims[a] == 1, std::abs( m_viewStrides[a] ) )
+                                 < std::make_pair( m_viewDims[b] == 1, std::abs( m_viewStrides[b] ) );
+                      }
+                      );
+    FitsRawView result( * this );
+    for ( size_t i = 0 ; i < order.size() ; i++ ) {
+        result.m_viewDims[i] = m_viewDims[order[i]];
+        result.m_viewStrides[i] = m_viewStrides[order[i]];
+    }
+    return result;
+}
+
+const char *
+FitsRawView::get( const VI & pos )
+{
+    // preconditions
+    if ( CARTA_RUNTIME_CHECKS && pos.size() > dims().size() ) {
+        throw std::runtime_error( "invalid position" );
+    }
+    char * buff = reinterpret_cast < char * > ( & m_buff );
+    m_image-> decode( address( pos ), 0, 1, buff );
+    return buff;
+}
+
+NdArray::RawViewInterface *
+FitsRawView::getView( const SliceND & sliceInfo )
+{
+    // apply the slice to dimensions of this view
+    SliceND::ApplyResult ar = sliceInfo.apply( dims() );
+
+    // create applied result that combines m_appliedSlice with ar
+    SliceND::ApplyResult newAr = SliceND::ApplyResult::combine( m_appliedSlice, ar );
+
+    // return a new view bases on the new slice
+    return new FitsRawView( m_image, newAr );
+}
+
+void
+FitsRawView::forEach(
+    std::function < void (const char *) > func,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    // visit the elements block by block, instead of decoding the whole view at once
+    int pixelSize = m_image-> m_pixelSize;
+    auto chunkFunc = [&func, pixelSize] ( const char * data, int64_t count ) {
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            func( data + i * pixelSize );
+        }
+    };
+    forEach( DefaultChunkSize * pixelSize, chunkFunc, nullptr, traversal );
+}
+
+void
+FitsRawView::forEach(
+    int64_t buffSize,
+    std::function < void (const char *, int64_t count) > func,
+    char * buff,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    if ( traversal == Traversal::Optimal && ! isFileOrder() ) {
+        fileOrder().forEach( buffSize, func, buff, Traversal::Sequential );
+        return;
+    }
+    int pixelSize = m_image-> m_pixelSize;
+    CARTA_ASSERT( buffSize >= pixelSize );
+    int64_t maxElements = buffSize / pixelSize;
+    int64_t total = nElements();
+    if ( total == 0 ) {
+        return;
+    }
+
+    // hand out the rows straight from the mapping if they are usable as they are
+    size_t nDims = m_viewDims.size();
+    if ( ! buff && m_image-> isZeroCopy() && m_viewStrides[0] == pixelSize ) {
+        VI pos( nDims, 0 );
+        for ( int64_t row = 0 ; row < total / m_viewDims[0] ; row++ ) {
+            const char * data = address( pos );
+            for ( int64_t start = 0 ; start < m_viewDims[0] ; start += maxElements ) {
+                int64_t count = std::min < int64_t > ( maxElements, m_viewDims[0] - start );
+                func( data + start * pixelSize, count );
+            }
+            for ( size_t i = 1 ; i < nDims ; i++ ) {
+                if ( ++pos[i] < m_viewDims[i] ) {
+                    break;
+                }
+                pos[i] = 0;
+            }
+        }
+        return;
+    }
+
+    std::vector < char > localBuff;
+    if ( ! buff ) {
+        localBuff.resize( std::min( maxElements, total ) * pixelSize );
+        buff = localBuff.data();
+    }
+    for ( int64_t start = 0 ; start < total ; start += maxElements ) {
+        int64_t count = readElements( start, maxElements, buff );
+        func( buff, count );
+    }
+} // forEach
+
+int64_t
+FitsRawView::read(
+    int64_t buffSize,
+    char * buff,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    int pixelSize = m_image-> m_pixelSize;
+    int64_t count = traversal == Traversal::Optimal && ! isFileOrder()
+                    ? fileOrder().readElements( m_readPos, buffSize / pixelSize, buff )
+                    : readElements( m_readPos, buffSize / pixelSize, buff );
+    m_readPos += count;
+    return count * pixelSize;
+}
+
+int64_t
+FitsRawView::read(
+    int64_t chunk,
+    int64_t buffSize,
+    char * buff,
+    NdArray::RawViewInterface::Traversal traversal )
+{
+    int pixelSize = m_image-> m_pixelSize;
+    int64_t chunkSize = buffSize / pixelSize;
+    int64_t count = traversal == Traversal::Optimal && ! isFileOrder()
+                    ? fileOrder().readElements( chunk * chunkSize, chunkSize, buff )
+                    : readElements( chunk * chunkSize, chunkSize, buff );
+    return count * pixelSize;
+}
+
+int64_t
+FitsRawView::nElements() const
+{
+    int64_t result = 1;
+    for ( auto dim : m_viewDims ) {
+        result *= dim;
+    }
+    return result;
+}
+
+int64_t
+FitsRawView::readElements( int64_t start, int64_t count, char * out )
+{
+    int64_t total = nElements();
+    if ( start < 0 || start >= total || count <= 0 ) {
+        return 0;
+    }
+    count = std::min( count, total - start );
+
+    // position of the first element in view coordinates
+    size_t nDims = m_viewDims.size();
+    VI pos( nDims );
+    int64_t rest = start;
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        pos[i] = rest % m_viewDims[i];
+        rest /= m_viewDims[i];
+    }
+
+    // decode the range one (partial) row at a time
+    int pixelSize = m_image-> m_pixelSize;
+    int64_t done = 0;
+    while ( done < count ) {
+        int64_t len = std::min < int64_t > ( m_viewDims[0] - pos[0], count - done );
+        m_image-> decode( address( pos ), m_viewStrides[0], len, out + done * pixelSize );
+        done += len;
+
+        // advance the position, with carry into the higher axes
+        pos[0] += len;
+        for ( size_t i = 0 ; i + 1 < nDims && pos[i] == m_viewDims[i] ; i++ ) {
+            pos[i] = 0;
+            pos[i + 1]++;
+        }
+    }
+    return count;
+} // readElements
@@ -0,0 +1,127 @@
+/**
+ *
+ **/
+
+#pragma once
+
+#include "CartaLib/IImage.h"
+#include <vector>
+
+class FitsImage;
+
+/// FitsImageLoader plugin's implementation of the raw view
+///
+/// The view reads straight from the mapping of the image. Stored values are decoded
+/// (byte-swapped and scaled) only when they are copied into the buffer of a bulk read,
+/// one row at a time. The mapping is read-only, so a view can be used from any thread,
+/// but a single view is not thread safe.
+///
+/// Traversal::Optimal follows the order of the file, i.e. the axes of the view are
+/// traversed in the order of their strides. For an image that is not permuted that is
+/// the same as the sequential order, for a permuted one it avoids jumping across the
+/// mapping for every element.
+class FitsRawView
+    : public NdArray::RawViewInterface
+{
+public:
+
+    /// construct a view on an image from provided slice information
+    /// \param image pointer to the image which we keep on using, but we don't assume
+    /// ownership. It has to remain valid for the duration of existance of this instance.
+    /// \param sliceInfo for which part of the image to create view
+    FitsRawView( FitsImage * image, const SliceND & sliceInfo );
+
+    virtual PixelType
+    pixelType() override;
+
+    virtual const VI &
+    dims() override
+    {
+        return m_viewDims;
+    }
+
+    virtual const char *
+    get( const VI & pos ) override;
+
+    virtual void
+    forEach( std::function < void (const char *) > func, Traversal traversal ) override;
+
+    virtual const VI &
+    currentPos() override
+    {
+        return m_currPosView;
+    }
+
+    virtual RawViewInterface *
+    getView( const SliceND & sliceInfo ) override;
+
+    /// read the next buffSize bytes of the view, starting at the position set by seek()
+    virtual int64_t
+    read( int64_t buffSize, char * buff,
+          Traversal traversal = Traversal::Sequential ) override;
+
+    /// set the position (in elements) of the next read()
+    virtual void
+    seek( int64_t ind ) override
+    {
+        m_readPos = ind;
+    }
+
+    virtual int64_t
+    read( int64_t chunk, int64_t buffSize, char * buff,
+          Traversal traversal = Traversal::Sequential ) override;
+
+    /// The view is decoded in blocks of at most buffSize bytes. If the image does not
+    /// need decoding and no buffer is given, func gets pointers into the mapping.
+    virtual void
+    forEach(
+        int64_t buffSize,
+        std::function < void (const char *, int64_t count) > func,
+        char * buff = nullptr,
+        Traversal traversal = Traversal::Sequential ) override;
+
+protected:
+
+    /// default block size (in elements) used by the element-wise forEach()
+    static constexpr int64_t DefaultChunkSize = 1024 * 1024;
+
+    /// construct a view directly from applied slice
+    FitsRawView( FitsImage * image, const SliceND::ApplyResult & applyResult );
+
+    /// total number of elements in the view
+    int64_t
+    nElements() const;
+
+    /// decode elements [start, start+count) of the view in sequential order
+    /// \return number of elements decoded
+    int64_t
+    readElements( int64_t start, int64_t count, char * out );
+
+    /// address of the stored value at pos (view coordinates)
+    const char *
+    address( const VI & pos ) const;
+
+    /// are the axes of the view in the order of the file (by increasing stride)
+    bool
+    isFileOrder() const;
+
+    /// a copy of the view with its axes in the order of the file, its sequential
+    /// order is the Traversal::Optimal order of this view
+    FitsRawView
+    fileOrder() const;
+
+    FitsImage * m_image = nullptr; // we don't own this!
+    SliceND::ApplyResult m_appliedSlice;
+    VI m_viewDims, m_currPosView;
+
+    /// address of the first element of the view, and the distance between neighbours
+    /// along each axis of the view in bytes
+    const char * m_origin = nullptr;
+    std::vector < int64_t > m_viewStrides;
+
+    // buffer for reporting results when calling get()
+    double m_buff;
+
+    // position (in elements) of the next stateful read()
+    int64_t m_readPos = 0;
+};
@@ -0,0 +1,215 @@
+/**
+ *
+ **/
+
+#include "FitsTileCompression.h"
+#include <zlib.h>
+#include <algorithm>
+
+namespace FitsTileCompression
+{
+namespace
+{
+/// number of significant bits in a byte
+struct SignificantBits {
+    SignificantBits()
+    {
+        bits[0] = 0;
+        for ( int i = 1 ; i < 256 ; i++ ) {
+            bits[i] = bits[i / 2] + 1;
+        }
+    }
+
+    int bits[256];
+};
+
+/// Rice decoding for bytePix sized integers, see fits_rdecomp() in cfitsio
+template < typename T >
+bool
+riceDecodeTyped( const uint8_t * in, int64_t inSize, int blockSize, int64_t count,
+                 int32_t * out, int fsBits, int fsMax )
+{
+    static const SignificantBits significant;
+    const int bBits = 8 * sizeof( T );
+    const uint8_t * end = in + inSize;
+    if ( inSize < int64_t( sizeof( T ) ) + 1 ) {
+        return false;
+    }
+
+    // the first value is stored as it is, big-endian
+    uint32_t first = 0;
+    for ( size_t i = 0 ; i < sizeof( T ) ; i++ ) {
+        first = ( first << 8 ) | * in++;
+    }
+    T lastPix = static_cast < T > ( first );
+
+    // bit buffer: b holds nBits unused bits, reading past the end (which cfitsio
+    // reports as "hit end of compressed byte stream") feeds zeros and fails the tile
+    uint32_t b = * in++;
+    int nBits = 8;
+    bool overrun = false;
+    auto nextByte = [&in, end, &overrun] () -> uint32_t {
+        if ( in < end ) {
+            return * in++;
+        }
+        overrun = true;
+        return 0;
+    };
+
+    for ( int64_t i = 0 ; i < count ; ) {
+        // the block header: fs + 1 in fsBits bits
+        nBits -= fsBits;
+        while ( nBits < 0 ) {
+            b = ( b << 8 ) | nextByte();
+            nBits += 8;
+        }
+        int fs = int( b >> nBits ) - 1;
+        b &= ( 1u << nBits ) - 1;
+        int64_t iMax = std::min < int64_t > ( i + blockSize, count );
+
+        if ( fs < 0 ) {
+            // all differences are zero
+            for ( ; i < iMax ; i++ ) {
+                out[i] = lastPix;
+            }
+        }
+        else if ( fs == fsMax ) {
+            // high entropy block, the differences are stored with bBits bits each
+            for ( ; i < iMax ; i++ ) {
+                int k = bBits - nBits;
+                uint32_t diff = k < 32 ? b << k : 0;
+                for ( k -= 8 ; k >= 0 ; k -= 8 ) {
+                    b = nextByte();
+                    diff |= b << k;
+                }
+                if ( nBits > 0 ) {
+                    b = nextByte();
+                    diff |= b >> ( - k );
+                    b &= ( 1u << nBits ) - 1;
+                }
+                else {
+                    b = 0;
+                }
+                diff = ( diff & 1 ) == 0 ? diff >> 1 : ~ ( diff >> 1 );
+                lastPix = static_cast < T > ( diff + uint32_t( lastPix ) );
+                out[i] = lastPix;
+            }
+        }
+        else if ( fs > fsMax ) {
+            return false;
+        }
+        else {
+            // the differences are stored as the number of leading zeros (unary, ended
+            // by a one bit) followed by the fs low bits
+            for ( ; i < iMax ; i++ ) {
+                while ( b == 0 ) {
+                    if ( in >= end ) {
+                        return false;
+                    }
+                    nBits += 8;
+                    b = * in++;
+                }
+                int nZero = nBits - significant.bits[b];
+                nBits -= nZero + 1;
+                b ^= 1u << nBits;
+                nBits -= fs;
+                while ( nBits < 0 ) {
+                    b = ( b << 8 ) | nextByte();
+                    nBits += 8;
+                }
+                uint32_t diff = ( uint32_t( nZero ) << fs ) | ( b >> nBits );
+                b &= ( 1u << nBits ) - 1;
+                diff = ( diff & 1 ) == 0 ? diff >> 1 : ~ ( diff >> 1 );
+                lastPix = static_cast < T > ( diff + uint32_t( lastPix ) );
+                out[i] = lastPix;
+            }
+        }
+        if ( overrun ) {
+            return false;
+        }
+    }
+    return true;
+} // riceDecodeTyped
+}
+
+bool
+riceDecode( const uint8_t * in, int64_t inSize, int bytePix, int blockSize, int64_t count,
+            int32_t * out )
+{
+    if ( blockSize <= 0 ) {
+        return false;
+    }
+    switch ( bytePix )
+    {
+    case 1 :
+        return riceDecodeTyped < uint8_t > ( in, inSize, blockSize, count, out, 3, 6 );
+    case 2 :
+        return riceDecodeTyped < int16_t > ( in, inSize, blockSize, count, out, 4, 14 );
+    case 4 :
+        return riceDecodeTyped < int32_t > ( in, inSize, blockSize, count, out, 5, 25 );
+    default :
+        return false;
+    }
+}
+
+bool
+gunzip( const uint8_t * in, int64_t inSize, int64_t outSize, uint8_t * out )
+{
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in = const_cast < Bytef * > ( in );
+    stream.avail_in = inSize;
+    stream.next_out = out;
+    stream.avail_out = outSize;
+
+    // 15 + 32: maximum window size, detect gzip or zlib header
+    if ( inflateInit2( & stream, 15 + 32 ) != Z_OK ) {
+        return false;
+    }
+    int status = inflate( & stream, Z_FINISH );
+    int64_t produced = stream.total_out;
+    inflateEnd( & stream );
+    return ( status == Z_STREAM_END || status == Z_BUF_ERROR ) && produced == outSize;
+}
+
+void
+unshuffle( std::vector < uint8_t > & data, int elementSize )
+{
+    if ( elementSize <= 1 ) {
+        return;
+    }
+    size_t count = data.size() / elementSize;
+    std::vector < uint8_t > shuffled( data );
+    for ( size_t i = 0 ; i < count ; i++ ) {
+        for ( int k = 0 ; k < elementSize ; k++ ) {
+            data[i * elementSize + k] = shuffled[k * count + i];
+        }
+    }
+}
+
+float
+randomValue( int i )
+{
+    // the sequence from the standard (a Park-Miller generator), same as
+    // fits_init_randoms() in cfitsio
+    struct Sequence {
+        Sequence()
+        {
+            const double a = 16807.0;
+            const double m = 2147483647.0;
+            double seed = 1;
+            for ( int k = 0 ; k < RandomCount ; k++ ) {
+                double temp = a * seed;
+                seed = temp - m * static_cast < int > ( temp / m );
+                values[k] = static_cast < float > ( seed / m );
+            }
+        }
+
+        float values[RandomCount];
+    };
+    static const Sequence sequence;
+    return sequence.values[i];
+}
+}
@@ -0,0 +1,50 @@
+/**
+ * Decoders for the tiles of tile-compressed FITS images (as written by fpack), see
+ * "Tiled Image Convention for Storing Compressed Images in FITS Binary Tables"
+ * (Pence, White, Seaman) and the FITS standard 4.0, section 10.
+ *
+ * Only the algorithms that are commonly used for archives are supported: RICE_1,
+ * GZIP_1, GZIP_2 and NOCOMPRESS, including quantized floating point data with or
+ * without subtractive dithering.
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace FitsTileCompression
+{
+/// decode a Rice compressed tile
+/// \param in compressed bytes
+/// \param inSize number of compressed bytes
+/// \param bytePix size of the compressed integers (1, 2 or 4)
+/// \param blockSize number of pixels per block (BLOCKSIZE, usually 32)
+/// \param count number of pixels in the tile
+/// \param out where to store the count pixels
+/// \return false if the data is corrupted
+bool
+riceDecode( const uint8_t * in, int64_t inSize, int bytePix, int blockSize, int64_t count,
+            int32_t * out );
+
+/// inflate gzip (or zlib) compressed data
+/// \param in compressed bytes
+/// \param inSize number of compressed bytes
+/// \param outSize expected number of uncompressed bytes
+/// \param out where to store the uncompressed bytes
+/// \return false if the data is corrupted, or shorter than outSize
+bool
+gunzip( const uint8_t * in, int64_t inSize, int64_t outSize, uint8_t * out );
+
+/// undo the byte shuffling of GZIP_2, which stores the most significant bytes of all
+/// values first, then the next bytes, etc.
+void
+unshuffle( std::vector < uint8_t > & data, int elementSize );
+
+/// the i-th value of the random number sequence used for subtractive dithering
+float
+randomValue( int i );
+
+/// length of the random number sequence
+constexpr int RandomCount = 10000;
+}
@@ -0,0 +1,528 @@
+/**
+ *
+ **/
+
+#include "Hdf5Image.h"
+#include "Hdf5RawView.h"
+#include "CartaLib/PermutedImage.h"
+#include <casacore/casa/Exceptions/Error.h>
+#include <casacore/casa/Containers/Record.h>
+#include <casacore/casa/Logging/LogIO.h>
+#include <casacore/images/Images/ImageFITSConverter.h>
+#include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+
+namespace
+{
+/// all calls into the HDF5 library go through this mutex (recursive, because ids are
+/// also closed while it's held)
+QMutex &
+hdf5Mutex()
+{
+    static QMutex mutex( QMutex::Recursive );
+    return mutex;
+}
+
+/// holds the mutex, and silences the automatic error printing of HDF5 while it does
+///
+/// We report our own errors, HDF5 would print a stack trace for every file that is not
+/// an HDF5 image. The handler is process-wide state, so whatever was there before
+/// (e.g. set by casacore) is put back when the lock is released.
+class Hdf5Lock
+{
+public:
+
+    Hdf5Lock()
+        : m_locker( & hdf5Mutex() )
+    {
+        H5Eget_auto2( H5E_DEFAULT, & m_func, & m_data );
+        H5Eset_auto2( H5E_DEFAULT, nullptr, nullptr );
+    }
+
+    ~Hdf5Lock()
+    {
+        H5Eset_auto2( H5E_DEFAULT, m_func, m_data );
+    }
+
+private:
+
+    QMutexLocker m_locker;
+    H5E_auto2_t m_func = nullptr;
+    void * m_data = nullptr;
+};
+
+/// smallest prime >= n, used for the number of chunk cache slots
+int64_t
+nextPrime( int64_t n )
+{
+    for ( ; ; n++ ) {
+        bool prime = n > 1;
+        for ( int64_t d = 2 ; d * d <= n && prime ; d++ ) {
+            prime = n % d != 0;
+        }
+        if ( prime ) {
+            return n;
+        }
+    }
+}
+
+/// does the path exist in the file? (checks all the groups along the path)
+bool
+pathExists( hid_t file, const QString & path )
+{
+    QString partial;
+    for ( const QString & part : path.split( '/' ) ) {
+        partial += partial.isEmpty() ? part : "/" + part;
+        if ( H5Lexists( file, partial.toUtf8().constData(), H5P_DEFAULT ) <= 0 ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// a header card with a value
+QString
+fitsCard( const QString & key, const QString & value )
+{
+    return QString( "%1= %2" ).arg( key, - 8 ).arg( value, 20 ).leftJustified( 80, ' ' );
+}
+
+/// callback for H5Aiterate2(), adds the value of a scalar attribute to the list
+herr_t
+attributeFunc( hid_t location, const char * name, const H5A_info_t *, void * data )
+{
+    auto & result = * static_cast < std::vector < std::pair < QString, QVariant > > * > ( data );
+    Hdf5Id attr( H5Aopen( location, name, H5P_DEFAULT ), H5Aclose );
+    Hdf5Id space( H5Aget_space( attr.id() ), H5Sclose );
+    Hdf5Id type( H5Aget_type( attr.id() ), H5Tclose );
+    if ( ! attr.isValid() || ! type.isValid() || H5Sget_simple_extent_npoints( space.id() ) != 1 ) {
+        return 0;
+    }
+    QVariant value;
+    switch ( H5Tget_class( type.id() ) )
+    {
+    case H5T_STRING :
+        if ( H5Tis_variable_str( type.id() ) > 0 ) {
+            char * str = nullptr;
+            if ( H5Aread( attr.id(), type.id(), & str ) >= 0 && str ) {
+                value = QString::fromUtf8( str );
+                H5free_memory( str );
+            }
+        }
+        else {
+            std::vector < char > str( H5Tget_size( type.id() ) + 1, 0 );
+            if ( H5Aread( attr.id(), type.id(), str.data() ) >= 0 ) {
+                value = QString::fromUtf8( str.data() );
+            }
+        }
+        break;
+    case H5T_INTEGER : {
+        long long number;
+        if ( H5Aread( attr.id(), H5T_NATIVE_LLONG, & number ) >= 0 ) {
+            value = QVariant( number );
+        }
+        break;
+    }
+    case H5T_FLOAT : {
+        double number;
+        if ( H5Aread( attr.id(), H5T_NATIVE_DOUBLE, & number ) >= 0 ) {
+            value = QVariant( number );
+        }
+        break;
+    }
+    default :
+        break;
+    } // switch
+    if ( value.isValid() ) {
+        result.push_back( std::make_pair( QString( name ), value ) );
+    }
+    return 0;
+} // attributeFunc
+}
+
+constexpr int64_t Hdf5Image::MaxChunkCacheBytes;
+
+void
+Hdf5Id::reset( hid_t id, CloseFunc close )
+{
+    if ( m_id >= 0 && m_close ) {
+        Hdf5Lock lock;
+        m_close( m_id );
+    }
+    m_id = id;
+    m_close = close;
+}
+
+Hdf5Image::SharedPtr
+Hdf5Image::open( const QString & fname )
+{
+    Hdf5Lock lock;
+    QByteArray name = fname.toLocal8Bit();
+    if ( H5Fis_hdf5( name.constData() ) <= 0 ) {
+        return nullptr;
+    }
+    Hdf5Image::SharedPtr img = std::make_shared < Hdf5Image > ();
+    img-> m_file.reset( H5Fopen( name.constData(), H5F_ACC_RDONLY, H5P_DEFAULT ), H5Fclose );
+    if ( ! img-> m_file.isValid() || ! pathExists( img-> m_file.id(), "0/DATA" ) ) {
+        return nullptr;
+    }
+
+    // the dimensions of the image are the dimensions of the dataset in reverse order
+    {
+        Hdf5Id data( H5Dopen2( img-> m_file.id(), "0/DATA", H5P_DEFAULT ), H5Dclose );
+        Hdf5Id space( H5Dget_space( data.id() ), H5Sclose );
+        int rank = H5Sget_simple_extent_ndims( space.id() );
+        if ( rank < 2 ) {
+            return nullptr;
+        }
+        std::vector < hsize_t > dims( rank );
+        H5Sget_simple_extent_dims( space.id(), dims.data(), nullptr );
+        for ( int i = rank - 1 ; i >= 0 ; i-- ) {
+            img-> m_dims.push_back( dims[i] );
+        }
+    }
+    VI axes( img-> m_dims.size() );
+    for ( size_t i = 0 ; i < axes.size() ; i++ ) {
+        axes[i] = i;
+    }
+    if ( ! img-> openDataset( "0/DATA", axes, img-> m_data ) ) {
+        return nullptr;
+    }
+
+    // the rotated copy has the spectral axis fastest, then y, x (and stokes)
+    QString rotatedPath;
+    if ( img-> m_dims.size() == 3 ) {
+        rotatedPath = "0/SwizzledData/ZYX";
+        axes = { 2, 1, 0 };
+    }
+    else if ( img-> m_dims.size() == 4 ) {
+        rotatedPath = "0/SwizzledData/ZYXW";
+        axes = { 2, 1, 0, 3 };
+    }
+    if ( ! rotatedPath.isEmpty() && pathExists( img-> m_file.id(), rotatedPath ) ) {
+        if ( ! img-> openDataset( rotatedPath.toUtf8().constData(), axes, img-> m_rotated ) ) {
+            qWarning() << "Ignoring" << rotatedPath << ", it does not match the image";
+            img-> m_rotated.id.reset();
+        }
+    }
+
+    // the FITS header is stored as attributes, let casacore make sense of the
+    // world coordinates
+    std::vector < QString > lines;
+    lines.push_back( fitsCard( "SIMPLE", "T" ) );
+    lines.push_back( fitsCard( "BITPIX", "-32" ) );
+    lines.push_back( fitsCard( "NAXIS", QString::number( img-> m_dims.size() ) ) );
+    for ( size_t i = 0 ; i < img-> m_dims.size() ; i++ ) {
+        lines.push_back( fitsCard( QString( "NAXIS%1" ).arg( i + 1 ), QString::number( img-> m_dims[i] ) ) );
+    }
+    static const std::set < QString > skipped {
+        "SIMPLE", "BITPIX", "NAXIS", "EXTEND", "END", "HISTORY", "COMMENT"
+    };
+    QString title;
+    Hdf5Id group( H5Gopen2( img-> m_file.id(), "0", H5P_DEFAULT ), H5Gclose );
+    for ( auto & attr : readAttributes( group.id() ) ) {
+        const QString & key = attr.first;
+        const QVariant & value = attr.second;
+        if ( key == "BUNIT" ) {
+            img-> m_unit = Unit( value.toString().trimmed() );
+        }
+        else if ( key == "OBJECT" ) {
+            title = value.toString().trimmed();
+        }
+
+        // only proper FITS keywords
+        if ( key.length() > 8 || key.startsWith( "NAXIS" ) || skipped.count( key ) ) {
+            continue;
+        }
+        if ( value.type() == QVariant::String ) {
+            lines.push_back( fitsCard( key, "'" + value.toString().replace( "'", "''" ) + "'" ) );
+        }
+        else if ( value.type() == QVariant::Double ) {
+            lines.push_back( fitsCard( key, QString::number( value.toDouble(), 'G', 17 ) ) );
+        }
+        else {
+            lines.push_back( fitsCard( key, value.toString() ) );
+        }
+    }
+    lines.push_back( QString( "END" ).leftJustified( 80, ' ' ) );
+    casa::Vector < casa::String > header( lines.size() );
+    for ( size_t i = 0 ; i < lines.size() ; i++ ) {
+        header[i] = lines[i].toStdString();
+    }
+    try {
+        casa::Record headerRec;
+        casa::LogIO os;
+        casa::Int stokesFITSValue = 1;
+        casa::IPosition shape( img-> m_dims );
+        casa::CoordinateSystem cs = casa::ImageFITSConverter::getCoordinateSystem(
+            stokesFITSValue, headerRec, header, os, 0, shape, false );
+        if ( cs.nPixelAxes() != img-> m_dims.size() ) {
+            qWarning() << "Coordinate system does not match the image axes";
+            return nullptr;
+        }
+        img-> m_casaCS = std::make_shared < casa::CoordinateSystem > ( cs );
+    }
+    catch ( casa::AipsError & e ) {
+        qWarning() << "Could not parse coordinates:" << e.what();
+        return nullptr;
+    }
+    img-> m_htmlTitle = title.toHtmlEscaped();
+    img-> m_meta = std::make_shared < CCMetaDataInterface > ( img-> m_htmlTitle, img-> m_casaCS );
+    return img;
+} // open
+
+bool
+Hdf5Image::openDataset( const char * path, const VI & axes, Dataset & dataset )
+{
+    size_t nDims = m_dims.size();
+    Hdf5Id data( H5Dopen2( m_file.id(), path, H5P_DEFAULT ), H5Dclose );
+    Hdf5Id type( H5Dget_type( data.id() ), H5Tclose );
+    Hdf5Id space( H5Dget_space( data.id() ), H5Sclose );
+    if ( ! data.isValid() || ! type.isValid() || ! space.isValid() ) {
+        return false;
+    }
+    H5T_class_t typeClass = H5Tget_class( type.id() );
+    if ( typeClass != H5T_FLOAT && typeClass != H5T_INTEGER ) {
+        return false;
+    }
+
+    // the dataset axes are stored slowest first
+    if ( H5Sget_simple_extent_ndims( space.id() ) != int( nDims ) ) {
+        return false;
+    }
+    std::vector < hsize_t > dims( nDims ), chunk( nDims );
+    H5Sget_simple_extent_dims( space.id(), dims.data(), nullptr );
+    for ( size_t d = 0 ; d < nDims ; d++ ) {
+        if ( int64_t( dims[nDims - 1 - d] ) != m_dims[axes[d]] ) {
+            return false;
+        }
+    }
+
+    // contiguous datasets are read best one plane at a time
+    Hdf5Id createPlist( H5Dget_create_plist( data.id() ), H5Pclose );
+    bool chunked = H5Pget_layout( createPlist.id() ) == H5D_CHUNKED;
+    if ( chunked ) {
+        H5Pget_chunk( createPlist.id(), nDims, chunk.data() );
+    }
+    else {
+        for ( size_t d = 0 ; d < nDims ; d++ ) {
+            chunk[nDims - 1 - d] = d < 2 ? dims[nDims - 1 - d] : 1;
+        }
+    }
+    dataset.axes = axes;
+    dataset.chunk.resize( nDims );
+    for ( size_t d = 0 ; d < nDims ; d++ ) {
+        dataset.chunk[axes[d]] = std::max < hsize_t > ( 1, chunk[nDims - 1 - d] );
+    }
+    if ( ! chunked ) {
+        dataset.id.reset( H5Dopen2( m_file.id(), path, H5P_DEFAULT ), H5Dclose );
+        return dataset.id.isValid();
+    }
+
+    // the chunk cache holds all the chunks covering the two fastest axes of the
+    // dataset, so that they are decompressed only once when the plane is read in parts
+    int64_t chunkBytes = H5Tget_size( type.id() );
+    int64_t planeChunks = 1;
+    for ( size_t d = 0 ; d < nDims ; d++ ) {
+        int64_t n = chunk[nDims - 1 - d];
+        chunkBytes *= n;
+        if ( d < 2 ) {
+            planeChunks *= ( dims[nDims - 1 - d] + n - 1 ) / n;
+        }
+    }
+    int64_t cacheBytes = std::min( MaxChunkCacheBytes, planeChunks * chunkBytes );
+    int64_t cacheChunks = std::max < int64_t > ( 1, cacheBytes / chunkBytes );
+
+    // HDF5 suggests about 100 hash slots per chunk that fits into the cache, a prime
+    int64_t slots = nextPrime( std::min < int64_t > ( 1000003, std::max < int64_t > ( 521, cacheChunks * 100 ) ) );
+    Hdf5Id accessPlist( H5Pcreate( H5P_DATASET_ACCESS ), H5Pclose );
+    H5Pset_chunk_cache( accessPlist.id(), slots, cacheBytes, H5D_CHUNK_CACHE_W0_DEFAULT );
+    dataset.id.reset( H5Dopen2( m_file.id(), path, accessPlist.id() ), H5Dclose );
+    return dataset.id.isValid();
+} // openDataset
+
+std::vector < std::pair < QString, QVariant > >
+Hdf5Image::readAttributes( hid_t group )
+{
+    std::vector < std::pair < QString, QVariant > > result;
+    hsize_t index = 0;
+    H5Aiterate2( group, H5_INDEX_CRT_ORDER, H5_ITER_INC, & index, attributeFunc, & result );
+    if ( result.empty() ) {
+        // creation order is only available if it was tracked when the file was written
+        index = 0;
+        H5Aiterate2( group, H5_INDEX_NAME, H5_ITER_INC, & index, attributeFunc, & result );
+    }
+    return result;
+}
+
+std::shared_ptr < Image::ImageInterface >
+Hdf5Image::getPermuted( const std::vector < int > & indices )
+{
+    //Make sure the passed in indices make sense for this image.
+    int axisCount = m_dims.size();
+    int indexCount = indices.size();
+    CARTA_ASSERT( axisCount == indexCount );
+    std::set < int > usedIndices;
+    casa::Vector < int > newOrder( indexCount );
+    for ( int i = 0 ; i < indexCount ; i++ ) {
+        CARTA_ASSERT( 0 <= indices[i] && indices[i] < axisCount );
+        CARTA_ASSERT( usedIndices.count( indices[i] ) == 0 );
+        usedIndices.insert( indices[i] );
+        newOrder[i] = indices[i];
+    }
+
+    //Change the order of the axes in the coordinate system
+    auto coordSys = std::make_shared < casa::CoordinateSystem > ( * m_casaCS );
+    coordSys-> transpose( newOrder, newOrder );
+    auto meta = std::make_shared < CCMetaDataInterface > ( m_htmlTitle, coordSys );
+
+    //Create a CARTA image with permuted axes that reads from this one.
+    return std::make_shared < Carta::Lib::PermutedImage > ( shared_from_this(), indices, meta );
+}
+
+NdArray::RawViewInterface *
+Hdf5Image::getDataSlice( const SliceND & sliceInfo )
+{
+    return new Hdf5RawView( this, sliceInfo );
+}
+
+bool
+Hdf5Image::getPixel( const VI & pos, double & value )
+{
+    if ( pos.size() != m_dims.size() ) {
+        return false;
+    }
+    for ( size_t i = 0 ; i < pos.size() ; i++ ) {
+        if ( pos[i] < 0 || pos[i] >= m_dims[i] ) {
+            return false;
+        }
+    }
+    VI ones( pos.size(), 1 );
+    float pixel;
+    if ( ! readBox( pos, ones, ones, & pixel ) ) {
+        return false;
+    }
+    value = pixel;
+    return true;
+}
+
+bool
+Hdf5Image::getRow( const VI & pos, double * row )
+{
+    if ( pos.size() != m_dims.size() ) {
+        return false;
+    }
+    for ( size_t i = 1 ; i < pos.size() ; i++ ) {
+        if ( pos[i] < 0 || pos[i] >= m_dims[i] ) {
+            return false;
+        }
+    }
+    VI blc = pos;
+    blc[0] = 0;
+    VI shape( pos.size(), 1 );
+    shape[0] = m_dims[0];
+    VI step( pos.size(), 1 );
+    if ( ! readBox( blc, shape, step, reinterpret_cast < float * > ( row ) ) ) {
+        return false;
+    }
+    widenRow < float > ( row, m_dims[0] );
+    return true;
+}
+
+bool
+Hdf5Image::readBox( const VI & blc, const VI & shape, const VI & step, float * out )
+{
+    CARTA_ASSERT( blc.size() == m_dims.size() && shape.size() == m_dims.size()
+                  && step.size() == m_dims.size() );
+    for ( int n : shape ) {
+        if ( n <= 0 ) {
+            return true;
+        }
+    }
+
+    // spectral profiles and other boxes that are longer along the spectral axis than
+    // they are wide come from the rotated copy
+    bool spectral = hasRotatedData() && shape[2] > int64_t( shape[0] ) * shape[1];
+    Hdf5Lock lock;
+    if ( ! readDataset( spectral ? m_rotated : m_data, blc, shape, step, out ) ) {
+        qWarning() << "Could not read from HDF5 image";
+        return false;
+    }
+    return true;
+}
+
+bool
+Hdf5Image::readDataset( const Dataset & dataset, const VI & blc, const VI & shape,
+                        const VI & step, float * out )
+{
+    // the selection in dataset order (slowest first), with positive strides
+    size_t nDims = m_dims.size();
+    std::vector < hsize_t > start( nDims ), stride( nDims ), count( nDims );
+    bool direct = true;
+    int64_t total = 1;
+    for ( size_t d = 0 ; d < nDims ; d++ ) {
+        int a = dataset.axes[d];
+        size_t h = nDims - 1 - d;
+        start[h] = step[a] > 0 ? blc[a] : blc[a] + int64_t( shape[a] - 1 ) * step[a];
+        stride[h] = std::abs( step[a] );
+        count[h] = shape[a];
+        total *= shape[a];
+        direct = direct && a == int( d ) && step[a] > 0;
+    }
+    Hdf5Id fileSpace( H5Dget_space( dataset.id.id() ), H5Sclose );
+    Hdf5Id memSpace( H5Screate_simple( nDims, count.data(), nullptr ), H5Sclose );
+    if ( H5Sselect_hyperslab( fileSpace.id(), H5S_SELECT_SET, start.data(), stride.data(),
+                              count.data(), nullptr ) < 0 ) {
+        return false;
+    }
+
+    // the selection is read straight into out if it's in the same order
+    std::vector < float > buff;
+    if ( ! direct ) {
+        buff.resize( total );
+    }
+    if ( H5Dread( dataset.id.id(), H5T_NATIVE_FLOAT, memSpace.id(), fileSpace.id(), H5P_DEFAULT,
+                  direct ? out : buff.data() ) < 0 ) {
+        return false;
+    }
+    if ( direct ) {
+        return true;
+    }
+
+    // otherwise move the pixels into place: the distance in out between neighbours
+    // along each dataset axis (negative for reversed axes)
+    std::vector < int64_t > outStrides( nDims ), delta( nDims );
+    int64_t outStride = 1;
+    for ( size_t i = 0 ; i < nDims ; i++ ) {
+        outStrides[i] = outStride;
+        outStride *= shape[i];
+    }
+    int64_t outIndex = 0;
+    for ( size_t d = 0 ; d < nDims ; d++ ) {
+        int a = dataset.axes[d];
+        delta[d] = step[a] > 0 ? outStrides[a] : - outStrides[a];
+        if ( step[a] < 0 ) {
+            outIndex += int64_t( shape[a] - 1 ) * outStrides[a];
+        }
+    }
+    VI k( nDims, 0 );
+    int64_t rowLength = shape[dataset.axes[0]];
+    for ( int64_t i = 0 ; i < total ; i += rowLength ) {
+        for ( int64_t j = 0 ; j < rowLength ; j++ ) {
+            out[outIndex + j * delta[0]] = buff[i + j];
+        }
+        for ( size_t d = 1 ; d < nDims ; d++ ) {
+            outIndex += delta[d];
+            if ( ++k[d] < shape[dataset.axes[d]] ) {
+                break;
+            }
+            outIndex -= delta[d] * shape[dataset.axes[d]];
+            k[d] = 0;
+        }
+    }
+    return true;
+} // readDataset
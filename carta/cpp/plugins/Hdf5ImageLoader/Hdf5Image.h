@@ -0,0 +1,246 @@
+/**
+ * Image interface for chunked HDF5 images, read with the HDF5 library directly.
+ *
+ * The supported layout is the one used by the IDIA HDF5 converter: the image is the
+ * float dataset "0/DATA" (axes stored in reverse order, i.e. the last dataset axis is
+ * the first image axis), and the FITS header is stored as attributes of the group "0".
+ * Files can also contain a copy of the cube with the spectral axis fastest, in
+ * "0/SwizzledData/ZYX" (3D) or "0/SwizzledData/ZYXW" (4D). When it is present, reads
+ * that cover more channels than pixels of a plane (i.e. spectral profiles) are served
+ * from the rotated copy, so extracting a spectrum touches a few chunks instead of one
+ * chunk per channel.
+ *
+ * Reads are done with hyperslab selections straight into the caller's buffer. The
+ * chunk cache of each dataset is sized so that a whole plane of chunks (along its two
+ * fastest axes) fits, up to MaxChunkCacheBytes, so reading a plane row by row does not
+ * decompress the same chunk over and over. The chunk shape is used by the views for
+ * Traversal::Optimal.
+ *
+ * The HDF5 library is usually not built thread safe, so all calls go through a single
+ * process-wide mutex. The mutex only serializes this plugin: casacore links the same
+ * library for its own HDF5 images and does not take it, so opening an HDF5 image with
+ * the CasaImageLoader while this plugin reads is not safe with a non thread safe build.
+ * HDF5's automatic error printing is turned off only while the mutex is held.
+ *
+ * Other HDF5 files (e.g. written by casacore) are left to the CasaImageLoader plugin.
+ * Casacore can't read this layout, so getCasaImage() returns nullptr.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include "../CasaImageLoader/CCImage.h"
+#include "../CasaImageLoader/CCMetaDataInterface.h"
+#include <hdf5.h>
+#include <QString>
+#include <QVariant>
+#include <memory>
+#include <vector>
+
+/// owns an HDF5 identifier, and closes it with the matching close function
+class Hdf5Id
+{
+    CLASS_BOILERPLATE( Hdf5Id );
+
+public:
+
+    typedef herr_t ( * CloseFunc )( hid_t );
+
+    Hdf5Id( hid_t id = - 1, CloseFunc close = nullptr )
+        : m_id( id )
+          , m_close( close )
+    { }
+
+    Hdf5Id( const Hdf5Id & ) = delete;
+
+    Hdf5Id &
+    operator= ( const Hdf5Id & ) = delete;
+
+    ~Hdf5Id()
+    {
+        reset();
+    }
+
+    /// close the current identifier and take ownership of a new one
+    void
+    reset( hid_t id = - 1, CloseFunc close = nullptr );
+
+    hid_t
+    id() const
+    {
+        return m_id;
+    }
+
+    bool
+    isValid() const
+    {
+        return m_id >= 0;
+    }
+
+private:
+
+    hid_t m_id;
+    CloseFunc m_close;
+};
+
+class Hdf5Image
+    : public CCImageBase
+      , public std::enable_shared_from_this < Hdf5Image >
+{
+    CLASS_BOILERPLATE( Hdf5Image );
+
+public:
+
+    /// upper limit for the chunk cache of a dataset
+    static constexpr int64_t MaxChunkCacheBytes = 256 * 1024 * 1024;
+
+    /// open an image in the IDIA HDF5 layout
+    /// \return the image, or nullptr if the file is not such an image
+    static Hdf5Image::SharedPtr
+    open( const QString & fname );
+
+    virtual const Unit &
+    getPixelUnit() const override
+    {
+        return m_unit;
+    }
+
+    /// returns a Carta::Lib::PermutedImage reading from this image
+    virtual std::shared_ptr < Image::ImageInterface >
+    getPermuted( const std::vector < int > & indices ) override;
+
+    virtual const VI &
+    dims() const override
+    {
+        return m_dims;
+    }
+
+    virtual bool
+    hasMask() const override
+    {
+        return false;
+    }
+
+    virtual bool
+    hasErrorsInfo() const override
+    {
+        return false;
+    }
+
+    virtual Image::PixelType
+    pixelType() const override
+    {
+        return Image::PixelType::Real32;
+    }
+
+    virtual Image::PixelType
+    errorType() const override
+    {
+        qFatal( "not implemented" );
+    }
+
+    virtual NdArray::RawViewInterface *
+    getDataSlice( const SliceND & sliceInfo ) override;
+
+    /// \todo implement this
+    virtual NdArray::Byte *
+    getMaskSlice( const SliceND & sliceInfo ) override
+    {
+        Q_UNUSED( sliceInfo );
+        qFatal( "not implemented" );
+    }
+
+    /// \todo implement this
+    virtual NdArray::RawViewInterface *
+    getErrorSlice( const SliceND & sliceInfo ) override
+    {
+        Q_UNUSED( sliceInfo );
+        qFatal( "not implemented" );
+    }
+
+    virtual bool
+    getPixel( const VI & pos, double & value ) override;
+
+    virtual bool
+    getRow( const VI & pos, double * row ) override;
+
+    virtual Image::MetaDataInterface::SharedPtr
+    metaData() override
+    {
+        return m_meta;
+    }
+
+    /// casacore can't read this layout
+    virtual casa::LatticeBase *
+    getCasaImage() override
+    {
+        return nullptr;
+    }
+
+    /// read a box of the image, first axis fastest
+    /// \param blc first pixel of the box
+    /// \param shape number of pixels of the box along each axis
+    /// \param step step along each axis (may be negative)
+    /// \param out where to store the pixels
+    /// \return false if HDF5 reported an error
+    bool
+    readBox( const VI & blc, const VI & shape, const VI & step, float * out );
+
+    /// chunk shape of the image (first axis fastest)
+    const VI &
+    chunkShape() const
+    {
+        return m_data.chunk;
+    }
+
+    /// is there a rotated copy of the cube with the spectral axis fastest?
+    bool
+    hasRotatedData() const
+    {
+        return m_rotated.id.isValid();
+    }
+
+    Hdf5Image() { }
+
+    virtual
+    ~Hdf5Image() { }
+
+protected:
+
+    /// a dataset holding the cube in some axis order
+    struct Dataset {
+        Hdf5Id id;
+
+        /// image axis of each dataset axis (fastest first)
+        VI axes;
+
+        /// chunk shape (image axis order)
+        VI chunk;
+    };
+
+    /// open a dataset, and size its chunk cache
+    /// \param axes image axis of each dataset axis (fastest first)
+    /// \return false if the dataset does not exist, or does not match the image
+    bool
+    openDataset( const char * path, const VI & axes, Dataset & dataset );
+
+    /// read the scalar attributes of a group (strings, integers and floats)
+    static std::vector < std::pair < QString, QVariant > >
+    readAttributes( hid_t group );
+
+    /// read a box from a dataset (caller must hold the HDF5 mutex)
+    bool
+    readDataset( const Dataset & dataset, const VI & blc, const VI & shape, const VI & step,
+                 float * out );
+
+    Hdf5Id m_file;
+    Dataset m_data;
+    Dataset m_rotated;
+
+    VI m_dims;
+    Unit m_unit;
+    std::shared_ptr < casa::CoordinateSystem > m_casaCS;
+    QString m_htmlTitle;
+    CCMetaDataInterface::SharedPtr m_meta;
+};
@@ -0,0 +1,57 @@
+#include "Hdf5ImageLoader.h"
+#include "Hdf5Image.h"
+#include "CartaLib/Hooks/LoadAstroImage.h"
+#include <QDebug>
+
+typedef Carta::Lib::Hooks::LoadAstroImage LoadAstroImage;
+
+Hdf5ImageLoader::Hdf5ImageLoader(QObject *parent) :
+    QObject(parent)
+{
+}
+
+bool Hdf5ImageLoader::handleHook(BaseHook & hookData)
+{
+    qDebug() << "Hdf5ImageLoader plugin is handling hook #" << hookData.hookId();
+    if( hookData.is<Initialize>()) {
+        return true;
+    }
+
+    else if( hookData.is<LoadAstroImage>()) {
+        LoadAstroImage & hook = static_cast<LoadAstroImage &>( hookData);
+        auto fname = hook.paramsPtr->fileName;
+        hook.result = loadImage( fname);
+        // return true if result is not null, so that other loaders get a chance
+        // with files we don't understand
+        return hook.result != nullptr;
+    }
+
+    qWarning() << "Sorrry, dont' know how to handle this hook";
+    return false;
+}
+
+std::vector<HookId> Hdf5ImageLoader::getInitialHookList()
+{
+    return {
+        Initialize::staticId,
+        LoadAstroImage::staticId
+    };
+}
+
+///
+/// \brief Attempts to open an HDF5 image in the IDIA layout.
+/// \param fname file name with the image
+/// \return the image, or nullptr if the file is not such an image
+///
+Image::ImageInterface::SharedPtr Hdf5ImageLoader::loadImage( const QString & fname)
+{
+    qDebug() << "Hdf5ImageLoader plugin trying to load image: " << fname;
+    Hdf5Image::SharedPtr res = Hdf5Image::open( fname);
+    if( ! res) {
+        qDebug() << "\t-not a chunked HDF5 image";
+        return nullptr;
+    }
+    qDebug() << "Created image interface with chunks" << res->chunkShape()
+             << (res->hasRotatedData() ? "and rotated data" : "");
+    return res;
+}
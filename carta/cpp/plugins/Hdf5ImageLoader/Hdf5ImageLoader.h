@@ -0,0 +1,25 @@
+/// This plugin reads chunked HDF5 images with the HDF5 library.
+
+#pragma once
+
+#include "CartaLib/IPlugin.h"
+#include <QObject>
+#include <QString>
+
+
+class Hdf5ImageLoader : public QObject, public IPlugin
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "org.cartaviewer.IPlugin")
+    Q_INTERFACES( IPlugin)
+
+public:
+
+    Hdf5ImageLoader(QObject *parent = 0);
+    virtual bool handleHook(BaseHook & hookData) override;
+    virtual std::vector<HookId> getInitialHookList() override;
+
+private:
+
+    Image::ImageInterface::SharedPtr loadImage(const QString & fname);
+};
@@ -0,0 +1,118 @@
+/**
+ *
+ **/
+
+#pragma once
+
+#include "CartaLib/IImage.h"
+#include <vector>
+
+class Hdf5Image;
+
+/// Hdf5ImageLoader plugin's implementation of the raw view
+///
+/// Sequential reads are split into the largest boxes of the image that are contiguous
+/// in the view (whole planes, whole rows, or a part of a row), and each box is read
+/// with a single hyperslab selection by Hdf5Image::readBox(). A single view is not
+/// thread safe.
+///
+/// With Traversal::Optimal, the view is visited in blocks that follow the chunk shape
+/// of the image, so every chunk is read only once, but the blocks are not in sequential
+/// order.
+class Hdf5RawView
+    : public NdArray::RawViewInterface
+{
+public:
+
+    /// construct a view on an image from provided slice information
+    /// \param image pointer to the image which we keep on using, but we don't assume
+    /// ownership. It has to remain valid for the duration of existance of this instance.
+    /// \param sliceInfo for which part of the image to create view
+    Hdf5RawView( Hdf5Image * image, const SliceND & sliceInfo );
+
+    virtual PixelType
+    pixelType() override;
+
+    virtual const VI &
+    dims() override
+    {
+        return m_viewDims;
+    }
+
+    virtual const char *
+    get( const VI & pos ) override;
+
+    virtual void
+    forEach( std::function < void (const char *) > func, Traversal traversal ) override;
+
+    virtual const VI &
+    currentPos() override
+    {
+        return m_currPosView;
+    }
+
+    virtual RawViewInterface *
+    getView( const SliceND & sliceInfo ) override;
+
+    /// read the next buffSize bytes of the view, starting at the position set by seek()
+    virtual int64_t
+    read( int64_t buffSize, char * buff,
+          Traversal traversal = Traversal::Sequential ) override;
+
+    /// set the position (in elements) of the next read()
+    virtual void
+    seek( int64_t ind ) override
+    {
+        m_readPos = ind;
+    }
+
+    virtual int64_t
+    read( int64_t chunk, int64_t buffSize, char * buff,
+          Traversal traversal = Traversal::Sequential ) override;
+
+    /// The view is read in blocks of at most buffSize bytes.
+    virtual void
+    forEach(
+        int64_t buffSize,
+        std::function < void (const char *, int64_t count) > func,
+        char * buff = nullptr,
+        Traversal traversal = Traversal::Sequential ) override;
+
+protected:
+
+    /// default block size (in elements) used by the element-wise forEach()
+    static constexpr int64_t DefaultChunkSize = 1024 * 1024;
+
+    /// construct a view directly from applied slice
+    Hdf5RawView( Hdf5Image * image, const SliceND::ApplyResult & applyResult );
+
+    /// total number of elements in the view
+    int64_t
+    nElements() const;
+
+    /// chunk aligned block shape (in view coordinates) with at most maxElements elements
+    VI
+    optimalCursorShape( int64_t maxElements ) const;
+
+    /// read a box of the view
+    void
+    readBox( const VI & viewStart, const VI & shape, float * out );
+
+    /// read elements [start, start+count) of the view in sequential order
+    /// \return number of elements read
+    int64_t
+    readElements( int64_t start, int64_t count, float * out );
+
+    Hdf5Image * m_image = nullptr; // we don't own this!
+    SliceND::ApplyResult m_appliedSlice;
+    VI m_viewDims, m_currPosView;
+
+    /// first pixel of the view and the step along each axis, in image coordinates
+    VI m_start, m_step;
+
+    // buffer for reporting results when calling get()
+    float m_buff;
+
+    // position (in elements) of the next stateful read()
+    int64_t m_readPos = 0;
+};
@@ -254,7 +254,7 @@ bool Histogram1::handleHook( BaseHook & hookData ){
                 ImageHistogram<casa::Float>* hist = new ImageHistogram<casa::Float>();
                 m_histogram.reset( hist );
                 if( casaImage ){
-                    hist->setImage( casaImage );
+                    hist->setImage( casaImage, images.front() );
                 }
             }
         }
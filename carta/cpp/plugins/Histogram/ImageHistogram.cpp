@@ -3,23 +3,16 @@
 #include <QtCore/qmath.h>
 #include "CartaLib/IImage.h"
 #include "ImageHistogram.h"
-#include <casacore/images/Images/SubImage.h>
-#include <casacore/images/Regions/ImageRegion.h>
-#include <casacore/casa/version.h>
-#ifdef CASACORE_VERSION
-#include <casacore/lattices/LatticeMath/LatticeHistograms.h>
-#else
-#include <casacore/lattices/Lattices/LatticeHistograms.h>
-#endif
+#include <casacore/images/Images/ImageInterface.h>
 #include "CartaLib/Hooks/LoadAstroImage.h"
 #include "plugins/CasaImageLoader/CasaImageLoader.h"
 #include <casacore/casa/Arrays/Vector.h>
 #include <casacore/casa/BasicSL/String.h>
+#include <limits>
 
 
 template <class T>
 ImageHistogram<T>::ImageHistogram( ):
-	m_histogramMaker(NULL), m_region(NULL),
 	ALL_CHANNELS(-1),
 	ALL_INTENSITIES( -1),
 	m_image(nullptr),
@@ -75,51 +68,81 @@ void ImageHistogram<T>::setIntensityRange( double minimumIntensity, double maxim
 template <class T>
 bool ImageHistogram<T>::compute( ){
 	bool success = true;
-	if ( m_histogramMaker != NULL ){
-
-		//Set the number of bins.
-		m_histogramMaker->setNBins( m_binCount );
+	if ( m_dataSource ){
 
 		//Set the intensity range.
-		casa::Vector<T> includeRange;
+		double minIntensity = -std::numeric_limits<double>::infinity();
+		double maxIntensity = std::numeric_limits<double>::infinity();
 		if ( m_intensityMin != ALL_INTENSITIES && m_intensityMax != ALL_INTENSITIES ){
-			includeRange.resize(2);
-			includeRange[0] = m_intensityMin;
-			includeRange[1] = m_intensityMax;
+			minIntensity = m_intensityMin;
+			maxIntensity = m_intensityMax;
 		}
-		m_histogramMaker->setIncludeRange( includeRange );
 		try {
 
-			//Calculate the histogram
-			casa::Array<T> values;
-			casa::Array<T> counts;
-			success = m_histogramMaker->getHistograms( values, counts );
-			if ( success ){
+			//Rebin the fine histogram, counting the pixels only if needed.
+			Carta::Core::Algorithms::FineHistogram::SharedPtr fineHistogram =
+			        _getFineHistogram( minIntensity, maxIntensity );
+			if ( fineHistogram ){
+				std::vector< std::pair<double,double> > data =
+				        fineHistogram->rebin( m_binCount, minIntensity, maxIntensity );
+
 				//Store the data
-				m_xValues.resize( values.size());
-				m_yValues.resize( counts.size());
-				values.tovector( m_xValues );
-				counts.tovector( m_yValues );
+				int dataCount = data.size();
+				m_xValues.resize( dataCount );
+				m_yValues.resize( dataCount );
+				for ( int i = 0; i < dataCount; i++ ){
+					m_xValues[i] = data[i].first;
+					m_yValues[i] = data[i].second;
+				}
+			}
+			else {
+				success = false;
 			}
 		}
-		catch( casa::AipsError& error ){
+		catch( std::exception& error ){
 			success = false;
 			qDebug() << "Exception: "<<error.what();
 		}
 	}
 	else {
-	    qDebug() << "m_histogram maker was null";
+	    qDebug() << "histogram image was null";
 		success = false;
 	}
 	return success;
 }
 
 template <class T>
-casa::LatticeHistograms<T>* ImageHistogram<T>::_filterByChannels( const casa::ImageInterface<T> * image ){
-	casa::LatticeHistograms<T>* imageHistogram = NULL;
+Carta::Core::Algorithms::FineHistogram::SharedPtr ImageHistogram<T>::_getFineHistogram(
+        double minIntensity, double maxIntensity ){
+	if ( m_fullHistogram && m_fullHistogram->covers( m_binCount, minIntensity, maxIntensity ) ){
+		return m_fullHistogram;
+	}
+	if ( m_rangeHistogram && m_rangeHistogram->covers( m_binCount, minIntensity, maxIntensity ) ){
+		return m_rangeHistogram;
+	}
+	std::unique_ptr<NdArray::RawViewInterface> view( _filterByChannels() );
+	if ( !view ){
+		return nullptr;
+	}
+
+	//Count all the intensities first, so later intensity ranges are likely covered.
+	if ( !m_fullHistogram ){
+		m_fullHistogram = Carta::Core::Algorithms::FineHistogram::compute( view.get() );
+		if ( m_fullHistogram->covers( m_binCount, minIntensity, maxIntensity ) ){
+			return m_fullHistogram;
+		}
+	}
+	m_rangeHistogram = Carta::Core::Algorithms::FineHistogram::compute( view.get(),
+	        minIntensity, maxIntensity );
+	return m_rangeHistogram;
+}
+
+template <class T>
+NdArray::RawViewInterface* ImageHistogram<T>::_filterByChannels() const {
+	NdArray::RawViewInterface* view = nullptr;
 	if ( m_channelMin != ALL_CHANNELS && m_channelMax != ALL_CHANNELS ){
-		//Create a slicer from the image
-		casa::CoordinateSystem cSys = image->coordinates();
+		//Create a slice from the image
+		casa::CoordinateSystem cSys = m_image->coordinates();
 		if ( cSys.hasSpectralAxis() ){
 			//We use the preset spectral coordinate, if it
 			//exists because images can be rotated when they
@@ -127,86 +150,51 @@ casa::LatticeHistograms<T>* ImageHistogram<T>::_filterByChannels( const casa::Im
 			//take rotation into account.
 			int spectralIndex = cSys.spectralAxisNumber();
 			if ( spectralIndex >= 0 ){
-                casa::IPosition imShape = image->shape();
-
-                int shapeCount = imShape.nelements();
-                casa::IPosition startPos( shapeCount, 0);
-                casa::IPosition endPos(imShape - 1);
-                casa::IPosition stride( shapeCount, 1);
+                const std::vector<int>& imShape = m_dataSource->dims();
+                int shapeCount = imShape.size();
 
                 int endIndex = m_channelMax;
-                if ( m_channelMax >= imShape(spectralIndex) && m_channelMin < imShape(spectralIndex)){
-                    endIndex = imShape(spectralIndex) - 1;
+                if ( m_channelMax >= imShape[spectralIndex] && m_channelMin < imShape[spectralIndex]){
+                    endIndex = imShape[spectralIndex] - 1;
+                }
+                if ( 0 <= m_channelMin && m_channelMin <= endIndex ){
+                    SliceND channelSlice;
+                    for ( int i = 0; i < shapeCount; i++ ){
+                        if ( i == spectralIndex ){
+                            channelSlice.start( m_channelMin );
+                            channelSlice.end( endIndex + 1 );
+                        }
+                        if ( i < shapeCount - 1 ){
+                            channelSlice.next();
+                        }
+                    }
+                    view = m_dataSource->getDataSlice( channelSlice );
                 }
-
-                startPos[spectralIndex] = m_channelMin;
-                endPos[spectralIndex] = endIndex;
-
-                casa::Slicer channelSlicer( startPos, endPos, stride, casa::Slicer::endIsLast );
-                m_subImage.reset(new casa::SubImage<T> (*image, channelSlicer ));
-                imageHistogram = new casa::LatticeHistograms<T>( *m_subImage.get() );
 			}
 		}
 	}
 	else {
-		imageHistogram = new casa::LatticeHistograms<T>( *m_image );
+		view = m_dataSource->getDataSlice( SliceND() );
 	}
-	return imageHistogram;
+	return view;
 }
 
 template <class T>
-void ImageHistogram<T>::setImage( casa::ImageInterface<T> *  val ){
-    if ( val != nullptr ){
+void ImageHistogram<T>::setImage( casa::ImageInterface<T> *  val,
+        std::shared_ptr<Image::ImageInterface> dataSource ){
+    if ( val != nullptr && dataSource ){
         m_image = val;
+        m_dataSource = dataSource;
 	    _reset();
 	}
 }
 
-template <class T>
-void ImageHistogram<T>::setRegion( casa::ImageRegion* region ){
-	this->m_region = region;
-}
-
 template <class T>
 bool ImageHistogram<T>::_reset(){
-	bool success = true;
-	if ( m_image != nullptr ){
-		if ( m_histogramMaker != NULL ){
-			//delete m_histogramMaker;
-			m_histogramMaker = NULL;
-		}
-		try {
-			if ( m_region == NULL ){
-				//Make the histogram based on the image
-				m_histogramMaker = _filterByChannels( m_image );
-			}
-			else {
-				//Make the histogram based on the region
-				m_subImage.reset(new casa::SubImage<T>( *m_image, *m_region ));
-				if ( m_subImage.get() != NULL ){
-					m_histogramMaker = _filterByChannels( m_subImage.get() );
-				}
-				else {
-					success = false;
-				}
-			}
-			if ( success ){
-				success = compute();
-			}
-		}
-		catch( casa::AipsError& error ){
-			success = false;
-			/*if ( heightSource != NULL ){
-				QString msg( "Could not make a histogram of the region: ");
-				msg.append( error.getMesg().c_str() );
-				heightSource->postMessage( msg );
-			}*/
-		}
-	}
-	else {
-		success = false;
-	}
-	return success;
+	//The pixels are counted again by the next compute.
+	m_fullHistogram.reset();
+	m_rangeHistogram.reset();
+	return m_dataSource != nullptr;
 }
 
 template <class T>
@@ -375,8 +363,6 @@ void ImageHistogram<T>::toAscii( QTextStream& out ) const {
 
 template <class T>
 ImageHistogram<T>::~ImageHistogram() {
-	delete m_histogramMaker;
-	//delete m_subImage;
 }
 
 template class ImageHistogram<float>;
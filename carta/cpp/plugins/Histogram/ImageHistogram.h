@@ -5,6 +5,8 @@
 #include <casacore/casa/aipstype.h>
 #include <casacore/casa/vector.h>
 #include "IImageHistogram.h"
+#include "CartaLib/IImage.h"
+#include "core/Algorithms/FineHistogram.h"
 #include <QTextStream>
 
 
@@ -12,14 +14,15 @@
 
 namespace casa {
     template <class T> class ImageInterface;
-    template <class T> class LatticeHistograms;
-    template <class T> class SubImage;
-    class ImageRegion;
     class String;
 }
 
 /**
  * Generates and Manages the data corresponding to a histogram.
+ *
+ * The pixels of the channel range are counted once into a fine histogram, and the
+ * histogram for the bin count and intensity range is rebinned from it, so changing those
+ * doesn't read the pixels again unless the bins would be finer than the fine bins.
  */
 template <class T>
 class ImageHistogram : public IImageHistogram {
@@ -33,7 +36,6 @@ public:
     virtual bool compute() Q_DECL_OVERRIDE;
 
 	int getDataCount() const;
-	void setRegion(casa::ImageRegion* region);
 	void defineLine( int index, QVector<double>& xVals, QVector<double>& yVals,
 			bool useLogY ) const;
 	void defineStepHorizontal( int index, QVector<double>& xVals, QVector<double>& yVals,
@@ -56,7 +58,12 @@ public:
 
 	void setIntensityRange( double minimumIntensity, double maximumIntensity )  Q_DECL_OVERRIDE;
 
-	void setImage(casa::ImageInterface<T> *  val);
+	/**
+	 * Sets the image.
+	 * @param val the casa image, used for the name and units.
+	 * @param dataSource the same image, used for the pixels.
+	 */
+	void setImage(casa::ImageInterface<T> *  val, std::shared_ptr<Image::ImageInterface> dataSource );
 	static double computeYValue( double value, bool useLog );
 
 signals:
@@ -65,15 +72,22 @@ signals:
 private:
 	ImageHistogram( const ImageHistogram<T>& other );
 	ImageHistogram operator=( const ImageHistogram<T>& other );
-	//Completely reset the histogram if the image, region, or channels change
+	//Completely reset the histogram if the image or channels change
 	bool _reset();
-	casa::LatticeHistograms<T>* _filterByChannels( const casa::ImageInterface<T>*  image );
+	//Returns a view of the pixels in the channel range, nullptr if there are none.
+	NdArray::RawViewInterface* _filterByChannels() const;
+	//Returns a fine histogram that can be rebinned for the intensity range, counting
+	//the pixels again if neither of the current ones can.
+	Carta::Core::Algorithms::FineHistogram::SharedPtr _getFineHistogram( double minIntensity,
+	        double maxIntensity );
 
 	vector<T> m_xValues;
 	vector<T> m_yValues;
-	casa::LatticeHistograms<T>* m_histogramMaker;
-	casa::ImageRegion* m_region;
-	std::shared_ptr<casa::SubImage<T> > m_subImage;
+	//Fine histogram of all the intensities in the channel range.
+	Carta::Core::Algorithms::FineHistogram::SharedPtr m_fullHistogram;
+	//Fine histogram of an intensity range too narrow for the full one.
+	Carta::Core::Algorithms::FineHistogram::SharedPtr m_rangeHistogram;
+	std::shared_ptr<Image::ImageInterface> m_dataSource;
 	const int ALL_CHANNELS;
 	const int ALL_INTENSITIES;
     const casa::ImageInterface<T>*  m_image; //Use
@@ -9,6 +9,8 @@ SUBDIRS += casaCore-2.0.1
 SUBDIRS += python273
 SUBDIRS += noisepy
 SUBDIRS += blurpy
+SUBDIRS += FitsImageLoader
+SUBDIRS += Hdf5ImageLoader
 SUBDIRS += CasaImageLoader
 SUBDIRS += Colormaps1
 SUBDIRS += Histogram
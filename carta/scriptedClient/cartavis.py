@@ -279,6 +279,22 @@ class Cartavis:
         result = self.con.cmdTagList("getPluginList")
         return result
 
+    def getCacheStatistics(self):
+        """
+        Returns the usage counters of the server's render caches.
+
+        Returns
+        -------
+        list
+            The first entry is "total <budget> <bytes>", followed by one
+            entry per cache category in the form
+            "<category> <budget> <bytes> <entries> <hits> <misses> <evictions>".
+            Budgets and sizes are in bytes, a budget of -1 means the category
+            is only limited by the total budget.
+        """
+        result = self.con.cmdTagList("getCacheStatistics")
+        return result
+
     def getEmptyWindowCount(self):
         """
         Returns the number of empty windows in the application.
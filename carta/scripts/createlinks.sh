@@ -64,6 +64,19 @@ rmsymlink wcslib-shared/include
 ln -s $LIBWCS wcslib-shared/include
 ln -s $GNULIB  wcslib-shared/lib
 
+#
+# hdf5  installation location
+# do not change is unless you ibstalled it in your own directory
+#
+mkdir -p hdf5-shared
+rmsymlink hdf5-1.8.16-shared
+ln -s hdf5-shared ./hdf5-1.8.16-shared
+export LIBHDF5=$GNULIB/hdf5/serial
+rmsymlink hdf5-shared/lib
+rmsymlink hdf5-shared/include
+ln -s $LIBHDF5 hdf5-shared/lib
+ln -s /usr/include/hdf5/serial hdf5-shared/include
+
 #
 #rapidjson installation location
 #
@@ -70,6 +70,21 @@ rmsymlink wcslib-shared/include
 ln -s $LIBWCS_LIB wcslib-shared/lib
 ln -s $LIBWCS_INCLUDE wcslib-shared/include
 
+#
+# hdf5  installation location
+# do not change is unless you ibstalled it in your own directory
+#
+mkdir -p hdf5-shared
+rmsymlink hdf5-1.8.16-shared
+ln -s hdf5-shared ./hdf5-1.8.16-shared
+export LIBHDF5_INCLUDE=/usr/local/opt/hdf5/include
+export LIBHDF5_LIB=/usr/local/opt/hdf5/lib
+
+rmsymlink hdf5-shared/lib
+rmsymlink hdf5-shared/include
+ln -s $LIBHDF5_LIB hdf5-shared/lib
+ln -s $LIBHDF5_INCLUDE hdf5-shared/include
+
 #
 #rapidjson installation location
 #